@@ -0,0 +1,130 @@
+// AssetPoolBench.cpp
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+import AssetPool;
+import LegacyAssetPool;
+
+// About the size of the demos' render objects, so the pools' layouts show in the cache misses
+struct BenchAsset
+{
+	std::array<std::uint64_t, 8> data{};
+};
+
+struct BenchResult
+{
+	double add_ns = 0.0; // per asset, into an empty pool
+	double remove_ns = 0.0; // per asset, every other one
+	double get_ns = 0.0; // per lookup, in random order, half of the ids removed
+	double for_each_ns = 0.0; // per live asset, half of the slots free
+	double add_reuse_ns = 0.0; // per asset, into the free slots
+};
+
+constexpr std::uint32_t AssetCount = 1 << 18;
+constexpr std::uint32_t Repetitions = 5;
+
+using Clock = std::chrono::steady_clock;
+
+double ns_per_op(Clock::time_point begin, Clock::time_point end, std::uint32_t op_count)
+{
+	return std::chrono::duration<double, std::nano>(end - begin).count() / op_count;
+}
+
+// Keeps the reads from being optimized out
+volatile std::uint64_t g_sink = 0;
+
+template <typename PoolT>
+BenchResult run_once(std::vector<std::uint32_t> const & lookup_order)
+{
+	BenchResult result;
+	PoolT pool;
+
+	using IdT = decltype(pool.Add(BenchAsset{}));
+	std::vector<IdT> ids;
+	ids.reserve(AssetCount);
+
+	Clock::time_point begin = Clock::now();
+	for (std::uint32_t i = 0; i < AssetCount; ++i)
+		ids.push_back(pool.Add(BenchAsset{ .data{ i } }));
+	result.add_ns = ns_per_op(begin, Clock::now(), AssetCount);
+
+	begin = Clock::now();
+	for (std::uint32_t i = 0; i < AssetCount; i += 2)
+		pool.Remove(ids[i]);
+	result.remove_ns = ns_per_op(begin, Clock::now(), AssetCount / 2);
+
+	std::uint64_t sum = 0;
+	begin = Clock::now();
+	for (std::uint32_t i : lookup_order)
+	{
+		if (BenchAsset const * asset = pool.Get(ids[i]))
+			sum += asset->data[0];
+	}
+	result.get_ns = ns_per_op(begin, Clock::now(), AssetCount);
+
+	begin = Clock::now();
+	pool.ForEach([&sum](IdT /*id*/, BenchAsset & asset) { sum += asset.data[0]; });
+	result.for_each_ns = ns_per_op(begin, Clock::now(), AssetCount / 2);
+
+	begin = Clock::now();
+	for (std::uint32_t i = 0; i < AssetCount; i += 2)
+		ids[i] = pool.Add(BenchAsset{ .data{ i } });
+	result.add_reuse_ns = ns_per_op(begin, Clock::now(), AssetCount / 2);
+
+	g_sink = g_sink + sum;
+	return result;
+}
+
+// Best of the repetitions, the others include the noise of the rest of the system
+template <typename PoolT>
+BenchResult run(std::vector<std::uint32_t> const & lookup_order)
+{
+	BenchResult best = run_once<PoolT>(lookup_order);
+	for (std::uint32_t i = 1; i < Repetitions; ++i)
+	{
+		BenchResult result = run_once<PoolT>(lookup_order);
+		best.add_ns = std::min(best.add_ns, result.add_ns);
+		best.remove_ns = std::min(best.remove_ns, result.remove_ns);
+		best.get_ns = std::min(best.get_ns, result.get_ns);
+		best.for_each_ns = std::min(best.for_each_ns, result.for_each_ns);
+		best.add_reuse_ns = std::min(best.add_reuse_ns, result.add_reuse_ns);
+	}
+	return best;
+}
+
+void print_row(char const * name, double legacy_ns, double chunked_ns)
+{
+	std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << legacy_ns << std::setw(12) << chunked_ns
+		<< std::setw(10) << legacy_ns / chunked_ns << "x" << std::endl;
+}
+
+int main()
+{
+	std::vector<std::uint32_t> lookup_order(AssetCount);
+	std::iota(lookup_order.begin(), lookup_order.end(), 0u);
+	std::shuffle(lookup_order.begin(), lookup_order.end(), std::mt19937{ 42 });
+
+	BenchResult legacy = run<LegacyAssetPool<BenchAsset>>(lookup_order);
+	BenchResult chunked = run<AssetPool<BenchAsset>>(lookup_order);
+
+	std::cout << AssetCount << " assets of " << sizeof(BenchAsset) << " bytes, best of " << Repetitions
+		<< " runs, ns per operation" << std::endl;
+	std::cout << std::left << std::setw(12) << "" << std::right << std::setw(12) << "legacy"
+		<< std::setw(12) << "chunked" << std::setw(11) << "speedup" << std::endl;
+	print_row("Add", legacy.add_ns, chunked.add_ns);
+	print_row("Remove", legacy.remove_ns, chunked.remove_ns);
+	print_row("Get", legacy.get_ns, chunked.get_ns);
+	print_row("ForEach", legacy.for_each_ns, chunked.for_each_ns);
+	print_row("Add reuse", legacy.add_reuse_ns, chunked.add_reuse_ns);
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+// LegacyAssetPool.ixx
+
+module;
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+export module LegacyAssetPool;
+
+// The AssetPool as it was before it was chunked, for comparing the two in AssetPoolBench: the assets in one vector that
+// moves them when it grows, the metadata packed next to each other, and no list of the live assets, so ForEach has to
+// check every slot.
+
+inline constexpr std::uint32_t IndexMask = 0xFFFFF; // 20 bits for index
+inline constexpr std::uint32_t GenerationMask = 0xFFF; // 12 bits for generation
+inline constexpr std::uint32_t GenerationShift = 20; // generation starts at bit 20
+inline constexpr std::uint32_t InvalidId = 0xFFFFFFFF; // reserved invalid ID
+
+export class LegacyAssetId
+{
+public:
+	LegacyAssetId() = default;
+	LegacyAssetId(std::uint32_t index, std::uint32_t generation)
+		: id((generation << GenerationShift) | index)
+	{}
+
+	std::uint32_t GetIndex() const { return id & IndexMask; }
+	std::uint32_t GetGeneration() const { return id >> GenerationShift; }
+	bool IsValid() const { return id != InvalidId; }
+
+	bool operator==(LegacyAssetId const & other) const { return id == other.id; }
+
+private:
+	std::uint32_t id = InvalidId;
+};
+
+struct AssetMeta
+{
+	std::uint32_t generation : 12 = 0;
+	std::uint32_t is_active : 1 = 0;
+	std::uint32_t not_used : 19 = 0; // padding to fill 32 bits
+};
+
+template <typename AssetType>
+concept ValidAssetType = std::is_move_constructible_v<AssetType> && std::is_move_assignable_v<AssetType>;
+
+export template <ValidAssetType AssetType>
+class LegacyAssetPool
+{
+public:
+	LegacyAssetPool() = default;
+	~LegacyAssetPool() = default;
+
+	LegacyAssetPool(LegacyAssetPool && other) = default;
+	LegacyAssetPool & operator=(LegacyAssetPool && other) = default;
+
+	LegacyAssetPool(LegacyAssetPool const &) = delete;
+	LegacyAssetPool & operator=(LegacyAssetPool const &) = delete;
+
+	LegacyAssetId Add(AssetType asset);
+	void Remove(LegacyAssetId id);
+
+	AssetType const * Get(LegacyAssetId id) const;
+	AssetType * Get(LegacyAssetId id);
+
+	// Calls fn(LegacyAssetId, AssetType &) for every live asset
+	template <typename FnT>
+	void ForEach(FnT && fn);
+
+private:
+	std::vector<AssetMeta> m_meta;
+	std::vector<AssetType> m_assets;
+
+	std::vector<std::uint32_t> m_free_indices;
+};
+
+template <ValidAssetType AssetType>
+LegacyAssetId LegacyAssetPool<AssetType>::Add(AssetType asset)
+{
+	std::uint32_t index;
+	if (!m_free_indices.empty())
+	{
+		index = m_free_indices.back();
+		m_free_indices.pop_back();
+
+		m_assets[index] = std::move(asset);
+	}
+	else
+	{
+		index = static_cast<std::uint32_t>(m_assets.size());
+		if (index >= IndexMask)
+			return LegacyAssetId{};
+
+		m_assets.push_back(std::move(asset));
+		m_meta.emplace_back();
+	}
+
+	m_meta[index].is_active = 1;
+
+	return LegacyAssetId{ index, m_meta[index].generation };
+}
+
+template <ValidAssetType AssetType>
+void LegacyAssetPool<AssetType>::Remove(LegacyAssetId id)
+{
+	std::uint32_t index = id.GetIndex();
+
+	if (index >= m_meta.size())
+		return;
+	if (!m_meta[index].is_active)
+		return;
+	if (m_meta[index].generation != id.GetGeneration())
+		return;
+
+	m_meta[index].is_active = 0;
+	m_meta[index].generation++;
+
+	// slots are retired once they reach the maximum generation to prevent collisions with old handles
+	if (m_meta[index].generation < GenerationMask)
+		m_free_indices.push_back(index);
+}
+
+template <ValidAssetType AssetType>
+AssetType const * LegacyAssetPool<AssetType>::Get(LegacyAssetId id) const
+{
+	std::uint32_t index = id.GetIndex();
+
+	if (index >= m_meta.size())
+		return nullptr;
+	if (!m_meta[index].is_active)
+		return nullptr;
+	if (m_meta[index].generation != id.GetGeneration())
+		return nullptr;
+
+	return &m_assets[index];
+}
+
+template <ValidAssetType AssetType>
+AssetType * LegacyAssetPool<AssetType>::Get(LegacyAssetId id)
+{
+	std::uint32_t index = id.GetIndex();
+
+	if (index >= m_meta.size())
+		return nullptr;
+	if (!m_meta[index].is_active)
+		return nullptr;
+	if (m_meta[index].generation != id.GetGeneration())
+		return nullptr;
+
+	return &m_assets[index];
+}
+
+template <ValidAssetType AssetType>
+template <typename FnT>
+void LegacyAssetPool<AssetType>::ForEach(FnT && fn)
+{
+	for (std::uint32_t index = 0; index < m_meta.size(); ++index)
+	{
+		if (m_meta[index].is_active)
+			fn(LegacyAssetId{ index, m_meta[index].generation }, m_assets[index]);
+	}
+}
@@ -0,0 +1,40 @@
+// AllocationCounter.cpp
+
+// Not a module unit: replacements of the global allocation functions have to belong to the global module, and
+// compilers don't all accept them inside a module's purview, even in an extern "C++" block.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local std::uint64_t t_allocation_count = 0;
+}
+
+extern "C" std::uint64_t allocation_counter_get_thread_count()
+{
+	return t_allocation_count;
+}
+
+#ifdef ENABLE_ALLOCATION_COUNTER
+// The array and nothrow forms call these, only the over-aligned forms aren't counted
+void * operator new(std::size_t size)
+{
+	++t_allocation_count;
+	if (void * ptr = std::malloc(size > 0 ? size : 1))
+		return ptr;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t /*size*/) noexcept
+{
+	std::free(ptr);
+}
+#endif
@@ -0,0 +1,28 @@
+// AllocationCounter.ixx
+
+module;
+
+#include <cstdint>
+
+export module AllocationCounter;
+
+// Defined in AllocationCounter.cpp, next to the replaced operator new
+extern "C" std::uint64_t allocation_counter_get_thread_count();
+
+// Counts the heap allocations of each thread, to check that a frame in the steady state doesn't allocate.
+// The count comes from replacing the global operator new, which is only done when ENABLE_ALLOCATION_COUNTER is
+// defined; otherwise the counts stay 0.
+export namespace AllocationCounter
+{
+#ifdef ENABLE_ALLOCATION_COUNTER
+	constexpr bool Enabled = true;
+#else
+	constexpr bool Enabled = false;
+#endif
+
+	// Allocations made by the calling thread since it started
+	std::uint64_t GetThreadCount()
+	{
+		return allocation_counter_get_thread_count();
+	}
+}
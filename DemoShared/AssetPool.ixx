@@ -2,144 +2,230 @@
 
 module;
 
+#include <cstddef>
 #include <cstdint>
-#include <stdexcept>
+#include <limits>
+#include <memory>
+#include <new>
+#include <span>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 export module AssetPool;
 
-constexpr std::uint32_t IndexMask = 0xFFFFF; // 20 bits for index
-constexpr std::uint32_t GenerationMask = 0xFFF; // 12 bits for generation
-constexpr std::uint32_t GenerationShift = 20; // generation starts at bit 20
-constexpr std::uint32_t InvalidId = 0xFFFFFFFF; // reserved invalid ID
-
-export class AssetId
+// The index is stored in the low bits of the id and the generation above it. The defaults, 20 bits for the index and
+// 12 for the generation, fit in 32 bits, wider ids are stored in 64 bits.
+export template <std::uint32_t IndexBits = 20, std::uint32_t GenerationBits = 12>
+class BasicAssetId
 {
+	static_assert(IndexBits > 0 && IndexBits <= 32, "the index must fit in 32 bits");
+	static_assert(GenerationBits > 0 && GenerationBits <= 32, "the generation must fit in 32 bits");
+
 public:
-	AssetId() = default;
-	AssetId(std::uint32_t index, std::uint32_t generation)
-		: id((generation << GenerationShift) | index)
+	using StorageT = std::conditional_t<IndexBits + GenerationBits <= 32, std::uint32_t, std::uint64_t>;
+
+	constexpr static std::uint32_t IndexMask = static_cast<std::uint32_t>((std::uint64_t{ 1 } << IndexBits) - 1);
+	constexpr static std::uint32_t GenerationMask = static_cast<std::uint32_t>((std::uint64_t{ 1 } << GenerationBits) - 1);
+	constexpr static StorageT InvalidId = std::numeric_limits<StorageT>::max(); // reserved invalid ID
+
+	BasicAssetId() = default;
+	BasicAssetId(std::uint32_t index, std::uint32_t generation)
+		: id((static_cast<StorageT>(generation) << IndexBits) | index)
 	{}
 
-	std::uint32_t GetIndex() const { return id & IndexMask; }
-	std::uint32_t GetGeneration() const { return id >> GenerationShift; }
+	std::uint32_t GetIndex() const { return static_cast<std::uint32_t>(id & IndexMask); }
+	std::uint32_t GetGeneration() const { return static_cast<std::uint32_t>(id >> IndexBits); }
 	bool IsValid() const { return id != InvalidId; }
 
-	bool operator==(AssetId const & other) const { return id == other.id; }
+	bool operator==(BasicAssetId const & other) const { return id == other.id; }
 
 private:
-	std::uint32_t id = InvalidId;
+	StorageT id = InvalidId;
 };
 
-struct AssetMeta
-{
-	std::uint32_t generation : 12 = 0;
-	std::uint32_t is_active : 1 = 0;
-	std::uint32_t not_used : 19 = 0; // padding to fill 32 bits
-};
+export using AssetId = BasicAssetId<>;
 
-template <typename AssetType>
-concept ValidAssetType = std::is_move_constructible_v<AssetType> && std::is_move_assignable_v<AssetType>;
+export template <typename AssetType>
+concept ValidAssetType = std::is_move_constructible_v<AssetType> && std::is_nothrow_destructible_v<AssetType>;
 
-export template <ValidAssetType AssetType>
+// Assets live in fixed size chunks that are never moved, so a pointer returned by Get stays valid until the asset is
+// removed, however many assets are added after it. The metadata is kept apart from the assets, one array per field,
+// and the indices of the live assets are packed into a dense array that ForEach walks without touching free slots.
+export template <ValidAssetType AssetType, std::uint32_t IndexBits = 20, std::uint32_t GenerationBits = 12>
 class AssetPool
 {
 public:
+	using IdT = BasicAssetId<IndexBits, GenerationBits>;
+
+	constexpr static std::uint32_t ChunkSize = 64; // assets per chunk
+
 	AssetPool() = default;
-	~AssetPool() = default;
+	~AssetPool() { destroy_assets(); }
 
 	AssetPool(AssetPool && other) = default;
-	AssetPool & operator=(AssetPool && other) = default;
+	AssetPool & operator=(AssetPool && other);
 
 	AssetPool(AssetPool const &) = delete;
 	AssetPool & operator=(AssetPool const &) = delete;
 
-	AssetId Add(AssetType asset);
-	void Remove(AssetId id);
+	IdT Add(AssetType asset);
+	void Remove(IdT id);
+
+	AssetType const * Get(IdT id) const;
+	AssetType * Get(IdT id);
+
+	std::uint32_t GetCount() const { return static_cast<std::uint32_t>(m_dense.size()); }
 
-	AssetType const * Get(AssetId id) const;
-	AssetType * Get(AssetId id);
+	// Indices of the live assets in no particular order, removing an asset moves the last index into its place
+	std::span<std::uint32_t const> GetLiveIndices() const { return m_dense; }
+
+	// Calls fn(IdT, AssetType &) for every live asset, fn must not add or remove assets
+	template <typename FnT>
+	void ForEach(FnT && fn);
+	template <typename FnT>
+	void ForEach(FnT && fn) const;
 
 private:
-	std::vector<AssetMeta> m_meta;
-	std::vector<AssetType> m_assets;
+	constexpr static std::uint32_t NotLive = std::numeric_limits<std::uint32_t>::max();
+
+	struct Chunk
+	{
+		alignas(AssetType) std::byte storage[sizeof(AssetType) * ChunkSize];
+	};
+
+	AssetType * get_slot(std::uint32_t index) const;
+	bool is_live(IdT id) const;
+	void destroy_assets();
+
+	std::vector<std::unique_ptr<Chunk>> m_chunks;
+
+	std::vector<std::uint32_t> m_generations;
+	std::vector<std::uint32_t> m_dense_positions; // position of the slot in m_dense, NotLive for free slots
+	std::vector<std::uint32_t> m_dense;
 
 	std::vector<std::uint32_t> m_free_indices;
 };
 
-template <ValidAssetType AssetType>
-AssetId AssetPool<AssetType>::Add(AssetType asset)
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+AssetPool<AssetType, IndexBits, GenerationBits> & AssetPool<AssetType, IndexBits, GenerationBits>::operator=(AssetPool && other)
+{
+	if (this == &other)
+		return *this;
+
+	destroy_assets();
+	m_chunks = std::move(other.m_chunks);
+	m_generations = std::move(other.m_generations);
+	m_dense_positions = std::move(other.m_dense_positions);
+	m_dense = std::move(other.m_dense);
+	m_free_indices = std::move(other.m_free_indices);
+	other.m_dense.clear();
+
+	return *this;
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+auto AssetPool<AssetType, IndexBits, GenerationBits>::Add(AssetType asset) -> IdT
 {
 	std::uint32_t index;
 	if (!m_free_indices.empty())
 	{
 		index = m_free_indices.back();
 		m_free_indices.pop_back();
-
-		m_assets[index] = std::move(asset);
 	}
 	else
 	{
-		index = static_cast<std::uint32_t>(m_assets.size());
-		if (index >= IndexMask)
-			return AssetId{};
-
-		m_assets.push_back(std::move(asset));
-		m_meta.emplace_back();
+		index = static_cast<std::uint32_t>(m_generations.size());
+		if (index >= IdT::IndexMask)
+			return IdT{};
+
+		if (index % ChunkSize == 0)
+			m_chunks.push_back(std::make_unique<Chunk>());
+		m_generations.push_back(0);
+		m_dense_positions.push_back(NotLive);
 	}
 
-	m_meta[index].is_active = 1;
+	std::construct_at(get_slot(index), std::move(asset));
+
+	m_dense_positions[index] = static_cast<std::uint32_t>(m_dense.size());
+	m_dense.push_back(index);
 
-	return AssetId{ index, m_meta[index].generation };
+	return IdT{ index, m_generations[index] };
 }
 
-template <ValidAssetType AssetType>
-void AssetPool<AssetType>::Remove(AssetId id)
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+void AssetPool<AssetType, IndexBits, GenerationBits>::Remove(IdT id)
 {
+	if (!is_live(id))
+		return;
+
 	std::uint32_t index = id.GetIndex();
+	std::destroy_at(get_slot(index));
 
-	if (index >= m_meta.size())
-		return;
-	if (!m_meta[index].is_active)
-		return;
-	if (m_meta[index].generation != id.GetGeneration())
-		return;
+	std::uint32_t position = m_dense_positions[index];
+	m_dense[position] = m_dense.back();
+	m_dense_positions[m_dense[position]] = position;
+	m_dense.pop_back();
+	m_dense_positions[index] = NotLive;
 
-	m_meta[index].is_active = 0;
-	m_meta[index].generation++;
+	m_generations[index]++;
 
 	// slots are retired once they reach the maximum generation to prevent collisions with old handles
-	if (m_meta[index].generation < GenerationMask)
+	if (m_generations[index] < IdT::GenerationMask)
 		m_free_indices.push_back(index);
 }
 
-template <ValidAssetType AssetType>
-AssetType const * AssetPool<AssetType>::Get(AssetId id) const
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+AssetType const * AssetPool<AssetType, IndexBits, GenerationBits>::Get(IdT id) const
 {
-	std::uint32_t index = id.GetIndex();
+	return is_live(id) ? get_slot(id.GetIndex()) : nullptr;
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+AssetType * AssetPool<AssetType, IndexBits, GenerationBits>::Get(IdT id)
+{
+	return is_live(id) ? get_slot(id.GetIndex()) : nullptr;
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+template <typename FnT>
+void AssetPool<AssetType, IndexBits, GenerationBits>::ForEach(FnT && fn)
+{
+	for (std::uint32_t index : m_dense)
+		fn(IdT{ index, m_generations[index] }, *get_slot(index));
+}
 
-	if (index >= m_meta.size())
-		return nullptr;
-	if (!m_meta[index].is_active)
-		return nullptr;
-	if (m_meta[index].generation != id.GetGeneration())
-		return nullptr;
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+template <typename FnT>
+void AssetPool<AssetType, IndexBits, GenerationBits>::ForEach(FnT && fn) const
+{
+	for (std::uint32_t index : m_dense)
+		fn(IdT{ index, m_generations[index] }, static_cast<AssetType const &>(*get_slot(index)));
+}
 
-	return &m_assets[index];
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+AssetType * AssetPool<AssetType, IndexBits, GenerationBits>::get_slot(std::uint32_t index) const
+{
+	std::byte * storage = m_chunks[index / ChunkSize]->storage + sizeof(AssetType) * (index % ChunkSize);
+	return std::launder(reinterpret_cast<AssetType *>(storage));
 }
 
-template <ValidAssetType AssetType>
-AssetType * AssetPool<AssetType>::Get(AssetId id)
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+bool AssetPool<AssetType, IndexBits, GenerationBits>::is_live(IdT id) const
 {
 	std::uint32_t index = id.GetIndex();
 
-	if (index >= m_meta.size())
-		return nullptr;
-	if (!m_meta[index].is_active)
-		return nullptr;
-	if (m_meta[index].generation != id.GetGeneration())
-		return nullptr;
+	if (index >= m_generations.size())
+		return false;
+	if (m_dense_positions[index] == NotLive)
+		return false;
+	return m_generations[index] == id.GetGeneration();
+}
 
-	return &m_assets[index];
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+void AssetPool<AssetType, IndexBits, GenerationBits>::destroy_assets()
+{
+	for (std::uint32_t index : m_dense)
+		std::destroy_at(get_slot(index));
+	m_dense.clear();
 }
@@ -0,0 +1,283 @@
+// AssetRegistry.ixx
+
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+export module AssetRegistry;
+
+import AssetPool;
+
+// Identifies what was loaded: the file, made canonical so different spellings of a path match,
+// and the parameters it was loaded with, as they change the resulting asset
+export struct AssetKey
+{
+	std::string path;
+	std::string params;
+
+	bool operator==(AssetKey const & other) const = default;
+};
+
+export AssetKey MakeAssetKey(std::filesystem::path const & path, std::string params = {})
+{
+	std::error_code error;
+	std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, error);
+	return AssetKey{ .path = (error ? path : canonical_path).generic_string(), .params = std::move(params) };
+}
+
+export struct AssetKeyHash
+{
+	std::size_t operator()(AssetKey const & key) const
+	{
+		std::size_t hash = std::hash<std::string>{}(key.path);
+		return hash ^ (std::hash<std::string>{}(key.params) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2));
+	}
+};
+
+// What was returned by a loader, the size is what the asset takes on the gpu, as far as the loader can tell
+export struct LoadedAsset
+{
+	AssetId id;
+	std::uint64_t byte_size = 0;
+};
+
+export struct AssetMemoryEntry
+{
+	AssetKey key;
+	AssetId id;
+	std::uint32_t ref_count = 0;
+	std::uint64_t byte_size = 0;
+};
+
+template <typename StoreT>
+concept AssetStore = requires (StoreT & store, AssetId id)
+{
+	store.Remove(id);
+};
+
+// Sits in front of an AssetPool or the MeshManager and remembers what was loaded from where, so loading the same
+// file with the same parameters again returns the existing asset instead of a copy.
+// Assets are reference counted through Handles, the asset is removed from the store when its last handle goes.
+export template <AssetStore StoreT>
+class AssetRegistry
+{
+public:
+	class Handle
+	{
+	public:
+		Handle() = default;
+		~Handle() { reset(); }
+
+		Handle(Handle const & other);
+		Handle & operator=(Handle const & other);
+		Handle(Handle && other);
+		Handle & operator=(Handle && other);
+
+		AssetId GetId() const { return m_id; }
+		bool IsValid() const { return m_id.IsValid(); }
+
+	private:
+		friend class AssetRegistry;
+
+		// Takes over a reference that was already counted
+		Handle(AssetRegistry & registry, AssetId id)
+			: m_registry{ &registry }
+			, m_id{ id }
+		{}
+
+		void reset();
+
+		AssetRegistry * m_registry = nullptr;
+		AssetId m_id;
+	};
+
+	explicit AssetRegistry(StoreT & store)
+		: m_store{ store }
+	{}
+
+	AssetRegistry(AssetRegistry const &) = delete;
+	AssetRegistry & operator=(AssetRegistry const &) = delete;
+
+	// Returns the asset loaded with the key, or calls load, which returns a LoadedAsset, and registers its result.
+	// The handle is invalid if the asset wasn't loaded before and load failed, or returned an asset that can't be
+	// registered: one that is registered already, or any asset if load registered the key itself.
+	template <typename LoadFnT>
+	Handle GetOrLoad(AssetKey const & key, LoadFnT && load);
+
+	// Handle to an asset that is already registered, invalid otherwise
+	Handle Find(AssetKey const & key);
+
+	std::uint32_t GetCount() const { return static_cast<std::uint32_t>(m_entries.size()); }
+	std::uint64_t GetTotalSize() const { return m_total_size; }
+	std::uint64_t GetHitCount() const { return m_hit_count; }
+
+	// Registered assets, largest first
+	std::vector<AssetMemoryEntry> GetMemoryReport() const;
+
+private:
+	struct Entry
+	{
+		AssetId id;
+		std::uint32_t ref_count = 0;
+		std::uint64_t byte_size = 0;
+	};
+
+	using EntryMap = std::unordered_map<AssetKey, Entry, AssetKeyHash>;
+
+	void add_ref(AssetId id);
+	void release(AssetId id);
+
+	StoreT & m_store;
+	EntryMap m_entries;
+	// By the asset's index, the entries don't move when m_entries rehashes
+	std::unordered_map<std::uint32_t, typename EntryMap::value_type *> m_entries_by_index;
+	std::uint64_t m_total_size = 0;
+	std::uint64_t m_hit_count = 0;
+};
+
+template <AssetStore StoreT>
+AssetRegistry<StoreT>::Handle::Handle(Handle const & other)
+	: m_registry{ other.m_registry }
+	, m_id{ other.m_id }
+{
+	if (m_registry)
+		m_registry->add_ref(m_id);
+}
+
+template <AssetStore StoreT>
+auto AssetRegistry<StoreT>::Handle::operator=(Handle const & other) -> Handle &
+{
+	if (this == &other)
+		return *this;
+
+	if (other.m_registry)
+		other.m_registry->add_ref(other.m_id);
+	reset();
+	m_registry = other.m_registry;
+	m_id = other.m_id;
+	return *this;
+}
+
+template <AssetStore StoreT>
+AssetRegistry<StoreT>::Handle::Handle(Handle && other)
+	: m_registry{ std::exchange(other.m_registry, nullptr) }
+	, m_id{ std::exchange(other.m_id, AssetId{}) }
+{}
+
+template <AssetStore StoreT>
+auto AssetRegistry<StoreT>::Handle::operator=(Handle && other) -> Handle &
+{
+	if (this == &other)
+		return *this;
+
+	reset();
+	m_registry = std::exchange(other.m_registry, nullptr);
+	m_id = std::exchange(other.m_id, AssetId{});
+	return *this;
+}
+
+template <AssetStore StoreT>
+void AssetRegistry<StoreT>::Handle::reset()
+{
+	if (m_registry)
+		m_registry->release(m_id);
+	m_registry = nullptr;
+	m_id = AssetId{};
+}
+
+template <AssetStore StoreT>
+template <typename LoadFnT>
+auto AssetRegistry<StoreT>::GetOrLoad(AssetKey const & key, LoadFnT && load) -> Handle
+{
+	Handle handle = Find(key);
+	if (handle.IsValid())
+	{
+		++m_hit_count;
+		return handle;
+	}
+
+	LoadedAsset loaded = load();
+	if (!loaded.id.IsValid())
+		return Handle{};
+
+	// An asset that is registered already, e.g. under another key, would get a second entry. That counts as a failed
+	// load, and the registered asset is left alone.
+	if (m_entries_by_index.contains(loaded.id.GetIndex()))
+		return Handle{};
+
+	auto [iter, inserted] = m_entries.emplace(key, Entry{ .id = loaded.id, .ref_count = 1, .byte_size = loaded.byte_size });
+	if (!inserted)
+	{
+		// The loader registered the key itself. Nothing refers to the asset it returned, so it is removed.
+		m_store.Remove(loaded.id);
+		return Handle{};
+	}
+	m_entries_by_index[loaded.id.GetIndex()] = &*iter;
+	m_total_size += loaded.byte_size;
+
+	return Handle{ *this, loaded.id };
+}
+
+template <AssetStore StoreT>
+auto AssetRegistry<StoreT>::Find(AssetKey const & key) -> Handle
+{
+	auto iter = m_entries.find(key);
+	if (iter == m_entries.end())
+		return Handle{};
+
+	++iter->second.ref_count;
+	return Handle{ *this, iter->second.id };
+}
+
+template <AssetStore StoreT>
+std::vector<AssetMemoryEntry> AssetRegistry<StoreT>::GetMemoryReport() const
+{
+	std::vector<AssetMemoryEntry> report;
+	report.reserve(m_entries.size());
+	for (auto const & [key, entry] : m_entries)
+	{
+		report.push_back(AssetMemoryEntry{
+			.key = key,
+			.id = entry.id,
+			.ref_count = entry.ref_count,
+			.byte_size = entry.byte_size
+		});
+	}
+
+	std::ranges::sort(report, std::ranges::greater{}, &AssetMemoryEntry::byte_size);
+	return report;
+}
+
+template <AssetStore StoreT>
+void AssetRegistry<StoreT>::add_ref(AssetId id)
+{
+	auto iter = m_entries_by_index.find(id.GetIndex());
+	if (iter != m_entries_by_index.end() && iter->second->second.id == id)
+		++iter->second->second.ref_count;
+}
+
+template <AssetStore StoreT>
+void AssetRegistry<StoreT>::release(AssetId id)
+{
+	auto iter = m_entries_by_index.find(id.GetIndex());
+	if (iter == m_entries_by_index.end() || !(iter->second->second.id == id))
+		return;
+
+	Entry & entry = iter->second->second;
+	if (--entry.ref_count > 0)
+		return;
+
+	m_total_size -= entry.byte_size;
+	m_store.Remove(id);
+	// Erasing by key would erase by a reference into the node being erased
+	m_entries.erase(m_entries.find(iter->second->first));
+	m_entries_by_index.erase(iter);
+}
@@ -5,6 +5,7 @@ module;
 #include <expected>
 #include <filesystem>
 #include <iostream>
+#include <utility>
 #include <vector>
 
 #include <assimp/Importer.hpp>
@@ -16,14 +17,23 @@ export module AssimpLoader;
 import GraphicsApi;
 import GraphicsError;
 import Mesh;
+import MeshletBuilder;
+import MeshSimplifier;
+import Trace;
 import Vertex;
 
 export namespace AssimpLoader
 {
+	// With generate_lods every mesh gets a chain of simplified lods, see MeshSimplifier.
+	// With build_meshlets every lod is split into meshlets for culling, see MeshletBuilder.
 	std::vector<Mesh> LoadObjWithColorMaterial(
 		GraphicsApi const & graphics_api,
-		std::filesystem::path const & filepath)
+		std::filesystem::path const & filepath,
+		bool generate_lods = false,
+		bool build_meshlets = false)
 	{
+		Trace::Zone zone{ "AssimpLoader::LoadObjWithColorMaterial" };
+
 		Assimp::Importer importer;
 		const aiScene * scene = importer.ReadFile(filepath.string(),
 			aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
@@ -65,8 +75,20 @@ export namespace AssimpLoader
 				}
 			}
 
+			std::vector<MeshLod> lods;
+			if (generate_lods)
+			{
+				MeshLodChain lod_chain = MeshSimplifier::BuildLodChain(verts, indices);
+				indices = std::move(lod_chain.indices);
+				lods = std::move(lod_chain.lods);
+			}
+
+			std::vector<Meshlet> meshlets;
+			if (build_meshlets)
+				meshlets = MeshletBuilder::Build(verts, indices, lods);
+
 			Mesh mesh{ graphics_api };
-			std::expected<void, GraphicsError> result = mesh.Create(verts, indices);
+			std::expected<void, GraphicsError> result = mesh.Create(verts, indices, std::move(lods), std::move(meshlets));
 			if (!result)
 			{
 				std::cout << "AssimpLoader::LoadObjWithColorMaterial: Failed to create mesh "
@@ -2,6 +2,8 @@
 
 module;
 
+#include <algorithm>
+#include <cmath>
 #include <numbers>
 
 #include <glm/vec3.hpp>
@@ -36,6 +38,15 @@ public:
 	CameraPosUniform const & GetPosUniform() const { return m_pos_uniform; }
 	glm::vec3 const & GetDir() const { return m_dir; }
 	ViewProjUniform const & GetViewProjUniform() const { return m_view_proj_uniform; }
+	float GetNearPlane() const { return m_near_plane; }
+	float GetFarPlane() const { return m_far_plane; }
+
+	// Distance of a world position along the view direction
+	float GetViewDepth(glm::vec3 const & world_pos) const;
+	// Distance of a world position along the view direction, mapped so the near plane is 0 and the far plane is 1
+	float GetNormalizedDepth(glm::vec3 const & world_pos) const;
+	// Size on screen of one world unit at the view depth, in pixels of a viewport with the given height
+	float GetPixelsPerUnit(float view_depth, int viewport_height) const;
 
 private:
 	CameraPosUniform m_pos_uniform{ { 0.0f, 0.0f, 0.0f } };
@@ -57,6 +68,22 @@ void Camera::Init(glm::vec3 const & pos, glm::vec3 const & dir)
 	m_view_proj_uniform.view = glm::lookAt(m_pos_uniform.pos, m_pos_uniform.pos + m_dir, m_up_dir);
 }
 
+float Camera::GetViewDepth(glm::vec3 const & world_pos) const
+{
+	return -(m_view_proj_uniform.view * glm::vec4(world_pos, 1.0f)).z;
+}
+
+float Camera::GetNormalizedDepth(glm::vec3 const & world_pos) const
+{
+	return (GetViewDepth(world_pos) - m_near_plane) / (m_far_plane - m_near_plane);
+}
+
+float Camera::GetPixelsPerUnit(float view_depth, int viewport_height) const
+{
+	// proj[1][1] is 1 / tan(fov / 2), negated for vulkan
+	return static_cast<float>(viewport_height) * 0.5f * std::abs(m_view_proj_uniform.proj[1][1]) / std::max(view_depth, m_near_plane);
+}
+
 void Camera::OnViewportResized(int width, int height)
 {
 	if (height == 0)
@@ -4,7 +4,6 @@ module;
 
 #include <expected>
 #include <filesystem>
-#include <iostream>
 #include <optional>
 
 #include <glm/mat4x4.hpp>
@@ -18,13 +17,22 @@ import GraphicsError;
 import GraphicsPipeline;
 import LightsManager;
 import PipelineBuilder;
-import RenderObject;
+import ShaderVariant;
+import TypedPipeline;
 import Vertex;
 
 export class ColorPipeline
 {
 public:
 	using VertexT = ColorVertex;
+	constexpr static char const * Name = "ColorPipeline";
+	constexpr static RenderPass Pass = RenderPass::GEOMETRY;
+
+	struct FrameData
+	{
+		Camera const * camera = nullptr;
+		LightsManager const * lights = nullptr;
+	};
 
 	struct ObjectData
 	{
@@ -34,8 +42,11 @@ public:
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
 		GraphicsApi const & graphics_api,
 		std::filesystem::path const & shaders_path,
-		Camera const & camera,
-		LightsManager const & lights);
+		LightsManager const & lights,
+		ShaderVariant const & variant);
+
+	static void UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data);
+	static void UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data);
 
 	ColorPipeline() = default;
 	explicit ColorPipeline(AssetId asset_id) : m_asset_id(asset_id) {}
@@ -43,25 +54,26 @@ public:
 	AssetId GetAssetId() const { return m_asset_id; }
 
 private:
+	struct ObjectDataVS
+	{
+		alignas(16) glm::mat4 model;
+	};
+
 	AssetId m_asset_id;
 };
 
 std::expected<GraphicsPipeline, GraphicsError> ColorPipeline::CreateGraphicsPipeline(
 	GraphicsApi const & graphics_api,
 	std::filesystem::path const & shaders_path,
-	Camera const & camera,
-	LightsManager const & lights)
+	LightsManager const & lights,
+	ShaderVariant const & variant)
 {
-	struct ObjectDataVS
-	{
-		alignas(16) glm::mat4 model;
-	};
-
 	PipelineBuilder builder{ graphics_api };
 
 	std::expected<void, GraphicsError> load_shaders_result = builder.LoadShaders(
 		shaders_path / "color.vert",
-		shaders_path / "color.frag");
+		shaders_path / "color.frag",
+		variant);
 	if (!load_shaders_result.has_value())
 		return std::unexpected{ load_shaders_result.error() };
 
@@ -69,33 +81,23 @@ std::expected<GraphicsPipeline, GraphicsError> ColorPipeline::CreateGraphicsPipe
 	builder.SetObjectDataTypes<ObjectDataVS, std::nullopt_t>();
 	builder.SetVSUniformTypes<ViewProjUniform>();
 	builder.SetFSUniformTypes<LightsUniform>();
+	builder.SetFSStorageBuffers(lights.GetStorageBuffers());
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerFrameConstantsCallback(
-		[&camera, &lights](GraphicsPipeline const & pipeline)
-		{
-			pipeline.SetUniform(0 /*binding*/, camera.GetViewProjUniform());
-			pipeline.SetUniform(1 /*binding*/, lights.GetLightsUniform());
-		});
-	builder.SetPerObjectConstantsCallback(
-		[](GraphicsPipeline const & pipeline, void const * object_data)
-		{
-			if (!object_data)
-			{
-				std::cout << "ObjectData is null for ColorPipeline" << std::endl;
-				return;
-			}
-
-			// For optimal performance, we assume that the object data is of the correct type.
-			// Use compile-time checks when creating render objects to ensure the data is compatible with the pipeline.
-			auto const * data = static_cast<ObjectData const *>(object_data);
-
-			pipeline.SetObjectData(
-				ObjectDataVS{
-					.model = data->model
-				},
-				std::nullopt);
-		});
-
 	return builder.CreatePipeline();
 }
+
+inline void ColorPipeline::UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data)
+{
+	pipeline.SetUniform(0 /*binding*/, frame_data.camera->GetViewProjUniform());
+	pipeline.SetUniform(1 /*binding*/, frame_data.lights->GetLightsUniform());
+}
+
+inline void ColorPipeline::UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data)
+{
+	pipeline.SetObjectData(
+		ObjectDataVS{
+			.model = object_data.model
+		},
+		std::nullopt);
+}
@@ -0,0 +1,238 @@
+// ConcurrentAssetPool.ixx
+
+module;
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+export module ConcurrentAssetPool;
+
+import AssetPool;
+
+// An AssetPool that Add, Remove and Get can be called on from any thread, so loaders running on worker threads can
+// publish their assets directly.
+// Free slots are popped from a lock free list whose head carries a tag against ABA, Get is wait free and only
+// checks the slot's generation. A removed asset is invalidated right away but it is only destroyed, and its slot
+// reused, by the next Reclaim, which the owner calls at a point where no thread can still use a pointer it got from
+// Get before the removal, e.g. once per frame after the loaders have handed over their results.
+export template <ValidAssetType AssetType, std::uint32_t IndexBits = 20, std::uint32_t GenerationBits = 12>
+class ConcurrentAssetPool
+{
+	static_assert(GenerationBits < 32, "the generation shares a 32 bit word with the live flag");
+
+public:
+	using IdT = BasicAssetId<IndexBits, GenerationBits>;
+
+	constexpr static std::uint32_t ChunkSize = 256; // slots per chunk
+
+	ConcurrentAssetPool()
+		: m_chunks(MaxChunks)
+	{}
+	~ConcurrentAssetPool();
+
+	ConcurrentAssetPool(ConcurrentAssetPool const &) = delete;
+	ConcurrentAssetPool & operator=(ConcurrentAssetPool const &) = delete;
+
+	IdT Add(AssetType asset);
+	void Remove(IdT id);
+
+	AssetType const * Get(IdT id) const;
+	AssetType * Get(IdT id);
+
+	// Destroys the removed assets and makes their slots available again, see the class comment
+	void Reclaim();
+
+private:
+	constexpr static std::uint32_t MaxChunks = (IdT::IndexMask + ChunkSize - 1) / ChunkSize;
+	constexpr static std::uint32_t NoSlot = IdT::IndexMask; // never handed out, see Add
+
+	struct Slot
+	{
+		std::atomic<std::uint32_t> state{ 0 }; // generation << 1 | live
+		std::atomic<std::uint32_t> next{ NoSlot }; // next slot of the free or the retired list
+		alignas(AssetType) std::byte storage[sizeof(AssetType)];
+
+		AssetType * GetAsset() { return std::launder(reinterpret_cast<AssetType *>(storage)); }
+	};
+
+	struct Chunk
+	{
+		Slot slots[ChunkSize];
+	};
+
+	// Index of the first free slot in the low half, a counter bumped on every change in the high half
+	static std::uint64_t make_head(std::uint32_t index, std::uint32_t tag) { return std::uint64_t{ tag } << 32 | index; }
+	static std::uint32_t get_head_index(std::uint64_t head) { return static_cast<std::uint32_t>(head); }
+	static std::uint32_t get_head_tag(std::uint64_t head) { return static_cast<std::uint32_t>(head >> 32); }
+
+	Slot * find_slot(std::uint32_t index) const;
+	Slot & get_or_create_slot(std::uint32_t index);
+
+	std::uint32_t pop_free();
+	void push_free(std::uint32_t index);
+
+	// Chunks are created on demand and only deleted with the pool, so slots never move
+	std::vector<std::atomic<Chunk *>> m_chunks;
+	std::atomic<std::uint32_t> m_slot_count{ 0 };
+
+	std::atomic<std::uint64_t> m_free_head{ make_head(NoSlot, 0) };
+	std::atomic<std::uint32_t> m_retired_head{ NoSlot };
+};
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::~ConcurrentAssetPool()
+{
+	Reclaim();
+
+	for (std::atomic<Chunk *> & chunk_ptr : m_chunks)
+	{
+		std::unique_ptr<Chunk> chunk{ chunk_ptr.load(std::memory_order_relaxed) };
+		if (!chunk)
+			continue;
+
+		for (Slot & slot : chunk->slots)
+		{
+			if (slot.state.load(std::memory_order_relaxed) & 1)
+				std::destroy_at(slot.GetAsset());
+		}
+	}
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+auto ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::Add(AssetType asset) -> IdT
+{
+	std::uint32_t index = pop_free();
+	if (index == NoSlot)
+	{
+		index = m_slot_count.fetch_add(1, std::memory_order_relaxed);
+		if (index >= IdT::IndexMask)
+		{
+			m_slot_count.store(IdT::IndexMask, std::memory_order_relaxed);
+			return IdT{};
+		}
+	}
+
+	Slot & slot = get_or_create_slot(index);
+	std::construct_at(slot.GetAsset(), std::move(asset));
+
+	// Publishes the asset, Get only returns it once it sees the live flag
+	std::uint32_t generation = slot.state.load(std::memory_order_relaxed) >> 1;
+	slot.state.store(generation << 1 | 1, std::memory_order_release);
+
+	return IdT{ index, generation };
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+void ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::Remove(IdT id)
+{
+	Slot * slot = find_slot(id.GetIndex());
+	if (!slot)
+		return;
+
+	// Only one of several threads removing the same id gets past the exchange
+	std::uint32_t live_state = id.GetGeneration() << 1 | 1;
+	if (!slot->state.compare_exchange_strong(live_state, (id.GetGeneration() + 1) << 1, std::memory_order_acq_rel))
+		return;
+
+	std::uint32_t head = m_retired_head.load(std::memory_order_relaxed);
+	do
+	{
+		slot->next.store(head, std::memory_order_relaxed);
+	} while (!m_retired_head.compare_exchange_weak(head, id.GetIndex(), std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+AssetType const * ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::Get(IdT id) const
+{
+	return const_cast<ConcurrentAssetPool *>(this)->Get(id);
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+AssetType * ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::Get(IdT id)
+{
+	Slot * slot = find_slot(id.GetIndex());
+	if (!slot)
+		return nullptr;
+	if (slot->state.load(std::memory_order_acquire) != (id.GetGeneration() << 1 | 1))
+		return nullptr;
+
+	return slot->GetAsset();
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+void ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::Reclaim()
+{
+	// Taking the whole list at once leaves Remove the only thread pushing, so the retired list needs no tag
+	std::uint32_t index = m_retired_head.exchange(NoSlot, std::memory_order_acquire);
+	while (index != NoSlot)
+	{
+		Slot & slot = *find_slot(index);
+		std::uint32_t next = slot.next.load(std::memory_order_relaxed);
+
+		std::destroy_at(slot.GetAsset());
+
+		// slots are retired once they reach the maximum generation to prevent collisions with old handles
+		if ((slot.state.load(std::memory_order_relaxed) >> 1) < IdT::GenerationMask)
+			push_free(index);
+
+		index = next;
+	}
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+auto ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::find_slot(std::uint32_t index) const -> Slot *
+{
+	if (index >= IdT::IndexMask)
+		return nullptr;
+
+	Chunk * chunk = m_chunks[index / ChunkSize].load(std::memory_order_acquire);
+	return chunk ? &chunk->slots[index % ChunkSize] : nullptr;
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+auto ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::get_or_create_slot(std::uint32_t index) -> Slot &
+{
+	std::atomic<Chunk *> & chunk_ptr = m_chunks[index / ChunkSize];
+	Chunk * chunk = chunk_ptr.load(std::memory_order_acquire);
+	if (!chunk)
+	{
+		// Threads that reserved slots of the same new chunk race to create it, the losers drop theirs
+		std::unique_ptr<Chunk> new_chunk = std::make_unique<Chunk>();
+		if (chunk_ptr.compare_exchange_strong(chunk, new_chunk.get(), std::memory_order_acq_rel))
+			chunk = new_chunk.release();
+	}
+
+	return chunk->slots[index % ChunkSize];
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+std::uint32_t ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::pop_free()
+{
+	std::uint64_t head = m_free_head.load(std::memory_order_acquire);
+	while (get_head_index(head) != NoSlot)
+	{
+		// The slot may be popped by another thread meanwhile, then its next is stale but the tag makes the exchange fail
+		std::uint32_t next = find_slot(get_head_index(head))->next.load(std::memory_order_relaxed);
+		if (m_free_head.compare_exchange_weak(head, make_head(next, get_head_tag(head) + 1), std::memory_order_acquire))
+			return get_head_index(head);
+	}
+
+	return NoSlot;
+}
+
+template <ValidAssetType AssetType, std::uint32_t IndexBits, std::uint32_t GenerationBits>
+void ConcurrentAssetPool<AssetType, IndexBits, GenerationBits>::push_free(std::uint32_t index)
+{
+	Slot & slot = *find_slot(index);
+	std::uint64_t head = m_free_head.load(std::memory_order_relaxed);
+	do
+	{
+		slot.next.store(get_head_index(head), std::memory_order_relaxed);
+	} while (!m_free_head.compare_exchange_weak(head, make_head(index, get_head_tag(head) + 1), std::memory_order_release,
+		std::memory_order_relaxed));
+}
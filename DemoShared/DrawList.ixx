@@ -0,0 +1,403 @@
+// DrawList.ixx
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module DrawList;
+
+import Mesh;
+import TypedPipeline;
+
+// Sort key layout, from the most significant bit:
+//   opaque passes:  pass (2) | pipeline (10) | texture (10) | mesh (18) | depth (24)
+//   blended passes: pass (2) | inverted depth (24) | pipeline (10) | texture (10) | mesh (18)
+// Opaque draws are grouped by state and then drawn front to back within a group, blended draws have to be
+// drawn back to front so depth takes precedence over state for them.
+constexpr std::uint32_t PassBits = 2;
+constexpr std::uint32_t PipelineBits = 10;
+constexpr std::uint32_t TextureBits = 10;
+constexpr std::uint32_t MeshBits = 18;
+constexpr std::uint32_t DepthBits = 24;
+static_assert(PassBits + PipelineBits + TextureBits + MeshBits + DepthBits == 64);
+
+constexpr std::uint64_t mask(std::uint32_t bits) { return (std::uint64_t{ 1 } << bits) - 1; }
+
+export struct DrawRecord
+{
+	std::uint64_t key = 0;
+	Mesh const * mesh = nullptr;
+	void const * object_data = nullptr; // of the pipeline's ObjectData type, nullptr if it has none
+	std::uint32_t pipeline_slot = 0;
+	std::uint32_t lod = 0;
+	// Index ranges of the draw in the list's range storage, the whole lod is drawn if there are none
+	std::uint32_t first_range = 0;
+	std::uint32_t range_count = 0;
+	std::uint32_t handle = 0; // see DrawList::Add
+	bool visible = true; // hidden records keep their place in the list but aren't drawn
+};
+
+// Draws a run of records that share a pipeline, instantiated per pipeline type so the object data is pushed without type erasure.
+// ranges is the list's range storage that the records index into.
+export using DrawRunFn = void (*)(void const * pipeline, std::span<DrawRecord const> records, std::span<MeshIndexRange const> ranges);
+
+// Identifies a record of a DrawList, it stays the same when the records are sorted
+export using DrawHandle = std::uint32_t;
+export constexpr DrawHandle InvalidDrawHandle = ~0u;
+
+// Compact list of draws, radix sorted by key and submitted in runs of the same pipeline, the submission loop touches
+// nothing but the records. Records are kept from frame to frame and only patched when what they draw changes.
+// A record whose key changed only moves within its run, the records of the same pass and, for opaque passes, the
+// same pipeline, so Sort re-sorts just the runs with changed keys. Adding records or changing their pipeline sorts
+// the whole list again.
+export class DrawList
+{
+public:
+	constexpr static std::uint32_t m_max_pipelines = 1 << PipelineBits;
+
+	// Returns the slot of the pipeline, or m_max_pipelines if the table is full.
+	// sort_order is the pipeline's place in the draw order within a pass, unique and below m_max_pipelines.
+	std::uint32_t AddPipeline(void const * pipeline, DrawRunFn draw_fn, char const * name, std::uint32_t sort_order);
+
+	// Adds a record that stays in the list, returns InvalidDrawHandle if the pipeline slot doesn't exist.
+	// It draws the whole of lod 0 at depth 0 until it's patched.
+	DrawHandle Add(
+		RenderPass pass,
+		std::uint32_t pipeline_slot,
+		std::uint32_t texture_index,
+		std::uint32_t mesh_index,
+		Mesh const * mesh,
+		void const * object_data);
+
+	// Patch a record, the ones that change its key mark its run for sorting
+	void SetState(DrawHandle handle, std::uint32_t pipeline_slot, std::uint32_t texture_index, std::uint32_t mesh_index, Mesh const * mesh);
+	void SetDepth(DrawHandle handle, float depth); // normalized to [0, 1], 0 being the near plane
+	void SetLod(DrawHandle handle, std::uint32_t lod, std::span<MeshIndexRange const> ranges); // e.g. the visible meshlets, empty to draw the whole lod
+	void SetVisible(DrawHandle handle, bool visible);
+
+	// Releases the ranges of the last frame, records that draw ranges have to be given them again before they're drawn
+	void BeginFrame();
+	void Sort();
+
+	// Draws the records of the passes from first_pass to last_pass.
+	// Calls begin_run(name) and end_run() around every run, used for profiling zones
+	template <typename BeginRunFn, typename EndRunFn>
+	void Submit(RenderPass first_pass, RenderPass last_pass, BeginRunFn && begin_run, EndRunFn && end_run) const;
+
+	// Of the visible records
+	std::uint64_t GetTriangleCount() const;
+
+	std::size_t GetSize() const { return m_records.size(); }
+	std::size_t GetPipelineCount() const { return m_pipelines.size(); }
+
+private:
+	struct PipelineSlot
+	{
+		void const * pipeline = nullptr;
+		DrawRunFn draw_fn = nullptr;
+		char const * name = nullptr;
+		std::uint32_t sort_order = 0;
+	};
+
+	// Where a record is and what its key is made of, by handle
+	struct RecordEntry
+	{
+		std::uint32_t position = 0; // in m_records
+		std::uint32_t run = 0; // in m_runs
+		RenderPass pass = RenderPass::GEOMETRY;
+		std::uint32_t texture_index = 0;
+		std::uint32_t mesh_index = 0;
+		std::uint64_t quantized_depth = 0;
+	};
+
+	// Records whose keys can change without moving them out of it, contiguous once sorted
+	struct Run
+	{
+		std::uint32_t begin = 0;
+		std::uint32_t end = 0;
+		bool dirty = false;
+	};
+
+	std::uint64_t make_key(RecordEntry const & entry, std::uint32_t pipeline_slot) const;
+	void update_key(DrawHandle handle);
+	void sort_all();
+	void sort_run(Run const & run);
+
+	std::vector<PipelineSlot> m_pipelines;
+	std::vector<DrawRecord> m_records;
+	std::vector<DrawRecord> m_sort_scratch;
+	std::vector<MeshIndexRange> m_ranges; // of the current frame
+	std::vector<RecordEntry> m_entries;
+	std::vector<Run> m_runs;
+	bool m_sort_all = false; // records were added or changed runs since the last sort
+};
+
+template <typename BeginRunFn, typename EndRunFn>
+void DrawList::Submit(RenderPass first_pass, RenderPass last_pass, BeginRunFn && begin_run, EndRunFn && end_run) const
+{
+	// The pass is in the top bits of the key, so the records of a pass range are contiguous once sorted
+	auto get_pass = [](DrawRecord const & record) { return record.key >> (64 - PassBits); };
+	auto pass_begin = std::ranges::partition_point(m_records,
+		[&](DrawRecord const & record) { return get_pass(record) < static_cast<std::uint64_t>(first_pass); });
+	auto pass_end = std::ranges::partition_point(m_records,
+		[&](DrawRecord const & record) { return get_pass(record) <= static_cast<std::uint64_t>(last_pass); });
+
+	std::size_t run_begin = static_cast<std::size_t>(pass_begin - m_records.begin());
+	std::size_t const records_end = static_cast<std::size_t>(pass_end - m_records.begin());
+	while (run_begin < records_end)
+	{
+		std::uint32_t slot = m_records[run_begin].pipeline_slot;
+
+		std::size_t run_end = run_begin + 1;
+		while (run_end < records_end && m_records[run_end].pipeline_slot == slot)
+			++run_end;
+
+		PipelineSlot const & pipeline = m_pipelines[slot];
+		begin_run(pipeline.name);
+		pipeline.draw_fn(pipeline.pipeline, std::span<DrawRecord const>{ m_records.data() + run_begin, run_end - run_begin }, m_ranges);
+		end_run();
+
+		run_begin = run_end;
+	}
+}
+
+// The bits of a key above the ones that can change within a run: the pass, and for opaque passes the pipeline
+std::uint64_t get_run_key(std::uint64_t key)
+{
+	RenderPass const pass = static_cast<RenderPass>(key >> (64 - PassBits));
+	return IsBlendedPass(pass) ? key >> (64 - PassBits) : key >> (64 - PassBits - PipelineBits);
+}
+
+std::uint32_t DrawList::AddPipeline(void const * pipeline, DrawRunFn draw_fn, char const * name, std::uint32_t sort_order)
+{
+	if (m_pipelines.size() >= m_max_pipelines)
+		return m_max_pipelines;
+
+	m_pipelines.push_back(PipelineSlot{ .pipeline = pipeline, .draw_fn = draw_fn, .name = name, .sort_order = sort_order });
+	return static_cast<std::uint32_t>(m_pipelines.size() - 1);
+}
+
+DrawHandle DrawList::Add(
+	RenderPass pass,
+	std::uint32_t pipeline_slot,
+	std::uint32_t texture_index,
+	std::uint32_t mesh_index,
+	Mesh const * mesh,
+	void const * object_data)
+{
+	if (pipeline_slot >= m_pipelines.size())
+		return InvalidDrawHandle;
+
+	DrawHandle const handle = static_cast<DrawHandle>(m_entries.size());
+	RecordEntry const entry{
+		.position = static_cast<std::uint32_t>(m_records.size()),
+		.pass = pass,
+		.texture_index = texture_index,
+		.mesh_index = mesh_index
+	};
+	m_entries.push_back(entry);
+
+	m_records.push_back(DrawRecord{
+		.key = make_key(entry, pipeline_slot),
+		.mesh = mesh,
+		.object_data = object_data,
+		.pipeline_slot = pipeline_slot,
+		.handle = handle
+		});
+	m_sort_all = true;
+
+	return handle;
+}
+
+void DrawList::SetState(DrawHandle handle, std::uint32_t pipeline_slot, std::uint32_t texture_index, std::uint32_t mesh_index, Mesh const * mesh)
+{
+	if (handle >= m_entries.size() || pipeline_slot >= m_pipelines.size())
+		return;
+
+	RecordEntry & entry = m_entries[handle];
+	DrawRecord & record = m_records[entry.position];
+	entry.texture_index = texture_index;
+	entry.mesh_index = mesh_index;
+	record.mesh = mesh;
+	if (record.pipeline_slot != pipeline_slot)
+	{
+		record.pipeline_slot = pipeline_slot;
+		m_sort_all = true;
+	}
+	update_key(handle);
+}
+
+void DrawList::SetDepth(DrawHandle handle, float depth)
+{
+	if (handle >= m_entries.size())
+		return;
+
+	depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	m_entries[handle].quantized_depth = static_cast<std::uint64_t>(depth * static_cast<float>(mask(DepthBits)));
+	update_key(handle);
+}
+
+void DrawList::SetLod(DrawHandle handle, std::uint32_t lod, std::span<MeshIndexRange const> ranges)
+{
+	if (handle >= m_entries.size())
+		return;
+
+	DrawRecord & record = m_records[m_entries[handle].position];
+	record.lod = lod;
+	record.first_range = static_cast<std::uint32_t>(m_ranges.size());
+	record.range_count = static_cast<std::uint32_t>(ranges.size());
+	m_ranges.insert(m_ranges.end(), ranges.begin(), ranges.end());
+}
+
+void DrawList::SetVisible(DrawHandle handle, bool visible)
+{
+	if (handle < m_entries.size())
+		m_records[m_entries[handle].position].visible = visible;
+}
+
+void DrawList::BeginFrame()
+{
+	m_ranges.clear();
+}
+
+void DrawList::Sort()
+{
+	if (m_sort_all)
+	{
+		sort_all();
+		return;
+	}
+
+	for (Run & run : m_runs)
+	{
+		if (!run.dirty)
+			continue;
+
+		sort_run(run);
+		run.dirty = false;
+	}
+}
+
+std::uint64_t DrawList::GetTriangleCount() const
+{
+	std::uint64_t count = 0;
+	for (DrawRecord const & record : m_records)
+	{
+		if (!record.visible)
+			continue;
+
+		if (record.range_count > 0)
+		{
+			for (MeshIndexRange const & range : std::span{ m_ranges }.subspan(record.first_range, record.range_count))
+				count += range.index_count / 3;
+		}
+		else if (record.lod < record.mesh->GetLodCount())
+			count += record.mesh->GetLod(record.lod).index_count / 3;
+	}
+	return count;
+}
+
+std::uint64_t DrawList::make_key(RecordEntry const & entry, std::uint32_t pipeline_slot) const
+{
+	std::uint64_t state = ((m_pipelines[pipeline_slot].sort_order & mask(PipelineBits)) << (TextureBits + MeshBits))
+		| ((entry.texture_index & mask(TextureBits)) << MeshBits)
+		| (entry.mesh_index & mask(MeshBits));
+
+	std::uint64_t key = (static_cast<std::uint64_t>(entry.pass) & mask(PassBits)) << (64 - PassBits);
+	if (IsBlendedPass(entry.pass))
+		key |= ((mask(DepthBits) - entry.quantized_depth) << (PipelineBits + TextureBits + MeshBits)) | state;
+	else
+		key |= (state << DepthBits) | entry.quantized_depth;
+	return key;
+}
+
+void DrawList::update_key(DrawHandle handle)
+{
+	RecordEntry const & entry = m_entries[handle];
+	DrawRecord & record = m_records[entry.position];
+
+	std::uint64_t const key = make_key(entry, record.pipeline_slot);
+	if (key == record.key)
+		return;
+
+	record.key = key;
+	if (!m_sort_all)
+		m_runs[entry.run].dirty = true;
+}
+
+// LSD radix sort, 8 bits per pass. It's stable, so draws with equal keys keep their submission order.
+// Passes where every key has the same byte are skipped, which is most of them for a small scene.
+void DrawList::sort_all()
+{
+	constexpr std::uint32_t RadixBits = 8;
+	constexpr std::uint32_t BucketCount = 1 << RadixBits;
+
+	m_sort_all = false;
+	m_runs.clear();
+	if (m_records.empty())
+		return;
+
+	m_sort_scratch.resize(m_records.size());
+
+	std::vector<DrawRecord> * src = &m_records;
+	std::vector<DrawRecord> * dst = &m_sort_scratch;
+
+	for (std::uint32_t shift = 0; shift < 64 && m_records.size() > 1; shift += RadixBits)
+	{
+		std::array<std::uint32_t, BucketCount> counts{};
+		for (DrawRecord const & record : *src)
+			++counts[(record.key >> shift) & (BucketCount - 1)];
+
+		if (counts[((*src)[0].key >> shift) & (BucketCount - 1)] == src->size())
+			continue;
+
+		std::uint32_t offset = 0;
+		for (std::uint32_t & count : counts)
+		{
+			std::uint32_t bucket_count = count;
+			count = offset;
+			offset += bucket_count;
+		}
+
+		for (DrawRecord const & record : *src)
+			(*dst)[counts[(record.key >> shift) & (BucketCount - 1)]++] = record;
+
+		std::swap(src, dst);
+	}
+
+	if (src != &m_records)
+		m_records.swap(m_sort_scratch);
+
+	for (std::uint32_t i = 0; i < m_records.size(); ++i)
+	{
+		if (i == 0 || get_run_key(m_records[i].key) != get_run_key(m_records[i - 1].key))
+			m_runs.push_back(Run{ .begin = i, .end = i });
+
+		++m_runs.back().end;
+		RecordEntry & entry = m_entries[m_records[i].handle];
+		entry.position = i;
+		entry.run = static_cast<std::uint32_t>(m_runs.size() - 1);
+	}
+}
+
+// Insertion sort, stable and without allocations. The keys of a run change little from one frame to the next,
+// so the run is nearly sorted already and this is close to a single pass over it.
+void DrawList::sort_run(Run const & run)
+{
+	for (std::uint32_t i = run.begin + 1; i < run.end; ++i)
+	{
+		DrawRecord const record = m_records[i];
+		std::uint32_t j = i;
+		for (; j > run.begin && m_records[j - 1].key > record.key; --j)
+			m_records[j] = m_records[j - 1];
+		m_records[j] = record;
+	}
+
+	for (std::uint32_t i = run.begin; i < run.end; ++i)
+		m_entries[m_records[i].handle].position = i;
+}
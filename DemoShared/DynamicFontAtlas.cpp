@@ -0,0 +1,344 @@
+// DynamicFontAtlas.cpp
+
+module;
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+module DynamicFontAtlas;
+
+import FrameArena;
+import GraphicsError;
+import Trace;
+
+GlyphRasterizer CreatePrebakedAtlasRasterizer(
+	FontAtlas const & font_atlas,
+	std::shared_ptr<StbImage const> image,
+	std::uint32_t pixel_size)
+{
+	return [&font_atlas, image = std::move(image), pixel_size](std::uint32_t unicode) -> std::optional<GlyphBitmap>
+		{
+			auto glyph = font_atlas.GetGlyph(unicode);
+			if (!glyph.has_value() || !glyph->get().atlas_bounds.has_value() || !image->IsValid())
+				return std::nullopt;
+
+			// The bounds are at pixel centers, the bitmap takes the whole pixels around them
+			glm::vec4 const bounds = glyph->get().atlas_bounds.value();
+			int const x0 = std::max(0, static_cast<int>(std::floor(bounds.x)));
+			int const y0 = std::max(0, static_cast<int>(std::floor(bounds.y)));
+			int const x1 = std::min(image->GetWidth(), static_cast<int>(std::ceil(bounds.z)));
+			int const y1 = std::min(image->GetHeight(), static_cast<int>(std::ceil(bounds.w)));
+			if (x1 <= x0 || y1 <= y0)
+				return std::nullopt;
+
+			GlyphBitmap bitmap{
+				.width = static_cast<std::uint32_t>(x1 - x0),
+				.height = static_cast<std::uint32_t>(y1 - y0),
+				.bounds = bounds - glm::vec4{ x0, y0, x0, y0 }
+			};
+			std::size_t const row_size = bitmap.width * pixel_size;
+			bitmap.pixels.resize(row_size * bitmap.height);
+			for (int y = y0; y < y1; ++y)
+			{
+				std::uint8_t const * src = image->GetData() + (static_cast<std::size_t>(y) * image->GetWidth() + x0) * pixel_size;
+				std::memcpy(bitmap.pixels.data() + (y - y0) * row_size, src, row_size);
+			}
+			return bitmap;
+		};
+}
+
+DynamicFontAtlas::DynamicFontAtlas(
+	GraphicsApi const & graphics_api,
+	AssetPool<Texture> & texture_pool,
+	FontAtlas const & metrics,
+	GlyphRasterizer rasterizer,
+	DynamicFontAtlasSettings const & settings /*= DynamicFontAtlasSettings{}*/)
+	: m_graphics_api(graphics_api)
+	, m_texture_pool(texture_pool)
+	, m_metrics(metrics)
+	, m_rasterizer(std::move(rasterizer))
+	, m_settings(settings)
+	, m_pixel_size(GetPixelSize(settings.format))
+{
+	m_page_pixels.resize(static_cast<std::size_t>(m_settings.page_size) * m_settings.page_size * m_pixel_size, 0);
+
+	Texture texture;
+	std::expected<void, GraphicsError> result = texture.Create(
+		m_graphics_api,
+		ImageData{
+			.data = m_page_pixels.data(),
+			.format = m_settings.format,
+			.width = m_settings.page_size,
+			.height = m_settings.page_size
+		},
+		false /*use_mip_map*/);
+	if (result.has_value())
+		m_texture_id = m_texture_pool.Add(std::move(texture));
+	else
+		std::cout << "DynamicFontAtlas: Failed to create the page texture. " << result.error().GetMessage() << std::endl;
+
+	for (std::uint32_t i = 0; i < std::max(m_settings.worker_count, 1u); ++i)
+		m_workers.emplace_back([this](std::stop_token stop_token) { worker_main(stop_token); });
+}
+
+DynamicFontAtlas::~DynamicFontAtlas()
+{
+	for (std::jthread & worker : m_workers)
+		worker.request_stop();
+	m_request_cv.notify_all();
+}
+
+void DynamicFontAtlas::worker_main(std::stop_token stop_token)
+{
+	while (true)
+	{
+		std::uint32_t unicode = 0;
+		{
+			std::unique_lock lock{ m_mutex };
+			if (!m_request_cv.wait(lock, stop_token, [this] { return !m_requests.empty(); }))
+				return; // stopped
+
+			unicode = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		// A full pool gives an invalid id as well, the glyph is then missing
+		std::optional<GlyphBitmap> bitmap = m_rasterizer(unicode);
+		AssetId const bitmap_id = bitmap.has_value() ? m_rasterized.Add(std::move(bitmap.value())) : AssetId{};
+
+		std::lock_guard lock{ m_mutex };
+		m_results.emplace_back(unicode, bitmap_id);
+	}
+}
+
+DynamicFontAtlas::GlyphLookup DynamicFontAtlas::GetGlyph(std::uint32_t unicode)
+{
+	auto [it, inserted] = m_entries.try_emplace(unicode);
+	Entry & entry = it->second;
+	if (inserted)
+	{
+		{
+			std::lock_guard lock{ m_mutex };
+			m_requests.push_back(unicode);
+		}
+		m_request_cv.notify_one();
+		++m_stats.pending_count;
+		return GlyphLookup{ .state = GlyphState::Pending };
+	}
+
+	if (entry.state != GlyphState::Ready)
+		return GlyphLookup{ .state = entry.state };
+
+	entry.last_used_frame = m_frame;
+	m_shelves[entry.shelf].last_used_frame = m_frame;
+	return GlyphLookup{ .state = GlyphState::Ready, .uv_rect = entry.uv_rect };
+}
+
+void DynamicFontAtlas::Touch(std::uint32_t unicode)
+{
+	auto it = m_entries.find(unicode);
+	if (it == m_entries.end() || it->second.state != GlyphState::Ready)
+		return;
+
+	it->second.last_used_frame = m_frame;
+	m_shelves[it->second.shelf].last_used_frame = m_frame;
+}
+
+// Shelves are rows of glyphs of about the same height. A glyph goes into the lowest shelf that's tall enough
+// without wasting much, a new shelf is opened above the others otherwise.
+std::optional<DynamicFontAtlas::Rect> DynamicFontAtlas::allocate(std::uint32_t width, std::uint32_t height)
+{
+	std::uint32_t const page_size = m_settings.page_size;
+	if (width > page_size || height > page_size)
+		return std::nullopt;
+
+	auto find_shelf = [&](std::uint32_t max_height) -> Shelf *
+		{
+			Shelf * best = nullptr;
+			for (Shelf & shelf : m_shelves)
+			{
+				if (shelf.height >= height && shelf.height <= max_height && shelf.x + width <= page_size
+					&& (!best || shelf.height < best->height))
+					best = &shelf;
+			}
+			return best;
+		};
+
+	Shelf * shelf = find_shelf(height + height / 4 + 1);
+	if (!shelf && m_shelves_top + height <= page_size)
+	{
+		m_shelves.push_back(Shelf{ .y = m_shelves_top, .height = height });
+		m_shelves_top += height;
+		shelf = &m_shelves.back();
+	}
+	if (!shelf)
+		shelf = find_shelf(page_size); // any shelf with room, e.g. a tall one that was evicted
+
+	if (!shelf)
+		return std::nullopt;
+
+	Rect rect{ .x = shelf->x, .y = shelf->y, .width = width, .height = height };
+	shelf->x += width;
+	return rect;
+}
+
+// Evicts the least recently used shelf that's at least min_height tall and wasn't used in the last frame.
+// Returns false if there's none.
+bool DynamicFontAtlas::evict_shelf(std::uint32_t min_height)
+{
+	Shelf * victim = nullptr;
+	for (Shelf & shelf : m_shelves)
+	{
+		if (shelf.height >= min_height && !shelf.glyphs.empty() && shelf.last_used_frame < m_frame
+			&& (!victim || shelf.last_used_frame < victim->last_used_frame))
+			victim = &shelf;
+	}
+	if (!victim)
+		return false;
+
+	for (std::uint32_t unicode : victim->glyphs)
+		m_entries.erase(unicode); // requested again the next time it's needed
+	m_stats.resident_count -= static_cast<std::uint32_t>(victim->glyphs.size());
+	m_stats.evicted_count += victim->glyphs.size();
+	victim->glyphs.clear();
+	victim->x = 0;
+	++m_generation;
+
+	// Empty shelves at the top give their rows back, so they can be split into shelves of other heights
+	while (!m_shelves.empty() && m_shelves.back().glyphs.empty())
+	{
+		m_shelves_top -= m_shelves.back().height;
+		m_shelves.pop_back();
+	}
+	return true;
+}
+
+void DynamicFontAtlas::place(std::uint32_t unicode, GlyphBitmap const & bitmap, Rect const & rect)
+{
+	std::size_t const row_size = bitmap.width * m_pixel_size;
+	for (std::uint32_t y = 0; y < bitmap.height; ++y)
+	{
+		std::size_t const offset = ((static_cast<std::size_t>(rect.y) + y) * m_settings.page_size + rect.x) * m_pixel_size;
+		std::memcpy(m_page_pixels.data() + offset, bitmap.pixels.data() + y * row_size, row_size);
+	}
+
+	Rect const glyph_rect{ .x = rect.x, .y = rect.y, .width = bitmap.width, .height = bitmap.height };
+	if (!m_dirty_rect)
+	{
+		m_dirty_rect = glyph_rect;
+	}
+	else
+	{
+		std::uint32_t const x0 = std::min(m_dirty_rect->x, glyph_rect.x);
+		std::uint32_t const y0 = std::min(m_dirty_rect->y, glyph_rect.y);
+		std::uint32_t const x1 = std::max(m_dirty_rect->x + m_dirty_rect->width, glyph_rect.x + glyph_rect.width);
+		std::uint32_t const y1 = std::max(m_dirty_rect->y + m_dirty_rect->height, glyph_rect.y + glyph_rect.height);
+		m_dirty_rect = Rect{ .x = x0, .y = y0, .width = x1 - x0, .height = y1 - y0 };
+	}
+
+	std::uint32_t const shelf_index = static_cast<std::uint32_t>(
+		std::ranges::find_if(m_shelves, [&](Shelf const & shelf) { return shelf.y == rect.y; }) - m_shelves.begin());
+	m_shelves[shelf_index].glyphs.push_back(unicode);
+	m_shelves[shelf_index].last_used_frame = std::max(m_shelves[shelf_index].last_used_frame, m_frame);
+
+	float const page_size = static_cast<float>(m_settings.page_size);
+	Entry & entry = m_entries[unicode];
+	entry.state = GlyphState::Ready;
+	entry.shelf = shelf_index;
+	entry.last_used_frame = m_frame;
+	entry.uv_rect = glm::vec4{
+		rect.x + bitmap.bounds.x,
+		rect.y + bitmap.bounds.y,
+		rect.x + bitmap.bounds.z,
+		rect.y + bitmap.bounds.w } / page_size;
+
+	++m_stats.resident_count;
+	++m_generation;
+}
+
+void DynamicFontAtlas::Update()
+{
+	Trace::Zone zone{ "DynamicFontAtlas::Update" };
+
+	std::vector<std::pair<std::uint32_t, AssetId>> results;
+	{
+		std::lock_guard lock{ m_mutex };
+		results.swap(m_results);
+	}
+
+	for (auto const & [unicode, bitmap_id] : results)
+	{
+		--m_stats.pending_count;
+		GlyphBitmap * bitmap = m_rasterized.Get(bitmap_id);
+		bool const valid = bitmap && bitmap->width > 0 && bitmap->height > 0
+			&& bitmap->pixels.size() == static_cast<std::size_t>(bitmap->width) * bitmap->height * m_pixel_size;
+		if (valid)
+			m_unplaced.emplace_back(unicode, std::move(*bitmap));
+		else
+		{
+			m_entries[unicode].state = GlyphState::Missing;
+			++m_generation;
+		}
+		m_rasterized.Remove(bitmap_id);
+	}
+	// Only this thread gets the bitmaps, so none of the removed ones is still in use
+	m_rasterized.Reclaim();
+
+	// Glyphs that don't fit even after evicting everything that's idle wait for the next frame
+	std::erase_if(m_unplaced, [&](std::pair<std::uint32_t, GlyphBitmap> const & unplaced)
+		{
+			GlyphBitmap const & bitmap = unplaced.second;
+			std::uint32_t const width = bitmap.width + m_settings.padding;
+			std::uint32_t const height = bitmap.height + m_settings.padding;
+
+			std::optional<Rect> rect = allocate(width, height);
+			while (!rect && evict_shelf(height))
+				rect = allocate(width, height);
+			if (!rect)
+				return false;
+
+			place(unplaced.first, bitmap, rect.value());
+			return true;
+		});
+
+	m_stats.uploaded_bytes = 0;
+	Texture * texture = m_texture_pool.Get(m_texture_id);
+	if (m_dirty_rect && texture)
+	{
+		Rect const & dirty = m_dirty_rect.value();
+		std::size_t const row_size = dirty.width * m_pixel_size;
+		std::pmr::vector<std::uint8_t> pixels(row_size * dirty.height, FrameArena::GetResource());
+		for (std::uint32_t y = 0; y < dirty.height; ++y)
+		{
+			std::size_t const offset = ((static_cast<std::size_t>(dirty.y) + y) * m_settings.page_size + dirty.x) * m_pixel_size;
+			std::memcpy(pixels.data() + y * row_size, m_page_pixels.data() + offset, row_size);
+		}
+
+		std::expected<void, GraphicsError> result = texture->Update(
+			m_graphics_api,
+			ImageData{ .data = pixels.data(), .format = m_settings.format, .width = dirty.width, .height = dirty.height },
+			dirty.x,
+			dirty.y);
+		if (!result.has_value())
+			std::cout << "DynamicFontAtlas::Update: " << result.error().GetMessage() << std::endl;
+		m_stats.uploaded_bytes = pixels.size();
+	}
+	m_dirty_rect.reset();
+
+	++m_frame;
+}
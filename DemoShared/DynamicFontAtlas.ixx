@@ -0,0 +1,174 @@
+// DynamicFontAtlas.ixx
+
+module;
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/vec4.hpp>
+
+export module DynamicFontAtlas;
+
+import AssetPool;
+import ConcurrentAssetPool;
+import FontAtlas;
+import GraphicsApi;
+import StbImage;
+import Texture;
+
+// The pixels of one glyph, in the format of the atlas page
+export struct GlyphBitmap
+{
+	std::uint32_t width = 0;
+	std::uint32_t height = 0;
+	std::vector<std::uint8_t> pixels; // rows go up like the glyph bounds, see FontAtlas::Glyph
+	glm::vec4 bounds{ 0.0f }; // left, bottom, right, top of the glyph's quad in the bitmap, in pixels
+};
+
+// Produces the bitmap of a glyph, called on the atlas' worker threads. Returns nothing for glyphs the font doesn't have.
+export using GlyphRasterizer = std::function<std::optional<GlyphBitmap>(std::uint32_t unicode)>;
+
+// Rasterizes by copying the glyphs out of a pre-baked msdf atlas image kept in system memory. A real rasterizer,
+// msdfgen or FreeType, plugs in the same way. The image has to be loaded flipped, so its rows go up.
+export GlyphRasterizer CreatePrebakedAtlasRasterizer(
+	FontAtlas const & font_atlas,
+	std::shared_ptr<StbImage const> image,
+	std::uint32_t pixel_size);
+
+export struct DynamicFontAtlasSettings
+{
+	std::uint32_t page_size = 1024; // width and height of the page, which is all the gpu memory the atlas uses
+	std::uint32_t padding = 1; // between glyphs, so filtering doesn't bleed into the neighbors
+	PixelFormat format = PixelFormat::RGB_UNORM;
+	std::uint32_t worker_count = 2;
+};
+
+export struct DynamicFontAtlasStats
+{
+	std::uint32_t resident_count = 0; // glyphs in the page
+	std::uint32_t pending_count = 0; // requested and not in the page yet
+	std::uint64_t evicted_count = 0; // since the atlas was created
+	std::uint64_t uploaded_bytes = 0; // by the last Update
+};
+
+// A font atlas whose glyphs are rasterized the first time they're needed, on worker threads, and shelf packed into
+// a page texture. Finished glyphs are uploaded once per frame as one sub-rect of the page. When the page is full, the
+// least recently used shelf is evicted, as long as none of its glyphs were drawn in the last frame.
+// GetGlyph never blocks: a glyph that isn't resident yet is pending, text skips it until it arrives.
+export class DynamicFontAtlas
+{
+public:
+	enum class GlyphState
+	{
+		Ready,
+		Pending,
+		Missing, // the rasterizer doesn't have it
+	};
+
+	struct GlyphLookup
+	{
+		GlyphState state = GlyphState::Missing;
+		glm::vec4 uv_rect{ 0.0f }; // left, bottom, right, top in the page, when ready
+	};
+
+	explicit DynamicFontAtlas(
+		GraphicsApi const & graphics_api,
+		AssetPool<Texture> & texture_pool,
+		FontAtlas const & metrics,
+		GlyphRasterizer rasterizer,
+		DynamicFontAtlasSettings const & settings = DynamicFontAtlasSettings{});
+	~DynamicFontAtlas();
+
+	DynamicFontAtlas(DynamicFontAtlas const &) = delete;
+	DynamicFontAtlas & operator=(DynamicFontAtlas const &) = delete;
+
+	// Requests the glyph if it isn't resident and marks it as used this frame
+	GlyphLookup GetGlyph(std::uint32_t unicode);
+	// Marks a glyph as used this frame, for text that didn't change
+	void Touch(std::uint32_t unicode);
+
+	// Packs and uploads the glyphs that finished rasterizing, call it once per frame before the text is updated
+	void Update();
+
+	// Changes when glyphs become ready or are evicted, text that uses the atlas has to be rebuilt then
+	std::uint64_t GetGeneration() const { return m_generation; }
+
+	AssetId GetTexture() const { return m_texture_id; }
+	FontAtlas const & GetMetrics() const { return m_metrics; }
+	DynamicFontAtlasStats const & GetStats() const { return m_stats; }
+
+private:
+	struct Shelf
+	{
+		std::uint32_t y = 0;
+		std::uint32_t height = 0;
+		std::uint32_t x = 0; // where the next glyph goes
+		std::uint64_t last_used_frame = 0; // of its most recently used glyph
+		std::vector<std::uint32_t> glyphs; // unicodes
+	};
+
+	struct Entry
+	{
+		GlyphState state = GlyphState::Pending;
+		glm::vec4 uv_rect{ 0.0f };
+		std::uint32_t shelf = 0;
+		std::uint64_t last_used_frame = 0;
+	};
+
+	struct Rect
+	{
+		std::uint32_t x = 0;
+		std::uint32_t y = 0;
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+	};
+
+	void worker_main(std::stop_token stop_token);
+
+	std::optional<Rect> allocate(std::uint32_t width, std::uint32_t height);
+	bool evict_shelf(std::uint32_t min_height);
+	void place(std::uint32_t unicode, GlyphBitmap const & bitmap, Rect const & rect);
+
+	GraphicsApi const & m_graphics_api;
+	AssetPool<Texture> & m_texture_pool;
+	FontAtlas const & m_metrics;
+	GlyphRasterizer m_rasterizer;
+	DynamicFontAtlasSettings m_settings;
+	std::uint32_t m_pixel_size = 0;
+
+	AssetId m_texture_id;
+	std::vector<std::uint8_t> m_page_pixels; // cpu copy of the page, the dirty rect is uploaded from it
+	std::optional<Rect> m_dirty_rect;
+
+	std::vector<Shelf> m_shelves; // from the bottom of the page up
+	std::uint32_t m_shelves_top = 0; // first row above the shelves
+	std::unordered_map<std::uint32_t, Entry> m_entries;
+
+	// Rasterized glyphs that didn't fit yet because everything in the page is in use
+	std::vector<std::pair<std::uint32_t, GlyphBitmap>> m_unplaced;
+
+	std::uint64_t m_frame = 1;
+	std::uint64_t m_generation = 0;
+	DynamicFontAtlasStats m_stats;
+
+	// Shared with the workers
+	std::mutex m_mutex;
+	std::condition_variable_any m_request_cv;
+	std::deque<std::uint32_t> m_requests;
+	std::vector<std::pair<std::uint32_t, AssetId>> m_results; // invalid ids for missing glyphs
+
+	// The workers add the bitmaps here and only pass their ids through m_results, Update removes and reclaims them
+	ConcurrentAssetPool<GlyphBitmap> m_rasterized;
+
+	std::vector<std::jthread> m_workers; // last, so they stop before the rest is destroyed
+};
@@ -23,6 +23,7 @@ import GraphicsApi;
 import GraphicsError;
 import StbImage;
 import Texture;
+import Trace;
 
 export class FontAtlas
 {
@@ -44,6 +45,19 @@ public:
 
 	AssetId GetTexture() const { return m_texture_id; }
 	float GetPxRange() const { return m_px_range; }
+	// Distance between baselines, in ems like the glyph metrics
+	float GetLineHeight() const { return m_line_height; }
+	// Height of the tallest glyphs above the baseline, in ems
+	float GetAscender() const { return m_ascender; }
+
+	// Adjustment of the advance between two glyphs, in ems, 0 for most pairs
+	float GetKerning(std::uint32_t left_unicode, std::uint32_t right_unicode) const
+	{
+		if (m_kerning.empty())
+			return 0.0f;
+		auto it = m_kerning.find(kerning_key(left_unicode, right_unicode));
+		return it != m_kerning.end() ? it->second : 0.0f;
+	}
 
 	std::optional<std::reference_wrapper<const Glyph>> GetGlyph(std::uint32_t unicode) const
 	{
@@ -54,8 +68,15 @@ public:
 	}
 
 private:
+	static std::uint64_t kerning_key(std::uint32_t left_unicode, std::uint32_t right_unicode)
+	{
+		return (std::uint64_t{ left_unicode } << 32) | right_unicode;
+	}
+
 	void init_glyphs(std::filesystem::path const & json_path)
 	{
+		Trace::Zone zone{ "FontAtlas::init_glyphs" };
+
 		std::ifstream file(json_path);
 		if (!file)
 			throw std::runtime_error("Failed to open JSON file: " + json_path.string());
@@ -82,10 +103,31 @@ private:
 
 			m_glyphs.emplace(glyph.unicode, std::move(glyph));
 		}
+
+		// Both are optional, depending on how the atlas was generated
+		auto metrics = json.find("metrics");
+		if (metrics != json.end() && metrics->contains("lineHeight"))
+			m_line_height = (*metrics)["lineHeight"].get<float>();
+		if (metrics != json.end() && metrics->contains("ascender"))
+			m_ascender = (*metrics)["ascender"].get<float>();
+
+		auto kerning = json.find("kerning");
+		if (kerning != json.end())
+		{
+			for (const auto & k : *kerning)
+			{
+				m_kerning.emplace(
+					kerning_key(k["unicode1"].get<std::uint32_t>(), k["unicode2"].get<std::uint32_t>()),
+					k["advance"].get<float>());
+			}
+		}
 	}
 
 private:
 	AssetId m_texture_id;
 	float m_px_range = 0.0f;
+	float m_line_height = 1.2f;
+	float m_ascender = 0.9f;
 	std::unordered_map<std::uint32_t, const Glyph> m_glyphs;
+	std::unordered_map<std::uint64_t, float> m_kerning;
 };
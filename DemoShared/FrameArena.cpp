@@ -0,0 +1,84 @@
+// FrameArena.cpp
+
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+
+module FrameArena;
+
+namespace
+{
+	std::atomic<std::uint64_t> g_frame{ 0 };
+
+	thread_local FrameArena t_arena;
+}
+
+void FrameArena::BeginFrame()
+{
+	g_frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameArena & FrameArena::Get()
+{
+	std::uint64_t const frame = g_frame.load(std::memory_order_relaxed);
+	if (t_arena.m_frame != frame)
+	{
+		t_arena.Reset();
+		t_arena.m_frame = frame;
+	}
+	return t_arena;
+}
+
+void FrameArena::Reset()
+{
+	// A frame that spilled into several blocks gets a single block of their total size, so the arena settles on one
+	if (m_blocks.size() > 1 && m_block_index > 0)
+	{
+		m_block_size = m_stats.capacity_bytes;
+		m_blocks.clear();
+		m_blocks.push_back(Block{ .data = std::make_unique_for_overwrite<std::byte[]>(m_block_size), .size = m_block_size });
+		++m_stats.block_allocation_count;
+	}
+
+	m_block_index = 0;
+	m_block_offset = 0;
+	m_stats.used_bytes = 0;
+}
+
+void * FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	bytes = std::max<std::size_t>(bytes, 1); // distinct pointers for empty allocations
+
+	for (;;)
+	{
+		if (m_block_index < m_blocks.size())
+		{
+			Block & block = m_blocks[m_block_index];
+			void * ptr = block.data.get() + m_block_offset;
+			std::size_t space = block.size - m_block_offset;
+			if (std::align(alignment, bytes, ptr, space))
+			{
+				m_block_offset = block.size - space + bytes;
+				m_stats.used_bytes += bytes;
+				m_stats.peak_bytes = std::max(m_stats.peak_bytes, m_stats.used_bytes);
+				return ptr;
+			}
+
+			++m_block_index;
+			m_block_offset = 0;
+			continue;
+		}
+
+		std::size_t const size = std::max(m_block_size, bytes + alignment);
+		m_blocks.push_back(Block{ .data = std::make_unique_for_overwrite<std::byte[]>(size), .size = size });
+		m_stats.capacity_bytes = 0;
+		for (Block const & b : m_blocks)
+			m_stats.capacity_bytes += b.size;
+		++m_stats.block_allocation_count;
+	}
+}
@@ -0,0 +1,68 @@
+// FrameArena.ixx
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+export module FrameArena;
+
+export struct FrameArenaStats
+{
+	std::size_t used_bytes = 0; // allocated in the current frame
+	std::size_t peak_bytes = 0; // most allocated in a single frame
+	std::size_t capacity_bytes = 0;
+	std::uint64_t block_allocation_count = 0; // requests to the heap, stops growing once a frame fits in the blocks
+};
+
+// Bump allocator for data that only lives until the end of the frame, like the strings and scratch arrays built while
+// updating and recording it. Allocating moves an offset, deallocating does nothing and the whole arena is released at
+// once when the next frame begins. The blocks are kept between frames, so once they fit a frame the heap isn't used.
+// Every thread has its own arena, so allocating never takes a lock. It is a std::pmr::memory_resource:
+//     std::pmr::string text{ FrameArena::GetResource() };
+// Nothing allocated from it may be kept past the frame, e.g. in a member container.
+export class FrameArena final : public std::pmr::memory_resource
+{
+public:
+	constexpr static std::size_t DefaultBlockSize = 64 * 1024;
+
+	explicit FrameArena(std::size_t block_size = DefaultBlockSize) : m_block_size{ block_size } {}
+
+	FrameArena(FrameArena const &) = delete;
+	FrameArena & operator=(FrameArena const &) = delete;
+
+	// Begins a new frame on every thread, each thread's arena is reset the next time the thread gets it.
+	// Called by the update thread once nothing allocated in the previous frame is in use anymore.
+	static void BeginFrame();
+
+	// The calling thread's arena, reset if a frame began since the thread last got it
+	static FrameArena & Get();
+	static std::pmr::memory_resource * GetResource() { return &Get(); }
+
+	// Releases everything allocated from the arena
+	void Reset();
+
+	FrameArenaStats const & GetStats() const { return m_stats; }
+
+private:
+	void * do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void * /*ptr*/, std::size_t /*bytes*/, std::size_t /*alignment*/) override {}
+	bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override { return this == &other; }
+
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> data;
+		std::size_t size = 0;
+	};
+
+	std::size_t m_block_size = 0; // of the next block, grows to the size of a whole frame
+	std::vector<Block> m_blocks;
+	std::size_t m_block_index = 0; // allocated from
+	std::size_t m_block_offset = 0;
+	std::uint64_t m_frame = 0; // the frame the arena was last reset for
+
+	FrameArenaStats m_stats;
+};
@@ -2,11 +2,34 @@
 
 module;
 
-#include <mutex>
-#include <unordered_set>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
 
 export module Input;
 
+export struct KeyEvent
+{
+	int key = 0;
+	bool pressed = false;
+	std::chrono::steady_clock::time_point time; // when the window system delivered it
+};
+
+// Time from the oldest key event applied in a frame until the frame was presented
+export struct InputLatencyStats
+{
+	float last_ms = 0.0f; // of the last frame that had key events
+	float avg_ms = 0.0f; // moving average over the frames that had key events
+	std::uint32_t dropped_event_count = 0; // events that didn't fit in the queue
+};
+
+// Key events are pushed by the thread that receives the window events and applied once per frame by the thread that
+// updates the scene, through a single producer single consumer queue, so neither thread ever waits for the other.
+// The keys pressed during a frame are a bitset, KeyIsPressed only tests a bit.
 export class Input
 {
 public:
@@ -18,19 +41,19 @@ public:
 		Up      = 265  // GLFW_KEY_UP
 	};
 
-	void SetKey(int key, bool pressed)
-	{
-		std::lock_guard lock(m_key_state_mutex);
-		if (pressed)
-			m_key_state.insert(key);
-		else
-			m_key_state.erase(key);
-	}
+	constexpr static int KeyCount = 512; // above GLFW_KEY_LAST, other keys are ignored
+
+	// Producer side, called from the window event thread
+	void SetKey(int key, bool pressed);
+
+	// Consumer side, called from the update thread. BeginFrame applies the queued events to the frame's key state,
+	// OnFramePresented measures the latency of the frame's events once it has been presented.
+	void BeginFrame();
+	void OnFramePresented();
 
 	bool KeyIsPressed(int key) const
 	{
-		std::lock_guard lock(m_key_state_mutex);
-		return m_key_state.contains(key);
+		return key >= 0 && key < KeyCount && m_pressed_keys.test(static_cast<std::size_t>(key));
 	}
 
 	bool KeyIsPressed(Key key) const
@@ -38,7 +61,76 @@ public:
 		return KeyIsPressed(static_cast<int>(key));
 	}
 
+	// Oldest key event applied by the last BeginFrame, none if there weren't any
+	std::optional<std::chrono::steady_clock::time_point> GetOldestEventTime() const { return m_oldest_event_time; }
+
+	InputLatencyStats const & GetLatencyStats() const { return m_latency_stats; }
+
 private:
-	mutable std::mutex m_key_state_mutex;
-	std::unordered_set<int> m_key_state;
+	constexpr static std::uint32_t QueueCapacity = 1024; // power of 2, the indices wrap around
+	constexpr static float LatencyAvgWeight = 0.1f;
+
+	std::array<KeyEvent, QueueCapacity> m_events;
+	// On their own cache lines, each is written by one thread and read by the other
+	alignas(64) std::atomic<std::uint32_t> m_write_index{ 0 };
+	alignas(64) std::atomic<std::uint32_t> m_read_index{ 0 };
+	alignas(64) std::atomic<std::uint32_t> m_dropped_event_count{ 0 };
+
+	// Only touched by the consumer
+	std::bitset<KeyCount> m_pressed_keys;
+	std::optional<std::chrono::steady_clock::time_point> m_oldest_event_time;
+	InputLatencyStats m_latency_stats;
 };
+
+void Input::SetKey(int key, bool pressed)
+{
+	if (key < 0 || key >= KeyCount)
+		return;
+
+	std::uint32_t write_index = m_write_index.load(std::memory_order_relaxed);
+	if (write_index - m_read_index.load(std::memory_order_acquire) == QueueCapacity)
+	{
+		// The consumer is far behind, better to lose an event than to block the window's event loop
+		m_dropped_event_count.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	m_events[write_index % QueueCapacity] = KeyEvent{
+		.key = key,
+		.pressed = pressed,
+		.time = std::chrono::steady_clock::now()
+	};
+	m_write_index.store(write_index + 1, std::memory_order_release);
+}
+
+void Input::BeginFrame()
+{
+	std::uint32_t read_index = m_read_index.load(std::memory_order_relaxed);
+	std::uint32_t const write_index = m_write_index.load(std::memory_order_acquire);
+
+	m_oldest_event_time.reset();
+	if (read_index != write_index)
+		m_oldest_event_time = m_events[read_index % QueueCapacity].time;
+
+	// A press and release within the same frame is applied in order, so such a key reads as released
+	for (; read_index != write_index; ++read_index)
+	{
+		KeyEvent const & event = m_events[read_index % QueueCapacity];
+		m_pressed_keys.set(static_cast<std::size_t>(event.key), event.pressed);
+	}
+	m_read_index.store(read_index, std::memory_order_release);
+
+	m_latency_stats.dropped_event_count = m_dropped_event_count.load(std::memory_order_relaxed);
+}
+
+void Input::OnFramePresented()
+{
+	if (!m_oldest_event_time)
+		return;
+
+	std::chrono::duration<float, std::milli> const latency = std::chrono::steady_clock::now() - *m_oldest_event_time;
+	m_latency_stats.last_ms = latency.count();
+	m_latency_stats.avg_ms = m_latency_stats.avg_ms == 0.0f
+		? latency.count()
+		: std::lerp(m_latency_stats.avg_ms, latency.count(), LatencyAvgWeight);
+}
@@ -0,0 +1,284 @@
+// JobSystem.cpp
+
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+module JobSystem;
+
+import PlatformUtils;
+import Trace;
+
+namespace
+{
+	// Lets Run push to the deque of the worker it's called on
+	thread_local JobSystem const * t_job_system = nullptr;
+	thread_local std::uint32_t t_worker_index = 0;
+}
+
+bool WorkStealingDeque::Push(Job * job)
+{
+	std::int64_t const bottom = m_bottom.load(std::memory_order_relaxed);
+	std::int64_t const top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= Capacity)
+		return false;
+
+	m_jobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job * WorkStealingDeque::Pop()
+{
+	std::int64_t const bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job * job = m_jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// The last job, a thief may be taking it at the same time
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job * WorkStealingDeque::Steal()
+{
+	std::int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::int64_t const bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return nullptr;
+
+	Job * job = m_jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+std::uint32_t JobSystem::GetDefaultWorkerCount()
+{
+	return std::max(PlatformUtils::GetPhysicalCoreCount(), 2u) - 1;
+}
+
+JobSystem::JobSystem(std::uint32_t worker_count /*= GetDefaultWorkerCount()*/)
+	: m_main_thread_id{ std::this_thread::get_id() }
+{
+	// All the workers exist before any of them starts stealing from the others
+	m_workers.reserve(worker_count);
+	for (std::uint32_t i = 0; i < worker_count; ++i)
+		m_workers.push_back(std::make_unique<Worker>());
+
+	for (std::uint32_t i = 0; i < worker_count; ++i)
+		m_workers[i]->thread = std::jthread([this, i](std::stop_token stop_token) { worker_loop(i, stop_token); });
+}
+
+JobSystem::~JobSystem()
+{
+	for (std::unique_ptr<Worker> & worker : m_workers)
+		worker->thread.request_stop();
+	m_work_epoch.fetch_add(1);
+	m_work_epoch.notify_all();
+
+	for (std::unique_ptr<Worker> & worker : m_workers)
+		worker->thread.join();
+
+	// Jobs that were never run, e.g. main thread jobs nobody waited for
+	for (Job * job : m_shared_jobs)
+		delete job;
+	for (Job * job : m_main_thread_jobs)
+		delete job;
+	for (Job * job : m_free_jobs)
+		delete job;
+}
+
+void JobSystem::Run(std::function<void()> fn, JobCounter * counter /*= nullptr*/)
+{
+	if (counter)
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+
+	push(allocate_job(std::move(fn), counter));
+	wake_worker();
+}
+
+void JobSystem::RunOnMainThread(std::function<void()> fn, JobCounter * counter /*= nullptr*/)
+{
+	if (counter)
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+
+	std::scoped_lock lock(m_main_thread_jobs_mutex);
+	m_main_thread_jobs.push_back(allocate_job(std::move(fn), counter));
+}
+
+void JobSystem::RunMainThreadJobs()
+{
+	std::vector<Job *> jobs;
+	{
+		std::scoped_lock lock(m_main_thread_jobs_mutex);
+		jobs.swap(m_main_thread_jobs);
+	}
+
+	for (Job * job : jobs)
+		execute(job);
+}
+
+void JobSystem::Wait(JobCounter const & counter)
+{
+	Trace::Zone zone{ "JobSystem::Wait" };
+
+	bool const on_main_thread = is_main_thread();
+	std::uint32_t const worker_index = t_job_system == this ? t_worker_index : NotAWorker;
+
+	// Never sleeps, the jobs waited for are short and the counter may be gone as soon as it reaches 0
+	while (!counter.IsDone())
+	{
+		if (on_main_thread)
+			RunMainThreadJobs();
+
+		if (Job * job = find_job(worker_index))
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::worker_loop(std::uint32_t worker_index, std::stop_token stop_token)
+{
+	Trace::SetThreadName("Worker");
+
+	t_job_system = this;
+	t_worker_index = worker_index;
+
+	while (!stop_token.stop_requested())
+	{
+		if (Job * job = find_job(worker_index))
+		{
+			execute(job);
+			continue;
+		}
+
+		// Jobs added after the epoch was read change it, then the wait returns right away
+		std::uint32_t const epoch = m_work_epoch.load();
+		if (Job * job = find_job(worker_index))
+		{
+			execute(job);
+			continue;
+		}
+
+		m_sleeping_count.fetch_add(1);
+		if (!stop_token.stop_requested())
+			m_work_epoch.wait(epoch);
+		m_sleeping_count.fetch_sub(1);
+	}
+}
+
+Job * JobSystem::allocate_job(std::function<void()> fn, JobCounter * counter)
+{
+	Job * job = nullptr;
+	{
+		std::scoped_lock lock(m_free_jobs_mutex);
+		if (!m_free_jobs.empty())
+		{
+			job = m_free_jobs.back();
+			m_free_jobs.pop_back();
+		}
+	}
+
+	if (!job)
+		return new Job{ .fn = std::move(fn), .counter = counter };
+
+	job->fn = std::move(fn);
+	job->counter = counter;
+	return job;
+}
+
+void JobSystem::free_job(Job * job)
+{
+	std::scoped_lock lock(m_free_jobs_mutex);
+	m_free_jobs.push_back(job);
+}
+
+Job * JobSystem::find_job(std::uint32_t worker_index)
+{
+	WorkStealingDeque * own_deque = worker_index != NotAWorker
+		? &m_workers[worker_index]->deque
+		: (is_main_thread() ? &m_main_thread_deque : nullptr);
+	if (own_deque)
+	{
+		if (Job * job = own_deque->Pop())
+			return job;
+	}
+
+	{
+		std::scoped_lock lock(m_shared_jobs_mutex);
+		if (!m_shared_jobs.empty())
+		{
+			Job * job = m_shared_jobs.front();
+			m_shared_jobs.pop_front();
+			return job;
+		}
+	}
+
+	// Starts with the next worker, so the thieves spread over the victims
+	std::uint32_t const worker_count = GetWorkerCount();
+	std::uint32_t const first = worker_index != NotAWorker ? worker_index + 1 : 0;
+	for (std::uint32_t i = 0; i < worker_count; ++i)
+	{
+		std::uint32_t const victim = (first + i) % worker_count;
+		if (victim == worker_index)
+			continue;
+		if (Job * job = m_workers[victim]->deque.Steal())
+			return job;
+	}
+	if (own_deque != &m_main_thread_deque)
+		return m_main_thread_deque.Steal();
+
+	return nullptr;
+}
+
+void JobSystem::execute(Job * job)
+{
+	job->fn();
+	job->fn = nullptr; // the closure is destroyed before the waiter can go on
+
+	// The counter's owner may destroy it as soon as it reaches 0, it's the last thing touched
+	if (job->counter)
+		job->counter->m_count.fetch_sub(1, std::memory_order_release);
+	free_job(job);
+}
+
+void JobSystem::push(Job * job)
+{
+	if (t_job_system == this && m_workers[t_worker_index]->deque.Push(job))
+		return;
+	if (t_job_system != this && is_main_thread() && m_main_thread_deque.Push(job))
+		return;
+
+	std::scoped_lock lock(m_shared_jobs_mutex);
+	m_shared_jobs.push_back(job);
+}
+
+void JobSystem::wake_worker()
+{
+	m_work_epoch.fetch_add(1);
+	if (m_sleeping_count.load() > 0)
+		m_work_epoch.notify_one();
+}
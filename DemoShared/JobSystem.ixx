@@ -0,0 +1,158 @@
+// JobSystem.ixx
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+export module JobSystem;
+
+// Number of jobs that were started with it and haven't finished yet, see JobSystem::Wait.
+// A job that depends on others waits on their counter, the wait runs other jobs meanwhile.
+export class JobCounter
+{
+public:
+	JobCounter() = default;
+
+	JobCounter(JobCounter const &) = delete;
+	JobCounter & operator=(JobCounter const &) = delete;
+
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<std::uint32_t> m_count{ 0 };
+};
+
+struct Job
+{
+	std::function<void()> fn;
+	JobCounter * counter = nullptr;
+};
+
+// Chase-Lev deque: the owning worker pushes and pops at the bottom, the other threads steal from the top
+class WorkStealingDeque
+{
+public:
+	constexpr static std::int64_t Capacity = 4096; // power of 2
+
+	// Owner only, fails when full
+	bool Push(Job * job);
+	// Owner only
+	Job * Pop();
+	// Any thread
+	Job * Steal();
+
+private:
+	std::array<std::atomic<Job *>, Capacity> m_jobs{};
+	alignas(64) std::atomic<std::int64_t> m_top{ 0 };
+	alignas(64) std::atomic<std::int64_t> m_bottom{ 0 };
+};
+
+// Worker threads with a deque each, jobs are pushed to the deque of the worker that creates them and idle workers
+// steal from the others. The main thread has a deque too, jobs created on other threads go through a shared queue.
+// Finished jobs are kept for reuse, so once the pool has grown to the number of jobs in flight running a job doesn't
+// allocate, as long as its closure fits in std::function's small buffer.
+// Idle workers sleep until jobs are added, so they don't take cpu time from the update/render thread.
+// The thread that created the job system is its main thread, jobs that have to run on it, like anything that uses
+// the graphics api, are queued with RunOnMainThread and run when it calls RunMainThreadJobs or waits.
+export class JobSystem
+{
+public:
+	// A worker per physical core, minus the core of the main thread
+	static std::uint32_t GetDefaultWorkerCount();
+
+	explicit JobSystem(std::uint32_t worker_count = GetDefaultWorkerCount());
+	~JobSystem();
+
+	JobSystem(JobSystem const &) = delete;
+	JobSystem & operator=(JobSystem const &) = delete;
+
+	std::uint32_t GetWorkerCount() const { return static_cast<std::uint32_t>(m_workers.size()); }
+
+	// The counter, if any, counts the job until it has finished
+	void Run(std::function<void()> fn, JobCounter * counter = nullptr);
+	void RunOnMainThread(std::function<void()> fn, JobCounter * counter = nullptr);
+
+	void RunMainThreadJobs();
+
+	// Runs other jobs until the counter's jobs have finished
+	void Wait(JobCounter const & counter);
+
+	// Calls fn(begin, end) for ranges covering [0, count) in parallel and returns once all of them are done.
+	// The ranges are sized so each thread gets a few of them to balance uneven work, but never below min_grain items.
+	template <typename FnT>
+	void ParallelFor(std::uint32_t count, FnT && fn, std::uint32_t min_grain = 1);
+
+private:
+	struct Worker
+	{
+		WorkStealingDeque deque;
+		std::jthread thread;
+	};
+
+	void worker_loop(std::uint32_t worker_index, std::stop_token stop_token);
+
+	Job * allocate_job(std::function<void()> fn, JobCounter * counter);
+	void free_job(Job * job);
+
+	Job * find_job(std::uint32_t worker_index);
+	void execute(Job * job);
+	void push(Job * job);
+	void wake_worker();
+
+	bool is_main_thread() const { return std::this_thread::get_id() == m_main_thread_id; }
+
+	constexpr static std::uint32_t NotAWorker = ~0u;
+
+	std::thread::id const m_main_thread_id;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	WorkStealingDeque m_main_thread_deque;
+	std::mutex m_shared_jobs_mutex;
+	std::deque<Job *> m_shared_jobs; // added from other threads, or when a deque is full
+	std::mutex m_main_thread_jobs_mutex;
+	std::vector<Job *> m_main_thread_jobs;
+	std::mutex m_free_jobs_mutex;
+	std::vector<Job *> m_free_jobs;
+
+	// Bumped whenever jobs are added, sleeping workers wait for it to change
+	std::atomic<std::uint32_t> m_work_epoch{ 0 };
+	std::atomic<std::uint32_t> m_sleeping_count{ 0 };
+};
+
+template <typename FnT>
+void JobSystem::ParallelFor(std::uint32_t count, FnT && fn, std::uint32_t min_grain /*= 1*/)
+{
+	if (count == 0)
+		return;
+
+	constexpr std::uint32_t RangesPerThread = 4;
+	std::uint32_t const thread_count = GetWorkerCount() + 1;
+	std::uint32_t const grain = std::max(std::max(min_grain, 1u), (count + thread_count * RangesPerThread - 1) / (thread_count * RangesPerThread));
+	if (grain >= count)
+	{
+		fn(0u, count);
+		return;
+	}
+
+	// The calling thread takes the first range itself
+	JobCounter counter;
+	for (std::uint32_t begin = grain; begin < count; begin += grain)
+	{
+		std::uint32_t const end = std::min(begin + grain, count);
+		Run([&fn, begin, end]() { fn(begin, end); }, &counter);
+	}
+	fn(0u, grain);
+
+	Wait(counter);
+}
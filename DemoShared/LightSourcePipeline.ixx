@@ -4,7 +4,6 @@ module;
 
 #include <expected>
 #include <filesystem>
-#include <iostream>
 
 #include <glm/mat4x4.hpp>
 
@@ -16,13 +15,20 @@ import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
 import PipelineBuilder;
-import RenderObject;
+import TypedPipeline;
 import Vertex;
 
 export class LightSourcePipeline
 {
 public:
 	using VertexT = NormalVertex;
+	constexpr static char const * Name = "LightSourcePipeline";
+	constexpr static RenderPass Pass = RenderPass::GEOMETRY;
+
+	struct FrameData
+	{
+		Camera const * camera = nullptr;
+	};
 
 	struct ObjectData
 	{
@@ -32,8 +38,10 @@ public:
 
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
 		GraphicsApi const & graphics_api,
-		std::filesystem::path const & shaders_path,
-		Camera const & camera);
+		std::filesystem::path const & shaders_path);
+
+	static void UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data);
+	static void UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data);
 
 	LightSourcePipeline() = default;
 	explicit LightSourcePipeline(AssetId asset_id) : m_asset_id(asset_id) {}
@@ -41,14 +49,6 @@ public:
 	AssetId GetAssetId() const { return m_asset_id; }
 
 private:
-	AssetId m_asset_id;
-};
-
-std::expected<GraphicsPipeline, GraphicsError> LightSourcePipeline::CreateGraphicsPipeline(
-	GraphicsApi const & graphics_api,
-	std::filesystem::path const & shaders_path,
-	Camera const & camera)
-{
 	struct ObjectDataVS
 	{
 		alignas(16) glm::mat4 model;
@@ -58,6 +58,13 @@ std::expected<GraphicsPipeline, GraphicsError> LightSourcePipeline::CreateGraphi
 		alignas(16) glm::vec3 color;
 	};
 
+	AssetId m_asset_id;
+};
+
+std::expected<GraphicsPipeline, GraphicsError> LightSourcePipeline::CreateGraphicsPipeline(
+	GraphicsApi const & graphics_api,
+	std::filesystem::path const & shaders_path)
+{
 	PipelineBuilder builder{ graphics_api };
 
 	std::expected<void, GraphicsError> load_shaders_result = builder.LoadShaders(
@@ -72,33 +79,22 @@ std::expected<GraphicsPipeline, GraphicsError> LightSourcePipeline::CreateGraphi
 	builder.SetFSUniformTypes<CameraPosUniform>();
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerFrameConstantsCallback(
-		[&camera](GraphicsPipeline const & pipeline)
-		{
-			pipeline.SetUniform(0 /*binding*/, camera.GetViewProjUniform());
-			pipeline.SetUniform(1 /*binding*/, camera.GetPosUniform());
-		});
-	builder.SetPerObjectConstantsCallback(
-		[](GraphicsPipeline const & pipeline, void const * object_data)
-		{
-			if (!object_data)
-			{
-				std::cout << "ObjectData is null for LightSourcePipeline" << std::endl;
-				return;
-			}
-
-			// For optimal performance, we assume that the object data is of the correct type.
-			// Use compile-time checks when creating render objects to ensure the data is compatible with the pipeline.
-			auto const * data = static_cast<ObjectData const *>(object_data);
-
-			pipeline.SetObjectData(
-				ObjectDataVS{
-					.model = data->model
-				},
-				ObjectDataFS{
-					.color = data->color,
-				});
-		});
-
 	return builder.CreatePipeline();
 }
+
+inline void LightSourcePipeline::UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data)
+{
+	pipeline.SetUniform(0 /*binding*/, frame_data.camera->GetViewProjUniform());
+	pipeline.SetUniform(1 /*binding*/, frame_data.camera->GetPosUniform());
+}
+
+inline void LightSourcePipeline::UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data)
+{
+	pipeline.SetObjectData(
+		ObjectDataVS{
+			.model = object_data.model
+		},
+		ObjectDataFS{
+			.color = object_data.color,
+		});
+}
@@ -0,0 +1,441 @@
+// LightsManager.cpp
+
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_BINNING_SSE2
+#include <emmintrin.h>
+#endif
+
+module LightsManager;
+
+import GraphicsError;
+import Trace;
+
+struct BinningParams
+{
+	// Rows of the view matrix
+	glm::vec4 view_row_x;
+	glm::vec4 view_row_y;
+	glm::vec4 view_row_z;
+	// Projection scales, the sign of y is dropped because the tiles are always numbered from the top of the screen
+	float proj_scale_x = 1.0f;
+	float proj_scale_y = 1.0f;
+	float near_plane = 0.1f;
+	float far_plane = 100.0f;
+	float slice_scale = 1.0f;
+	float slice_bias = 0.0f;
+};
+
+// Same mapping as the shaders: the slice grows with the log of the view depth
+std::int32_t get_depth_slice(float view_depth, BinningParams const & params)
+{
+	float slice = std::log(std::max(view_depth, params.near_plane)) * params.slice_scale - params.slice_bias;
+	slice = std::clamp(slice, 0.0f, static_cast<float>(LightsManager::m_cluster_count_z - 1));
+	return static_cast<std::int32_t>(slice);
+}
+
+// Maps an ndc coordinate to a tile, tiles are clamped before the conversion so far off screen values can't overflow
+std::int32_t get_tile(float ndc, float scale, float bias, std::uint32_t tile_count)
+{
+	float tile = std::clamp(ndc * scale + bias, 0.0f, static_cast<float>(tile_count - 1));
+	return static_cast<std::int32_t>(tile);
+}
+
+// Conservative cluster bounds of a bounding sphere: the sphere's view space box is projected with the depth that
+// makes each side of the box largest on screen
+ClusterBounds compute_light_bounds(float x, float y, float z, float radius, BinningParams const & params)
+{
+	glm::vec4 pos{ x, y, z, 1.0f };
+	float view_x = glm::dot(params.view_row_x, pos);
+	float view_y = glm::dot(params.view_row_y, pos);
+	float depth = -glm::dot(params.view_row_z, pos);
+
+	float depth_min = depth - radius;
+	float depth_max = depth + radius;
+	if (radius <= 0.0f || depth_max <= params.near_plane || depth_min >= params.far_plane)
+		return ClusterBounds{};
+	depth_min = std::max(depth_min, params.near_plane);
+
+	auto project_min = [&](float v, float scale) { return v * scale / (v < 0.0f ? depth_min : depth_max); };
+	auto project_max = [&](float v, float scale) { return v * scale / (v > 0.0f ? depth_min : depth_max); };
+
+	float ndc_x0 = project_min(view_x - radius, params.proj_scale_x);
+	float ndc_x1 = project_max(view_x + radius, params.proj_scale_x);
+	float ndc_y0 = project_min(view_y - radius, params.proj_scale_y);
+	float ndc_y1 = project_max(view_y + radius, params.proj_scale_y);
+	if (ndc_x0 > 1.0f || ndc_x1 < -1.0f || ndc_y0 > 1.0f || ndc_y1 < -1.0f)
+		return ClusterBounds{};
+
+	constexpr float half_x = LightsManager::m_cluster_count_x * 0.5f;
+	constexpr float half_y = LightsManager::m_cluster_count_y * 0.5f;
+
+	// Rows are numbered from the top of the screen, like gl_FragCoord in the shaders
+	return ClusterBounds{
+		.x0 = get_tile(ndc_x0, half_x, half_x, LightsManager::m_cluster_count_x),
+		.x1 = get_tile(ndc_x1, half_x, half_x, LightsManager::m_cluster_count_x),
+		.y0 = get_tile(ndc_y1, -half_y, half_y, LightsManager::m_cluster_count_y),
+		.y1 = get_tile(ndc_y0, -half_y, half_y, LightsManager::m_cluster_count_y),
+		.z0 = get_depth_slice(depth_min, params),
+		.z1 = get_depth_slice(depth_max, params)
+	};
+}
+
+#ifdef LIGHT_BINNING_SSE2
+// compute_light_bounds for 4 lights at once, only the depth slices are left to scalar code since SSE has no log
+void compute_light_bounds_x4(
+	float const * x,
+	float const * y,
+	float const * z,
+	float const * radius,
+	BinningParams const & params,
+	ClusterBounds * out_bounds)
+{
+	__m128 const zero = _mm_setzero_ps();
+	__m128 const one = _mm_set1_ps(1.0f);
+	__m128 const minus_one = _mm_set1_ps(-1.0f);
+	__m128 const near_plane = _mm_set1_ps(params.near_plane);
+	__m128 const far_plane = _mm_set1_ps(params.far_plane);
+
+	__m128 const pos_x = _mm_loadu_ps(x);
+	__m128 const pos_y = _mm_loadu_ps(y);
+	__m128 const pos_z = _mm_loadu_ps(z);
+	__m128 const r = _mm_loadu_ps(radius);
+
+	auto transform = [&](glm::vec4 const & row)
+		{
+			__m128 xy = _mm_add_ps(_mm_mul_ps(pos_x, _mm_set1_ps(row.x)), _mm_mul_ps(pos_y, _mm_set1_ps(row.y)));
+			__m128 zw = _mm_add_ps(_mm_mul_ps(pos_z, _mm_set1_ps(row.z)), _mm_set1_ps(row.w));
+			return _mm_add_ps(xy, zw);
+		};
+	auto select = [](__m128 mask, __m128 a, __m128 b)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		};
+
+	__m128 const view_x = transform(params.view_row_x);
+	__m128 const view_y = transform(params.view_row_y);
+	__m128 const depth = _mm_sub_ps(zero, transform(params.view_row_z));
+
+	__m128 depth_min = _mm_sub_ps(depth, r);
+	__m128 const depth_max = _mm_add_ps(depth, r);
+	__m128 visible = _mm_and_ps(_mm_cmpgt_ps(r, zero),
+		_mm_and_ps(_mm_cmpgt_ps(depth_max, near_plane), _mm_cmplt_ps(depth_min, far_plane)));
+	depth_min = _mm_max_ps(depth_min, near_plane);
+
+	auto project_min = [&](__m128 v, float scale)
+		{
+			return _mm_div_ps(_mm_mul_ps(v, _mm_set1_ps(scale)), select(_mm_cmplt_ps(v, zero), depth_min, depth_max));
+		};
+	auto project_max = [&](__m128 v, float scale)
+		{
+			return _mm_div_ps(_mm_mul_ps(v, _mm_set1_ps(scale)), select(_mm_cmpgt_ps(v, zero), depth_min, depth_max));
+		};
+
+	__m128 const ndc_x0 = project_min(_mm_sub_ps(view_x, r), params.proj_scale_x);
+	__m128 const ndc_x1 = project_max(_mm_add_ps(view_x, r), params.proj_scale_x);
+	__m128 const ndc_y0 = project_min(_mm_sub_ps(view_y, r), params.proj_scale_y);
+	__m128 const ndc_y1 = project_max(_mm_add_ps(view_y, r), params.proj_scale_y);
+	visible = _mm_and_ps(visible, _mm_and_ps(
+		_mm_and_ps(_mm_cmple_ps(ndc_x0, one), _mm_cmpge_ps(ndc_x1, minus_one)),
+		_mm_and_ps(_mm_cmple_ps(ndc_y0, one), _mm_cmpge_ps(ndc_y1, minus_one))));
+
+	int const visible_mask = _mm_movemask_ps(visible);
+	if (visible_mask == 0)
+	{
+		std::fill_n(out_bounds, 4, ClusterBounds{});
+		return;
+	}
+
+	auto get_tiles = [&](__m128 ndc, float scale, float bias, std::uint32_t tile_count)
+		{
+			__m128 tile = _mm_add_ps(_mm_mul_ps(ndc, _mm_set1_ps(scale)), _mm_set1_ps(bias));
+			tile = _mm_min_ps(_mm_max_ps(tile, zero), _mm_set1_ps(static_cast<float>(tile_count - 1)));
+			return _mm_cvttps_epi32(tile);
+		};
+
+	constexpr float half_x = LightsManager::m_cluster_count_x * 0.5f;
+	constexpr float half_y = LightsManager::m_cluster_count_y * 0.5f;
+
+	alignas(16) std::int32_t x0[4], x1[4], y0[4], y1[4];
+	alignas(16) float d0[4], d1[4];
+	_mm_store_si128(reinterpret_cast<__m128i *>(x0), get_tiles(ndc_x0, half_x, half_x, LightsManager::m_cluster_count_x));
+	_mm_store_si128(reinterpret_cast<__m128i *>(x1), get_tiles(ndc_x1, half_x, half_x, LightsManager::m_cluster_count_x));
+	_mm_store_si128(reinterpret_cast<__m128i *>(y0), get_tiles(ndc_y1, -half_y, half_y, LightsManager::m_cluster_count_y));
+	_mm_store_si128(reinterpret_cast<__m128i *>(y1), get_tiles(ndc_y0, -half_y, half_y, LightsManager::m_cluster_count_y));
+	_mm_store_ps(d0, depth_min);
+	_mm_store_ps(d1, depth_max);
+
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		if ((visible_mask & (1 << lane)) == 0)
+		{
+			out_bounds[lane] = ClusterBounds{};
+			continue;
+		}
+
+		out_bounds[lane] = ClusterBounds{
+			.x0 = x0[lane],
+			.x1 = x1[lane],
+			.y0 = y0[lane],
+			.y1 = y1[lane],
+			.z0 = get_depth_slice(d0[lane], params),
+			.z1 = get_depth_slice(d1[lane], params)
+		};
+	}
+}
+#endif
+
+LightsManager::LightsManager(GraphicsApi const & graphics_api)
+	: m_light_buffer{ graphics_api }
+	, m_cluster_buffer{ graphics_api }
+	, m_light_index_buffer{ graphics_api }
+{
+	m_clusters.resize(m_cluster_count);
+	m_cluster_fill.resize(m_cluster_count);
+	m_light_indices.resize(m_max_light_indices);
+
+	auto create_buffer = [](StorageBuffer & buffer, std::size_t size, char const * name)
+		{
+			std::expected<void, GraphicsError> result = buffer.Create(size);
+			if (!result.has_value())
+				std::cout << "Failed to create the " << name << " storage buffer: " << result.error().GetMessage() << std::endl;
+		};
+	create_buffer(m_light_buffer, m_max_lights * sizeof(LightData), "lights");
+	create_buffer(m_cluster_buffer, m_cluster_count * sizeof(ClusterData), "light clusters");
+	create_buffer(m_light_index_buffer, m_max_light_indices * sizeof(std::uint32_t), "light indices");
+}
+
+std::optional<std::uint32_t> LightsManager::add_light(LightData const & light)
+{
+	if (m_lights.size() >= m_max_lights)
+		return std::nullopt;
+
+	m_lights.push_back(light);
+	m_bounds_x.push_back(light.pos.x);
+	m_bounds_y.push_back(light.pos.y);
+	m_bounds_z.push_back(light.pos.z);
+	m_bounds_radius.push_back(light.range);
+	return static_cast<std::uint32_t>(m_lights.size() - 1);
+}
+
+std::optional<std::uint32_t> LightsManager::AddPointLight(PointLight const & light)
+{
+	std::optional<std::uint32_t> index = add_light(LightData{});
+	if (index.has_value())
+		SetPointLight(index.value(), light);
+	return index;
+}
+
+std::optional<std::uint32_t> LightsManager::AddSpotLight(SpotLight const & light)
+{
+	std::optional<std::uint32_t> index = add_light(LightData{});
+	if (index.has_value())
+		SetSpotLight(index.value(), light);
+	return index;
+}
+
+void LightsManager::SetPointLight(std::uint32_t index, PointLight const & light)
+{
+	if (index >= m_lights.size())
+		return;
+
+	m_lights[index] = LightData{
+		.pos = light.pos,
+		.range = light.radius,
+		.color = light.color
+	};
+	m_bounds_x[index] = light.pos.x;
+	m_bounds_y[index] = light.pos.y;
+	m_bounds_z[index] = light.pos.z;
+	m_bounds_radius[index] = light.radius;
+}
+
+void LightsManager::SetSpotLight(std::uint32_t index, SpotLight const & light)
+{
+	if (index >= m_lights.size())
+		return;
+
+	// The cone is binned with the bounding sphere of its whole range, which is loose but cheap
+	m_lights[index] = LightData{
+		.pos = light.pos,
+		.range = light.range,
+		.color = light.color,
+		.inner_radius = light.inner_radius,
+		.dir = glm::normalize(light.dir),
+		.outer_radius = light.outer_radius
+	};
+	m_bounds_x[index] = light.pos.x;
+	m_bounds_y[index] = light.pos.y;
+	m_bounds_z[index] = light.pos.z;
+	m_bounds_radius[index] = light.range;
+}
+
+void LightsManager::OnViewportResized(int width, int height)
+{
+	m_viewport_width = std::max(width, 1);
+	m_viewport_height = std::max(height, 1);
+}
+
+std::vector<StorageBuffer const *> LightsManager::GetStorageBuffers() const
+{
+	return { &m_light_buffer, &m_cluster_buffer, &m_light_index_buffer };
+}
+
+void LightsManager::Update(Camera const & camera, JobSystem & jobs)
+{
+	Trace::Zone zone{ "LightsManager::Update" };
+
+	auto begin = std::chrono::steady_clock::now();
+
+	compute_cluster_bounds(camera, jobs);
+	assign_lights_to_clusters();
+
+	m_stats.binning_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void LightsManager::compute_cluster_bounds(Camera const & camera, JobSystem & jobs)
+{
+	glm::mat4 const & view = camera.GetViewProjUniform().view;
+	glm::mat4 const & proj = camera.GetViewProjUniform().proj;
+	float const near_plane = camera.GetNearPlane();
+	float const far_plane = camera.GetFarPlane();
+
+	BinningParams params{
+		.view_row_x = glm::vec4{ view[0][0], view[1][0], view[2][0], view[3][0] },
+		.view_row_y = glm::vec4{ view[0][1], view[1][1], view[2][1], view[3][1] },
+		.view_row_z = glm::vec4{ view[0][2], view[1][2], view[2][2], view[3][2] },
+		.proj_scale_x = std::abs(proj[0][0]),
+		.proj_scale_y = std::abs(proj[1][1]),
+		.near_plane = near_plane,
+		.far_plane = far_plane,
+		.slice_scale = static_cast<float>(m_cluster_count_z) / std::log(far_plane / near_plane),
+	};
+	params.slice_bias = params.slice_scale * std::log(near_plane);
+
+	m_uniform.cluster_grid = glm::uvec4{ m_cluster_count_x, m_cluster_count_y, m_cluster_count_z,
+		static_cast<std::uint32_t>(m_lights.size()) };
+	m_uniform.view_depth_row = params.view_row_z;
+	m_uniform.cluster_params = glm::vec4{
+		1.0f / static_cast<float>(m_viewport_width),
+		1.0f / static_cast<float>(m_viewport_height),
+		params.slice_scale,
+		params.slice_bias
+	};
+
+	std::size_t const light_count = m_lights.size();
+	m_cluster_bounds.resize(light_count);
+
+	// Split into groups of 4 lights, so each range stays on the 4 wide path. The lights are independent, the ranges
+	// only write their own bounds.
+	constexpr std::uint32_t LightsPerGroup = 4;
+	constexpr std::uint32_t MinGroupsPerJob = 64;
+	std::uint32_t const group_count = static_cast<std::uint32_t>(light_count / LightsPerGroup);
+	jobs.ParallelFor(group_count, [&](std::uint32_t begin_group, std::uint32_t end_group)
+		{
+			std::size_t const end = end_group * LightsPerGroup;
+			std::size_t i = begin_group * LightsPerGroup;
+#ifdef LIGHT_BINNING_SSE2
+			for (; i < end; i += 4)
+			{
+				compute_light_bounds_x4(&m_bounds_x[i], &m_bounds_y[i], &m_bounds_z[i], &m_bounds_radius[i],
+					params, &m_cluster_bounds[i]);
+			}
+#endif
+			for (; i < end; ++i)
+				m_cluster_bounds[i] = compute_light_bounds(m_bounds_x[i], m_bounds_y[i], m_bounds_z[i], m_bounds_radius[i], params);
+		}, MinGroupsPerJob);
+
+	for (std::size_t i = group_count * LightsPerGroup; i < light_count; ++i)
+		m_cluster_bounds[i] = compute_light_bounds(m_bounds_x[i], m_bounds_y[i], m_bounds_z[i], m_bounds_radius[i], params);
+}
+
+void LightsManager::assign_lights_to_clusters()
+{
+	auto for_each_cluster = [](ClusterBounds const & bounds, auto && fn)
+		{
+			for (std::int32_t z = bounds.z0; z <= bounds.z1; ++z)
+				for (std::int32_t y = bounds.y0; y <= bounds.y1; ++y)
+					for (std::int32_t x = bounds.x0; x <= bounds.x1; ++x)
+						fn((z * m_cluster_count_y + y) * m_cluster_count_x + x);
+		};
+
+	std::ranges::fill(m_clusters, ClusterData{});
+	std::ranges::fill(m_cluster_fill, 0);
+
+	m_stats.light_count = static_cast<std::uint32_t>(m_lights.size());
+	m_stats.visible_light_count = 0;
+
+	// Count the lights of each cluster first, so the indices of a cluster can be written contiguously
+	for (ClusterBounds const & bounds : m_cluster_bounds)
+	{
+		if (bounds.x0 > bounds.x1)
+			continue;
+
+		++m_stats.visible_light_count;
+		for_each_cluster(bounds, [this](std::uint32_t cluster) { ++m_clusters[cluster].count; });
+	}
+
+	m_stats.occupied_cluster_count = 0;
+	m_stats.max_lights_per_cluster = 0;
+	m_stats.dropped_light_indices = 0;
+
+	std::uint32_t offset = 0;
+	for (ClusterData & cluster : m_clusters)
+	{
+		if (cluster.count > 0)
+			++m_stats.occupied_cluster_count;
+		m_stats.max_lights_per_cluster = std::max(m_stats.max_lights_per_cluster, cluster.count);
+
+		// Clusters past the end of the index buffer lose their lights, which at worst darkens them
+		std::uint32_t const count = std::min(cluster.count, m_max_light_indices - offset);
+		m_stats.dropped_light_indices += cluster.count - count;
+
+		cluster.offset = offset;
+		cluster.count = count;
+		offset += count;
+	}
+	m_light_index_count = offset;
+
+	m_stats.avg_lights_per_cluster = m_stats.occupied_cluster_count > 0
+		? static_cast<float>(offset + m_stats.dropped_light_indices) / static_cast<float>(m_stats.occupied_cluster_count)
+		: 0.0f;
+
+	for (std::uint32_t light = 0; light < m_cluster_bounds.size(); ++light)
+	{
+		ClusterBounds const & bounds = m_cluster_bounds[light];
+		if (bounds.x0 > bounds.x1)
+			continue;
+
+		for_each_cluster(bounds, [this, light](std::uint32_t cluster)
+			{
+				ClusterData const & cluster_data = m_clusters[cluster];
+				std::uint32_t & fill = m_cluster_fill[cluster];
+				if (fill < cluster_data.count)
+					m_light_indices[cluster_data.offset + fill++] = light;
+			});
+	}
+}
+
+void LightsManager::Upload()
+{
+	Trace::Zone zone{ "LightsManager::Upload" };
+
+	if (!m_lights.empty())
+		m_light_buffer.Update(m_lights.data(), m_lights.size() * sizeof(LightData));
+	m_cluster_buffer.Update(m_clusters.data(), m_clusters.size() * sizeof(ClusterData));
+	if (m_light_index_count > 0)
+		m_light_index_buffer.Update(m_light_indices.data(), m_light_index_count * sizeof(std::uint32_t));
+}
@@ -2,10 +2,20 @@
 
 module;
 
+#include <cstdint>
+#include <optional>
+#include <vector>
+
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 export module LightsManager;
 
+import Camera;
+import GraphicsApi;
+import JobSystem;
+import StorageBuffer;
+
 export struct AmbientLight
 {
 	alignas(16) glm::vec3 color{ 1.0, 1.0, 1.0 };
@@ -13,40 +23,140 @@ export struct AmbientLight
 
 export struct PointLight
 {
-	alignas(16) glm::vec3 pos{ 0.0, 0.0, 0.0 };
-	alignas(16) glm::vec3 color{ 1.0, 1.0, 1.0 };
-	alignas(4) float radius = 0.0f;
+	glm::vec3 pos{ 0.0, 0.0, 0.0 };
+	glm::vec3 color{ 1.0, 1.0, 1.0 };
+	float radius = 0.0f;
 };
 
 export struct SpotLight
 {
-	alignas(16) glm::vec3 pos{ 0.0, 0.0, 0.0 };
-	alignas(16) glm::vec3 dir{ 0.0, 0.0, -1.0 };
-	alignas(16) glm::vec3 color{ 1.0, 1.0, 1.0 };
-	alignas(4) float inner_radius = 0.0;
-	alignas(4) float outer_radius = 0.0;
+	glm::vec3 pos{ 0.0, 0.0, 0.0 };
+	glm::vec3 dir{ 0.0, 0.0, -1.0 };
+	glm::vec3 color{ 1.0, 1.0, 1.0 };
+	float inner_radius = 0.0;
+	float outer_radius = 0.0;
+	float range = 50.0f; // the light is culled past this distance
 };
 
+// Per frame lighting constants, the lights themselves are in the storage buffers of the LightsManager
 export struct LightsUniform
 {
 	alignas(16) AmbientLight ambient_light;
-	alignas(16) PointLight pointlight_1;
-	alignas(16) PointLight pointlight_2;
-	alignas(16) PointLight pointlight_3;
-	alignas(16) SpotLight spotlight;
+	alignas(16) glm::uvec4 cluster_grid{ 0 }; // cluster counts in xyz, the light count in w
+	alignas(16) glm::vec4 view_depth_row{ 0.0f }; // dot with a world position gives minus the view depth
+	alignas(16) glm::vec4 cluster_params{ 0.0f }; // 1 / viewport size in xy, depth slice scale and bias in zw
+	alignas(16) glm::vec4 fog{ 0.0f }; // color in rgb, density in w, only used by shader variants with fog
+};
+
+export struct LightClusterStats
+{
+	float binning_ms = 0.0f;
+	std::uint32_t light_count = 0;
+	std::uint32_t visible_light_count = 0; // lights overlapping at least one cluster
+	std::uint32_t occupied_cluster_count = 0;
+	float avg_lights_per_cluster = 0.0f; // over the occupied clusters
+	std::uint32_t max_lights_per_cluster = 0;
+	std::uint32_t dropped_light_indices = 0; // cluster entries that didn't fit in m_max_light_indices
 };
 
+// Inclusive cluster ranges a light overlaps, empty when x0 > x1
+struct ClusterBounds
+{
+	std::int32_t x0 = 0, x1 = -1;
+	std::int32_t y0 = 0, y1 = -1;
+	std::int32_t z0 = 0, z1 = -1;
+};
+
+// Holds any number of point and spot lights (up to m_max_lights) and bins them every frame into a grid of clusters
+// covering the camera frustum: m_cluster_count_x * m_cluster_count_y screen tiles, each split into depth slices that
+// grow exponentially with the view depth. The fragment shaders find their cluster from the fragment position and
+// only shade with the lights in it, so the cost of a fragment depends on the lights near it, not on the light count.
+// Binning runs on the cpu, 4 lights at a time with SSE2 when it's available.
 export class LightsManager
 {
 public:
-	void SetAmbientLight(AmbientLight const & light) { m_lights.ambient_light = light; }
-	void SetPointLight1(PointLight const & light) { m_lights.pointlight_1 = light; }
-	void SetPointLight2(PointLight const & light) { m_lights.pointlight_2 = light; }
-	void SetPointLight3(PointLight const & light) { m_lights.pointlight_3 = light; }
-	void SetSpotLight(SpotLight const & light) { m_lights.spotlight = light; }
+	// Have to match the storage buffer declarations in the shaders
+	constexpr static std::uint32_t m_max_lights = 4096;
+	constexpr static std::uint32_t m_cluster_count_x = 16;
+	constexpr static std::uint32_t m_cluster_count_y = 9;
+	constexpr static std::uint32_t m_cluster_count_z = 24;
+	constexpr static std::uint32_t m_cluster_count = m_cluster_count_x * m_cluster_count_y * m_cluster_count_z;
+	constexpr static std::uint32_t m_max_light_indices = 1 << 18;
+
+public:
+	explicit LightsManager(GraphicsApi const & graphics_api);
+
+	LightsManager(LightsManager const &) = delete;
+	LightsManager & operator=(LightsManager const &) = delete;
+
+	void SetAmbientLight(AmbientLight const & light) { m_uniform.ambient_light = light; }
+	void SetFog(glm::vec3 const & color, float density) { m_uniform.fog = glm::vec4{ color, density }; }
 
-	LightsUniform const & GetLightsUniform() const { return m_lights; }
+	// Return the index to update the light with, or a null optional when there are m_max_lights already
+	std::optional<std::uint32_t> AddPointLight(PointLight const & light);
+	std::optional<std::uint32_t> AddSpotLight(SpotLight const & light);
+	void SetPointLight(std::uint32_t index, PointLight const & light);
+	void SetSpotLight(std::uint32_t index, SpotLight const & light);
+
+	void OnViewportResized(int width, int height);
+
+	// Bins the lights into the clusters of the camera's frustum, call it once the camera is up to date for the frame.
+	// The clusters each light covers are found in parallel on the job system.
+	void Update(Camera const & camera, JobSystem & jobs);
+	// Copies the lights and the clusters to the storage buffers, has to be called while the frame is being recorded
+	void Upload();
+
+	LightsUniform const & GetLightsUniform() const { return m_uniform; }
+	// In the order the shaders declare them: lights, clusters, light indices
+	std::vector<StorageBuffer const *> GetStorageBuffers() const;
+
+	LightClusterStats const & GetClusterStats() const { return m_stats; }
 
 private:
-	LightsUniform m_lights;
+	// std430 layout of a light in the lights storage buffer, a zero direction marks a point light
+	struct LightData
+	{
+		alignas(16) glm::vec3 pos{ 0.0f };
+		float range = 0.0f;
+		alignas(16) glm::vec3 color{ 0.0f };
+		float inner_radius = 0.0f;
+		alignas(16) glm::vec3 dir{ 0.0f };
+		float outer_radius = 0.0f;
+	};
+
+	// Offset into the light indices and light count of a cluster
+	struct ClusterData
+	{
+		std::uint32_t offset = 0;
+		std::uint32_t count = 0;
+	};
+
+	std::optional<std::uint32_t> add_light(LightData const & light);
+	void compute_cluster_bounds(Camera const & camera, JobSystem & jobs);
+	void assign_lights_to_clusters();
+
+private:
+	LightsUniform m_uniform;
+
+	std::vector<LightData> m_lights;
+	// Bounding spheres of the lights in SoA layout for the binning
+	std::vector<float> m_bounds_x;
+	std::vector<float> m_bounds_y;
+	std::vector<float> m_bounds_z;
+	std::vector<float> m_bounds_radius;
+
+	std::vector<ClusterBounds> m_cluster_bounds;
+	std::vector<ClusterData> m_clusters;
+	std::vector<std::uint32_t> m_cluster_fill; // write cursor of each cluster while binning
+	std::vector<std::uint32_t> m_light_indices;
+	std::uint32_t m_light_index_count = 0;
+
+	StorageBuffer m_light_buffer;
+	StorageBuffer m_cluster_buffer;
+	StorageBuffer m_light_index_buffer;
+
+	int m_viewport_width = 1;
+	int m_viewport_height = 1;
+
+	LightClusterStats m_stats;
 };
@@ -2,8 +2,10 @@
 
 module;
 
+#include <cstdint>
 #include <expected>
 #include <filesystem>
+#include <utility>
 #include <vector>
 
 export module MeshManager;
@@ -12,9 +14,21 @@ import AssetPool;
 import GraphicsApi;
 import GraphicsError;
 import Mesh;
+import MeshletBuilder;
+import MeshSimplifier;
 import ObjLoader;
 import Vertex;
 
+// Everything a mesh is created from, built without touching the graphics api so it can be loaded on any thread
+export template<IsVertex VertexT>
+struct MeshData
+{
+	std::vector<VertexT> vertices;
+	std::vector<Mesh::IndexT> indices;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+};
+
 export template<IsVertex T>
 class MeshId : public AssetId
 {
@@ -35,22 +49,61 @@ public:
 	template<IsVertex VertexT>
 	std::expected<MeshId<VertexT>, GraphicsError> CreateMesh(
 		std::vector<VertexT> const & vertices,
-		std::vector<Mesh::IndexT> const & indices);
+		std::vector<Mesh::IndexT> const & indices,
+		std::vector<MeshLod> lods = {},
+		std::vector<Meshlet> meshlets = {});
 
+	template<IsVertex VertexT>
+	std::expected<MeshId<VertexT>, GraphicsError> CreateMesh(MeshData<VertexT> data);
+
+	// With generate_lods the mesh gets a chain of simplified lods, see MeshSimplifier.
+	// With build_meshlets every lod is split into meshlets for culling, see MeshletBuilder.
 	template<IsVertex VertexT>
 	std::expected<MeshId<VertexT>, GraphicsError> CreateMesh(
-		std::filesystem::path const & file_path);
+		std::filesystem::path const & file_path,
+		bool generate_lods = false,
+		bool build_meshlets = false);
+
+	// The file loading part of CreateMesh, safe to call from any thread
+	template<IsVertex VertexT>
+	static std::expected<MeshData<VertexT>, GraphicsError> LoadMeshData(
+		std::filesystem::path const & file_path,
+		bool generate_lods = false,
+		bool build_meshlets = false);
 
 	void Remove(AssetId id) { m_mesh_pool.Remove(id); }
 
 	Mesh const * Get(AssetId id) const { return m_mesh_pool.Get(id); }
 	Mesh * Get(AssetId id) { return m_mesh_pool.Get(id); }
 
+	// Size of the vertices and indices the mesh was created with, 0 for meshes added with AddMesh
+	std::uint64_t GetMeshSize(AssetId id) const;
+
+private:
+	void set_mesh_size(AssetId id, std::uint64_t size);
+
 private:
 	GraphicsApi const & m_graphics_api;
 	AssetPool<Mesh> m_mesh_pool;
+	std::vector<std::uint64_t> m_mesh_sizes; // by pool index
 };
 
+std::uint64_t MeshManager::GetMeshSize(AssetId id) const
+{
+	if (!m_mesh_pool.Get(id) || id.GetIndex() >= m_mesh_sizes.size())
+		return 0;
+
+	return m_mesh_sizes[id.GetIndex()];
+}
+
+void MeshManager::set_mesh_size(AssetId id, std::uint64_t size)
+{
+	if (id.GetIndex() >= m_mesh_sizes.size())
+		m_mesh_sizes.resize(id.GetIndex() + 1, 0);
+
+	m_mesh_sizes[id.GetIndex()] = size;
+}
+
 template<IsVertex VertexT>
 std::expected<MeshId<VertexT>, GraphicsError> MeshManager::AddMesh(Mesh mesh)
 {
@@ -58,16 +111,19 @@ std::expected<MeshId<VertexT>, GraphicsError> MeshManager::AddMesh(Mesh mesh)
 	if (!mesh_id.IsValid())
 		return std::unexpected{ GraphicsError{ "MeshManager::AddMesh: Failed to add mesh to pool." } };
 
+	set_mesh_size(mesh_id, 0);
 	return mesh_id;
 }
 
 template<IsVertex VertexT>
 std::expected<MeshId<VertexT>, GraphicsError> MeshManager::CreateMesh(
 	std::vector<VertexT> const & vertices,
-	std::vector<Mesh::IndexT> const & indices)
+	std::vector<Mesh::IndexT> const & indices,
+	std::vector<MeshLod> lods /*= {}*/,
+	std::vector<Meshlet> meshlets /*= {}*/)
 {
 	Mesh mesh{ m_graphics_api };
-	std::expected<void, GraphicsError> result = mesh.Create(vertices, indices);
+	std::expected<void, GraphicsError> result = mesh.Create(vertices, indices, std::move(lods), std::move(meshlets));
 	if (!result.has_value())
 		return std::unexpected{ result.error().AddToMessage(" MeshManager::CreateMesh: Failed to create mesh.") };
 
@@ -75,20 +131,51 @@ std::expected<MeshId<VertexT>, GraphicsError> MeshManager::CreateMesh(
 	if (!mesh_id.IsValid())
 		return std::unexpected{ GraphicsError{ "MeshManager::CreateMesh: Failed to add mesh to pool." } };
 
+	set_mesh_size(mesh_id, vertices.size() * sizeof(VertexT) + indices.size() * sizeof(Mesh::IndexT));
 	return mesh_id;
 }
 
+template<IsVertex VertexT>
+std::expected<MeshId<VertexT>, GraphicsError> MeshManager::CreateMesh(MeshData<VertexT> data)
+{
+	return CreateMesh(data.vertices, data.indices, std::move(data.lods), std::move(data.meshlets));
+}
+
 template<IsVertex VertexT>
 std::expected<MeshId<VertexT>, GraphicsError> MeshManager::CreateMesh(
-	std::filesystem::path const & file_path)
+	std::filesystem::path const & file_path,
+	bool generate_lods /*= false*/,
+	bool build_meshlets /*= false*/)
+{
+	std::expected<MeshData<VertexT>, GraphicsError> data = LoadMeshData<VertexT>(file_path, generate_lods, build_meshlets);
+	if (!data.has_value())
+		return std::unexpected{ data.error().AddToMessage(" MeshManager::CreateMesh: Failed to load mesh.") };
+
+	return CreateMesh(std::move(*data));
+}
+
+template<IsVertex VertexT>
+std::expected<MeshData<VertexT>, GraphicsError> MeshManager::LoadMeshData(
+	std::filesystem::path const & file_path,
+	bool generate_lods /*= false*/,
+	bool build_meshlets /*= false*/)
 {
 	if (!std::filesystem::exists(file_path))
-		return std::unexpected{ GraphicsError{ "MeshManager::CreateMesh: File does not exist: " + file_path.string() } };
+		return std::unexpected{ GraphicsError{ "MeshManager::LoadMeshData: File does not exist: " + file_path.string() } };
 
-	std::vector<VertexT> verts;
-	std::vector<Mesh::IndexT> indices;
-	if (!ObjLoader::LoadObjFile(file_path, verts, indices))
-		return std::unexpected{ GraphicsError{ "MeshManager::CreateMesh: Error loading file: " + file_path.string() } };
+	MeshData<VertexT> data;
+	if (!ObjLoader::LoadObjFile(file_path, data.vertices, data.indices))
+		return std::unexpected{ GraphicsError{ "MeshManager::LoadMeshData: Error loading file: " + file_path.string() } };
+
+	if (generate_lods)
+	{
+		MeshLodChain lod_chain = MeshSimplifier::BuildLodChain(data.vertices, data.indices);
+		data.indices = std::move(lod_chain.indices);
+		data.lods = std::move(lod_chain.lods);
+	}
+
+	if (build_meshlets)
+		data.meshlets = MeshletBuilder::Build(data.vertices, data.indices, data.lods);
 
-	return CreateMesh(verts, indices);
+	return data;
 }
@@ -0,0 +1,315 @@
+// MeshSimplifier.cpp
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+module MeshSimplifier;
+
+namespace
+{
+	constexpr std::uint32_t NoVertex = std::numeric_limits<std::uint32_t>::max();
+	constexpr std::uint32_t SeamVertex = NoVertex - 1;
+
+	// Sum of squared distances to a set of planes as a symmetric 4x4 matrix, only the upper triangle is stored
+	struct Quadric
+	{
+		std::array<double, 10> m{};
+
+		void AddPlane(glm::dvec3 const & n, double d)
+		{
+			m[0] += n.x * n.x; m[1] += n.x * n.y; m[2] += n.x * n.z; m[3] += n.x * d;
+			m[4] += n.y * n.y; m[5] += n.y * n.z; m[6] += n.y * d;
+			m[7] += n.z * n.z; m[8] += n.z * d;
+			m[9] += d * d;
+		}
+
+		double Evaluate(glm::dvec3 const & p) const
+		{
+			return m[0] * p.x * p.x + 2.0 * m[1] * p.x * p.y + 2.0 * m[2] * p.x * p.z + 2.0 * m[3] * p.x
+				+ m[4] * p.y * p.y + 2.0 * m[5] * p.y * p.z + 2.0 * m[6] * p.y
+				+ m[7] * p.z * p.z + 2.0 * m[8] * p.z
+				+ m[9];
+		}
+
+		Quadric & operator+=(Quadric const & other)
+		{
+			for (std::size_t i = 0; i < m.size(); ++i)
+				m[i] += other.m[i];
+			return *this;
+		}
+	};
+
+	struct Collapse
+	{
+		std::uint32_t from = 0; // position groups
+		std::uint32_t to = 0;
+		double cost = 0.0;
+	};
+
+	// Vertices at exactly the same position share a group, the simplifier works on groups so that split vertices
+	// (e.g. with different normals) don't look like open borders
+	std::uint32_t weld_positions(std::span<glm::vec3 const> positions, std::vector<std::uint32_t> & out_groups)
+	{
+		std::vector<std::uint32_t> order(positions.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::ranges::sort(order, [&](std::uint32_t a, std::uint32_t b)
+			{
+				return std::tie(positions[a].x, positions[a].y, positions[a].z) < std::tie(positions[b].x, positions[b].y, positions[b].z);
+			});
+
+		out_groups.assign(positions.size(), 0);
+		std::uint32_t group_count = 0;
+		for (std::size_t i = 0; i < order.size(); ++i)
+		{
+			if (i > 0 && positions[order[i]] != positions[order[i - 1]])
+				++group_count;
+			out_groups[order[i]] = group_count;
+		}
+		return positions.empty() ? 0 : group_count + 1;
+	}
+
+	glm::dvec3 triangle_normal(glm::dvec3 const & p0, glm::dvec3 const & p1, glm::dvec3 const & p2)
+	{
+		return glm::cross(p1 - p0, p2 - p0);
+	}
+}
+
+std::vector<Mesh::IndexT> MeshSimplifier::Simplify(
+	std::span<glm::vec3 const> positions,
+	std::span<Mesh::IndexT const> indices,
+	std::size_t target_index_count,
+	float max_error,
+	float & out_error)
+{
+	out_error = 0.0f;
+
+	std::vector<Mesh::IndexT> result(indices.begin(), indices.end());
+	if (result.size() <= target_index_count || positions.empty())
+		return result;
+
+	std::vector<std::uint32_t> groups;
+	std::uint32_t const group_count = weld_positions(positions, groups);
+
+	auto group_pos = [&](std::uint32_t vertex) { return glm::dvec3{ positions[vertex] }; };
+
+	// The vertex of each group, groups with more than one used vertex are attribute seams
+	std::vector<std::uint32_t> group_vertex(group_count, NoVertex);
+	for (Mesh::IndexT index : result)
+	{
+		std::uint32_t & vertex = group_vertex[groups[index]];
+		if (vertex == NoVertex)
+			vertex = index;
+		else if (vertex != index)
+			vertex = SeamVertex;
+	}
+
+	std::vector<Quadric> quadrics(group_count);
+	for (std::size_t i = 0; i < result.size(); i += 3)
+	{
+		glm::dvec3 p0 = group_pos(result[i]);
+		glm::dvec3 normal = triangle_normal(p0, group_pos(result[i + 1]), group_pos(result[i + 2]));
+		double length = glm::length(normal);
+		if (length == 0.0)
+			continue;
+
+		normal /= length;
+		double d = -glm::dot(normal, p0);
+		for (std::size_t k = 0; k < 3; ++k)
+			quadrics[groups[result[i + k]]].AddPlane(normal, d);
+	}
+
+	// Seams and open borders (edges with a single triangle) stay where they are
+	std::vector<std::uint8_t> locked(group_count, 0);
+	for (std::uint32_t group = 0; group < group_count; ++group)
+		locked[group] = group_vertex[group] == SeamVertex ? 1 : 0;
+	{
+		std::vector<std::uint64_t> edges;
+		edges.reserve(result.size());
+		for (std::size_t i = 0; i < result.size(); i += 3)
+		{
+			for (std::size_t k = 0; k < 3; ++k)
+			{
+				std::uint64_t a = groups[result[i + k]];
+				std::uint64_t b = groups[result[i + (k + 1) % 3]];
+				edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+			}
+		}
+		std::ranges::sort(edges);
+
+		for (std::size_t i = 0; i < edges.size();)
+		{
+			std::size_t run_end = i + 1;
+			while (run_end < edges.size() && edges[run_end] == edges[i])
+				++run_end;
+			if (run_end - i == 1)
+			{
+				locked[static_cast<std::uint32_t>(edges[i] >> 32)] = 1;
+				locked[static_cast<std::uint32_t>(edges[i])] = 1;
+			}
+			i = run_end;
+		}
+	}
+
+	double const max_cost = static_cast<double>(max_error) * max_error;
+	double accepted_cost = 0.0;
+
+	std::vector<std::uint32_t> adjacency_offsets(group_count + 1);
+	std::vector<std::uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<std::uint8_t> touched(group_count);
+	std::vector<std::uint8_t> removed;
+
+	// Each pass collapses the cheapest edges whose neighborhoods don't overlap, then the topology is rebuilt
+	std::size_t index_count = result.size();
+	while (index_count > target_index_count)
+	{
+		std::size_t const triangle_count = result.size() / 3;
+
+		std::ranges::fill(adjacency_offsets, 0u);
+		for (Mesh::IndexT index : result)
+			++adjacency_offsets[groups[index] + 1];
+		std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+		adjacency.resize(result.size());
+		{
+			std::vector<std::uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for (std::size_t i = 0; i < result.size(); ++i)
+				adjacency[fill[groups[result[i]]]++] = static_cast<std::uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (std::size_t i = 0; i < result.size(); i += 3)
+		{
+			for (std::size_t k = 0; k < 3; ++k)
+			{
+				std::uint32_t a = groups[result[i + k]];
+				std::uint32_t b = groups[result[i + (k + 1) % 3]];
+				Quadric quadric = quadrics[a];
+				quadric += quadrics[b];
+				if (!locked[a])
+					collapses.push_back(Collapse{ a, b, quadric.Evaluate(group_pos(result[i + (k + 1) % 3])) });
+				if (!locked[b])
+					collapses.push_back(Collapse{ b, a, quadric.Evaluate(group_pos(result[i + k])) });
+			}
+		}
+		std::ranges::sort(collapses, {}, &Collapse::cost);
+
+		std::ranges::fill(touched, std::uint8_t{ 0 });
+		removed.assign(triangle_count, 0);
+
+		std::size_t collapsed_count = 0;
+		for (Collapse const & collapse : collapses)
+		{
+			if (collapse.cost > max_cost || index_count <= target_index_count)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			auto const triangles_begin = adjacency.begin() + adjacency_offsets[collapse.from];
+			auto const triangles_end = adjacency.begin() + adjacency_offsets[collapse.from + 1];
+
+			// The vertex that replaces the collapsed one has to be the same in all the triangles on the edge,
+			// otherwise the edge runs along a seam of the other vertex
+			std::uint32_t to_vertex = NoVertex;
+			bool valid = true;
+			for (auto it = triangles_begin; it != triangles_end && valid; ++it)
+			{
+				for (std::size_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t vertex = result[*it * 3 + k];
+					if (groups[vertex] != collapse.to)
+						continue;
+					if (to_vertex == NoVertex)
+						to_vertex = vertex;
+					else if (to_vertex != vertex)
+						valid = false;
+				}
+			}
+			if (!valid || to_vertex == NoVertex)
+				continue;
+
+			// Reject collapses that would flip a triangle that survives them
+			glm::dvec3 const to_pos = group_pos(to_vertex);
+			for (auto it = triangles_begin; it != triangles_end && valid; ++it)
+			{
+				std::array<glm::dvec3, 3> corners;
+				bool has_to = false;
+				for (std::size_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t vertex = result[*it * 3 + k];
+					corners[k] = group_pos(vertex);
+					has_to = has_to || groups[vertex] == collapse.to;
+				}
+				if (has_to)
+					continue;
+
+				glm::dvec3 normal_before = triangle_normal(corners[0], corners[1], corners[2]);
+				for (std::size_t k = 0; k < 3; ++k)
+				{
+					if (groups[result[*it * 3 + k]] == collapse.from)
+						corners[k] = to_pos;
+				}
+				glm::dvec3 normal_after = triangle_normal(corners[0], corners[1], corners[2]);
+				valid = glm::dot(normal_before, normal_after) > 0.0;
+			}
+			if (!valid)
+				continue;
+
+			for (auto it = triangles_begin; it != triangles_end; ++it)
+			{
+				bool has_to = false;
+				for (std::size_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t group = groups[result[*it * 3 + k]];
+					has_to = has_to || group == collapse.to;
+					touched[group] = 1;
+				}
+
+				if (has_to)
+				{
+					removed[*it] = 1;
+					index_count -= 3;
+					continue;
+				}
+
+				for (std::size_t k = 0; k < 3; ++k)
+				{
+					if (groups[result[*it * 3 + k]] == collapse.from)
+						result[*it * 3 + k] = static_cast<Mesh::IndexT>(to_vertex);
+				}
+			}
+
+			quadrics[collapse.to] += quadrics[collapse.from];
+			accepted_cost = std::max(accepted_cost, collapse.cost);
+			++collapsed_count;
+		}
+
+		if (collapsed_count == 0)
+			break;
+
+		std::size_t write = 0;
+		for (std::size_t triangle = 0; triangle < triangle_count; ++triangle)
+		{
+			if (removed[triangle])
+				continue;
+			for (std::size_t k = 0; k < 3; ++k)
+				result[write++] = result[triangle * 3 + k];
+		}
+		result.resize(write);
+		index_count = result.size();
+	}
+
+	out_error = static_cast<float>(std::sqrt(accepted_cost));
+	return result;
+}
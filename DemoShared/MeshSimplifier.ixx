@@ -0,0 +1,106 @@
+// MeshSimplifier.ixx
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+export module MeshSimplifier;
+
+import Mesh;
+import Trace;
+
+export struct MeshLodSettings
+{
+	std::uint32_t max_lod_count = 4; // including the full mesh
+	float reduction = 0.5f; // target index count of a lod relative to the previous one
+	float max_error = 0.1f; // relative to the mesh's bounding radius, no lods are built past it
+};
+
+// The indices of every lod one after the other, the full mesh first, ready for Mesh::Create
+export struct MeshLodChain
+{
+	std::vector<Mesh::IndexT> indices;
+	std::vector<MeshLod> lods;
+};
+
+// Quadric error metric simplification (Garland and Heckbert) by half edge collapses: a vertex is merged into one of
+// its neighbors, so the simplified indices still refer to the original vertex buffer and all the lods of a mesh
+// can share it. Vertices on open borders and attribute seams (several vertices at the same position) are never
+// moved, which keeps the silhouette and the uv/normal seams of the mesh intact.
+export namespace MeshSimplifier
+{
+	// Collapses edges, cheapest first, until there are at most target_index_count indices left or the next collapse
+	// would move the surface by more than max_error. out_error is set to the largest error that was accepted.
+	std::vector<Mesh::IndexT> Simplify(
+		std::span<glm::vec3 const> positions,
+		std::span<Mesh::IndexT const> indices,
+		std::size_t target_index_count,
+		float max_error,
+		float & out_error);
+
+	template <typename VertexT>
+	MeshLodChain BuildLodChain(
+		std::vector<VertexT> const & vertices,
+		std::vector<Mesh::IndexT> const & indices,
+		MeshLodSettings const & settings = {});
+}
+
+template <typename VertexT>
+MeshLodChain MeshSimplifier::BuildLodChain(
+	std::vector<VertexT> const & vertices,
+	std::vector<Mesh::IndexT> const & indices,
+	MeshLodSettings const & settings /*= {}*/)
+{
+	Trace::Zone zone{ "MeshSimplifier::BuildLodChain" };
+
+	MeshLodChain chain;
+	chain.indices = indices;
+	chain.lods.push_back(MeshLod{ .first_index = 0, .index_count = static_cast<std::uint32_t>(indices.size()) });
+	if (vertices.empty() || indices.empty())
+		return chain;
+
+	std::vector<glm::vec3> positions;
+	positions.reserve(vertices.size());
+	for (VertexT const & vertex : vertices)
+		positions.push_back(vertex.pos);
+
+	glm::vec3 min_pos = positions.front();
+	glm::vec3 max_pos = positions.front();
+	for (glm::vec3 const & pos : positions)
+	{
+		min_pos = glm::min(min_pos, pos);
+		max_pos = glm::max(max_pos, pos);
+	}
+	float max_error = glm::length(max_pos - min_pos) * 0.5f * settings.max_error;
+
+	// Every lod is simplified from the full mesh so its error is measured against it, not against the previous lod
+	std::size_t prev_index_count = indices.size();
+	while (chain.lods.size() < settings.max_lod_count)
+	{
+		std::size_t target_index_count = static_cast<std::size_t>(static_cast<float>(prev_index_count) * settings.reduction) / 3 * 3;
+
+		float error = 0.0f;
+		std::vector<Mesh::IndexT> lod_indices = Simplify(positions, indices, target_index_count, max_error, error);
+
+		// Stop once the error bound keeps the simplifier from making meaningful progress
+		if (lod_indices.empty() || lod_indices.size() > prev_index_count * 9 / 10)
+			break;
+
+		chain.lods.push_back(MeshLod{
+			.first_index = static_cast<std::uint32_t>(chain.indices.size()),
+			.index_count = static_cast<std::uint32_t>(lod_indices.size()),
+			.error = error
+			});
+		chain.indices.insert(chain.indices.end(), lod_indices.begin(), lod_indices.end());
+		prev_index_count = lod_indices.size();
+	}
+
+	return chain;
+}
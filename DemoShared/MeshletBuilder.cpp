@@ -0,0 +1,198 @@
+// MeshletBuilder.cpp
+
+module;
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+module MeshletBuilder;
+
+namespace
+{
+	constexpr std::uint32_t NoMeshlet = std::numeric_limits<std::uint32_t>::max();
+
+	// Bounding sphere of the meshlet's vertices and the cone around its triangle normals
+	Meshlet compute_meshlet_bounds(
+		std::span<glm::vec3 const> positions,
+		std::span<Mesh::IndexT const> indices,
+		std::uint32_t first_index)
+	{
+		Meshlet meshlet{
+			.first_index = first_index,
+			.index_count = static_cast<std::uint32_t>(indices.size())
+		};
+
+		glm::vec3 min_pos = positions[indices.front()];
+		glm::vec3 max_pos = min_pos;
+		for (Mesh::IndexT index : indices)
+		{
+			min_pos = glm::min(min_pos, positions[index]);
+			max_pos = glm::max(max_pos, positions[index]);
+		}
+		meshlet.center = (min_pos + max_pos) * 0.5f;
+		for (Mesh::IndexT index : indices)
+			meshlet.radius = std::max(meshlet.radius, glm::length(positions[index] - meshlet.center));
+
+		std::vector<glm::vec3> normals;
+		normals.reserve(indices.size() / 3);
+		for (std::size_t i = 0; i < indices.size(); i += 3)
+		{
+			glm::vec3 const & p0 = positions[indices[i]];
+			glm::vec3 normal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+				normals.push_back(normal / length);
+		}
+
+		glm::vec3 axis{ 0.0f };
+		for (glm::vec3 const & normal : normals)
+			axis += normal;
+		float axis_length = glm::length(axis);
+		if (normals.empty() || axis_length == 0.0f)
+			return meshlet;
+		meshlet.cone_axis = axis / axis_length;
+
+		float min_dot = 1.0f;
+		for (glm::vec3 const & normal : normals)
+			min_dot = std::min(min_dot, glm::dot(meshlet.cone_axis, normal));
+
+		// The cone of view directions from which every triangle is back facing is the normal cone widened by 90 degrees
+		// and inverted, its cutoff is cos(angle + 90) negated, i.e. the sine of the normal cone's angle.
+		// If the normal cone is wider than 90 degrees there's always a triangle facing the camera.
+		meshlet.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+		return meshlet;
+	}
+
+	void build_lod_meshlets(
+		std::span<glm::vec3 const> positions,
+		std::span<Mesh::IndexT> lod_indices,
+		std::uint32_t first_index,
+		std::vector<Meshlet> & out_meshlets)
+	{
+		std::size_t const triangle_count = lod_indices.size() / 3;
+
+		// Triangles around each vertex
+		std::vector<std::uint32_t> adjacency_offsets(positions.size() + 1, 0);
+		for (Mesh::IndexT index : lod_indices)
+			++adjacency_offsets[index + 1];
+		std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+		std::vector<std::uint32_t> adjacency(lod_indices.size());
+		{
+			std::vector<std::uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for (std::size_t i = 0; i < lod_indices.size(); ++i)
+				adjacency[fill[lod_indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+		}
+
+		std::vector<Mesh::IndexT> ordered;
+		ordered.reserve(lod_indices.size());
+		std::vector<std::uint8_t> used(triangle_count, 0);
+		std::vector<std::uint32_t> vertex_meshlet(positions.size(), NoMeshlet); // last meshlet that has the vertex
+		std::vector<std::uint32_t> candidates;
+
+		std::size_t seed = 0;
+		while (ordered.size() < lod_indices.size())
+		{
+			std::uint32_t const meshlet_id = static_cast<std::uint32_t>(out_meshlets.size());
+			std::size_t const meshlet_begin = ordered.size();
+			std::uint32_t vertex_count = 0;
+			std::uint32_t meshlet_triangle_count = 0;
+			candidates.clear();
+
+			auto new_vertex_count = [&](std::uint32_t triangle)
+				{
+					std::uint32_t count = 0;
+					for (std::size_t k = 0; k < 3; ++k)
+						count += vertex_meshlet[lod_indices[triangle * 3 + k]] != meshlet_id ? 1 : 0;
+					return count;
+				};
+
+			// Meshlets start at the first unused triangle, which keeps them close to the original order
+			while (used[seed])
+				++seed;
+			std::uint32_t triangle = static_cast<std::uint32_t>(seed);
+
+			while (true)
+			{
+				used[triangle] = 1;
+				++meshlet_triangle_count;
+				for (std::size_t k = 0; k < 3; ++k)
+				{
+					Mesh::IndexT index = lod_indices[triangle * 3 + k];
+					ordered.push_back(index);
+					if (vertex_meshlet[index] == meshlet_id)
+						continue;
+
+					vertex_meshlet[index] = meshlet_id;
+					++vertex_count;
+					for (std::uint32_t i = adjacency_offsets[index]; i < adjacency_offsets[index + 1]; ++i)
+					{
+						if (!used[adjacency[i]])
+							candidates.push_back(adjacency[i]);
+					}
+				}
+
+				if (meshlet_triangle_count == MeshletBuilder::MaxTriangles)
+					break;
+
+				// Grow over the neighbor that adds the fewest vertices, the oldest one on ties so the meshlet stays round
+				std::erase_if(candidates, [&](std::uint32_t candidate) { return used[candidate] != 0; });
+				std::uint32_t best = NoMeshlet;
+				std::uint32_t best_new_vertices = 4;
+				for (std::uint32_t candidate : candidates)
+				{
+					std::uint32_t new_vertices = new_vertex_count(candidate);
+					if (new_vertices < best_new_vertices && vertex_count + new_vertices <= MeshletBuilder::MaxVertices)
+					{
+						best = candidate;
+						best_new_vertices = new_vertices;
+						if (new_vertices == 0)
+							break;
+					}
+				}
+				if (best == NoMeshlet)
+					break;
+				triangle = best;
+			}
+
+			std::span<Mesh::IndexT const> meshlet_indices{ ordered.data() + meshlet_begin, ordered.size() - meshlet_begin };
+			out_meshlets.push_back(compute_meshlet_bounds(positions, meshlet_indices,
+				first_index + static_cast<std::uint32_t>(meshlet_begin)));
+		}
+
+		std::ranges::copy(ordered, lod_indices.begin());
+	}
+}
+
+std::vector<Meshlet> MeshletBuilder::Build(
+	std::span<glm::vec3 const> positions,
+	std::vector<Mesh::IndexT> & indices,
+	std::vector<MeshLod> & lods)
+{
+	std::vector<Meshlet> meshlets;
+	if (positions.empty() || indices.empty())
+		return meshlets;
+
+	if (lods.empty())
+		lods.push_back(MeshLod{ .first_index = 0, .index_count = static_cast<std::uint32_t>(indices.size()) });
+
+	for (MeshLod & lod : lods)
+	{
+		if (std::size_t{ lod.first_index } + lod.index_count > indices.size() || lod.index_count % 3 != 0)
+			continue;
+
+		lod.first_meshlet = static_cast<std::uint32_t>(meshlets.size());
+		build_lod_meshlets(positions, std::span<Mesh::IndexT>{ indices.data() + lod.first_index, lod.index_count },
+			lod.first_index, meshlets);
+		lod.meshlet_count = static_cast<std::uint32_t>(meshlets.size()) - lod.first_meshlet;
+	}
+
+	return meshlets;
+}
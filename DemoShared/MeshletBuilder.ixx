@@ -0,0 +1,52 @@
+// MeshletBuilder.ixx
+
+module;
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+export module MeshletBuilder;
+
+import Mesh;
+import Trace;
+
+// Splits the lods of a mesh into meshlets: clusters of up to MaxVertices vertices and MaxTriangles triangles that
+// are grown greedily over shared edges, so each one is a compact patch of the surface with tight bounds.
+// The triangles of every lod are reordered so that its meshlets are contiguous ranges of its index range,
+// which lets a run of visible meshlets be drawn with a single call, see MeshletCuller.
+export namespace MeshletBuilder
+{
+	constexpr std::uint32_t MaxVertices = 64;
+	constexpr std::uint32_t MaxTriangles = 124;
+
+	// Reorders the indices of every lod and sets its meshlet range. Without lods the whole index buffer is one lod.
+	std::vector<Meshlet> Build(
+		std::span<glm::vec3 const> positions,
+		std::vector<Mesh::IndexT> & indices,
+		std::vector<MeshLod> & lods);
+
+	template <typename VertexT>
+	std::vector<Meshlet> Build(
+		std::vector<VertexT> const & vertices,
+		std::vector<Mesh::IndexT> & indices,
+		std::vector<MeshLod> & lods);
+}
+
+template <typename VertexT>
+std::vector<Meshlet> MeshletBuilder::Build(
+	std::vector<VertexT> const & vertices,
+	std::vector<Mesh::IndexT> & indices,
+	std::vector<MeshLod> & lods)
+{
+	Trace::Zone zone{ "MeshletBuilder::Build" };
+
+	std::vector<glm::vec3> positions;
+	positions.reserve(vertices.size());
+	for (VertexT const & vertex : vertices)
+		positions.push_back(vertex.pos);
+
+	return Build(positions, indices, lods);
+}
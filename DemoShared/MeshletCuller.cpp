@@ -0,0 +1,208 @@
+// MeshletCuller.cpp
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHLET_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+module MeshletCuller;
+
+import Trace;
+
+struct CullParams
+{
+	glm::mat4 model;
+	float scale = 1.0f; // largest scale of the model, applied to the bounding spheres
+	float inv_scale = 1.0f;
+	bool cull_cones = true; // the cones are only valid under a uniform scale
+	std::array<glm::vec4, 6> const * planes = nullptr;
+	glm::vec3 camera_pos{ 0.0f };
+};
+
+bool is_meshlet_visible(Meshlet const & meshlet, CullParams const & params)
+{
+	glm::vec3 const center{ params.model * glm::vec4{ meshlet.center, 1.0f } };
+	float const radius = meshlet.radius * params.scale;
+
+	for (glm::vec4 const & plane : *params.planes)
+	{
+		if (glm::dot(glm::vec3{ plane }, center) + plane.w < -radius)
+			return false;
+	}
+
+	if (!params.cull_cones)
+		return true;
+
+	// Back facing if the camera is inside the cone of directions from which all the triangles are seen from behind,
+	// widened by the bounding sphere so it holds for every point of the meshlet
+	glm::vec3 const axis = glm::vec3{ params.model * glm::vec4{ meshlet.cone_axis, 0.0f } } * params.inv_scale;
+	glm::vec3 const to_center = center - params.camera_pos;
+	return glm::dot(to_center, axis) < meshlet.cone_cutoff * glm::length(to_center) + radius;
+}
+
+#ifdef MESHLET_CULLING_SSE2
+// is_meshlet_visible for 4 meshlets at once, returns a bit per visible meshlet
+int get_visible_meshlets_x4(Meshlet const * meshlets, CullParams const & params)
+{
+	auto gather = [&](auto member)
+		{
+			return _mm_setr_ps(member(meshlets[0]), member(meshlets[1]), member(meshlets[2]), member(meshlets[3]));
+		};
+
+	__m128 const local_x = gather([](Meshlet const & meshlet) { return meshlet.center.x; });
+	__m128 const local_y = gather([](Meshlet const & meshlet) { return meshlet.center.y; });
+	__m128 const local_z = gather([](Meshlet const & meshlet) { return meshlet.center.z; });
+	__m128 const radius = _mm_mul_ps(gather([](Meshlet const & meshlet) { return meshlet.radius; }), _mm_set1_ps(params.scale));
+
+	glm::mat4 const & model = params.model;
+	auto transform = [&](__m128 x, __m128 y, __m128 z, int row, float w)
+		{
+			__m128 xy = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(model[0][row])), _mm_mul_ps(y, _mm_set1_ps(model[1][row])));
+			__m128 zw = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(model[2][row])), _mm_set1_ps(model[3][row] * w));
+			return _mm_add_ps(xy, zw);
+		};
+
+	__m128 const center_x = transform(local_x, local_y, local_z, 0, 1.0f);
+	__m128 const center_y = transform(local_x, local_y, local_z, 1, 1.0f);
+	__m128 const center_z = transform(local_x, local_y, local_z, 2, 1.0f);
+	__m128 const minus_radius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+	__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	for (glm::vec4 const & plane : *params.planes)
+	{
+		__m128 distance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(center_x, _mm_set1_ps(plane.x)), _mm_mul_ps(center_y, _mm_set1_ps(plane.y))),
+			_mm_add_ps(_mm_mul_ps(center_z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+		visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, minus_radius));
+	}
+
+	if (params.cull_cones && _mm_movemask_ps(visible) != 0)
+	{
+		__m128 const cone_x = gather([](Meshlet const & meshlet) { return meshlet.cone_axis.x; });
+		__m128 const cone_y = gather([](Meshlet const & meshlet) { return meshlet.cone_axis.y; });
+		__m128 const cone_z = gather([](Meshlet const & meshlet) { return meshlet.cone_axis.z; });
+		__m128 const cutoff = gather([](Meshlet const & meshlet) { return meshlet.cone_cutoff; });
+
+		__m128 const inv_scale = _mm_set1_ps(params.inv_scale);
+		__m128 const axis_x = _mm_mul_ps(transform(cone_x, cone_y, cone_z, 0, 0.0f), inv_scale);
+		__m128 const axis_y = _mm_mul_ps(transform(cone_x, cone_y, cone_z, 1, 0.0f), inv_scale);
+		__m128 const axis_z = _mm_mul_ps(transform(cone_x, cone_y, cone_z, 2, 0.0f), inv_scale);
+
+		__m128 const to_center_x = _mm_sub_ps(center_x, _mm_set1_ps(params.camera_pos.x));
+		__m128 const to_center_y = _mm_sub_ps(center_y, _mm_set1_ps(params.camera_pos.y));
+		__m128 const to_center_z = _mm_sub_ps(center_z, _mm_set1_ps(params.camera_pos.z));
+
+		__m128 const distance = _mm_sqrt_ps(_mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(to_center_x, to_center_x), _mm_mul_ps(to_center_y, to_center_y)),
+			_mm_mul_ps(to_center_z, to_center_z)));
+		__m128 const axis_dot = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(to_center_x, axis_x), _mm_mul_ps(to_center_y, axis_y)),
+			_mm_mul_ps(to_center_z, axis_z));
+		__m128 const threshold = _mm_add_ps(_mm_mul_ps(cutoff, distance), radius);
+		visible = _mm_and_ps(visible, _mm_cmplt_ps(axis_dot, threshold));
+	}
+
+	return _mm_movemask_ps(visible);
+}
+#endif
+
+void MeshletCuller::BeginFrame(Camera const & camera)
+{
+	// The side planes come from the rows of the view projection matrix (Gribb and Hartmann), they don't depend on the
+	// clip space depth range, which differs between the backends. Near and far are taken from the camera instead.
+	glm::mat4 const view_proj = camera.GetViewProjUniform().proj * camera.GetViewProjUniform().view;
+	auto row = [&](int i) { return glm::vec4{ view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i] }; };
+
+	glm::vec3 const & pos = camera.GetPosUniform().pos;
+	glm::vec3 const dir = glm::normalize(camera.GetDir());
+
+	m_planes = {
+		row(3) + row(0),
+		row(3) - row(0),
+		row(3) + row(1),
+		row(3) - row(1),
+		glm::vec4{ dir, -glm::dot(dir, pos) - camera.GetNearPlane() },
+		glm::vec4{ -dir, glm::dot(dir, pos) + camera.GetFarPlane() }
+	};
+	for (glm::vec4 & plane : m_planes)
+		plane /= glm::length(glm::vec3{ plane });
+
+	m_camera_pos = pos;
+	m_stats = MeshletCullStats{};
+}
+
+std::uint32_t MeshletCuller::Cull(std::span<Meshlet const> meshlets, glm::mat4 const & model, std::vector<MeshIndexRange> & out_ranges,
+	MeshletCullStats & stats) const
+{
+	Trace::Zone zone{ "MeshletCuller::Cull" };
+
+	float const scale_x = glm::length(glm::vec3{ model[0] });
+	float const scale_y = glm::length(glm::vec3{ model[1] });
+	float const scale_z = glm::length(glm::vec3{ model[2] });
+	float const max_scale = std::max({ scale_x, scale_y, scale_z });
+	float const min_scale = std::min({ scale_x, scale_y, scale_z });
+
+	CullParams const params{
+		.model = model,
+		.scale = max_scale,
+		.inv_scale = max_scale > 0.0f ? 1.0f / max_scale : 0.0f,
+		.cull_cones = max_scale - min_scale <= max_scale * 0.01f,
+		.planes = &m_planes,
+		.camera_pos = m_camera_pos
+	};
+
+	std::size_t const first_range = out_ranges.size();
+	auto add_visible = [&](Meshlet const & meshlet)
+		{
+			++stats.visible_count;
+			if (out_ranges.size() > first_range
+				&& out_ranges.back().first_index + out_ranges.back().index_count == meshlet.first_index)
+			{
+				out_ranges.back().index_count += meshlet.index_count;
+				return;
+			}
+			out_ranges.push_back(MeshIndexRange{ .first_index = meshlet.first_index, .index_count = meshlet.index_count });
+		};
+
+	std::size_t i = 0;
+#ifdef MESHLET_CULLING_SSE2
+	for (; i + 4 <= meshlets.size(); i += 4)
+	{
+		int const visible_mask = get_visible_meshlets_x4(&meshlets[i], params);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (visible_mask & (1 << lane))
+				add_visible(meshlets[i + lane]);
+		}
+	}
+#endif
+	for (; i < meshlets.size(); ++i)
+	{
+		if (is_meshlet_visible(meshlets[i], params))
+			add_visible(meshlets[i]);
+	}
+
+	std::uint32_t const range_count = static_cast<std::uint32_t>(out_ranges.size() - first_range);
+	stats.meshlet_count += static_cast<std::uint32_t>(meshlets.size());
+	stats.range_count += range_count;
+	return range_count;
+}
+
+void MeshletCuller::AddStats(MeshletCullStats const & stats)
+{
+	m_stats.meshlet_count += stats.meshlet_count;
+	m_stats.visible_count += stats.visible_count;
+	m_stats.range_count += stats.range_count;
+}
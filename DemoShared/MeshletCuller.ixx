@@ -0,0 +1,49 @@
+// MeshletCuller.ixx
+
+module;
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+export module MeshletCuller;
+
+import Camera;
+import Mesh;
+
+export struct MeshletCullStats
+{
+	std::uint32_t meshlet_count = 0; // tested this frame
+	std::uint32_t visible_count = 0;
+	std::uint32_t range_count = 0; // draws the visible meshlets were merged into
+};
+
+// Culls the meshlets of a mesh against the camera's frustum and against their normal cones, which removes the
+// clusters that are off screen or entirely back facing before their vertices are ever transformed.
+// The visible meshlets are emitted as index ranges, meshlets that are next to each other in the index buffer are
+// merged into one range, so a mostly visible mesh still takes only a few draws.
+// Cull doesn't change the culler, so meshes can be culled on several threads at once between BeginFrame calls.
+export class MeshletCuller
+{
+public:
+	// Takes the camera's frustum for the frame and resets the stats
+	void BeginFrame(Camera const & camera);
+
+	// Appends the ranges of the visible meshlets to out_ranges and returns how many were added.
+	// The counts are added to stats, which the caller hands to AddStats once it's back on a single thread.
+	std::uint32_t Cull(std::span<Meshlet const> meshlets, glm::mat4 const & model, std::vector<MeshIndexRange> & out_ranges,
+		MeshletCullStats & stats) const;
+
+	void AddStats(MeshletCullStats const & stats);
+	MeshletCullStats const & GetStats() const { return m_stats; }
+
+private:
+	std::array<glm::vec4, 6> m_planes{}; // world space, the normals point inside the frustum
+	glm::vec3 m_camera_pos{ 0.0f };
+	MeshletCullStats m_stats;
+};
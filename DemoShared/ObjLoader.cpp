@@ -15,6 +15,8 @@ module;
 
 module ObjLoader;
 
+import Trace;
+
 namespace
 {
 	struct ObjVertex
@@ -136,6 +138,8 @@ namespace ObjLoader
 		std::vector<NormalVertex> & out_vertices,
 		std::vector<Mesh::IndexT> & out_indices)
 	{
+		Trace::Zone zone{ "ObjLoader::LoadObjFile" };
+
 		std::vector<std::array<float, 3>> positions;
 		std::vector<std::array<float, 3>> normals;
 		std::vector<ObjFaceVerts> face_verts;
@@ -2,8 +2,14 @@
 
 module;
 
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <set>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -53,4 +59,40 @@ namespace PlatformUtils
 	{
 		return GetExecutablePath().parent_path();
 	}
+
+	// Cores without their hyperthreads, falls back to the logical processor count if the topology isn't available
+	export std::uint32_t GetPhysicalCoreCount()
+	{
+		std::uint32_t const logical_count = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+		std::uint32_t core_count = 0;
+
+#if defined(_WIN32)
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+		std::vector<std::uint8_t> buffer(length);
+		if (length > 0 && GetLogicalProcessorInformationEx(RelationProcessorCore,
+			reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+		{
+			for (DWORD offset = 0; offset < length; ++core_count)
+				offset += reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data() + offset)->Size;
+		}
+
+#elif defined(__linux__)
+		// Hyperthreads of a core share its core id within the package
+		std::set<std::pair<int, int>> cores;
+		for (std::uint32_t cpu = 0; cpu < logical_count; ++cpu)
+		{
+			std::filesystem::path const topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology";
+			std::ifstream package_file(topology / "physical_package_id");
+			std::ifstream core_file(topology / "core_id");
+			int package_id = 0, core_id = 0;
+			if (package_file >> package_id && core_file >> core_id)
+				cores.emplace(package_id, core_id);
+		}
+		core_count = static_cast<std::uint32_t>(cores.size());
+
+#endif
+
+		return core_count > 0 && core_count < logical_count ? core_count : logical_count;
+	}
 }
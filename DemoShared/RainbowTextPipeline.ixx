@@ -4,10 +4,9 @@ module;
 
 #include <expected>
 #include <filesystem>
-#include <iostream>
 #include <optional>
 
-#include <glm/vec4.hpp>
+#include <glm/vec3.hpp>
 
 export module RainbowTextPipeline;
 
@@ -16,38 +15,56 @@ import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
 import PipelineBuilder;
-import RenderObject;
 import Texture;
+import TypedPipeline;
 import Vertex;
 
 export class RainbowTextPipeline
 {
 public:
-	using VertexT = Texture2dVertex;
+	using VertexT = GlyphInstance; // the colors and msdf range come with every glyph, see TextBatch
+	constexpr static char const * Name = "RainbowTextPipeline";
+	constexpr static RenderPass Pass = RenderPass::OVERLAY;
 
+	// Text has no per-frame uniforms
+	struct FrameData
+	{
+	};
+
+	// Shared by all the text of a batch, the rest of the effect is per glyph, see EffectParams
 	struct ObjectData
 	{
-		glm::vec4 bg_color = glm::vec4(0.0f);
-		float screen_px_range = 1.0f;
 		float time = 0.0f;
-		float rainbow_width = 200.0f; // in pixels, adjust for dpi
-
-		// Adjust for slant angle (0.0 = vertical, 1.0 = 45 degrees forward, -1.0 = 45 degrees backward)
-		float slant_factor = -1.0f;
 	};
 
+	// TextStyle::effect_params of the labels drawn with this pipeline
+	static glm::vec3 EffectParams(
+		float rainbow_width, // in pixels, adjust for dpi
+		float slant_factor = -1.0f) // slant angle (0.0 = vertical, 1.0 = 45 degrees forward, -1.0 = 45 degrees backward)
+	{
+		return glm::vec3{ rainbow_width, slant_factor, 0.0f };
+	}
+
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
 		GraphicsApi const & graphics_api,
 		std::filesystem::path const & shaders_path,
 		AssetPool<Texture> const & texture_pool,
 		AssetId texture_id);
 
+	static void UpdatePerFrameConstants(GraphicsPipeline const & /*pipeline*/, FrameData const & /*frame_data*/) {}
+	static void UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data);
+
 	RainbowTextPipeline() = default;
 	explicit RainbowTextPipeline(AssetId asset_id) : m_asset_id(asset_id) {}
 
 	AssetId GetAssetId() const { return m_asset_id; }
 
 private:
+	struct ObjectDataFS
+	{
+		alignas(4) float time;
+	};
+
 	AssetId m_asset_id;
 };
 
@@ -57,15 +74,6 @@ std::expected<GraphicsPipeline, GraphicsError> RainbowTextPipeline::CreateGraphi
 	AssetPool<Texture> const & texture_pool,
 	AssetId texture_id)
 {
-	struct ObjectDataFS
-	{
-		alignas(16) glm::vec4 bg_color;
-		alignas(4) float screen_px_range;
-		alignas(4) float time;
-		alignas(4) float rainbow_width;
-		alignas(4) float slant_factor;
-	};
-
 	Texture const * texture = texture_pool.Get(texture_id);
 	if (!texture)
 		return std::unexpected{ GraphicsError{ "TextPipeline::CreateGraphicsPipeline: invalid texture" } };
@@ -93,27 +101,14 @@ std::expected<GraphicsPipeline, GraphicsError> RainbowTextPipeline::CreateGraphi
 		});
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerObjectConstantsCallback(
-		[](GraphicsPipeline const & pipeline, void const * object_data)
-		{
-			if (!object_data)
-			{
-				std::cout << "TextObjectData is null for RainbowTextPipeline" << std::endl;
-				return;
-			}
-
-			auto const * data = static_cast<ObjectData const *>(object_data);
-
-			pipeline.SetObjectData(
-				std::nullopt,
-				ObjectDataFS{
-					.bg_color = data->bg_color,
-					.screen_px_range = data->screen_px_range,
-					.time = data->time,
-					.rainbow_width = data->rainbow_width,
-					.slant_factor = data->slant_factor
-				});
-		});
-
 	return builder.CreatePipeline();
 }
+
+inline void RainbowTextPipeline::UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data)
+{
+	pipeline.SetObjectData(
+		std::nullopt,
+		ObjectDataFS{
+			.time = object_data.time
+		});
+}
@@ -4,7 +4,6 @@ module;
 
 #include <expected>
 #include <filesystem>
-#include <iostream>
 #include <optional>
 
 #include <glm/mat4x4.hpp>
@@ -18,14 +17,23 @@ import GraphicsError;
 import GraphicsPipeline;
 import LightsManager;
 import PipelineBuilder;
-import RenderObject;
+import ShaderVariant;
 import Texture;
+import TypedPipeline;
 import Vertex;
 
 export class ReflectionPipeline
 {
 public:
 	using VertexT = NormalVertex;
+	constexpr static char const * Name = "ReflectionPipeline";
+	constexpr static RenderPass Pass = RenderPass::GEOMETRY;
+
+	struct FrameData
+	{
+		Camera const * camera = nullptr;
+		LightsManager const * lights = nullptr;
+	};
 
 	struct ObjectData
 	{
@@ -35,10 +43,13 @@ public:
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
 		GraphicsApi const & graphics_api,
 		std::filesystem::path const & shaders_path,
-		Camera const & camera,
-		LightsManager const & lights,
 		AssetPool<Texture> const & texture_pool,
-		AssetId texture_id);
+		AssetId texture_id,
+		LightsManager const & lights,
+		ShaderVariant const & variant);
+
+	static void UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data);
+	static void UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data);
 
 	ReflectionPipeline() = default;
 	explicit ReflectionPipeline(AssetId asset_id) : m_asset_id(asset_id) {}
@@ -46,22 +57,22 @@ public:
 	AssetId GetAssetId() const { return m_asset_id; }
 
 private:
+	struct ObjectDataVS
+	{
+		alignas(16) glm::mat4 model;
+	};
+
 	AssetId m_asset_id;
 };
 
 std::expected<GraphicsPipeline, GraphicsError> ReflectionPipeline::CreateGraphicsPipeline(
 	GraphicsApi const & graphics_api,
 	std::filesystem::path const & shaders_path,
-	Camera const & camera,
-	LightsManager const & lights,
 	AssetPool<Texture> const & texture_pool,
-	AssetId texture_id)
+	AssetId texture_id,
+	LightsManager const & lights,
+	ShaderVariant const & variant)
 {
-	struct ObjectDataVS
-	{
-		alignas(16) glm::mat4 model;
-	};
-
 	Texture const * texture = texture_pool.Get(texture_id);
 	if (!texture)
 		return std::unexpected{ GraphicsError{ "ReflectionPipeline::CreateGraphicsPipeline: invalid texture" } };
@@ -70,7 +81,8 @@ std::expected<GraphicsPipeline, GraphicsError> ReflectionPipeline::CreateGraphic
 
 	std::expected<void, GraphicsError> load_shaders_result = builder.LoadShaders(
 		shaders_path / "reflection.vert",
-		shaders_path / "reflection.frag");
+		shaders_path / "reflection.frag",
+		variant);
 	if (!load_shaders_result.has_value())
 		return std::unexpected{ load_shaders_result.error() };
 
@@ -78,35 +90,25 @@ std::expected<GraphicsPipeline, GraphicsError> ReflectionPipeline::CreateGraphic
 	builder.SetObjectDataTypes<ObjectDataVS, std::nullopt_t>();
 	builder.SetVSUniformTypes<ViewProjUniform>();
 	builder.SetFSUniformTypes<LightsUniform, CameraPosUniform>();
+	builder.SetFSStorageBuffers(lights.GetStorageBuffers());
 	builder.SetTexture(*texture);
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerFrameConstantsCallback(
-		[&camera, &lights](GraphicsPipeline const & pipeline)
-		{
-			pipeline.SetUniform(0 /*binding*/, camera.GetViewProjUniform());
-			pipeline.SetUniform(1 /*binding*/, lights.GetLightsUniform());
-			pipeline.SetUniform(2 /*binding*/, camera.GetPosUniform());
-		});
-	builder.SetPerObjectConstantsCallback(
-		[](GraphicsPipeline const & pipeline, void const * object_data)
-		{
-			if (!object_data)
-			{
-				std::cout << "ObjectData is null for ReflectionPipeline" << std::endl;
-				return;
-			}
-
-			// For optimal performance, we assume that the object data is of the correct type.
-			// Use compile-time checks when creating render objects to ensure the data is compatible with the pipeline.
-			auto const * data = static_cast<ObjectData const *>(object_data);
-
-			pipeline.SetObjectData(
-				ObjectDataVS{
-					.model = data->model
-				},
-				std::nullopt);
-		});
-
 	return builder.CreatePipeline();
 }
+
+inline void ReflectionPipeline::UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data)
+{
+	pipeline.SetUniform(0 /*binding*/, frame_data.camera->GetViewProjUniform());
+	pipeline.SetUniform(1 /*binding*/, frame_data.lights->GetLightsUniform());
+	pipeline.SetUniform(2 /*binding*/, frame_data.camera->GetPosUniform());
+}
+
+inline void ReflectionPipeline::UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data)
+{
+	pipeline.SetObjectData(
+		ObjectDataVS{
+			.model = object_data.model
+		},
+		std::nullopt);
+}
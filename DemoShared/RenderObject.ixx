@@ -2,35 +2,47 @@
 
 module;
 
-#include <string>
+#include <cstdint>
+#include <optional>
 
 export module RenderObject;
 
 import AssetPool;
 
-export class RenderObject
+// ObjectData is the per-object data type of the pipeline the object is rendered with, std::nullopt_t if it has none
+export template <typename ObjectData = std::nullopt_t>
+class RenderObject
 {
 public:
-	explicit RenderObject(std::string name, AssetId mesh_id, AssetId pipeline_id)
-		: m_name(name)
-		, m_mesh_id(mesh_id)
+	explicit RenderObject(AssetId mesh_id, AssetId pipeline_id, ObjectData const * object_data = nullptr)
+		: m_mesh_id(mesh_id)
 		, m_pipeline_id(pipeline_id)
+		, m_object_data(object_data)
 	{}
 
-	void SetMeshId(AssetId mesh_id) { m_mesh_id = mesh_id; }
-	void SetPipelineId(AssetId pipeline_id) { m_pipeline_id = pipeline_id; }
-	void SetObjectData(void const * data) { m_object_data = data; }
+	void SetMeshId(AssetId mesh_id) { m_mesh_id = mesh_id; m_draw_dirty = true; }
+	void SetPipelineId(AssetId pipeline_id) { m_pipeline_id = pipeline_id; m_draw_dirty = true; }
+	void SetObjectData(ObjectData const * data) { m_object_data = data; }
 
 	AssetId GetMeshId() const { return m_mesh_id; }
 	AssetId GetPipelineId() const { return m_pipeline_id; }
-	void const * GetObjectData() const { return m_object_data; }
+	ObjectData const * GetObjectData() const { return m_object_data; }
 
-private:
-	std::string m_name; // for debugging
+	// The lod picked for the last frame, the next pick is made relative to it, see Scene::select_lod
+	void SetLod(std::uint32_t lod) { m_lod = lod; }
+	std::uint32_t GetLod() const { return m_lod; }
+
+	// Set when the mesh or the pipeline changed, the scene then patches the object's draw record, see Scene::update_draws
+	bool IsDrawDirty() const { return m_draw_dirty; }
+	void ClearDrawDirty() { m_draw_dirty = false; }
 
+private:
 	AssetId m_mesh_id;
 	AssetId m_pipeline_id;
 
-	// Pointer to per-object data that gets passed into shaders, expected to be of type Pipeline::ObjectData
-	void const * m_object_data = nullptr;
+	// Per-object data that gets passed into shaders, owned by the scene
+	ObjectData const * m_object_data = nullptr;
+
+	std::uint32_t m_lod = 0;
+	bool m_draw_dirty = false;
 };
@@ -0,0 +1,77 @@
+// ResolutionScaler.ixx
+
+module;
+
+#include <algorithm>
+#include <cmath>
+
+export module ResolutionScaler;
+
+export struct ResolutionScalerSettings
+{
+	double target_gpu_ms = 1000.0 / 60.0;
+	float min_scale = 0.5f;
+	float max_scale = 1.0f;
+};
+
+// Picks the scale of the scene's render resolution that keeps the gpu frame time under the target, see Renderer::SetRenderScale.
+// The gpu time of a fill rate bound frame is roughly proportional to the pixel count, so the scale that would hit
+// the target is the current one times the square root of target / measured. The measured time is smoothed and
+// the scale only moves part of the way there each frame, the timings are a few frames old so reacting at once would oscillate.
+export class ResolutionScaler
+{
+public:
+	explicit ResolutionScaler(ResolutionScalerSettings const & settings = {}) { SetSettings(settings); }
+
+	void SetSettings(ResolutionScalerSettings const & settings);
+	ResolutionScalerSettings const & GetSettings() const { return m_settings; }
+
+	// Takes the latest gpu frame time and returns the scale to render the next frame at
+	float Update(double gpu_frame_ms);
+
+	float GetScale() const { return m_scale; }
+	double GetFilteredGpuMs() const { return m_filtered_gpu_ms; }
+
+private:
+	constexpr static double m_smoothing = 0.1; // weight of a new frame time in the filtered time
+	constexpr static float m_adjust_rate = 0.1f; // part of the way to the ideal scale that is taken each frame
+	constexpr static double m_headroom = 0.15; // only scale up once the frame is this far under the target
+	constexpr static float m_scale_step = 1.0f / 64.0f; // scales are rounded so small changes don't resize the target every frame
+
+	ResolutionScalerSettings m_settings;
+	float m_scale = 1.0f;
+	double m_filtered_gpu_ms = 0.0;
+};
+
+void ResolutionScaler::SetSettings(ResolutionScalerSettings const & settings)
+{
+	m_settings = settings;
+	m_settings.min_scale = std::clamp(m_settings.min_scale, m_scale_step, 1.0f);
+	m_settings.max_scale = std::clamp(m_settings.max_scale, m_settings.min_scale, 1.0f);
+	m_scale = std::clamp(m_scale, m_settings.min_scale, m_settings.max_scale);
+}
+
+float ResolutionScaler::Update(double gpu_frame_ms)
+{
+	if (gpu_frame_ms <= 0.0 || m_settings.target_gpu_ms <= 0.0)
+		return m_scale; // no timings yet, e.g. the profiler isn't supported
+
+	m_filtered_gpu_ms = m_filtered_gpu_ms == 0.0
+		? gpu_frame_ms
+		: m_filtered_gpu_ms + (gpu_frame_ms - m_filtered_gpu_ms) * m_smoothing;
+
+	double budget_ratio = m_settings.target_gpu_ms / m_filtered_gpu_ms;
+	if (budget_ratio >= 1.0 && budget_ratio < 1.0 + m_headroom)
+		return m_scale;
+
+	float ideal_scale = m_scale * static_cast<float>(std::sqrt(budget_ratio));
+	float scale = m_scale + (ideal_scale - m_scale) * m_adjust_rate;
+	scale = std::round(scale / m_scale_step) * m_scale_step;
+
+	// Rounding can undo a small step, always move at least one step in the wanted direction
+	if (scale == m_scale)
+		scale += ideal_scale > m_scale ? m_scale_step : -m_scale_step;
+
+	m_scale = std::clamp(scale, m_settings.min_scale, m_settings.max_scale);
+	return m_scale;
+}
@@ -4,22 +4,35 @@ module;
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
+#include <format>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <numbers>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 module Scene;
 
+import AllocationCounter;
+import FrameArena;
 import PlatformUtils;
+import ShaderVariant;
+import StateCache;
 import StbImage;
 import TextMesh;
 import AssimpLoader;
 
-AssetId create_texture(
+LoadedAsset create_texture(
 	AssetPool<Texture> & texture_pool,
 	GraphicsApi const & graphics_api,
 	std::filesystem::path const & filepath,
@@ -31,29 +44,30 @@ AssetId create_texture(
 	if (!image.IsValid())
 	{
 		std::cout << "Failed to load image: " << filepath << std::endl;
-		return AssetId{};
+		return LoadedAsset{};
 	}
 
+	ImageData const image_data{
+		.data = image.GetData(),
+		.format = format,
+		.width = static_cast<std::uint32_t>(image.GetWidth()),
+		.height = static_cast<std::uint32_t>(image.GetHeight())
+	};
+
 	Texture texture;
-	std::expected<void, GraphicsError> result = texture.Create(
-		graphics_api,
-		ImageData{
-			.data = image.GetData(),
-			.format = format,
-			.width = static_cast<std::uint32_t>(image.GetWidth()),
-			.height = static_cast<std::uint32_t>(image.GetHeight())
-		});
+	std::expected<void, GraphicsError> result = texture.Create(graphics_api, image_data, use_mip_map);
 	if (!result.has_value() || !texture.IsValid())
 	{
 		std::cout << "Failed to create texture from image: " << filepath << std::endl;
-		return AssetId{};
+		return LoadedAsset{};
 	}
 
 	AssetId texture_id = texture_pool.Add(std::move(texture));
 	if (!texture_id.IsValid())
 		std::cout << "Failed to add texture to pool." << std::endl;
 
-	return texture_id;
+	// The mip chain adds a third to the base level
+	return LoadedAsset{ .id = texture_id, .byte_size = use_mip_map ? image_data.GetSize() * 4 / 3 : image_data.GetSize() };
 }
 
 AssetId Scene::create_texture(
@@ -62,10 +76,39 @@ AssetId Scene::create_texture(
 	bool flip_vertically /*= false*/,
 	bool use_mip_map /*= true*/)
 {
-	return ::create_texture(m_texture_pool, m_graphics_api, filepath, format, flip_vertically, use_mip_map);
+	AssetKey const key = MakeAssetKey(filepath,
+		std::format("format={} flip={} mips={}", static_cast<int>(format), flip_vertically, use_mip_map));
+	TextureRegistry::Handle texture = m_texture_registry.GetOrLoad(key, [&]
+		{
+			return ::create_texture(m_texture_pool, m_graphics_api, filepath, format, flip_vertically, use_mip_map);
+		});
+
+	AssetId texture_id = texture.GetId();
+	if (texture.IsValid())
+		m_texture_handles.push_back(std::move(texture));
+	return texture_id;
 }
 
-AssetId create_cubemap_texture(
+std::uint32_t Scene::add_to_texture_table(AssetId texture_id)
+{
+	Texture const * texture = m_texture_pool.Get(texture_id);
+	if (!texture)
+	{
+		std::cout << "Failed to add texture to the texture table: no texture found for AssetId: " << texture_id.GetIndex() << std::endl;
+		return 0;
+	}
+
+	std::expected<std::uint32_t, GraphicsError> texture_index = m_texture_table.Add(*texture);
+	if (!texture_index.has_value())
+	{
+		std::cout << "Failed to add texture to the texture table: " << texture_index.error().GetMessage() << std::endl;
+		return 0;
+	}
+
+	return texture_index.value();
+}
+
+LoadedAsset create_cubemap_texture(
 	AssetPool<Texture> & texture_pool,
 	GraphicsApi const & graphics_api,
 	std::array<std::filesystem::path, 6> const & filepaths)
@@ -80,7 +123,7 @@ AssetId create_cubemap_texture(
 		if (!images[i].IsValid())
 		{
 			std::cout << "Failed to load cubemap image: " << filepaths[i] << std::endl;
-			return AssetId{};
+			return LoadedAsset{};
 		}
 
 		if (i == 0)
@@ -91,7 +134,7 @@ AssetId create_cubemap_texture(
 		else if (images[i].GetWidth() != width || images[i].GetHeight() != height)
 		{
 			std::cout << "Cubemap images must have the same dimensions." << std::endl;
-			return AssetId{};
+			return LoadedAsset{};
 		}
 	}
 
@@ -99,31 +142,44 @@ AssetId create_cubemap_texture(
 	std::ranges::transform(images, data.begin(),
 		[](StbImage const & img) { return img.GetData(); });
 
+	CubeImageData const image_data{
+		.data = data,
+		.format = format,
+		.width = static_cast<std::uint32_t>(width),
+		.height = static_cast<std::uint32_t>(height)
+	};
+
 	Texture texture;
-	std::expected<void, GraphicsError> result = texture.Create(
-		graphics_api,
-		CubeImageData{
-			.data = data,
-			.format = format,
-			.width = static_cast<std::uint32_t>(width),
-			.height = static_cast<std::uint32_t>(height)
-		});
+	std::expected<void, GraphicsError> result = texture.Create(graphics_api, image_data);
 	if (!result.has_value() || !texture.IsValid())
 	{
 		std::cout << "Failed to create cubemap texture." << std::endl;
-		return AssetId{};
+		return LoadedAsset{};
 	}
 
 	AssetId texture_id = texture_pool.Add(std::move(texture));
 	if (!texture_id.IsValid())
 		std::cout << "Failed to add cubemap texture to pool." << std::endl;
 
-	return texture_id;
+	return LoadedAsset{ .id = texture_id, .byte_size = image_data.GetSize() * 6 /*faces*/ };
 }
 
 AssetId Scene::create_cubemap_texture(std::array<std::filesystem::path, 6> const & filepaths)
 {
-	return ::create_cubemap_texture(m_texture_pool, m_graphics_api, filepaths);
+	// Keyed by the first face, the other faces are part of the parameters
+	AssetKey key = MakeAssetKey(filepaths[0], "cube");
+	for (std::size_t i = 1; i < filepaths.size(); ++i)
+		key.params += " " + MakeAssetKey(filepaths[i]).path;
+
+	TextureRegistry::Handle texture = m_texture_registry.GetOrLoad(key, [&]
+		{
+			return ::create_cubemap_texture(m_texture_pool, m_graphics_api, filepaths);
+		});
+
+	AssetId texture_id = texture.GetId();
+	if (texture.IsValid())
+		m_texture_handles.push_back(std::move(texture));
+	return texture_id;
 }
 
 MeshId<PositionVertex> Scene::create_skybox_mesh()
@@ -180,7 +236,8 @@ MeshId<TextureVertex> Scene::create_ground_mesh()
 
 std::vector<MeshId<ColorVertex>> Scene::create_tree_meshes()
 {
-	std::vector<Mesh> tree_meshes = AssimpLoader::LoadObjWithColorMaterial(m_graphics_api, m_resources_path / "objects" / "tree_with_material.obj");
+	std::vector<Mesh> tree_meshes = AssimpLoader::LoadObjWithColorMaterial(m_graphics_api, m_resources_path / "objects" / "tree_with_material.obj",
+		true /*generate_lods*/);
 	if (tree_meshes.empty())
 	{
 		std::cout << "Failed to load tree_with_material.obj with Assimp" << std::endl;
@@ -202,62 +259,68 @@ std::vector<MeshId<ColorVertex>> Scene::create_tree_meshes()
 	return tree_mesh_ids;
 }
 
+// Picks the coarsest lod whose simplification error projects to less than the threshold in pixels. The error is
+// measured at the near edge of the bounding sphere, which overestimates it for everything behind. Switching back
+// needs the error to cross the threshold by the hysteresis, so objects at the threshold distance don't pop every frame.
+std::uint32_t Scene::select_lod(Mesh const & mesh, glm::mat4 const & model, std::uint32_t prev_lod) const
+{
+	std::uint32_t const lod_count = mesh.GetLodCount();
+	if (lod_count <= 1)
+		return 0;
+
+	float const scale = std::max({ glm::length(glm::vec3{ model[0] }), glm::length(glm::vec3{ model[1] }), glm::length(glm::vec3{ model[2] }) });
+	glm::vec3 const center{ model * glm::vec4{ mesh.GetBoundsCenter(), 1.0f } };
+	float const view_depth = m_camera.GetViewDepth(center) - mesh.GetBoundsRadius() * scale;
+	float const pixels_per_unit = m_camera.GetPixelsPerUnit(view_depth, m_renderer.GetSceneSize().y);
+
+	auto error_px = [&](std::uint32_t lod) { return mesh.GetLod(lod).error * scale * pixels_per_unit; };
+
+	float const refine_threshold = m_lod_settings.error_threshold_px * (1.0f + m_lod_settings.hysteresis);
+	float const coarsen_threshold = m_lod_settings.error_threshold_px * (1.0f - m_lod_settings.hysteresis);
+
+	std::uint32_t lod = std::min(prev_lod, lod_count - 1);
+	while (lod > 0 && error_px(lod) > refine_threshold)
+		--lod;
+	while (lod + 1 < lod_count && error_px(lod + 1) < coarsen_threshold)
+		++lod;
+	return lod;
+}
+
 std::unique_ptr<TextMesh> Scene::create_text_mesh(
 	std::string const & text,
-	FontAtlas const & font_atlas,
+	DynamicFontAtlas & font_atlas,
 	float font_size,
 	glm::vec2 origin,
-	int viewport_width,
-	int viewport_height)
+	TextStyle const & style)
 {
-	std::uint32_t font_tex_width = 0, font_tex_height = 0;
-	Texture const * font_tex = m_texture_pool.Get(font_atlas.GetTexture());
-	if (font_tex)
-	{
-		font_tex_width = font_tex->GetWidth();
-		font_tex_height = font_tex->GetHeight();
-	}
+	// The viewport size comes with the first OnViewportResized
+	return std::make_unique<TextMesh>(m_graphics_api, m_text_layout_cache, text, font_atlas, font_size, origin,
+		0 /*viewport_width*/, 0 /*viewport_height*/, style);
+}
 
-	auto text_mesh = std::make_unique<TextMesh>(m_graphics_api, text,
-		font_atlas, font_tex_width, font_tex_height, font_size, origin, viewport_width, viewport_height);
-	text_mesh->SetUpdateMeshCallback([&mesh_manager = m_mesh_manager](AssetId id, Mesh new_mesh)
+void Scene::log_asset_memory()
+{
+	auto log_line = [&](std::string const & line)
 		{
-			if (!id.IsValid())
-			{
-				std::cout << "Scene::create_text_mesh: Invalid AssetId for updating mesh" << std::endl;
-				return;
-			}
+			m_log_view->Append(std::format("{}{}", m_log_view->GetLineCount() > 0 ? "\n" : "", line));
+		};
 
-			Mesh * mesh = mesh_manager.Get(id);
-			if (!mesh)
+	auto log_registry = [&](std::string_view kind, auto const & registry)
+		{
+			log_line(std::format("{}: {} loaded, {:.1f} MB, {} loads reused", kind, registry.GetCount(),
+				static_cast<double>(registry.GetTotalSize()) / (1024.0 * 1024.0), registry.GetHitCount()));
+			for (AssetMemoryEntry const & entry : registry.GetMemoryReport())
 			{
-				std::cout << "Scene::create_text_mesh: No mesh found in pool for AssetId: " << id.GetIndex() << std::endl;
-				return;
+				log_line(std::format("  {:.1f} MB x{} {}", static_cast<double>(entry.byte_size) / (1024.0 * 1024.0),
+					entry.ref_count, std::filesystem::path{ entry.key.path }.filename().string()));
 			}
+		};
 
-			*mesh = std::move(new_mesh);
-		});
-
-	std::expected<Mesh, GraphicsError> mesh = text_mesh->CreateMesh();
-	if (!mesh.has_value())
-	{
-		std::cout << "Scene::create_text_mesh: Failed to create mesh. Error: "
-			<< mesh.error().GetMessage() << std::endl;
-		return text_mesh;
-	}
-
-	std::expected<MeshId<TextMesh::VertexT>, GraphicsError> mesh_id = m_mesh_manager.AddMesh<TextMesh::VertexT>(std::move(mesh.value()));
-	if (!mesh_id.has_value() || !mesh_id.value().IsValid())
-	{
-		std::cout << "Failed to add text mesh to mesh manager: " << mesh_id.error().GetMessage() << std::endl;
-		return text_mesh;
-	}
-
-	text_mesh->SetMeshId(mesh_id.value());
-	return text_mesh;
+	log_registry("Textures", m_texture_registry);
+	log_registry("Meshes", m_mesh_registry);
 }
 
-void init_sword_transform(int index, glm::mat4 & transform)
+Transform get_sword_transform(int index)
 {
 	float x_rot = static_cast<float>(std::numbers::pi / 2.0);
 	float y_rot = static_cast<float>(std::numbers::pi / 4.0);
@@ -269,43 +332,65 @@ void init_sword_transform(int index, glm::mat4 & transform)
 	}
 
 	// the sword mesh was designed for the Y axis being the up direction, but we're using the Z axis, this can be corrected by rotating on the X axis
-	transform = glm::rotate(glm::mat4(1.0), x_rot, glm::vec3(1.0, 0.0, 0.0)) * transform;
-	transform = glm::rotate(glm::mat4(1.0), y_rot, glm::vec3(0.0, 1.0, 0.0)) * transform;
-	transform = glm::translate(glm::mat4(1.0), pos) * transform;
+	return Transform{
+		.translation = pos,
+		.rotation = glm::angleAxis(y_rot, glm::vec3(0.0, 1.0, 0.0)) * glm::angleAxis(x_rot, glm::vec3(1.0, 0.0, 0.0))
+	};
 }
 
-void update_sword_transform(int index, glm::mat4 & transform, float time, float delta_time)
+void update_sword_transform(int index, TransformStore & transforms, TransformId transform, float time, float delta_time)
 {
-	float sword_pos_z;
+	glm::vec3 sword_pos = transforms.GetTranslation(transform);
 	if (index == 0)
-		sword_pos_z = std::cos(time * 0.5f) * 0.5f + 3.5f;
+		sword_pos.z = std::cos(time * 0.5f) * 0.5f + 3.5f;
 	else
-		sword_pos_z = std::sin(time * 0.5f) * 0.5f + 3.5f;
-	transform[3][2] = sword_pos_z;
-
-	glm::vec3 sword_pos(transform[3][0], transform[3][1], transform[3][2]);
-	glm::vec3 sword_y_axis(transform[1][0], transform[1][1], transform[1][2]);
+		sword_pos.z = std::sin(time * 0.5f) * 0.5f + 3.5f;
+	transforms.SetTranslation(transform, sword_pos);
 
-	transform = glm::translate(glm::mat4(1.0), -sword_pos) * transform;
-	transform = glm::rotate(glm::mat4(1.0), delta_time * 0.5f, sword_y_axis) * transform;
-	transform = glm::translate(glm::mat4(1.0), sword_pos) * transform;
+	// spins around its own Y axis
+	transforms.RotateLocal(transform, delta_time * 0.5f, glm::vec3(0.0, 1.0, 0.0));
 }
 
-void init_gem_transform(int index, glm::mat4 & transform)
+// Relative to the ring the gems circle on
+Transform get_gem_transform(int index)
 {
 	float x_rot = static_cast<float>(std::numbers::pi / 2.0);
 	float z_rot = static_cast<float>(index * std::numbers::pi * 2.0 / 3.0);
 	glm::vec3 pos(0.0f, 4.0f, 2.0f);
 
 	// the gem meshes were designed for the Y axis being the up direction, but we're using the Z axis, this can be corrected by rotating on the X axis
-	transform = glm::rotate(glm::mat4(1.0), x_rot, glm::vec3(1.0, 0.0, 0.0)) * transform;
-	transform = glm::translate(glm::mat4(1.0), pos) * transform;
-	transform = glm::rotate(glm::mat4(1.0), z_rot, glm::vec3(0.0, 0.0, 1.0)) * transform;
+	glm::quat const ring_pos_rotation = glm::angleAxis(z_rot, glm::vec3(0.0, 0.0, 1.0));
+	return Transform{
+		.translation = ring_pos_rotation * pos,
+		.rotation = ring_pos_rotation * glm::angleAxis(x_rot, glm::vec3(1.0, 0.0, 0.0))
+	};
 }
 
-void update_gem_transform(glm::mat4 & transform, float delta_time)
+// Small lights circling above the ground on a grid, to give the light clusters some work
+constexpr std::uint32_t swarm_light_grid_size = 32;
+constexpr std::uint32_t swarm_light_count = swarm_light_grid_size * swarm_light_grid_size;
+
+PointLight get_swarm_light(std::uint32_t index, float time)
 {
-	transform = glm::rotate(glm::mat4(1.0), delta_time * 0.5f, glm::vec3(0.0, 0.0, 1.0)) * transform;
+	constexpr float spacing = 1.8f;
+	constexpr float grid_offset = (swarm_light_grid_size - 1) * spacing * 0.5f;
+	constexpr float two_pi = 2.0f * std::numbers::pi_v<float>;
+
+	float const hue = static_cast<float>(index) / static_cast<float>(swarm_light_count);
+	float const phase = hue * 97.0f; // scatters the neighbours
+	float const angle = time * (0.5f + 0.5f * hue) + phase;
+
+	glm::vec3 const base{
+		static_cast<float>(index % swarm_light_grid_size) * spacing - grid_offset,
+		static_cast<float>(index / swarm_light_grid_size) * spacing - grid_offset,
+		0.6f
+	};
+
+	return PointLight{
+		.pos = base + glm::vec3{ std::cos(angle) * 0.7f, std::sin(angle) * 0.7f, std::sin(angle * 2.0f) * 0.3f },
+		.color = 0.5f + 0.5f * glm::cos(two_pi * (hue + glm::vec3{ 0.0f, 0.33f, 0.67f })),
+		.radius = 2.0f
+	};
 }
 
 Scene::Scene(GraphicsApi const & graphics_api, std::string const & title, float dpi_scale_factor)
@@ -314,7 +399,13 @@ Scene::Scene(GraphicsApi const & graphics_api, std::string const & title, float
 	, m_title{ title }
 	, m_renderer{ graphics_api }
 	, m_camera{ graphics_api.ShouldFlipScreenY() }
+	, m_lights{ graphics_api }
 	, m_mesh_manager{ graphics_api }
+	, m_texture_registry{ m_texture_pool }
+	, m_mesh_registry{ m_mesh_manager }
+	, m_texture_table{ graphics_api }
+	, m_text_batch{ graphics_api, m_mesh_manager }
+	, m_rainbow_text_batch{ graphics_api, m_mesh_manager }
 {
 	float label_font_size = 18.0f * dpi_scale_factor;
 	float title_font_size = 32.0f * dpi_scale_factor;
@@ -333,89 +424,138 @@ Scene::Scene(GraphicsApi const & graphics_api, std::string const & title, float
 		textures_path / "skybox" / "back.jpg"
 	});
 
-	AssetId arial_tex_id = create_texture(fonts_path / "ArialAtlas.png", PixelFormat::RGB_UNORM, true /*flip_vertically*/, false /*use_mip_map*/);
-	m_arial_font = std::make_unique<FontAtlas>(arial_tex_id, fonts_path / "ArialAtlas.json");
-
-	ColorPipeline color_pipeline = create_pipeline<ColorPipeline>(m_camera, m_lights);
-	TexturePipeline ground_pipeline = create_pipeline<TexturePipeline>(m_camera, m_lights, m_texture_pool, ground_tex_id);
-	SkyboxPipeline skybox_pipeline = create_pipeline<SkyboxPipeline>(m_camera, m_texture_pool, skybox_tex_id);
-	LightSourcePipeline light_source_pipeline = create_pipeline<LightSourcePipeline>(m_camera);
-	ReflectionPipeline reflection_pipeline = create_pipeline<ReflectionPipeline>(m_camera, m_lights, m_texture_pool, skybox_tex_id);
-	TextPipeline text_pipeline = create_pipeline<TextPipeline>(m_texture_pool, arial_tex_id);
-	RainbowTextPipeline rainbow_text_pipeline = create_pipeline<RainbowTextPipeline>(m_texture_pool, arial_tex_id);
-
-	MeshId<NormalVertex> sword_mesh = create_mesh<NormalVertex>(objects_path / "skullsword.obj");
-	init_sword_transform(0, m_sword0.model);
-	init_sword_transform(1, m_sword1.model);
+	// The pre-baked atlas stays in system memory, the glyphs are copied out of it into the dynamic atlas' page as
+	// text needs them, so only the page is on the gpu
+	m_arial_font = std::make_unique<FontAtlas>(AssetId{} /*texture_id*/, fonts_path / "ArialAtlas.json");
+	std::uint32_t const font_pixel_size = GetPixelSize(PixelFormat::RGB_UNORM);
+	auto arial_image = std::make_shared<StbImage const>(fonts_path / "ArialAtlas.png", font_pixel_size /*req_comp*/, true /*flip_vertically*/);
+	m_arial_glyphs = std::make_unique<DynamicFontAtlas>(graphics_api, m_texture_pool, *m_arial_font,
+		CreatePrebakedAtlasRasterizer(*m_arial_font, std::move(arial_image), font_pixel_size));
+	AssetId arial_tex_id = m_arial_glyphs->GetTexture();
+
+	// The swords are close to the camera, fog is only worth its cost on the ground and the tree
+	ShaderVariant const fog_variant{ ShaderFeature::POINT_LIGHTS, ShaderFeature::SPOT_LIGHTS, ShaderFeature::FOG };
+	ShaderVariant const lit_variant{ ShaderFeature::POINT_LIGHTS, ShaderFeature::SPOT_LIGHTS };
+
+	ColorPipeline color_pipeline = create_pipeline<ColorPipeline>(
+		ColorPipeline::FrameData{ .camera = &m_camera, .lights = &m_lights }, m_lights, fog_variant);
+	TexturePipeline texture_pipeline = create_pipeline<TexturePipeline>(
+		TexturePipeline::FrameData{ .camera = &m_camera, .lights = &m_lights }, m_texture_table, m_lights, fog_variant);
+	SkyboxPipeline skybox_pipeline = create_pipeline<SkyboxPipeline>(
+		SkyboxPipeline::FrameData{ .camera = &m_camera }, m_texture_pool, skybox_tex_id);
+	LightSourcePipeline light_source_pipeline = create_pipeline<LightSourcePipeline>(
+		LightSourcePipeline::FrameData{ .camera = &m_camera });
+	ReflectionPipeline reflection_pipeline = create_pipeline<ReflectionPipeline>(
+		ReflectionPipeline::FrameData{ .camera = &m_camera, .lights = &m_lights }, m_texture_pool, skybox_tex_id, m_lights, lit_variant);
+	TextPipeline text_pipeline = create_pipeline<TextPipeline>(TextPipeline::FrameData{}, m_texture_pool, arial_tex_id);
+	RainbowTextPipeline rainbow_text_pipeline = create_pipeline<RainbowTextPipeline>(
+		RainbowTextPipeline::FrameData{}, m_texture_pool, arial_tex_id);
+
+	std::array<MeshFile, 4> const mesh_files{
+		MeshFile{ .path = objects_path / "skullsword.obj", .generate_lods = true, .build_meshlets = true },
+		MeshFile{ .path = objects_path / "redgem.obj" },
+		MeshFile{ .path = objects_path / "greengem.obj" },
+		MeshFile{ .path = objects_path / "bluegem.obj" }
+	};
+	std::vector<MeshId<NormalVertex>> const meshes = load_meshes<NormalVertex>(mesh_files);
+	MeshId<NormalVertex> const sword_mesh = meshes[0];
+	MeshId<NormalVertex> const red_gem_mesh = meshes[1];
+	MeshId<NormalVertex> const green_gem_mesh = meshes[2];
+	MeshId<NormalVertex> const blue_gem_mesh = meshes[3];
+
+	m_sword_transforms[0] = m_transforms.Add(get_sword_transform(0));
+	m_sword_transforms[1] = m_transforms.Add(get_sword_transform(1));
+	m_transforms.SetOutput(m_sword_transforms[0], &m_sword0.model);
+	m_transforms.SetOutput(m_sword_transforms[1], &m_sword1.model);
 	create_render_object("sword0", sword_mesh, reflection_pipeline, m_sword0);
 	create_render_object("sword1", sword_mesh, reflection_pipeline, m_sword1);
 
-	MeshId<NormalVertex> red_gem_mesh = create_mesh<NormalVertex>(objects_path / "redgem.obj");
-	MeshId<NormalVertex> green_gem_mesh = create_mesh<NormalVertex>(objects_path / "greengem.obj");
-	MeshId<NormalVertex> blue_gem_mesh = create_mesh<NormalVertex>(objects_path / "bluegem.obj");
 	m_red_gem.color = glm::vec3{ 1.0f, 0.0f, 0.0f };
 	m_green_gem.color = glm::vec3{ 0.0f, 1.0f, 0.0f };
 	m_blue_gem.color = glm::vec3{ 0.0f, 0.0f, 1.0f };
-	init_gem_transform(0, m_red_gem.model);
-	init_gem_transform(1, m_green_gem.model);
-	init_gem_transform(2, m_blue_gem.model);
+	m_gem_ring_transform = m_transforms.Add(Transform{});
+	m_transforms.SetOutput(m_transforms.Add(get_gem_transform(0), m_gem_ring_transform), &m_red_gem.model);
+	m_transforms.SetOutput(m_transforms.Add(get_gem_transform(1), m_gem_ring_transform), &m_green_gem.model);
+	m_transforms.SetOutput(m_transforms.Add(get_gem_transform(2), m_gem_ring_transform), &m_blue_gem.model);
 	create_render_object("red gem", red_gem_mesh, light_source_pipeline, m_red_gem);
 	create_render_object("green gem", green_gem_mesh, light_source_pipeline, m_green_gem);
 	create_render_object("blue gem", blue_gem_mesh, light_source_pipeline, m_blue_gem);
 
 	MeshId<TextureVertex> ground_mesh = create_ground_mesh();
-	create_render_object("ground", ground_mesh, ground_pipeline, m_ground);
+	m_ground.texture_index = add_to_texture_table(ground_tex_id);
+	create_render_object("ground", ground_mesh, texture_pipeline, m_ground);
 
 	MeshId<PositionVertex> skybox_mesh = create_skybox_mesh();
 	create_render_object("skybox", skybox_mesh, skybox_pipeline, std::nullopt); // don't have to provide nullopt here, but intellisense complains if we don't
 
 	std::vector<MeshId<ColorVertex>> tree_meshes = create_tree_meshes();
-	m_tree.model = glm::scale(m_tree.model, glm::vec3(3.281, 3.281, 3.281)); // meters to feet
-	m_tree.model = glm::translate(m_tree.model, glm::vec3(-3.0f, 5.0f, 0.0f));
+	float const meters_to_feet = 3.281f;
+	m_transforms.SetOutput(m_transforms.Add(Transform{
+		.translation = glm::vec3(-3.0f, 5.0f, 0.0f) * meters_to_feet,
+		.scale = glm::vec3(meters_to_feet)
+		}), &m_tree.model);
 	for (auto const & mesh : tree_meshes)
 		create_render_object("tree", mesh, color_pipeline, m_tree);
 
-	m_fps_mesh = create_text_mesh("FPS: ", *m_arial_font, label_font_size, glm::vec2{ -0.9, -0.9 } /*origin*/,
-		0 /*viewport_width*/, 0 /*viewport_height*/);
-	m_fps_label = TextPipeline::ObjectData{
-		.screen_px_range = m_fps_mesh->GetScreenPxRange(),
-		.bg_color = { 0.0f, 0.0f, 0.0f, 0.0f },
-		.text_color = { 1.0f, 1.0f, 0.0f, 1.0 },
-	};
-	create_render_object("fps label", m_fps_mesh->GetMeshId(), text_pipeline, m_fps_label);
+	// Labels are drawn by their pipeline's batch, one draw for all of them
+	m_fps_mesh = create_text_mesh("FPS: ", *m_arial_glyphs, label_font_size, glm::vec2{ -0.9, -0.9 } /*origin*/, TextStyle{
+		.color = { 1.0f, 1.0f, 0.0f, 1.0 },
+		.bg_color = { 0.0f, 0.0f, 0.0f, 0.0f }
+		});
+	m_text_batch.Add(*m_fps_mesh);
+	create_render_object("text", m_text_batch.GetMeshId(), text_pipeline);
 
-	m_title_mesh = create_text_mesh(m_title, *m_arial_font, title_font_size, glm::vec2{ -0.9, 0.8 } /*origin*/,
-		0 /*viewport_width*/, 0 /*viewport_height*/);
-	m_title_label = RainbowTextPipeline::ObjectData{
+	m_title_mesh = create_text_mesh(m_title, *m_arial_glyphs, title_font_size, glm::vec2{ -0.9, 0.8 } /*origin*/, TextStyle{
 		.bg_color = { 0.0f, 0.0f, 0.0f, 0.0f },
-		.screen_px_range = m_title_mesh->GetScreenPxRange(),
-		.rainbow_width = 200.0f * dpi_scale_factor,
-		.slant_factor = -1.0f
-	};
-	create_render_object("title", m_title_mesh->GetMeshId(), rainbow_text_pipeline, m_title_label);
+		.effect_params = RainbowTextPipeline::EffectParams(200.0f * dpi_scale_factor /*rainbow_width*/)
+		});
+	m_rainbow_text_batch.Add(*m_title_mesh);
+	create_render_object("rainbow text", m_rainbow_text_batch.GetMeshId(), rainbow_text_pipeline, m_rainbow_text);
+
+	// Has its own instance buffer, sized for the glyphs that fit in its window
+	m_log_view = std::make_unique<TextView>(m_graphics_api, m_mesh_manager, m_text_layout_cache, *m_arial_glyphs, label_font_size,
+		glm::vec2{ 0.4, 0.9 } /*top_left*/, glm::vec2{ 0.55, 0.5 } /*size*/, TextStyle{ .color = { 0.9f, 0.9f, 0.9f, 1.0f } });
+	create_render_object("log", m_log_view->GetMeshId(), text_pipeline);
+	log_asset_memory();
 
 	m_lights.SetAmbientLight(AmbientLight{ glm::vec3{ 0.3, 0.3, 0.3 } });
+	m_lights.SetFog(glm::vec3{ 0.6f, 0.65f, 0.7f } /*color*/, 0.01f /*density*/);
 
-	m_lights.SetSpotLight(SpotLight{
+	m_lights.AddSpotLight(SpotLight{
 		.pos{ 0.0f, 0.0f, 25.0f },
 		.dir{ 0.0f, 0.0f, -1.0f },
 		.color{ 1.0f, 1.0f, 1.0f },
 		.inner_radius = 0.988f,
-		.outer_radius = 0.986f
+		.outer_radius = 0.986f,
+		.range = 30.0f
 		});
 
+	for (std::uint32_t & gem_light : m_gem_lights)
+		gem_light = m_lights.AddPointLight(PointLight{}).value_or(0);
+
+	m_first_swarm_light = m_lights.AddPointLight(PointLight{}).value_or(0);
+	m_swarm_light_count = 1;
+	while (m_swarm_light_count < swarm_light_count && m_lights.AddPointLight(PointLight{}).has_value())
+		++m_swarm_light_count;
+
 	glm::vec3 camera_pos{ 0.0f, -10.0f, 5.0f };
 	glm::vec3 camera_dir = glm::normalize(glm::vec3{ 0.0f, 0.0f, 2.5f } - camera_pos);
 	m_camera.Init(camera_pos, camera_dir);
+
+	// Loading isn't counted in the first frame's allocations
+	m_last_allocation_count = AllocationCounter::GetThreadCount();
 }
 
 void Scene::OnViewportResized(int width, int height)
 {
+	m_renderer.OnViewportResized(width, height);
 	m_camera.OnViewportResized(width, height);
 	if (m_fps_mesh)
 		m_fps_mesh->OnViewportResized(width, height);
 	if (m_title_mesh)
 		m_title_mesh->OnViewportResized(width, height);
+	if (m_log_view)
+		m_log_view->OnViewportResized(width, height);
 }
 
 void Scene::OnDPIScalingFactorChanged(float dpi_scale_factor)
@@ -425,14 +565,31 @@ void Scene::OnDPIScalingFactorChanged(float dpi_scale_factor)
 
 	if (m_fps_mesh)
 		m_fps_mesh->SetFontSize(label_font_size);
+	if (m_log_view)
+		m_log_view->SetFontSize(label_font_size);
 	if (m_title_mesh)
+	{
+		TextStyle style = m_title_mesh->GetStyle();
+		style.effect_params = RainbowTextPipeline::EffectParams(200.0f * dpi_scale_factor /*rainbow_width*/);
 		m_title_mesh->SetFontSize(title_font_size);
-
-	m_title_label.rainbow_width = 200.0f * dpi_scale_factor;
+		m_title_mesh->SetStyle(style);
+	}
 }
 
 void Scene::Update(double delta_time, Input const & input)
 {
+	Trace::Zone zone{ "Scene::Update" };
+
+	// The previous frame has been submitted, its transient data isn't used anymore
+	FrameArena::BeginFrame();
+
+	std::uint64_t const allocation_count = AllocationCounter::GetThreadCount();
+	std::uint64_t const frame_allocation_count = allocation_count - m_last_allocation_count;
+	m_last_allocation_count = allocation_count;
+	m_frame_allocation_count += frame_allocation_count;
+	if (frame_allocation_count > 0)
+		++m_allocating_frame_count;
+
 	const float dt = static_cast<float>(delta_time);
 	m_timer += dt;
 
@@ -441,11 +598,51 @@ void Scene::Update(double delta_time, Input const & input)
 	if (m_frame_timer >= 1.0)
 	{
 		float fps = static_cast<float>(m_frame_count) / m_frame_timer;
-		m_fps_mesh->SetText("FPS: " + std::to_string(static_cast<int>(fps)));
+		StateCounters const & state_counters = m_renderer.GetStateCounters();
+		LightClusterStats const & light_stats = m_lights.GetClusterStats();
+		MeshletCullStats const & meshlet_stats = m_meshlet_culler.GetStats();
+		// Of the last second, the label's own layout below shows up in the next one
+		TextLayoutStats const text_stats = m_text_layout_cache.GetStats();
+		m_text_layout_cache.ResetStats();
+		// Formatted into the frame arena, the label and the log only keep a copy when the text changed
+		std::pmr::string text{ FrameArena::GetResource() };
+		std::format_to(std::back_inserter(text),
+			"FPS: {} GPU: {:.2f} ms Scale: {:.0f}% Tris: {} Meshlets: {}/{} in {} draws State: {}/{} skipped Lights: {}/{} binned in {:.2f} ms, {:.1f} avg {} max per cluster Text: {:.0f}% cached, {:.2f} ms Glyphs: {} resident {} pending Input: {:.1f} ms to present",
+			static_cast<int>(fps), GetGpuTimings().frame_ms, m_renderer.GetRenderScale() * 100.0f, m_submitted_triangles,
+			meshlet_stats.visible_count, meshlet_stats.meshlet_count, meshlet_stats.range_count, state_counters.skipped, state_counters.issued + state_counters.skipped,
+			light_stats.visible_light_count, light_stats.light_count, light_stats.binning_ms,
+			light_stats.avg_lights_per_cluster, light_stats.max_lights_per_cluster,
+			text_stats.GetHitRate() * 100.0f, text_stats.layout_ms,
+			m_arial_glyphs->GetStats().resident_count, m_arial_glyphs->GetStats().pending_count,
+			input.GetLatencyStats().avg_ms);
+		if constexpr (AllocationCounter::Enabled)
+		{
+			std::format_to(std::back_inserter(text), " Heap: {} allocs in {}/{} frames, arena {:.1f} KB",
+				m_frame_allocation_count, m_allocating_frame_count, m_frame_count,
+				static_cast<float>(FrameArena::Get().GetStats().peak_bytes) / 1024.0f);
+		}
+		m_fps_mesh->SetText(text);
+
+		text.clear();
+		std::format_to(std::back_inserter(text), "{}{:.0f} s: {} fps, {:.2f} ms on the gpu",
+			m_log_view->GetLineCount() > 0 ? "\n" : "", m_timer, static_cast<int>(fps), GetGpuTimings().frame_ms);
+		m_log_view->Append(text);
+
 		m_frame_timer = 0.0;
 		m_frame_count = 0;
+		m_frame_allocation_count = 0;
+		m_allocating_frame_count = 0;
 	}
 
+	// After the text changed, so the glyphs it requests this frame are queued right away
+	m_arial_glyphs->Update();
+	if (m_fps_mesh)
+		m_fps_mesh->Refresh();
+	if (m_title_mesh)
+		m_title_mesh->Refresh();
+	if (m_log_view)
+		m_log_view->Refresh();
+
 	m_camera.Update(delta_time, input);
 
 	glm::vec3 bg_color;
@@ -454,72 +651,101 @@ void Scene::Update(double delta_time, Input const & input)
 	bg_color.b = std::tan(m_timer) / 2.0f + 0.5f;
 	m_renderer.SetClearColor(bg_color);
 
-	update_sword_transform(0, m_sword0.model, m_timer, dt);
-	update_sword_transform(1, m_sword1.model, m_timer, dt);
-	update_gem_transform(m_red_gem.model, dt);
-	update_gem_transform(m_green_gem.model, dt);
-	update_gem_transform(m_blue_gem.model, dt);
+	update_sword_transform(0, m_transforms, m_sword_transforms[0], m_timer, dt);
+	update_sword_transform(1, m_transforms, m_sword_transforms[1], m_timer, dt);
+	m_transforms.Rotate(m_gem_ring_transform, dt * 0.5f, glm::vec3(0.0, 0.0, 1.0));
+	m_transforms.Update(); // before the gem lights read the gems' model matrices
 
 	glm::mat4 const & red_gem_transform = m_red_gem.model;
-	m_lights.SetPointLight1(PointLight{
+	m_lights.SetPointLight(m_gem_lights[0], PointLight{
 		.pos{ red_gem_transform[3][0], red_gem_transform[3][1], red_gem_transform[3][2] },
 		.color{ 1.0, 0.0, 0.0 },
 		.radius = 20.0f
 		});
 
 	glm::mat4 const & green_gem_transform = m_green_gem.model;
-	m_lights.SetPointLight2(PointLight{
+	m_lights.SetPointLight(m_gem_lights[1], PointLight{
 		.pos{ green_gem_transform[3][0], green_gem_transform[3][1], green_gem_transform[3][2] },
 		.color{ 0.0, 1.0, 0.0 },
 		.radius = 20.0f
 		});
 
 	glm::mat4 const & blue_gem_transform = m_blue_gem.model;
-	m_lights.SetPointLight3(PointLight{
+	m_lights.SetPointLight(m_gem_lights[2], PointLight{
 		.pos{ blue_gem_transform[3][0], blue_gem_transform[3][1], blue_gem_transform[3][2] },
 		.color{ 0.0, 0.0, 1.0 },
 		.radius = 20.0f
 		});
 
-	m_title_label.time = m_timer;
+	// SetPointLight only writes the light's own slots, so the swarm is split across the workers
+	m_jobs.ParallelFor(m_swarm_light_count, [this](std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t i = begin; i < end; ++i)
+				m_lights.SetPointLight(m_first_swarm_light + i, get_swarm_light(i, m_timer));
+		}, 64 /*min_grain*/);
+
+	// The aspect ratio doesn't change with the scale, so only the lights care about the scene size
+	m_renderer.SetRenderScale(m_resolution_scaler.Update(GetGpuTimings().frame_ms));
+	glm::ivec2 scene_size = m_renderer.GetSceneSize();
+	m_lights.OnViewportResized(scene_size.x, scene_size.y);
+	m_lights.Update(m_camera, m_jobs);
+
+	m_rainbow_text.time = m_timer;
 }
 
-void Scene::Render() const
+void Scene::Render()
 {
-	m_renderer.BeginDraw();
+	Trace::Zone zone{ "Scene::Render" };
 
-	for (PipelineRenderObjects const & pipeline_r_objs : m_active_render_objects)
 	{
-		GraphicsPipeline const * pipeline = m_pipeline_pool.Get(pipeline_r_objs.pipeline_id);
-		if (!pipeline)
-		{
-			std::cout << "Scene::Render: No pipeline found in pool for pipeline ID: " << pipeline_r_objs.pipeline_id.GetIndex() << std::endl;
-			continue;
-		}
+		Trace::Zone build_zone{ "Scene::Render update draw list" };
+
+		m_draw_list.BeginFrame();
+		m_meshlet_culler.BeginFrame(m_camera);
+		std::apply([this](auto &... pipeline_sets)
+			{
+				(update_draws(pipeline_sets), ...);
+			}, m_pipeline_sets);
+		m_draw_list.Sort();
+		m_submitted_triangles = m_draw_list.GetTriangleCount();
+	}
+
+	m_renderer.BeginDraw();
 
-		pipeline->Activate();
-		pipeline->UpdatePerFrameConstants();
+	// The lights and the glyph instances have a copy per frame in flight, the current one is only safe to write once
+	// the frame began
+	m_lights.Upload();
+	m_text_batch.Upload();
+	m_rainbow_text_batch.Upload();
+	m_log_view->Upload();
 
-		for (AssetId obj_id : pipeline_r_objs.render_object_ids)
+	GpuProfiler & gpu_profiler = m_renderer.GetGpuProfiler();
+
+	// Runs aren't scoped blocks, so the cpu zones are recorded by hand
+	char const * run_name = nullptr;
+	std::uint64_t run_begin_ns = 0;
+	auto begin_run = [&](char const * name)
 		{
-			RenderObject const * obj = m_render_object_pool.Get(obj_id);
-			if (!obj)
-			{
-				std::cout << "Scene::Render: No render object found in pool for AssetId: " << obj_id.GetIndex() << std::endl;
-				continue;
-			}
+			run_name = name;
+			if constexpr (Trace::Enabled)
+				run_begin_ns = Trace::NowNs();
+			gpu_profiler.BeginZone(name);
+		};
+	auto end_run = [&]()
+		{
+			gpu_profiler.EndZone();
+			if constexpr (Trace::Enabled)
+				Trace::RecordZone(run_name, run_begin_ns, Trace::NowNs());
+		};
 
-			Mesh const * mesh = m_mesh_manager.Get(obj->GetMeshId());
-			if (!mesh)
-			{
-				std::cout << "Scene::Render: No mesh found in pool for AssetId: " << obj->GetMeshId().GetIndex() << std::endl;
-				continue;
-			}
+	m_draw_list.Submit(RenderPass::GEOMETRY, RenderPass::BLENDED, begin_run, end_run);
 
-			pipeline->UpdatePerObjectConstants(obj->GetObjectData());
-			mesh->Render();
-		}
-	}
+	// The upscale blit, when the scene is drawn at a lower resolution
+	gpu_profiler.BeginZone("Renderer::BeginOverlay");
+	m_renderer.BeginOverlay();
+	gpu_profiler.EndZone();
+
+	m_draw_list.Submit(RenderPass::OVERLAY, RenderPass::OVERLAY, begin_run, end_run);
 
 	m_renderer.EndDraw();
 }
@@ -2,11 +2,18 @@
 
 module;
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
+#include <format>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
+#include <tuple>
+#include <typeinfo>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -14,46 +21,149 @@ module;
 export module Scene;
 
 import AssetPool;
+import AssetRegistry;
 import Camera;
 import ColorPipeline;
+import ConcurrentAssetPool;
+import DrawList;
+import DynamicFontAtlas;
 import FontAtlas;
+import GpuProfiler;
 import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
 import Input;
+import JobSystem;
 import LightsManager;
 import LightSourcePipeline;
 import Mesh;
+import MeshletCuller;
 import MeshManager;
 import RainbowTextPipeline;
 import ReflectionPipeline;
 import Renderer;
 import RenderObject;
+import ResolutionScaler;
 import SkyboxPipeline;
+import TextBatch;
+import TextLayout;
 import TextMesh;
 import TextPipeline;
+import TextView;
+import TransformStore;
 import Texture;
 import TexturePipeline;
+import TextureTable;
+import Trace;
+import TypedPipeline;
 import Vertex;
 
 template <typename Mesh, typename Pipeline>
 concept MeshIsCompatibleWithPipeline = std::same_as<typename Mesh::VertexT, typename Pipeline::VertexT>;
 
-template <typename Pipeline>
-concept PipelineHasObjectData = requires { typename Pipeline::ObjectData; };
-
 template <typename ObjectData, typename Pipeline>
-concept ObjectDataIsCompatibleWithPipeline = std::same_as<ObjectData, typename Pipeline::ObjectData>
-|| (!PipelineHasObjectData<Pipeline> && std::same_as<ObjectData, std::nullopt_t>);
+concept ObjectDataIsCompatibleWithPipeline = std::same_as<ObjectData, PipelineObjectDataT<Pipeline>>;
+
+// Objects with a model transform get sorted by depth, the others keep their creation order
+template <typename ObjectData>
+concept ObjectDataHasModel = requires (ObjectData const & object_data)
+{
+	{ object_data.model } -> std::convertible_to<glm::mat4>;
+};
+
+// Objects that sample the texture table get grouped by texture within their pipeline
+template <typename ObjectData>
+concept ObjectDataHasTextureIndex = requires (ObjectData const & object_data)
+{
+	{ object_data.texture_index } -> std::convertible_to<std::uint32_t>;
+};
+
+// Screen space lod selection, see Scene::select_lod
+export struct LodSelectionSettings
+{
+	float error_threshold_px = 1.0f; // the coarsest lod whose error covers fewer pixels is drawn
+	float hysteresis = 0.25f; // relative band around the threshold in which the lod doesn't change
+};
+
+struct MeshFile
+{
+	std::filesystem::path path;
+	bool generate_lods = false;
+	bool build_meshlets = false;
+};
+
+// What an object with a model transform draws this frame, worked out on the job system by Scene::update_draws
+struct ObjectCullResult
+{
+	float depth = 0.0f;
+	std::uint32_t lod = 0;
+	bool visible = true; // false if every meshlet was culled
+	std::vector<MeshIndexRange> ranges; // of the visible meshlets, empty to draw the whole lod
+	MeshletCullStats stats;
+};
+
+using TextureRegistry = AssetRegistry<AssetPool<Texture>>;
+using MeshRegistry = AssetRegistry<MeshManager>;
 
-// Keeps track of which render objects are using the associated pipeline,
-// this allows the render objects to be grouped by pipeline for more efficient rendering
-struct PipelineRenderObjects
+// A pipeline that has render objects and its slot in the scene's draw list
+struct PipelineDrawSlot
 {
 	AssetId pipeline_id;
-	std::vector<AssetId> render_object_ids;
+	std::uint32_t slot = 0;
+};
+
+// A render object with a record in the scene's draw list, the record is kept from frame to frame
+template <typename ObjectData>
+struct DrawnObject
+{
+	RenderObject<ObjectData> * object = nullptr; // pool pointers stay valid until the object is removed
+	Mesh const * mesh = nullptr; // nullptr if the object's mesh wasn't found, its record is hidden then
+	DrawHandle handle = InvalidDrawHandle;
+};
+
+// Pipelines and render objects are stored per pipeline type, so the draw loop of each type is compiled
+// with its concrete object data and its constants updates are inlined instead of going through a type-erased callback
+template <PipelineTraits Pipeline>
+struct PipelineSet
+{
+	AssetPool<TypedPipeline<Pipeline>> pipeline_pool;
+	AssetPool<RenderObject<PipelineObjectDataT<Pipeline>>> render_object_pool;
+	std::vector<PipelineDrawSlot> draw_slots;
+	std::vector<DrawnObject<PipelineObjectDataT<Pipeline>>> drawn_objects;
 };
 
+// The draw order of the pipeline types within a pass, see Scene::get_pipeline_slot
+using PipelineSets = std::tuple<
+	PipelineSet<ReflectionPipeline>,
+	PipelineSet<LightSourcePipeline>,
+	PipelineSet<TexturePipeline>,
+	PipelineSet<ColorPipeline>,
+	PipelineSet<SkyboxPipeline>,
+	PipelineSet<TextPipeline>,
+	PipelineSet<RainbowTextPipeline>>;
+
+template <PipelineTraits Pipeline, std::size_t Index = 0>
+constexpr std::uint32_t get_pipeline_set_index()
+{
+	if constexpr (std::same_as<std::tuple_element_t<Index, PipelineSets>, PipelineSet<Pipeline>>)
+		return static_cast<std::uint32_t>(Index);
+	else
+		return get_pipeline_set_index<Pipeline, Index + 1>();
+}
+
+// The draw list's pipeline sort orders are split evenly between the sets, see Scene::get_pipeline_slot
+constexpr std::uint32_t MaxPipelinesPerSet = DrawList::m_max_pipelines / std::tuple_size_v<PipelineSets>;
+
+// Pipelines that bind a single texture don't need it in the key
+template <typename ObjectData>
+std::uint32_t get_texture_index(RenderObject<ObjectData> const & obj)
+{
+	if constexpr (ObjectDataHasTextureIndex<ObjectData>)
+		return obj.GetObjectData()->texture_index;
+	else
+		return 0;
+}
+
 export class Scene
 {
 public:
@@ -63,16 +173,45 @@ public:
 	void OnDPIScalingFactorChanged(float dpi_scale_factor);
 
 	void Update(double delta_time, Input const & input);
-	void Render() const;
+	void Render();
+
+	// Timings are a few frames old, see GpuProfiler
+	GpuFrameTimings const & GetGpuTimings() const { return m_renderer.GetGpuProfiler().GetLatestTimings(); }
+
+	void SetLodSettings(LodSelectionSettings const & settings) { m_lod_settings = settings; }
 
 private:
 	template <IsVertex VertexT, typename... Args>
 	MeshId<VertexT> create_mesh(Args &&... args);
-
-	template <typename PipelineT, typename... Args>
-	PipelineT create_pipeline(Args &&... args);
-
-	template <IsVertex VertexT, typename Pipeline, typename ObjectData = std::nullopt_t>
+	// Meshes loaded from files go through the mesh registry, loading a file again returns the same mesh.
+	// The files are loaded in parallel on the job system's workers, the meshes are created on this thread.
+	template <IsVertex VertexT>
+	std::vector<MeshId<VertexT>> load_meshes(std::span<MeshFile const> files);
+
+	template <PipelineTraits PipelineT, typename... Args>
+	PipelineT create_pipeline(typename PipelineT::FrameData const & frame_data, Args &&... args);
+
+	template <PipelineTraits Pipeline>
+	PipelineSet<Pipeline> & get_pipeline_set() { return std::get<PipelineSet<Pipeline>>(m_pipeline_sets); }
+
+	// The slot of the pipeline in the draw list, added when it gets its first render object.
+	// DrawList::m_max_pipelines if the pipeline doesn't exist or there are too many.
+	template <PipelineTraits Pipeline>
+	std::uint32_t get_pipeline_slot(PipelineSet<Pipeline> & pipeline_set, AssetId pipeline_id);
+
+	// Patches the draw records of the set's render objects for the frame: the state of the objects whose mesh or
+	// pipeline changed, and the depth, lod and visible meshlets of the objects with a model transform
+	template <PipelineTraits Pipeline>
+	void update_draws(PipelineSet<Pipeline> & pipeline_set);
+	template <PipelineTraits Pipeline>
+	void update_draw_state(PipelineSet<Pipeline> & pipeline_set, DrawnObject<PipelineObjectDataT<Pipeline>> & drawn);
+	// Picks the object's lod and culls its meshlets, runs on the job system's workers
+	template <typename ObjectData>
+	void cull_object(RenderObject<ObjectData> & obj, Mesh const & mesh, ObjectCullResult & result) const;
+
+	std::uint32_t select_lod(Mesh const & mesh, glm::mat4 const & model, std::uint32_t prev_lod) const;
+
+	template <IsVertex VertexT, PipelineTraits Pipeline, typename ObjectData = std::nullopt_t>
 		requires MeshIsCompatibleWithPipeline<MeshId<VertexT>, Pipeline> && ObjectDataIsCompatibleWithPipeline<ObjectData, Pipeline>
 	AssetId create_render_object(
 		std::string const & name,
@@ -86,17 +225,21 @@ private:
 		bool flip_vertically = false,
 		bool use_mip_map = true);
 	AssetId create_cubemap_texture(std::array<std::filesystem::path, 6> const & filepaths);
+	// Returns the texture's index in the texture table, 0 if it couldn't be added
+	std::uint32_t add_to_texture_table(AssetId texture_id);
 
 	MeshId<PositionVertex> create_skybox_mesh();
 	MeshId<TextureVertex> create_ground_mesh();
 	std::vector<MeshId<ColorVertex>> create_tree_meshes();
 	std::unique_ptr<TextMesh> create_text_mesh(
 		std::string const & text,
-		FontAtlas const & font_atlas,
+		DynamicFontAtlas & font_atlas,
 		float font_size,
 		glm::vec2 origin,
-		int viewport_width,
-		int viewport_height);
+		TextStyle const & style);
+
+	// Writes the registered textures and meshes to the log view, largest first
+	void log_asset_memory();
 
 private:
 	GraphicsApi const & m_graphics_api;
@@ -104,20 +247,37 @@ private:
 	std::string const m_title;
 
 	Renderer m_renderer;
+	ResolutionScaler m_resolution_scaler; // scales the scene to hold 60 fps on the gpu
 	Camera m_camera;
 	LightsManager m_lights;
 
 	MeshManager m_mesh_manager;
-	AssetPool<GraphicsPipeline> m_pipeline_pool;
-	AssetPool<RenderObject> m_render_object_pool;
 	AssetPool<Texture> m_texture_pool;
+	TextureRegistry m_texture_registry;
+	MeshRegistry m_mesh_registry;
+	// The scene's references to what it loaded, released before the pools are destroyed
+	std::vector<TextureRegistry::Handle> m_texture_handles;
+	std::vector<MeshRegistry::Handle> m_mesh_handles;
+	TextureTable m_texture_table; // declared before the pipelines that reference it
+
+	PipelineSets m_pipeline_sets;
+	DrawList m_draw_list;
+
+	LodSelectionSettings m_lod_settings;
+	std::uint64_t m_submitted_triangles = 0; // visible in the draw list of the last frame
 
-	std::vector<PipelineRenderObjects> m_active_render_objects;
+	MeshletCuller m_meshlet_culler;
+	std::vector<ObjectCullResult> m_cull_results; // one per object of the set being updated, reused between sets
 
-	std::unique_ptr<FontAtlas> m_arial_font;
+	std::unique_ptr<FontAtlas> m_arial_font; // metrics, the glyphs are in m_arial_glyphs
+	std::unique_ptr<DynamicFontAtlas> m_arial_glyphs;
+	TextLayoutCache m_text_layout_cache;
+	TextBatch m_text_batch; // every label drawn with the TextPipeline
+	TextBatch m_rainbow_text_batch; // every label drawn with the RainbowTextPipeline
 
 	std::unique_ptr<TextMesh> m_fps_mesh;
 	std::unique_ptr<TextMesh> m_title_mesh;
+	std::unique_ptr<TextView> m_log_view; // a line of stats every second
 
 	ReflectionPipeline::ObjectData m_sword0;
 	ReflectionPipeline::ObjectData m_sword1;
@@ -125,13 +285,30 @@ private:
 	LightSourcePipeline::ObjectData m_green_gem;
 	LightSourcePipeline::ObjectData m_blue_gem;
 	TexturePipeline::ObjectData m_ground;
-	TextPipeline::ObjectData m_fps_label;
-	RainbowTextPipeline::ObjectData m_title_label;
+	RainbowTextPipeline::ObjectData m_rainbow_text;
 	ColorPipeline::ObjectData m_tree;
 
+	// Writes the model matrices of the object data above
+	TransformStore m_transforms;
+	std::array<TransformId, 2> m_sword_transforms{};
+	TransformId m_gem_ring_transform = 0; // parent of the gems, rotating it turns the ring
+
+	// Light indices in the LightsManager
+	std::array<std::uint32_t, 3> m_gem_lights{};
+	std::uint32_t m_first_swarm_light = 0;
+	std::uint32_t m_swarm_light_count = 0;
+
 	float m_timer = 0.0f;
 	float m_frame_timer = 0.0f;
 	int m_frame_count = 0;
+
+	// Heap allocations of the update thread, see AllocationCounter
+	std::uint64_t m_last_allocation_count = 0; // at the start of the last frame
+	std::uint64_t m_frame_allocation_count = 0; // of the frames since the fps label was updated
+	int m_allocating_frame_count = 0;
+
+	// Declared last so it's destroyed first: its workers are stopped before the members their jobs use are gone
+	JobSystem m_jobs;
 };
 
 template<IsVertex VertexT, typename... Args>
@@ -148,28 +325,99 @@ MeshId<VertexT> Scene::create_mesh(Args &&... args)
 	return mesh_id.value();
 }
 
-template <typename PipelineT, typename... Args>
-PipelineT Scene::create_pipeline(Args &&... args)
+template <IsVertex VertexT>
+std::vector<MeshId<VertexT>> Scene::load_meshes(std::span<MeshFile const> files)
 {
+	Trace::Zone zone{ "Scene::load_meshes" };
+
+	auto get_key = [](MeshFile const & file)
+		{
+			return MakeAssetKey(file.path, std::format("vertex={} lods={} meshlets={}",
+				typeid(VertexT).name(), file.generate_lods, file.build_meshlets));
+		};
+
+	auto keep_handle = [this](MeshRegistry::Handle mesh)
+		{
+			MeshId<VertexT> mesh_id{ mesh.GetId() };
+			if (mesh.IsValid())
+				m_mesh_handles.push_back(std::move(mesh));
+			return mesh_id;
+		};
+
+	std::vector<MeshId<VertexT>> mesh_ids(files.size());
+	ConcurrentAssetPool<MeshData<VertexT>> loaded_mesh_data; // added to by the workers, reclaimed when it goes
+	JobCounter counter;
+	for (std::size_t i = 0; i < files.size(); ++i)
+	{
+		if (MeshRegistry::Handle mesh = m_mesh_registry.Find(get_key(files[i])); mesh.IsValid())
+		{
+			mesh_ids[i] = keep_handle(std::move(mesh));
+			continue;
+		}
+
+		// The file is parsed and processed on a worker, which publishes the data to the pool. The mesh is then created
+		// from it on this thread since it uses the graphics api. Both jobs are counted, the second is added before the
+		// first finishes.
+		m_jobs.Run([&, i]
+			{
+				std::expected<MeshData<VertexT>, GraphicsError> mesh_data =
+					MeshManager::LoadMeshData<VertexT>(files[i].path, files[i].generate_lods, files[i].build_meshlets);
+				if (!mesh_data.has_value())
+				{
+					std::cout << "Failed to create mesh: " << mesh_data.error().GetMessage() << std::endl;
+					return;
+				}
+
+				AssetId mesh_data_id = loaded_mesh_data.Add(std::move(mesh_data.value()));
+				m_jobs.RunOnMainThread([&, i, mesh_data_id]
+					{
+						MeshRegistry::Handle mesh = m_mesh_registry.GetOrLoad(get_key(files[i]), [&]
+							{
+								MeshData<VertexT> * data = loaded_mesh_data.Get(mesh_data_id);
+								if (!data)
+								{
+									std::cout << "Failed to create mesh: too many meshes loaded at once" << std::endl;
+									return LoadedAsset{};
+								}
+
+								MeshId<VertexT> mesh_id = create_mesh<VertexT>(std::move(*data));
+								return LoadedAsset{ .id = mesh_id, .byte_size = m_mesh_manager.GetMeshSize(mesh_id) };
+							});
+						loaded_mesh_data.Remove(mesh_data_id);
+						mesh_ids[i] = keep_handle(std::move(mesh));
+					}, &counter);
+			}, &counter);
+	}
+	m_jobs.Wait(counter);
+
+	return mesh_ids;
+}
+
+template <PipelineTraits PipelineT, typename... Args>
+PipelineT Scene::create_pipeline(typename PipelineT::FrameData const & frame_data, Args &&... args)
+{
+	Trace::Zone zone{ "Scene::create_pipeline" };
+
 	std::filesystem::path shaders_path = m_resources_path / "shaders";
 
 	std::expected<GraphicsPipeline, GraphicsError> pipeline
 		= PipelineT::CreateGraphicsPipeline(m_graphics_api, shaders_path, std::forward<Args>(args)...);
 	if (!pipeline.has_value())
 	{
-		std::cout << "Failed to create " << typeid(PipelineT).name()
+		std::cout << "Failed to create " << PipelineT::Name
 			<< " Error: " << pipeline.error().GetMessage() << std::endl;
 		return PipelineT{};
 	}
 
-	AssetId pipeline_id = m_pipeline_pool.Add(std::move(pipeline.value()));
+	AssetId pipeline_id = get_pipeline_set<PipelineT>().pipeline_pool.Add(
+		TypedPipeline<PipelineT>{ std::move(pipeline.value()), frame_data });
 	if (!pipeline_id.IsValid())
 		std::cout << "Failed to add pipeline to pool." << std::endl;
 
 	return PipelineT{ pipeline_id };
 }
 
-template <IsVertex VertexT, typename Pipeline, typename ObjectData /*= std::nullopt_t*/>
+template <IsVertex VertexT, PipelineTraits Pipeline, typename ObjectData /*= std::nullopt_t*/>
 	requires MeshIsCompatibleWithPipeline<MeshId<VertexT>, Pipeline> && ObjectDataIsCompatibleWithPipeline<ObjectData, Pipeline>
 AssetId Scene::create_render_object(
 	std::string const & name,
@@ -188,22 +436,172 @@ AssetId Scene::create_render_object(
 		return AssetId{};
 	}
 
-	RenderObject obj{ name, mesh_id, pipeline.GetAssetId() };
+	PipelineSet<Pipeline> & pipeline_set = get_pipeline_set<Pipeline>();
+
+	RenderObject<ObjectData> obj{ mesh_id, pipeline.GetAssetId() };
 	if constexpr (!std::same_as<ObjectData, std::nullopt_t>)
 		obj.SetObjectData(&object_data);
 
-	AssetId obj_id = m_render_object_pool.Add(std::move(obj));
+	AssetId obj_id = pipeline_set.render_object_pool.Add(std::move(obj));
 	if (!obj_id.IsValid())
 	{
 		std::cout << "Failed to add render object to pool for object: " + name;
 		return obj_id;
 	}
 
-	auto iter = std::ranges::find(m_active_render_objects, pipeline.GetAssetId(), &PipelineRenderObjects::pipeline_id);
-	if (iter != m_active_render_objects.end())
-		iter->render_object_ids.push_back(obj_id);
-	else
-		m_active_render_objects.push_back(PipelineRenderObjects{ pipeline.GetAssetId(), { obj_id } });
+	// The object's draw record is created here and kept, update_draws only patches it
+	DrawnObject<ObjectData> drawn{
+		.object = pipeline_set.render_object_pool.Get(obj_id),
+		.mesh = m_mesh_manager.Get(mesh_id)
+	};
+	std::uint32_t const pipeline_slot = get_pipeline_slot(pipeline_set, pipeline.GetAssetId());
+	if (drawn.mesh)
+	{
+		drawn.handle = m_draw_list.Add(Pipeline::Pass, pipeline_slot, get_texture_index(*drawn.object),
+			mesh_id.GetIndex(), drawn.mesh, drawn.object->GetObjectData());
+	}
+	if (drawn.handle == InvalidDrawHandle)
+	{
+		std::cout << "Scene::create_render_object: no mesh or pipeline to draw object: " + name;
+		return obj_id;
+	}
+	pipeline_set.drawn_objects.push_back(drawn);
 
 	return obj_id;
 }
+
+template <PipelineTraits Pipeline>
+void draw_run(void const * pipeline, std::span<DrawRecord const> records, std::span<MeshIndexRange const> ranges)
+{
+	// Records of a run only ever get their pipeline slot from Scene::get_pipeline_slot<Pipeline>, so the casts are to the exact types
+	auto const & typed_pipeline = *static_cast<TypedPipeline<Pipeline> const *>(pipeline);
+
+	typed_pipeline.Activate();
+
+	for (DrawRecord const & record : records)
+	{
+		if (!record.visible)
+			continue;
+
+		if constexpr (PipelineHasObjectData<Pipeline>)
+			typed_pipeline.SetObjectData(*static_cast<PipelineObjectDataT<Pipeline> const *>(record.object_data));
+		if (record.range_count > 0)
+			record.mesh->Render(ranges.subspan(record.first_range, record.range_count));
+		else
+			record.mesh->Render(record.lod);
+	}
+}
+
+template <PipelineTraits Pipeline>
+std::uint32_t Scene::get_pipeline_slot(PipelineSet<Pipeline> & pipeline_set, AssetId pipeline_id)
+{
+	auto iter = std::ranges::find(pipeline_set.draw_slots, pipeline_id, &PipelineDrawSlot::pipeline_id);
+	if (iter != pipeline_set.draw_slots.end())
+		return iter->slot;
+
+	TypedPipeline<Pipeline> const * pipeline = pipeline_set.pipeline_pool.Get(pipeline_id);
+	if (!pipeline)
+	{
+		std::cout << "Scene::get_pipeline_slot: No pipeline found in pool for pipeline ID: " << pipeline_id.GetIndex() << std::endl;
+		return DrawList::m_max_pipelines;
+	}
+
+	// The sets are drawn in the order of PipelineSets, the pipelines of a set in the order they got their first object
+	std::uint32_t const index_in_set = static_cast<std::uint32_t>(pipeline_set.draw_slots.size());
+	std::uint32_t const slot = index_in_set < MaxPipelinesPerSet
+		? m_draw_list.AddPipeline(pipeline, &draw_run<Pipeline>, Pipeline::Name, get_pipeline_set_index<Pipeline>() * MaxPipelinesPerSet + index_in_set)
+		: DrawList::m_max_pipelines;
+	if (slot == DrawList::m_max_pipelines)
+	{
+		std::cout << "Scene::get_pipeline_slot: Too many pipelines in the draw list" << std::endl;
+		return slot;
+	}
+
+	pipeline_set.draw_slots.push_back(PipelineDrawSlot{ .pipeline_id = pipeline_id, .slot = slot });
+	return slot;
+}
+
+template <PipelineTraits Pipeline>
+void Scene::update_draw_state(PipelineSet<Pipeline> & pipeline_set, DrawnObject<PipelineObjectDataT<Pipeline>> & drawn)
+{
+	RenderObject<PipelineObjectDataT<Pipeline>> & obj = *drawn.object;
+	obj.ClearDrawDirty();
+
+	drawn.mesh = m_mesh_manager.Get(obj.GetMeshId());
+	std::uint32_t const pipeline_slot = get_pipeline_slot(pipeline_set, obj.GetPipelineId());
+	if (!drawn.mesh || pipeline_slot == DrawList::m_max_pipelines)
+	{
+		std::cout << "Scene::update_draw_state: No mesh or pipeline for render object with mesh ID: " << obj.GetMeshId().GetIndex() << std::endl;
+		drawn.mesh = nullptr;
+		m_draw_list.SetVisible(drawn.handle, false);
+		return;
+	}
+
+	m_draw_list.SetState(drawn.handle, pipeline_slot, get_texture_index(obj), obj.GetMeshId().GetIndex(), drawn.mesh);
+	m_draw_list.SetVisible(drawn.handle, true);
+}
+
+template <PipelineTraits Pipeline>
+void Scene::update_draws(PipelineSet<Pipeline> & pipeline_set)
+{
+	using ObjectData = PipelineObjectDataT<Pipeline>;
+
+	std::span<DrawnObject<ObjectData>> const objects = pipeline_set.drawn_objects;
+	for (DrawnObject<ObjectData> & drawn : objects)
+	{
+		if (drawn.object->IsDrawDirty())
+			update_draw_state(pipeline_set, drawn);
+	}
+
+	// What the others draw doesn't depend on the camera, their records stay as they are
+	if constexpr (ObjectDataHasModel<ObjectData>)
+	{
+		std::uint32_t const obj_count = static_cast<std::uint32_t>(objects.size());
+
+		// The objects are culled in parallel, each into its own result, and their records are then patched on this
+		// thread. The results only grow, so their ranges keep their capacity from frame to frame.
+		if (m_cull_results.size() < obj_count)
+			m_cull_results.resize(obj_count);
+
+		m_jobs.ParallelFor(obj_count, [&](std::uint32_t begin, std::uint32_t end)
+			{
+				for (std::uint32_t i = begin; i < end; ++i)
+				{
+					if (objects[i].mesh)
+						cull_object(*objects[i].object, *objects[i].mesh, m_cull_results[i]);
+				}
+			});
+
+		for (std::uint32_t i = 0; i < obj_count; ++i)
+		{
+			if (!objects[i].mesh)
+				continue;
+
+			ObjectCullResult const & result = m_cull_results[i];
+			DrawHandle const handle = objects[i].handle;
+			m_meshlet_culler.AddStats(result.stats);
+			m_draw_list.SetVisible(handle, result.visible);
+			if (!result.visible)
+				continue;
+
+			// Only a changed depth re-sorts the record's run
+			m_draw_list.SetDepth(handle, result.depth);
+			m_draw_list.SetLod(handle, result.lod, result.ranges);
+		}
+	}
+}
+
+template <typename ObjectData>
+void Scene::cull_object(RenderObject<ObjectData> & obj, Mesh const & mesh, ObjectCullResult & result) const
+{
+	glm::mat4 const & model = obj.GetObjectData()->model;
+	result.depth = m_camera.GetNormalizedDepth(glm::vec3{ model[3] });
+	result.lod = select_lod(mesh, model, obj.GetLod());
+	obj.SetLod(result.lod);
+
+	// Nothing is drawn if every meshlet is culled
+	result.ranges.clear();
+	result.stats = MeshletCullStats{};
+	result.visible = result.lod >= mesh.GetLodCount() || mesh.GetLod(result.lod).meshlet_count == 0
+		|| m_meshlet_culler.Cull(mesh.GetMeshlets(result.lod), model, result.ranges, result.stats) > 0;
+}
@@ -0,0 +1,52 @@
+// ShaderVariant.ixx
+
+module;
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+export module ShaderVariant;
+
+// Optional shader features, a shader that declares a feature (see features.glsl) compiles it out when it's disabled.
+// The index of a feature is its vulkan specialization constant id, opengl gets a SHADER_FEATURE_<name> define.
+export enum class ShaderFeature : std::uint32_t
+{
+	POINT_LIGHTS,
+	SPOT_LIGHTS,
+	FOG,
+
+	COUNT
+};
+
+export constexpr std::array<char const *, static_cast<std::size_t>(ShaderFeature::COUNT)> shader_feature_names{
+	"POINT_LIGHTS",
+	"SPOT_LIGHTS",
+	"FOG"
+};
+
+// The set of enabled features a shader is loaded with, see PipelineBuilder::LoadShaders
+export class ShaderVariant
+{
+public:
+	constexpr ShaderVariant() = default;
+	constexpr ShaderVariant(std::initializer_list<ShaderFeature> features)
+	{
+		for (ShaderFeature feature : features)
+			Enable(feature);
+	}
+
+	constexpr void Enable(ShaderFeature feature) { m_features |= get_bit(feature); }
+	constexpr void Disable(ShaderFeature feature) { m_features &= ~get_bit(feature); }
+	constexpr bool Has(ShaderFeature feature) const { return (m_features & get_bit(feature)) != 0; }
+
+	constexpr std::uint32_t GetKey() const { return m_features; }
+
+	bool operator==(ShaderVariant const & other) const = default;
+
+private:
+	constexpr static std::uint32_t get_bit(ShaderFeature feature) { return 1u << static_cast<std::uint32_t>(feature); }
+
+	std::uint32_t m_features = 0;
+};
@@ -13,22 +13,30 @@ import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
 import PipelineBuilder;
-import RenderObject;
 import Texture;
+import TypedPipeline;
 import Vertex;
 
 export class SkyboxPipeline
 {
 public:
 	using VertexT = PositionVertex;
+	constexpr static char const * Name = "SkyboxPipeline";
+	constexpr static RenderPass Pass = RenderPass::SKYBOX;
+
+	struct FrameData
+	{
+		Camera const * camera = nullptr;
+	};
 
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
 		GraphicsApi const & graphics_api,
 		std::filesystem::path const & shaders_path,
-		Camera const & camera,
 		AssetPool<Texture> const & texture_pool,
 		AssetId texture_id);
 
+	static void UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data);
+
 	SkyboxPipeline() = default;
 	explicit SkyboxPipeline(AssetId asset_id) : m_asset_id(asset_id) {}
 
@@ -41,7 +49,6 @@ private:
 std::expected<GraphicsPipeline, GraphicsError> SkyboxPipeline::CreateGraphicsPipeline(
 	GraphicsApi const & graphics_api,
 	std::filesystem::path const & shaders_path,
-	Camera const & camera,
 	AssetPool<Texture> const & texture_pool,
 	AssetId texture_id)
 {
@@ -67,11 +74,10 @@ std::expected<GraphicsPipeline, GraphicsError> SkyboxPipeline::CreateGraphicsPip
 		});
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerFrameConstantsCallback(
-		[&camera](GraphicsPipeline const & pipeline)
-		{
-			pipeline.SetUniform(0 /*binding*/, camera.GetViewProjUniform());
-		});
-
 	return builder.CreatePipeline();
 }
+
+inline void SkyboxPipeline::UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data)
+{
+	pipeline.SetUniform(0 /*binding*/, frame_data.camera->GetViewProjUniform());
+}
@@ -10,6 +10,8 @@ module;
 
 export module StbImage;
 
+import Trace;
+
 export class StbImage
 {
 public:
@@ -56,6 +58,8 @@ void StbImage::LoadImage(std::filesystem::path const & filepath, int req_comp, b
 {
 	static_assert(std::same_as<stbi_uc, unsigned char>);
 
+	Trace::Zone zone{ "StbImage::LoadImage" };
+
 	free_image();
 
 	if (req_comp < 1)
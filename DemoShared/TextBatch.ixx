@@ -0,0 +1,265 @@
+// TextBatch.ixx
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <expected>
+#include <iostream>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module TextBatch;
+
+import FrameArena;
+import GraphicsApi;
+import GraphicsError;
+import Mesh;
+import MeshManager;
+import Trace;
+import Vertex;
+
+// Anything that lays out glyphs for a batch, e.g. TextMesh or TextView
+export template <typename T>
+concept GlyphSource = requires (T const & source)
+{
+	{ source.GetInstances() } -> std::convertible_to<std::span<GlyphInstance const>>;
+	{ source.GetVersion() } -> std::convertible_to<std::uint64_t>;
+};
+
+// Packs the glyphs of many labels into one dynamic instance buffer (see Mesh::CreateDynamic), so all the text that
+// shares a font atlas and a pipeline is a single render object and a single instanced draw of one quad.
+// Every frame in flight has its own copy of the instances, each copy remembers which instances it is missing and
+// Upload catches up the copy of the frame being recorded. The labels aren't owned and must outlive the batch.
+export class TextBatch
+{
+public:
+	using VertexT = GlyphInstance;
+
+	// A batch whose min and max capacity are the same is a fixed buffer that's allocated once
+	explicit TextBatch(
+		GraphicsApi const & graphics_api,
+		MeshManager & mesh_manager,
+		std::uint32_t min_instance_capacity = 256,
+		std::uint32_t max_instance_capacity = std::uint32_t{ 1 } << 20);
+
+	TextBatch(TextBatch const &) = delete;
+	TextBatch & operator=(TextBatch const &) = delete;
+
+	template <GlyphSource SourceT>
+	void Add(SourceT const & source);
+	void Remove(void const * source);
+
+	// Repacks the labels that changed and writes the instances the current frame's copy is missing,
+	// call it once per frame while the frame is recorded
+	void Upload();
+
+	MeshId<VertexT> GetMeshId() const { return m_mesh_id; }
+	std::uint32_t GetInstanceCount() const { return static_cast<std::uint32_t>(m_instances.size()); }
+
+private:
+	using GetInstancesFn = std::span<GlyphInstance const> (*)(void const * source);
+	using GetVersionFn = std::uint64_t (*)(void const * source);
+
+	struct Entry
+	{
+		void const * source = nullptr;
+		GetInstancesFn get_instances = nullptr;
+		GetVersionFn get_version = nullptr;
+		std::uint64_t version = 0; // of the source when it was packed
+	};
+
+	struct InstanceRange
+	{
+		std::uint32_t begin = 0;
+		std::uint32_t end = 0;
+
+		bool IsEmpty() const { return begin >= end; }
+	};
+
+	constexpr static std::uint32_t m_indices_per_quad = 6;
+
+	void pack();
+	std::expected<void, GraphicsError> reserve(std::uint32_t instance_count);
+
+	GraphicsApi const & m_graphics_api;
+	MeshManager & m_mesh_manager;
+	MeshId<VertexT> m_mesh_id;
+	std::uint32_t m_min_instance_capacity = 0;
+	std::uint32_t m_max_instance_capacity = 0;
+
+	std::vector<Entry> m_entries;
+	bool m_entries_changed = false;
+
+	std::vector<VertexT> m_instances; // of all the labels, in the order they were added
+	std::uint32_t m_instance_capacity = 0;
+	std::array<InstanceRange, GraphicsApi::m_max_frames_in_flight> m_stale_instances; // per copy of the instances
+};
+
+TextBatch::TextBatch(
+	GraphicsApi const & graphics_api,
+	MeshManager & mesh_manager,
+	std::uint32_t min_instance_capacity /*= 256*/,
+	std::uint32_t max_instance_capacity /*= std::uint32_t{ 1 } << 20*/)
+	: m_graphics_api(graphics_api)
+	, m_mesh_manager(mesh_manager)
+	, m_min_instance_capacity(std::max(min_instance_capacity, 1u))
+	, m_max_instance_capacity(std::max(max_instance_capacity, m_min_instance_capacity))
+{
+	std::expected<void, GraphicsError> result = reserve(m_min_instance_capacity);
+	if (!result.has_value())
+		std::cout << "TextBatch::TextBatch: " << result.error().GetMessage() << std::endl;
+}
+
+template <GlyphSource SourceT>
+void TextBatch::Add(SourceT const & source)
+{
+	m_entries.push_back(Entry{
+		.source = &source,
+		.get_instances = [](void const * source) -> std::span<GlyphInstance const>
+			{
+				return static_cast<SourceT const *>(source)->GetInstances();
+			},
+		.get_version = [](void const * source) -> std::uint64_t
+			{
+				return static_cast<SourceT const *>(source)->GetVersion();
+			},
+		.version = source.GetVersion()
+		});
+	m_entries_changed = true;
+}
+
+void TextBatch::Remove(void const * source)
+{
+	if (std::erase_if(m_entries, [&](Entry const & entry) { return entry.source == source; }) > 0)
+		m_entries_changed = true;
+}
+
+// Grows the mesh to fit instance_count instances. The new mesh replaces the old one in the pool, so the render object
+// keeps its mesh id, and it has none of the instances yet so every copy is stale. Growing is rare and waits for
+// the gpu on vulkan (the index buffer goes through a staging copy), so the old mesh is no longer in use.
+std::expected<void, GraphicsError> TextBatch::reserve(std::uint32_t instance_count)
+{
+	if (m_mesh_id.IsValid() && instance_count <= m_instance_capacity)
+		return {};
+
+	if (instance_count > m_max_instance_capacity)
+		return std::unexpected{ GraphicsError{ "TextBatch::reserve: Too many glyphs: " + std::to_string(instance_count) } };
+
+	Trace::Zone zone{ "TextBatch::reserve" };
+
+	std::uint32_t capacity = std::max(m_instance_capacity, m_min_instance_capacity);
+	while (capacity < instance_count)
+		capacity *= 2;
+	capacity = std::min(capacity, m_max_instance_capacity);
+
+	// The corners of one quad, the vertex shader takes them from the vertex index, see msdf_text.vert
+	std::vector<Mesh::IndexT> const indices{ 1, 0, 2, 1, 2, 3 };
+
+	Mesh mesh{ m_graphics_api };
+	std::expected<void, GraphicsError> result = mesh.CreateDynamic<VertexT>(capacity, indices);
+	if (!result.has_value())
+		return std::unexpected{ result.error().AddToMessage(" TextBatch::reserve: Failed to create mesh.") };
+
+	if (Mesh * old_mesh = m_mesh_manager.Get(m_mesh_id))
+	{
+		*old_mesh = std::move(mesh);
+	}
+	else
+	{
+		std::expected<MeshId<VertexT>, GraphicsError> mesh_id = m_mesh_manager.AddMesh<VertexT>(std::move(mesh));
+		if (!mesh_id.has_value())
+			return std::unexpected{ mesh_id.error().AddToMessage(" TextBatch::reserve: Failed to add mesh.") };
+		m_mesh_id = mesh_id.value();
+	}
+
+	m_instance_capacity = capacity;
+	m_stale_instances.fill(InstanceRange{ .begin = 0, .end = capacity });
+	return {};
+}
+
+void TextBatch::pack()
+{
+	bool changed = std::exchange(m_entries_changed, false);
+	for (Entry const & entry : m_entries)
+		changed = changed || entry.version != entry.get_version(entry.source);
+	if (!changed)
+		return;
+
+	Trace::Zone zone{ "TextBatch::pack" };
+
+	// Packed in the frame arena and copied into m_instances at the end, which keeps its capacity between packs
+	std::pmr::vector<VertexT> instances{ FrameArena::GetResource() };
+	instances.reserve(m_instances.size());
+	for (Entry & entry : m_entries)
+	{
+		std::span<GlyphInstance const> source_instances = entry.get_instances(entry.source);
+		instances.insert(instances.end(), source_instances.begin(), source_instances.end());
+		entry.version = entry.get_version(entry.source);
+	}
+
+	std::expected<void, GraphicsError> result = reserve(static_cast<std::uint32_t>(instances.size()));
+	if (!result.has_value())
+	{
+		std::cout << "TextBatch::pack: " << result.error().GetMessage() << std::endl;
+		instances.resize(std::min<std::size_t>(instances.size(), m_instance_capacity));
+	}
+
+	// Instances past the new end aren't drawn, so only the ones that changed or were added have to be written.
+	// A label that changes in the middle of the batch keeps the ones before it, and after it too if its glyph
+	// count didn't change.
+	auto same_instance = [](VertexT const & a, VertexT const & b)
+		{
+			return a.rect == b.rect && a.uv_rect == b.uv_rect && a.color == b.color && a.bg_color == b.bg_color && a.params == b.params;
+		};
+	std::size_t const common_count = std::min(instances.size(), m_instances.size());
+	std::size_t first_changed = 0;
+	while (first_changed < common_count && same_instance(instances[first_changed], m_instances[first_changed]))
+		++first_changed;
+	std::size_t last_changed = instances.size();
+	if (instances.size() <= m_instances.size())
+	{
+		while (last_changed > first_changed && same_instance(instances[last_changed - 1], m_instances[last_changed - 1]))
+			--last_changed;
+	}
+
+	if (first_changed < last_changed)
+	{
+		InstanceRange const changed{
+			.begin = static_cast<std::uint32_t>(first_changed),
+			.end = static_cast<std::uint32_t>(last_changed)
+		};
+		for (InstanceRange & stale : m_stale_instances)
+		{
+			stale = stale.IsEmpty()
+				? changed
+				: InstanceRange{ .begin = std::min(stale.begin, changed.begin), .end = std::max(stale.end, changed.end) };
+		}
+	}
+
+	m_instances.assign(instances.begin(), instances.end());
+}
+
+void TextBatch::Upload()
+{
+	pack();
+
+	Mesh * mesh = m_mesh_manager.Get(m_mesh_id);
+	if (!mesh)
+		return;
+
+	std::uint32_t const instance_count = static_cast<std::uint32_t>(m_instances.size());
+	InstanceRange & stale = m_stale_instances[m_graphics_api.GetCurFrameIndex()];
+	stale.end = std::min(stale.end, instance_count);
+	if (!stale.IsEmpty())
+		mesh->WriteVertices(std::span<VertexT const>{ m_instances }.subspan(stale.begin, stale.end - stale.begin), stale.begin);
+	stale = InstanceRange{};
+
+	mesh->SetIndexCount(m_indices_per_quad);
+	mesh->SetInstanceCount(instance_count);
+}
@@ -0,0 +1,271 @@
+// TextLayout.cpp
+
+module;
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+module TextLayout;
+
+import FrameArena;
+import Trace;
+
+namespace
+{
+	constexpr std::uint32_t ReplacementCharacter = 0xFFFD;
+
+	std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value)
+	{
+		return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+	}
+
+	struct Line
+	{
+		std::size_t first_glyph = 0;
+		std::size_t end_glyph = 0;
+		float width = 0.0f; // up to the end of the last glyph's advance, trailing spaces excluded
+	};
+}
+
+std::pmr::vector<std::uint32_t> TextLayout::DecodeUtf8(
+	std::string_view text,
+	std::pmr::memory_resource * resource /*= std::pmr::get_default_resource()*/)
+{
+	std::pmr::vector<std::uint32_t> codepoints{ resource };
+	codepoints.reserve(text.size());
+
+	std::size_t i = 0;
+	while (i < text.size())
+	{
+		std::uint8_t const lead = static_cast<std::uint8_t>(text[i]);
+		if (lead < 0x80)
+		{
+			codepoints.push_back(lead);
+			++i;
+			continue;
+		}
+
+		std::size_t length = 0;
+		std::uint32_t codepoint = 0;
+		std::uint32_t min_codepoint = 0; // rejects overlong encodings
+		if ((lead & 0xE0) == 0xC0)
+		{
+			length = 2;
+			codepoint = lead & 0x1F;
+			min_codepoint = 0x80;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			length = 3;
+			codepoint = lead & 0x0F;
+			min_codepoint = 0x800;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			length = 4;
+			codepoint = lead & 0x07;
+			min_codepoint = 0x10000;
+		}
+
+		// A bad sequence only consumes its lead byte, so the next valid character is still found
+		std::size_t continuation = 1;
+		while (length != 0 && continuation < length && i + continuation < text.size()
+			&& (static_cast<std::uint8_t>(text[i + continuation]) & 0xC0) == 0x80)
+		{
+			codepoint = (codepoint << 6) | (static_cast<std::uint8_t>(text[i + continuation]) & 0x3F);
+			++continuation;
+		}
+
+		bool const valid = length != 0 && continuation == length && codepoint >= min_codepoint && codepoint <= 0x10FFFF
+			&& (codepoint < 0xD800 || codepoint > 0xDFFF);
+		codepoints.push_back(valid ? codepoint : ReplacementCharacter);
+		i += valid ? length : 1;
+	}
+
+	return codepoints;
+}
+
+void TextLayout::Layout(
+	std::string_view text,
+	FontAtlas const & font_atlas,
+	float font_size,
+	TextLayoutOptions const & options,
+	GlyphRun & out_run)
+{
+	out_run.glyphs.clear();
+	out_run.size = glm::vec2{ 0.0f };
+	out_run.line_count = 0;
+
+	// Scratch of this layout only, the glyphs are written to the run
+	std::pmr::vector<Line> lines{ FrameArena::GetResource() };
+	Line line;
+	float pen_x = 0.0f;
+	std::uint32_t prev_codepoint = 0; // for kerning, 0 at the start of a line
+
+	// Where the line can be broken: the first glyph after the last space and the pen and line width at that point
+	std::size_t break_glyph = 0;
+	float break_pen_x = 0.0f;
+	float break_width = 0.0f;
+	bool has_break = false;
+
+	auto end_line = [&](std::size_t end_glyph, float width)
+		{
+			line.end_glyph = end_glyph;
+			line.width = width;
+			lines.push_back(line);
+			line = Line{ .first_glyph = end_glyph };
+			prev_codepoint = 0;
+			has_break = false;
+		};
+
+	for (std::uint32_t codepoint : DecodeUtf8(text, FrameArena::GetResource()))
+	{
+		if (codepoint == '\n')
+		{
+			end_line(out_run.glyphs.size(), line.width);
+			pen_x = 0.0f;
+			continue;
+		}
+
+		auto glyph = font_atlas.GetGlyph(codepoint);
+		if (!glyph.has_value())
+			glyph = font_atlas.GetGlyph(ReplacementCharacter);
+		if (!glyph.has_value())
+			glyph = font_atlas.GetGlyph('?');
+		if (!glyph.has_value())
+			continue; // nothing to draw it with
+
+		FontAtlas::Glyph const & g = glyph.value();
+		if (prev_codepoint != 0)
+			pen_x += font_atlas.GetKerning(prev_codepoint, g.unicode) * font_size;
+		prev_codepoint = g.unicode;
+
+		float const advance = g.advance * font_size;
+
+		// Whitespace doesn't need a quad, but it is where lines are broken
+		if (!g.plane_bounds.has_value() || !g.atlas_bounds.has_value())
+		{
+			if (codepoint == ' ' || codepoint == '\t')
+			{
+				break_glyph = out_run.glyphs.size();
+				break_width = line.width;
+				break_pen_x = pen_x + advance;
+				has_break = true;
+			}
+			pen_x += advance;
+			continue;
+		}
+
+		// The glyph doesn't fit, move the glyphs after the last space to a new line. A word wider than the whole
+		// line stays on its own line.
+		if (options.max_width > 0.0f && pen_x + advance > options.max_width && has_break && break_glyph > line.first_glyph)
+		{
+			std::size_t const moved_first = break_glyph;
+			float const shift = break_pen_x;
+			end_line(moved_first, break_width);
+			for (std::size_t i = moved_first; i < out_run.glyphs.size(); ++i)
+				out_run.glyphs[i].pos.x -= shift;
+			pen_x -= shift;
+			line.width = pen_x;
+		}
+
+		out_run.glyphs.push_back(PositionedGlyph{ .glyph = &g, .pos = glm::vec2{ pen_x, 0.0f } });
+		pen_x += advance;
+		line.width = pen_x;
+	}
+	end_line(out_run.glyphs.size(), line.width);
+
+	float max_line_width = 0.0f;
+	for (Line const & l : lines)
+		max_line_width = std::max(max_line_width, l.width);
+	float const box_width = options.max_width > 0.0f ? options.max_width : max_line_width;
+	float const line_height = font_atlas.GetLineHeight() * font_size;
+
+	for (std::size_t line_index = 0; line_index < lines.size(); ++line_index)
+	{
+		Line const & l = lines[line_index];
+		float offset = 0.0f;
+		if (options.align == TextAlign::Center)
+			offset = (box_width - l.width) * 0.5f;
+		else if (options.align == TextAlign::Right)
+			offset = box_width - l.width;
+
+		for (std::size_t i = l.first_glyph; i < l.end_glyph; ++i)
+		{
+			out_run.glyphs[i].pos.x += offset;
+			out_run.glyphs[i].pos.y = -static_cast<float>(line_index) * line_height;
+		}
+	}
+
+	out_run.line_count = static_cast<std::uint32_t>(lines.size());
+	out_run.size = glm::vec2{ max_line_width, out_run.line_count * line_height };
+}
+
+GlyphRun const & TextLayoutCache::Layout(
+	std::string_view text,
+	FontAtlas const & font_atlas,
+	float font_size,
+	TextLayoutOptions const & options /*= {}*/)
+{
+	std::uint64_t hash = std::hash<std::string_view>{}(text);
+	hash = hash_combine(hash, std::hash<FontAtlas const *>{}(&font_atlas));
+	hash = hash_combine(hash, std::bit_cast<std::uint32_t>(font_size));
+	hash = hash_combine(hash, std::bit_cast<std::uint32_t>(options.max_width));
+	hash = hash_combine(hash, static_cast<std::uint64_t>(options.align));
+
+	auto it = m_lookup.find(hash);
+	if (it != m_lookup.end())
+	{
+		Entry & entry = *it->second;
+		if (entry.text == text && entry.font_atlas == &font_atlas && entry.font_size == font_size && entry.options == options)
+		{
+			++m_stats.hit_count;
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			return entry.run;
+		}
+	}
+
+	Trace::Zone zone{ "TextLayoutCache::Layout miss" };
+	auto begin = std::chrono::steady_clock::now();
+	++m_stats.miss_count;
+
+	// A colliding entry is replaced, otherwise the least recently used one is reused once the cache is full
+	std::list<Entry>::iterator entry_it;
+	if (it != m_lookup.end())
+	{
+		entry_it = it->second;
+	}
+	else if (m_entries.size() >= std::max<std::size_t>(m_capacity, 1))
+	{
+		entry_it = std::prev(m_entries.end());
+		m_lookup.erase(entry_it->hash);
+	}
+	else
+	{
+		entry_it = m_entries.emplace(m_entries.end());
+	}
+	m_entries.splice(m_entries.begin(), m_entries, entry_it);
+
+	Entry & entry = *entry_it;
+	entry.hash = hash;
+	entry.text.assign(text);
+	entry.font_atlas = &font_atlas;
+	entry.font_size = font_size;
+	entry.options = options;
+	TextLayout::Layout(text, font_atlas, font_size, options, entry.run);
+	m_lookup[hash] = entry_it;
+
+	m_stats.layout_ms += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	return entry.run;
+}
@@ -0,0 +1,109 @@
+// TextLayout.ixx
+
+module;
+
+#include <cstdint>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+export module TextLayout;
+
+import FontAtlas;
+
+export enum class TextAlign
+{
+	Left,
+	Center,
+	Right,
+};
+
+export struct TextLayoutOptions
+{
+	float max_width = 0.0f; // in pixels, lines are broken at spaces to fit, 0 to only break at '\n'
+	TextAlign align = TextAlign::Left;
+
+	bool operator==(TextLayoutOptions const & other) const = default;
+};
+
+export struct PositionedGlyph
+{
+	FontAtlas::Glyph const * glyph = nullptr; // only glyphs with bounds, whitespace just moves the pen
+	glm::vec2 pos{ 0.0f }; // of the glyph's origin on its baseline, in pixels from the first baseline, y up
+};
+
+export struct GlyphRun
+{
+	std::vector<PositionedGlyph> glyphs;
+	glm::vec2 size{ 0.0f }; // width of the widest line and height of all the lines, in pixels
+	std::uint32_t line_count = 0;
+};
+
+export struct TextLayoutStats
+{
+	std::uint64_t hit_count = 0;
+	std::uint64_t miss_count = 0;
+	float layout_ms = 0.0f; // spent laying out the misses
+
+	float GetHitRate() const
+	{
+		std::uint64_t const count = hit_count + miss_count;
+		return count > 0 ? static_cast<float>(hit_count) / static_cast<float>(count) : 0.0f;
+	}
+};
+
+// Lays out UTF-8 text with a font atlas: decodes the codepoints, applies the atlas' kerning pairs, breaks lines
+// and aligns them. The positioned glyphs are kept in an LRU cache keyed by the hash of the text, the font, the size
+// and the options, so text that cycles through a few values, like counters, is only laid out the first time.
+export class TextLayoutCache
+{
+public:
+	explicit TextLayoutCache(std::size_t capacity = 256) : m_capacity(capacity) {}
+
+	TextLayoutCache(TextLayoutCache const &) = delete;
+	TextLayoutCache & operator=(TextLayoutCache const &) = delete;
+
+	// The run stays valid until the next call to Layout
+	GlyphRun const & Layout(std::string_view text, FontAtlas const & font_atlas, float font_size, TextLayoutOptions const & options = {});
+
+	// Accumulated since the last ResetStats
+	TextLayoutStats const & GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = TextLayoutStats{}; }
+
+private:
+	struct Entry
+	{
+		std::uint64_t hash = 0;
+		std::string text; // the hash can collide, so hits are checked against the rest of the key
+		FontAtlas const * font_atlas = nullptr;
+		float font_size = 0.0f;
+		TextLayoutOptions options;
+		GlyphRun run;
+	};
+
+	std::size_t m_capacity = 0;
+	std::list<Entry> m_entries; // most recently used first
+	std::unordered_map<std::uint64_t, std::list<Entry>::iterator> m_lookup;
+	TextLayoutStats m_stats;
+};
+
+export namespace TextLayout
+{
+	// Decodes the codepoints of UTF-8 text, invalid sequences become U+FFFD
+	std::pmr::vector<std::uint32_t> DecodeUtf8(
+		std::string_view text,
+		std::pmr::memory_resource * resource = std::pmr::get_default_resource());
+
+	// Lays out the text without caching
+	void Layout(
+		std::string_view text,
+		FontAtlas const & font_atlas,
+		float font_size,
+		TextLayoutOptions const & options,
+		GlyphRun & out_run);
+}
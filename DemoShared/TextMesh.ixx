@@ -2,172 +2,194 @@
 
 module;
 
-#include <expected>
-#include <functional>
-#include <iostream>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <glm/glm.hpp>
 
 export module TextMesh;
 
-import AssetPool;
+import DynamicFontAtlas;
 import FontAtlas;
 import GraphicsApi;
-import GraphicsError;
-import Mesh;
-import MeshManager;
-import Renderer;
+import TextLayout;
+import Trace;
 import Vertex;
 
+// How a string is drawn, the same for all of its glyphs
+export struct TextStyle
+{
+	glm::vec4 color = glm::vec4(1.0f);
+	glm::vec4 bg_color = glm::vec4(0.0f);
+	glm::vec3 effect_params = glm::vec3(0.0f); // params.yzw of the glyph instances, see the pipeline's fragment shader
+};
+
+// Screen space text laid out as one GlyphInstance per visible glyph, see TextLayoutCache for the layout.
+// It doesn't own any gpu memory, the instances of every label drawn with the same font and pipeline are packed into
+// one buffer by a TextBatch. The instances are only rebuilt when the text, its layout, its style or the glyphs in the
+// atlas change, which bumps the version. Glyphs that are still pending in the atlas are left out until they arrive.
 export class TextMesh
 {
 public:
-	using VertexT = Texture2dVertex;
-
-	using UpdateMeshCallbackT = std::function<void(AssetId, Mesh)>;
-
 	explicit TextMesh(
 		GraphicsApi const & graphics_api,
+		TextLayoutCache & layout_cache,
 		std::string const & text,
-		FontAtlas const & font_atlas,
-		std::uint32_t font_tex_width,
-		std::uint32_t font_tex_height,
+		DynamicFontAtlas & font_atlas,
 		float font_size,
 		glm::vec2 origin,
 		int viewport_width,
-		int viewport_height);
+		int viewport_height,
+		TextStyle const & style = TextStyle{},
+		TextLayoutOptions const & layout_options = TextLayoutOptions{});
 
-	std::expected<Mesh, GraphicsError> CreateMesh() const;
+	TextMesh(TextMesh const &) = delete;
+	TextMesh & operator=(TextMesh const &) = delete;
 
 	void OnViewportResized(int width, int height);
 
-	void SetText(std::string const & text);
-	void SetFontSize(float font_size);
+	// Keeps the glyphs resident in the atlas and picks up the ones that arrived, call it once per frame after the
+	// atlas' Update
+	void Refresh();
 
-	void SetUpdateMeshCallback(UpdateMeshCallbackT const & callback) { m_update_mesh_callback = callback; }
+	void SetText(std::string_view text);
+	void SetFontSize(float font_size);
+	void SetStyle(TextStyle const & style);
+	void SetLayoutOptions(TextLayoutOptions const & layout_options);
+	void SetVisible(bool visible);
 
-	void SetMeshId(MeshId<VertexT> mesh_id) { m_mesh_id = mesh_id; }
-	MeshId<VertexT> GetMeshId() const { return m_mesh_id; }
+	TextStyle const & GetStyle() const { return m_style; }
+	bool IsVisible() const { return m_visible; }
 
-	float GetScreenPxRange() const { return m_screen_px_range; }
+	// Empty while the label is hidden
+	std::span<GlyphInstance const> GetInstances() const;
+	// Changes whenever the instances do
+	std::uint64_t GetVersion() const { return m_version; }
 
 private:
+	void update_instances();
+
 	GraphicsApi const & m_graphics_api;
-	MeshId<VertexT> m_mesh_id;
-	UpdateMeshCallbackT m_update_mesh_callback;
+	TextLayoutCache & m_layout_cache;
 
 	std::string m_text;
-	FontAtlas const & m_font_atlas;
-	std::uint32_t m_font_tex_width = 0;
-	std::uint32_t m_font_tex_height = 0;
+	DynamicFontAtlas & m_font_atlas;
+	std::uint64_t m_atlas_generation = 0; // when the instances were built
+	std::vector<std::uint32_t> m_glyphs; // unicodes of the laid out glyphs, to touch them in the atlas
 	float m_font_size = 0.0f;
-	float m_screen_px_range = 0.0f;
 	glm::vec2 m_origin;
+	TextStyle m_style;
+	TextLayoutOptions m_layout_options;
+	bool m_visible = true;
 
 	int m_viewport_width = 0;
 	int m_viewport_height = 0;
+
+	std::vector<GlyphInstance> m_instances;
+	std::uint64_t m_version = 0;
 };
 
 TextMesh::TextMesh(
 	GraphicsApi const & graphics_api,
+	TextLayoutCache & layout_cache,
 	std::string const & text,
-	FontAtlas const & font_atlas,
-	std::uint32_t font_tex_width,
-	std::uint32_t font_tex_height,
+	DynamicFontAtlas & font_atlas,
 	float font_size,
 	glm::vec2 origin,
 	int viewport_width,
-	int viewport_height)
+	int viewport_height,
+	TextStyle const & style /*= TextStyle{}*/,
+	TextLayoutOptions const & layout_options /*= TextLayoutOptions{}*/)
 	: m_graphics_api(graphics_api)
+	, m_layout_cache(layout_cache)
 	, m_text(text)
 	, m_font_atlas(font_atlas)
-	, m_font_tex_width(font_tex_width)
-	, m_font_tex_height(font_tex_height)
 	, m_font_size(font_size)
-	, m_screen_px_range(font_size * font_atlas.GetPxRange())
 	, m_origin(origin)
+	, m_style(style)
+	, m_layout_options(layout_options)
 	, m_viewport_width(viewport_width)
 	, m_viewport_height(viewport_height)
 {
+	update_instances();
 }
 
-std::expected<Mesh, GraphicsError> TextMesh::CreateMesh() const
+std::span<GlyphInstance const> TextMesh::GetInstances() const
 {
-	if (m_font_tex_width == 0 || m_font_tex_height == 0
-		|| m_viewport_width == 0 || m_viewport_height == 0
-		|| m_text.empty())
-	{
-		return Mesh{ m_graphics_api }; // an empty mesh is an expected result here
-	}
-
-	std::vector<VertexT> verts;
-	std::vector<Mesh::IndexT> indices;
+	if (!m_visible)
+		return {};
+	return m_instances;
+}
 
-	// convert font size to screen coordinates -1 to 1
-	float height_scale = m_font_size * (2.0f / m_viewport_height);
-	float width_scale = m_font_size * (2.0f / m_viewport_width);
+void TextMesh::update_instances()
+{
+	Trace::Zone zone{ "TextMesh::update_instances" };
 
-	glm::vec2 pen = m_origin;
-	for (char c : m_text)
-	{
-		auto glyph = m_font_atlas.GetGlyph(static_cast<std::uint32_t>(c));
-		if (!glyph.has_value())
-			continue; // skip missing glyphs
+	++m_version;
+	m_instances.clear();
+	m_glyphs.clear();
+	m_atlas_generation = m_font_atlas.GetGeneration();
 
-		FontAtlas::Glyph const & g = glyph.value();
+	if (m_viewport_width == 0 || m_viewport_height == 0)
+		return;
 
-		// For the space character we just advance the pen position
-		if (!g.plane_bounds.has_value() || !g.atlas_bounds.has_value())
-		{
-			pen.x += g.advance * width_scale;
-			continue;
-		}
+	// The layout is in pixels, convert it to screen coordinates -1 to 1
+	float const px_to_screen_x = 2.0f / m_viewport_width;
+	float const px_to_screen_y = 2.0f / m_viewport_height;
 
-		// left, bottom, right, top
-		glm::vec4 pb = g.plane_bounds.value();
-		pb.x *= width_scale;
-		pb.z *= width_scale;
-		pb.y *= height_scale;
-		pb.w *= height_scale;
-		glm::vec4 uv = g.atlas_bounds.value();
-		uv.x /= m_font_tex_width;
-		uv.z /= m_font_tex_width;
-		uv.y /= m_font_tex_height;
-		uv.w /= m_font_tex_height;
-
-		// 2 triangles
-		Mesh::IndexT start_vi = verts.size();
-		verts.push_back({ { pen.x + pb.x, pen.y + pb.w }, { uv.x, uv.w } }); // top-left
-		verts.push_back({ { pen.x + pb.z, pen.y + pb.w }, { uv.z, uv.w } }); // top-right
-		verts.push_back({ { pen.x + pb.x, pen.y + pb.y }, { uv.x, uv.y } }); // bottom-left
-		verts.push_back({ { pen.x + pb.z, pen.y + pb.y }, { uv.z, uv.y } }); // bottom-right
-
-		indices.push_back(static_cast<Mesh::IndexT>(start_vi + 1));
-		indices.push_back(static_cast<Mesh::IndexT>(start_vi + 0));
-		indices.push_back(static_cast<Mesh::IndexT>(start_vi + 2));
-		indices.push_back(static_cast<Mesh::IndexT>(start_vi + 1));
-		indices.push_back(static_cast<Mesh::IndexT>(start_vi + 2));
-		indices.push_back(static_cast<Mesh::IndexT>(start_vi + 3));
-
-		pen.x += g.advance * width_scale;
-	}
+	FontAtlas const & metrics = m_font_atlas.GetMetrics();
+	glm::vec4 const params{ m_font_size * metrics.GetPxRange(), m_style.effect_params };
 
 	// Vulkan screen coordinates are different from OpenGL, the y-axis is -1 at the top instead of the bottom of the screen.
 	// We could create a projection matrix that flips the y-axis and pass that into the 2d shaders, but for now we'll do this
-	if (m_graphics_api.ShouldFlipScreenY())
+	float const y_sign = m_graphics_api.ShouldFlipScreenY() ? -1.0f : 1.0f;
+
+	// Unchanged text, e.g. after a resize or a style change, is a cache hit
+	GlyphRun const & run = m_layout_cache.Layout(m_text, metrics, m_font_size, m_layout_options);
+	m_instances.reserve(run.glyphs.size());
+	m_glyphs.reserve(run.glyphs.size());
+	for (PositionedGlyph const & positioned : run.glyphs)
 	{
-		for (VertexT & v : verts)
-			v.pos.y = -v.pos.y;
+		FontAtlas::Glyph const & g = *positioned.glyph;
+		m_glyphs.push_back(g.unicode);
+
+		DynamicFontAtlas::GlyphLookup const lookup = m_font_atlas.GetGlyph(g.unicode);
+		if (lookup.state != DynamicFontAtlas::GlyphState::Ready)
+			continue; // pending glyphs show up once they're in the atlas, which changes its generation
+
+		// left, bottom, right, top
+		glm::vec4 pb = g.plane_bounds.value() * m_font_size;
+		pb.x = m_origin.x + (positioned.pos.x + pb.x) * px_to_screen_x;
+		pb.z = m_origin.x + (positioned.pos.x + pb.z) * px_to_screen_x;
+		pb.y = m_origin.y + (positioned.pos.y + pb.y) * px_to_screen_y;
+		pb.w = m_origin.y + (positioned.pos.y + pb.w) * px_to_screen_y;
+
+		m_instances.push_back(GlyphInstance{
+			.rect = { pb.x, pb.y * y_sign, pb.z, pb.w * y_sign },
+			.uv_rect = lookup.uv_rect,
+			.color = m_style.color,
+			.bg_color = m_style.bg_color,
+			.params = params
+			});
 	}
+}
+
+void TextMesh::Refresh()
+{
+	if (!m_visible)
+		return; // its glyphs can be evicted, they're requested again when it's shown
 
-	Mesh mesh{ m_graphics_api };
-	std::expected<void, GraphicsError> result = mesh.Create(verts, indices);
-	if (!result.has_value())
-		return std::unexpected{ result.error().AddToMessage(" TextMesh::CreateMesh: Failed to create mesh.") };
+	if (m_atlas_generation != m_font_atlas.GetGeneration())
+	{
+		update_instances();
+		return;
+	}
 
-	return mesh;
+	for (std::uint32_t unicode : m_glyphs)
+		m_font_atlas.Touch(unicode);
 }
 
 void TextMesh::OnViewportResized(int width, int height)
@@ -177,38 +199,16 @@ void TextMesh::OnViewportResized(int width, int height)
 
 	m_viewport_width = width;
 	m_viewport_height = height;
-
-	if (m_update_mesh_callback)
-	{
-		std::expected<Mesh, GraphicsError> mesh = CreateMesh();
-		if (!mesh.has_value())
-		{
-			std::cout << "TextMesh::OnViewportResized: Failed to create mesh: " << mesh.error().GetMessage() << std::endl;
-			return;
-		}
-
-		m_update_mesh_callback(m_mesh_id, std::move(mesh.value()));
-	}
+	update_instances();
 }
 
-void TextMesh::SetText(std::string const & text)
+void TextMesh::SetText(std::string_view text)
 {
 	if (m_text == text)
 		return; // no change
 
 	m_text = text;
-
-	if (m_update_mesh_callback)
-	{
-		std::expected<Mesh, GraphicsError> mesh = CreateMesh();
-		if (!mesh.has_value())
-		{
-			std::cout << "TextMesh::SetText: Failed to create mesh: " << mesh.error().GetMessage() << std::endl;
-			return;
-		}
-
-		m_update_mesh_callback(m_mesh_id, std::move(mesh.value()));
-	}
+	update_instances();
 }
 
 void TextMesh::SetFontSize(float font_size)
@@ -217,17 +217,32 @@ void TextMesh::SetFontSize(float font_size)
 		return; // no change
 
 	m_font_size = font_size;
-	m_screen_px_range = m_font_size * m_font_atlas.GetPxRange();
+	update_instances();
+}
 
-	if (m_update_mesh_callback)
-	{
-		std::expected<Mesh, GraphicsError> mesh = CreateMesh();
-		if (!mesh.has_value())
-		{
-			std::cout << "TextMesh::SetFontSize: Failed to create mesh: " << mesh.error().GetMessage() << std::endl;
-			return;
-		}
-
-		m_update_mesh_callback(m_mesh_id, std::move(mesh.value()));
-	}
+void TextMesh::SetStyle(TextStyle const & style)
+{
+	if (m_style.color == style.color && m_style.bg_color == style.bg_color && m_style.effect_params == style.effect_params)
+		return; // no change
+
+	m_style = style;
+	update_instances();
+}
+
+void TextMesh::SetLayoutOptions(TextLayoutOptions const & layout_options)
+{
+	if (m_layout_options == layout_options)
+		return; // no change
+
+	m_layout_options = layout_options;
+	update_instances();
+}
+
+void TextMesh::SetVisible(bool visible)
+{
+	if (m_visible == visible)
+		return; // no change
+
+	m_visible = visible;
+	++m_version;
 }
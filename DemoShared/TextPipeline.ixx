@@ -4,10 +4,6 @@ module;
 
 #include <expected>
 #include <filesystem>
-#include <iostream>
-#include <optional>
-
-#include <glm/vec4.hpp>
 
 export module TextPipeline;
 
@@ -16,20 +12,20 @@ import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
 import PipelineBuilder;
-import RenderObject;
 import Texture;
+import TypedPipeline;
 import Vertex;
 
 export class TextPipeline
 {
 public:
-	using VertexT = Texture2dVertex;
+	using VertexT = GlyphInstance; // the colors and msdf range come with every glyph, see TextBatch
+	constexpr static char const * Name = "TextPipeline";
+	constexpr static RenderPass Pass = RenderPass::OVERLAY;
 
-	struct ObjectData
+	// Text has no per-frame uniforms
+	struct FrameData
 	{
-		float screen_px_range = 1.0f;
-		glm::vec4 bg_color = glm::vec4(0.0f);
-		glm::vec4 text_color = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
 	};
 
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
@@ -38,6 +34,8 @@ public:
 		AssetPool<Texture> const & texture_pool,
 		AssetId texture_id);
 
+	static void UpdatePerFrameConstants(GraphicsPipeline const & /*pipeline*/, FrameData const & /*frame_data*/) {}
+
 	TextPipeline() = default;
 	explicit TextPipeline(AssetId asset_id) : m_asset_id(asset_id) {}
 
@@ -53,13 +51,6 @@ std::expected<GraphicsPipeline, GraphicsError> TextPipeline::CreateGraphicsPipel
 	AssetPool<Texture> const & texture_pool,
 	AssetId texture_id)
 {
-	struct ObjectDataFS
-	{
-		alignas(4) float screen_px_range;
-		alignas(16) glm::vec4 bg_color;
-		alignas(16) glm::vec4 text_color;
-	};
-
 	Texture const * texture = texture_pool.Get(texture_id);
 	if (!texture)
 		return std::unexpected{ GraphicsError{ "TextPipeline::CreateGraphicsPipeline: invalid texture" } };
@@ -73,7 +64,6 @@ std::expected<GraphicsPipeline, GraphicsError> TextPipeline::CreateGraphicsPipel
 		return std::unexpected{ load_shaders_result.error() };
 
 	builder.SetVertexType<VertexT>();
-	builder.SetObjectDataTypes<std::nullopt_t, ObjectDataFS>();
 	builder.SetTexture(*texture);
 	builder.SetDepthTestOptions(DepthTestOptions{
 		.enable_depth_test = false,
@@ -87,27 +77,5 @@ std::expected<GraphicsPipeline, GraphicsError> TextPipeline::CreateGraphicsPipel
 		});
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerObjectConstantsCallback(
-		[](GraphicsPipeline const & pipeline, void const * object_data)
-		{
-			if (!object_data)
-			{
-				std::cout << "TextObjectData is null for TextPipeline" << std::endl;
-				return;
-			}
-
-			// For optimal performance, we assume that the object data is of the correct type.
-			// Use compile-time checks when creating render objects to ensure the data is compatible with the pipeline.
-			auto const * data = static_cast<ObjectData const *>(object_data);
-
-			pipeline.SetObjectData(
-				std::nullopt,
-				ObjectDataFS{
-					.screen_px_range = data->screen_px_range,
-					.bg_color = data->bg_color,
-					.text_color = data->text_color
-				});
-		});
-
 	return builder.CreatePipeline();
 }
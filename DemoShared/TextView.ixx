@@ -0,0 +1,338 @@
+// TextView.ixx
+
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+export module TextView;
+
+import DynamicFontAtlas;
+import FontAtlas;
+import GraphicsApi;
+import Mesh;
+import MeshManager;
+import TextBatch;
+import TextLayout;
+import TextMesh;
+import Trace;
+import Vertex;
+
+export struct TextViewSettings
+{
+	std::uint32_t max_lines = std::uint32_t{ 1 } << 18; // kept in the ring buffer, the oldest are dropped
+	std::uint32_t max_visible_glyphs = 16384; // size of the view's instance buffer, glyphs past it are clipped
+};
+
+// A scrolling window over a large text, e.g. a log or a console. The text is a ring buffer of lines, appending only
+// touches the new characters, and glyphs are only generated for the lines in the window, with the layout of
+// TextMesh. They go into the view's own instance buffer, which is allocated once at its full size, so what the view
+// costs follows what's on screen, not the size of the text.
+export class TextView
+{
+public:
+	explicit TextView(
+		GraphicsApi const & graphics_api,
+		MeshManager & mesh_manager,
+		TextLayoutCache & layout_cache,
+		DynamicFontAtlas & font_atlas,
+		float font_size,
+		glm::vec2 top_left, // in screen coordinates -1 to 1
+		glm::vec2 size, // in screen coordinates, lines are clipped at the right edge
+		TextStyle const & style = TextStyle{},
+		TextViewSettings const & settings = TextViewSettings{});
+
+	// The batch keeps a pointer to the view
+	TextView(TextView const &) = delete;
+	TextView & operator=(TextView const &) = delete;
+
+	void Append(std::string_view text);
+	void Clear();
+
+	// Scrolling up stops following the tail, scrolling back down to the last line resumes it
+	void ScrollBy(std::int64_t line_count);
+	void ScrollToTail();
+	bool IsFollowingTail() const { return m_follow_tail; }
+
+	void OnViewportResized(int width, int height);
+	void SetFontSize(float font_size);
+
+	// Rebuilds the window if it changed and keeps its glyphs resident in the atlas, call it once per frame after the
+	// atlas' Update
+	void Refresh();
+	// Writes the instances the current frame's copy is missing, call it once per frame while the frame is recorded
+	void Upload() { m_batch.Upload(); }
+
+	std::span<GlyphInstance const> GetInstances() const { return m_instances; }
+	std::uint64_t GetVersion() const { return m_version; }
+	MeshId<GlyphInstance> GetMeshId() const { return m_batch.GetMeshId(); }
+
+	// Lines are numbered from the first one ever appended, the ones that were dropped included
+	std::uint64_t GetFirstLine() const { return m_first_line; }
+	std::uint64_t GetLineCount() const { return m_line_count; }
+	std::uint64_t GetFirstVisibleLine() const;
+	std::uint32_t GetVisibleLineCount() const;
+
+private:
+	std::string & get_line(std::uint64_t line_number);
+	void new_line();
+	void update_instances();
+
+	GraphicsApi const & m_graphics_api;
+	TextLayoutCache & m_layout_cache;
+	DynamicFontAtlas & m_font_atlas;
+	TextViewSettings m_settings;
+
+	float m_font_size = 0.0f;
+	glm::vec2 m_top_left;
+	glm::vec2 m_size;
+	TextStyle m_style;
+
+	int m_viewport_width = 0;
+	int m_viewport_height = 0;
+
+	std::vector<std::string> m_lines; // ring buffer, grows up to max_lines, the strings are reused when it wraps
+	std::size_t m_ring_begin = 0; // index of the first line
+	std::uint64_t m_first_line = 0;
+	std::uint64_t m_line_count = 0;
+
+	std::uint64_t m_scroll_line = 0; // first visible line when not following the tail
+	bool m_follow_tail = true;
+	bool m_dirty = true;
+
+	std::vector<GlyphInstance> m_instances; // of the visible window
+	std::vector<std::uint32_t> m_glyphs; // unicodes of the visible window, to touch them in the atlas
+	std::uint64_t m_atlas_generation = 0;
+	std::uint64_t m_version = 0;
+
+	TextBatch m_batch;
+};
+
+TextView::TextView(
+	GraphicsApi const & graphics_api,
+	MeshManager & mesh_manager,
+	TextLayoutCache & layout_cache,
+	DynamicFontAtlas & font_atlas,
+	float font_size,
+	glm::vec2 top_left,
+	glm::vec2 size,
+	TextStyle const & style /*= TextStyle{}*/,
+	TextViewSettings const & settings /*= TextViewSettings{}*/)
+	: m_graphics_api(graphics_api)
+	, m_layout_cache(layout_cache)
+	, m_font_atlas(font_atlas)
+	, m_settings(settings)
+	, m_font_size(font_size)
+	, m_top_left(top_left)
+	, m_size(size)
+	, m_style(style)
+	, m_batch(graphics_api, mesh_manager, settings.max_visible_glyphs, settings.max_visible_glyphs)
+{
+	m_settings.max_lines = std::max(m_settings.max_lines, 1u);
+	m_batch.Add(*this);
+}
+
+std::string & TextView::get_line(std::uint64_t line_number)
+{
+	return m_lines[(m_ring_begin + static_cast<std::size_t>(line_number - m_first_line)) % m_lines.size()];
+}
+
+void TextView::new_line()
+{
+	if (m_line_count == m_settings.max_lines)
+	{
+		// The oldest line's string becomes the new line
+		m_lines[m_ring_begin].clear();
+		m_ring_begin = (m_ring_begin + 1) % m_lines.size();
+		++m_first_line;
+		return;
+	}
+
+	if (m_line_count == m_lines.size())
+		m_lines.emplace_back();
+	else
+		m_lines[(m_ring_begin + static_cast<std::size_t>(m_line_count)) % m_lines.size()].clear();
+	++m_line_count;
+}
+
+std::uint32_t TextView::GetVisibleLineCount() const
+{
+	float const line_height = m_font_atlas.GetMetrics().GetLineHeight() * m_font_size;
+	if (m_viewport_height == 0 || line_height <= 0.0f)
+		return 0;
+
+	float const height = m_size.y * 0.5f * static_cast<float>(m_viewport_height);
+	return static_cast<std::uint32_t>(std::max(height / line_height, 0.0f));
+}
+
+std::uint64_t TextView::GetFirstVisibleLine() const
+{
+	std::uint32_t const visible_count = GetVisibleLineCount();
+	std::uint64_t const tail_line = m_first_line + (m_line_count > visible_count ? m_line_count - visible_count : 0);
+	if (m_follow_tail)
+		return tail_line;
+	return std::clamp(m_scroll_line, m_first_line, tail_line);
+}
+
+void TextView::Append(std::string_view text)
+{
+	if (text.empty())
+		return;
+
+	std::uint64_t const window_begin = GetFirstVisibleLine();
+	std::uint64_t const window_end = window_begin + GetVisibleLineCount();
+	std::uint64_t const last_line = m_first_line + m_line_count; // one past, where the text goes if nothing's open
+
+	if (m_line_count == 0)
+		new_line();
+
+	std::size_t begin = 0;
+	while (true)
+	{
+		std::size_t const end = text.find('\n', begin);
+		get_line(m_first_line + m_line_count - 1).append(text.substr(begin, end - begin));
+		if (end == std::string_view::npos)
+			break;
+		new_line();
+		begin = end + 1;
+	}
+
+	// Appending only shows if the window follows the tail, contains the last line or lost lines at its top
+	m_dirty = m_dirty || m_follow_tail || window_end >= last_line || GetFirstVisibleLine() != window_begin;
+}
+
+void TextView::Clear()
+{
+	m_ring_begin = 0;
+	m_first_line += m_line_count;
+	m_line_count = 0;
+	m_scroll_line = m_first_line;
+	m_dirty = true;
+}
+
+void TextView::ScrollBy(std::int64_t line_count)
+{
+	std::uint64_t const first_visible = GetFirstVisibleLine();
+	m_follow_tail = false;
+	m_scroll_line = line_count < 0
+		? first_visible - std::min(first_visible - m_first_line, static_cast<std::uint64_t>(-line_count))
+		: first_visible + static_cast<std::uint64_t>(line_count);
+
+	std::uint64_t const scrolled = GetFirstVisibleLine();
+	m_scroll_line = scrolled;
+	m_follow_tail = line_count >= 0 && scrolled + GetVisibleLineCount() >= m_first_line + m_line_count;
+	m_dirty = m_dirty || scrolled != first_visible;
+}
+
+void TextView::ScrollToTail()
+{
+	if (m_follow_tail)
+		return;
+
+	m_follow_tail = true;
+	m_dirty = true;
+}
+
+void TextView::OnViewportResized(int width, int height)
+{
+	if (width == m_viewport_width && height == m_viewport_height)
+		return; // no change
+
+	m_viewport_width = width;
+	m_viewport_height = height;
+	m_dirty = true;
+}
+
+void TextView::SetFontSize(float font_size)
+{
+	if (m_font_size == font_size)
+		return; // no change
+
+	m_font_size = font_size;
+	m_dirty = true;
+}
+
+void TextView::Refresh()
+{
+	if (m_dirty || m_atlas_generation != m_font_atlas.GetGeneration())
+	{
+		update_instances();
+		return;
+	}
+
+	for (std::uint32_t unicode : m_glyphs)
+		m_font_atlas.Touch(unicode);
+}
+
+void TextView::update_instances()
+{
+	Trace::Zone zone{ "TextView::update_instances" };
+
+	++m_version;
+	m_dirty = false;
+	m_instances.clear();
+	m_glyphs.clear();
+	m_atlas_generation = m_font_atlas.GetGeneration();
+
+	if (m_viewport_width == 0 || m_viewport_height == 0 || m_line_count == 0)
+		return;
+
+	FontAtlas const & metrics = m_font_atlas.GetMetrics();
+	float const line_height = metrics.GetLineHeight() * m_font_size;
+	float const ascender = metrics.GetAscender() * m_font_size;
+	float const width = m_size.x * 0.5f * static_cast<float>(m_viewport_width);
+
+	// The layout is in pixels, convert it to screen coordinates -1 to 1
+	float const px_to_screen_x = 2.0f / m_viewport_width;
+	float const px_to_screen_y = 2.0f / m_viewport_height;
+
+	glm::vec4 const params{ m_font_size * metrics.GetPxRange(), m_style.effect_params };
+
+	// Same as TextMesh, vulkan's y-axis points down the screen
+	float const y_sign = m_graphics_api.ShouldFlipScreenY() ? -1.0f : 1.0f;
+
+	std::uint64_t const first_visible = GetFirstVisibleLine();
+	std::uint64_t const end_visible = std::min<std::uint64_t>(first_visible + GetVisibleLineCount(), m_first_line + m_line_count);
+	for (std::uint64_t line_number = first_visible; line_number < end_visible; ++line_number)
+	{
+		float const baseline = -ascender - static_cast<float>(line_number - first_visible) * line_height;
+
+		// Lines that stay in the window while it scrolls are cache hits
+		GlyphRun const & run = m_layout_cache.Layout(get_line(line_number), metrics, m_font_size);
+		for (PositionedGlyph const & positioned : run.glyphs)
+		{
+			FontAtlas::Glyph const & g = *positioned.glyph;
+
+			// left, bottom, right, top
+			glm::vec4 pb = g.plane_bounds.value() * m_font_size;
+			if (positioned.pos.x + pb.z > width)
+				break; // clipped at the right edge
+			if (m_instances.size() == m_settings.max_visible_glyphs)
+				return; // the buffer is full
+
+			m_glyphs.push_back(g.unicode);
+			DynamicFontAtlas::GlyphLookup const lookup = m_font_atlas.GetGlyph(g.unicode);
+			if (lookup.state != DynamicFontAtlas::GlyphState::Ready)
+				continue;
+
+			pb.x = m_top_left.x + (positioned.pos.x + pb.x) * px_to_screen_x;
+			pb.z = m_top_left.x + (positioned.pos.x + pb.z) * px_to_screen_x;
+			pb.y = m_top_left.y + (baseline + pb.y) * px_to_screen_y;
+			pb.w = m_top_left.y + (baseline + pb.w) * px_to_screen_y;
+
+			m_instances.push_back(GlyphInstance{
+				.rect = { pb.x, pb.y * y_sign, pb.z, pb.w * y_sign },
+				.uv_rect = lookup.uv_rect,
+				.color = m_style.color,
+				.bg_color = m_style.bg_color,
+				.params = params
+				});
+		}
+	}
+}
@@ -2,9 +2,9 @@
 
 module;
 
+#include <cstdint>
 #include <expected>
 #include <filesystem>
-#include <iostream>
 #include <optional>
 
 #include <glm/mat4x4.hpp>
@@ -18,27 +18,39 @@ import GraphicsError;
 import GraphicsPipeline;
 import LightsManager;
 import PipelineBuilder;
-import RenderObject;
-import Texture;
+import ShaderVariant;
+import TextureTable;
+import TypedPipeline;
 import Vertex;
 
 export class TexturePipeline
 {
 public:
 	using VertexT = TextureVertex;
+	constexpr static char const * Name = "TexturePipeline";
+	constexpr static RenderPass Pass = RenderPass::GEOMETRY;
+
+	struct FrameData
+	{
+		Camera const * camera = nullptr;
+		LightsManager const * lights = nullptr;
+	};
 
 	struct ObjectData
 	{
 		glm::mat4 model{ 1.0 };
+		std::uint32_t texture_index = 0; // index in the scene's TextureTable
 	};
 
 	static std::expected<GraphicsPipeline, GraphicsError> CreateGraphicsPipeline(
 		GraphicsApi const & graphics_api,
 		std::filesystem::path const & shaders_path,
-		Camera const & camera,
+		TextureTable const & texture_table,
 		LightsManager const & lights,
-		AssetPool<Texture> const & texture_pool,
-		AssetId texture_id);
+		ShaderVariant const & variant);
+
+	static void UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data);
+	static void UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data);
 
 	TexturePipeline() = default;
 	explicit TexturePipeline(AssetId asset_id) : m_asset_id(asset_id) {}
@@ -46,66 +58,59 @@ public:
 	AssetId GetAssetId() const { return m_asset_id; }
 
 private:
+	struct ObjectDataVS
+	{
+		alignas(16) glm::mat4 model;
+	};
+
+	struct ObjectDataFS
+	{
+		alignas(4) std::uint32_t texture_index;
+	};
+
 	AssetId m_asset_id;
 };
 
 std::expected<GraphicsPipeline, GraphicsError> TexturePipeline::CreateGraphicsPipeline(
 	GraphicsApi const & graphics_api,
 	std::filesystem::path const & shaders_path,
-	Camera const & camera,
+	TextureTable const & texture_table,
 	LightsManager const & lights,
-	AssetPool<Texture> const & texture_pool,
-	AssetId texture_id)
+	ShaderVariant const & variant)
 {
-	struct ObjectDataVS
-	{
-		alignas(16) glm::mat4 model;
-	};
-
-	Texture const * texture = texture_pool.Get(texture_id);
-	if (!texture)
-		return std::unexpected{ GraphicsError{ "TexturePipeline::CreateGraphicsPipeline: invalid texture" } };
-
 	PipelineBuilder builder{ graphics_api };
 
 	std::expected<void, GraphicsError> load_shaders_result = builder.LoadShaders(
 		shaders_path / "texture.vert",
-		shaders_path / "texture.frag");
+		shaders_path / "texture.frag",
+		variant);
 	if (!load_shaders_result.has_value())
 		return std::unexpected{ load_shaders_result.error() };
 
 	builder.SetVertexType<VertexT>();
-	builder.SetObjectDataTypes<ObjectDataVS, std::nullopt_t>();
+	builder.SetObjectDataTypes<ObjectDataVS, ObjectDataFS>();
 	builder.SetVSUniformTypes<ViewProjUniform>();
 	builder.SetFSUniformTypes<LightsUniform>();
-	builder.SetTexture(*texture);
+	builder.SetFSStorageBuffers(lights.GetStorageBuffers());
+	builder.SetTextureTable(texture_table);
 	builder.SetCullMode(CullMode::BACK);
 
-	builder.SetPerFrameConstantsCallback(
-		[&camera, &lights](GraphicsPipeline const & pipeline)
-		{
-			pipeline.SetUniform(0 /*binding*/, camera.GetViewProjUniform());
-			pipeline.SetUniform(1 /*binding*/, lights.GetLightsUniform());
-		});
-	builder.SetPerObjectConstantsCallback(
-		[](GraphicsPipeline const & pipeline, void const * object_data)
-		{
-			if (!object_data)
-			{
-				std::cout << "ObjectData is null for TexturePipeline" << std::endl;
-				return;
-			}
-
-			// For optimal performance, we assume that the object data is of the correct type.
-			// Use compile-time checks when creating render objects to ensure the data is compatible with the pipeline.
-			auto const * data = static_cast<ObjectData const *>(object_data);
-
-			pipeline.SetObjectData(
-				ObjectDataVS{
-					.model = data->model
-				},
-				std::nullopt);
-		});
-
 	return builder.CreatePipeline();
 }
+
+inline void TexturePipeline::UpdatePerFrameConstants(GraphicsPipeline const & pipeline, FrameData const & frame_data)
+{
+	pipeline.SetUniform(0 /*binding*/, frame_data.camera->GetViewProjUniform());
+	pipeline.SetUniform(1 /*binding*/, frame_data.lights->GetLightsUniform());
+}
+
+inline void TexturePipeline::UpdatePerObjectConstants(GraphicsPipeline const & pipeline, ObjectData const & object_data)
+{
+	pipeline.SetObjectData(
+		ObjectDataVS{
+			.model = object_data.model
+		},
+		ObjectDataFS{
+			.texture_index = object_data.texture_index
+		});
+}
@@ -0,0 +1,206 @@
+// Trace.cpp
+
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+module Trace;
+
+namespace
+{
+	constexpr std::uint64_t RingCapacity = 1 << 14; // must be a power of two
+	constexpr std::uint64_t RingMask = RingCapacity - 1;
+
+	// Fields are relaxed atomics so a concurrent dump is free of data races, on x86 and arm they are plain loads and stores
+	struct TraceEvent
+	{
+		std::atomic<char const *> name = nullptr;
+		std::atomic<std::uint64_t> begin_ns = 0;
+		std::atomic<std::uint64_t> end_ns = 0;
+	};
+
+	// Single producer (the owning thread), any number of readers
+	struct ThreadBuffer
+	{
+		std::uint32_t thread_id = 0;
+		std::atomic<char const *> thread_name = nullptr;
+		std::atomic<std::uint64_t> head = 0;
+		std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(RingCapacity);
+	};
+
+	struct EventCopy
+	{
+		char const * name = nullptr;
+		std::uint64_t begin_ns = 0;
+		std::uint64_t end_ns = 0;
+		std::uint32_t thread_id = 0;
+	};
+
+	// Buffers are registered once per thread and are never freed, so zones of finished threads can still be dumped
+	std::mutex g_registry_mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> g_thread_buffers;
+
+	thread_local ThreadBuffer * t_thread_buffer = nullptr;
+
+	ThreadBuffer & register_thread()
+	{
+		std::scoped_lock lock(g_registry_mutex);
+
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->thread_id = static_cast<std::uint32_t>(g_thread_buffers.size());
+		t_thread_buffer = buffer.get();
+		g_thread_buffers.push_back(std::move(buffer));
+
+		return *t_thread_buffer;
+	}
+
+	ThreadBuffer & get_thread_buffer()
+	{
+		if (!t_thread_buffer)
+			return register_thread();
+		return *t_thread_buffer;
+	}
+
+	void copy_events(ThreadBuffer const & buffer, std::uint64_t min_end_ns, std::vector<EventCopy> & out_events)
+	{
+		std::uint64_t head = buffer.head.load(std::memory_order_acquire);
+		std::uint64_t first = head > RingCapacity ? head - RingCapacity : 0;
+
+		std::size_t out_begin = out_events.size();
+		for (std::uint64_t i = first; i < head; ++i)
+		{
+			TraceEvent const & event = buffer.events[i & RingMask];
+			EventCopy copy{
+				.name = event.name.load(std::memory_order_relaxed),
+				.begin_ns = event.begin_ns.load(std::memory_order_relaxed),
+				.end_ns = event.end_ns.load(std::memory_order_relaxed),
+				.thread_id = buffer.thread_id
+			};
+			out_events.push_back(copy);
+		}
+
+		// The producer may have lapped us while copying, drop anything that could have been overwritten,
+		// including the slot it may be writing right now
+		std::uint64_t new_head = buffer.head.load(std::memory_order_acquire);
+		std::uint64_t overwritten = new_head + 1 > RingCapacity + first ? new_head + 1 - RingCapacity - first : 0;
+		overwritten = std::min<std::uint64_t>(overwritten, head - first);
+		out_events.erase(out_events.begin() + out_begin, out_events.begin() + out_begin + overwritten);
+
+		std::erase_if(out_events, [min_end_ns](EventCopy const & event)
+			{ return event.name == nullptr || event.end_ns < min_end_ns; });
+	}
+
+	void write_json_string(std::ostream & out, std::string_view str)
+	{
+		out << '"';
+		for (char c : str)
+		{
+			if (c == '"' || c == '\\')
+				out << '\\';
+			out << c;
+		}
+		out << '"';
+	}
+}
+
+namespace Trace
+{
+	void RecordZone(char const * name, std::uint64_t begin_ns, std::uint64_t end_ns)
+	{
+		ThreadBuffer & buffer = get_thread_buffer();
+
+		std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+		TraceEvent & event = buffer.events[head & RingMask];
+		event.name.store(name, std::memory_order_relaxed);
+		event.begin_ns.store(begin_ns, std::memory_order_relaxed);
+		event.end_ns.store(end_ns, std::memory_order_relaxed);
+
+		buffer.head.store(head + 1, std::memory_order_release);
+	}
+
+	void SetThreadName(char const * name)
+	{
+		if constexpr (!Enabled)
+			return;
+
+		get_thread_buffer().thread_name.store(name, std::memory_order_relaxed);
+	}
+
+	bool DumpChromeTrace(std::filesystem::path const & path, double last_seconds)
+	{
+		if constexpr (!Enabled)
+		{
+			std::cout << "Trace::DumpChromeTrace: tracing was compiled out, define ENABLE_TRACING to enable it" << std::endl;
+			return false;
+		}
+
+		std::uint64_t now_ns = NowNs();
+		std::uint64_t window_ns = static_cast<std::uint64_t>(last_seconds * 1'000'000'000.0);
+		std::uint64_t min_end_ns = now_ns > window_ns ? now_ns - window_ns : 0;
+
+		std::vector<EventCopy> events;
+		std::vector<std::pair<std::uint32_t, char const *>> thread_names;
+		{
+			std::scoped_lock lock(g_registry_mutex);
+			for (auto const & buffer : g_thread_buffers)
+			{
+				copy_events(*buffer, min_end_ns, events);
+				thread_names.emplace_back(buffer->thread_id, buffer->thread_name.load(std::memory_order_relaxed));
+			}
+		}
+
+		std::ranges::sort(events, {}, &EventCopy::begin_ns);
+
+		std::ofstream out(path);
+		if (!out)
+		{
+			std::cout << "Trace::DumpChromeTrace: failed to open " << path << std::endl;
+			return false;
+		}
+
+		std::uint64_t base_ns = events.empty() ? now_ns : events.front().begin_ns;
+
+		out << std::fixed << std::setprecision(3);
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		bool first = true;
+		for (auto const & [thread_id, thread_name] : thread_names)
+		{
+			if (!thread_name)
+				continue;
+
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_id
+				<< ",\"args\":{\"name\":";
+			write_json_string(out, thread_name);
+			out << "}}";
+			first = false;
+		}
+
+		for (EventCopy const & event : events)
+		{
+			// Chrome trace timestamps are in microseconds
+			double ts_us = static_cast<double>(event.begin_ns - base_ns) / 1000.0;
+			double dur_us = static_cast<double>(event.end_ns - event.begin_ns) / 1000.0;
+
+			out << (first ? "" : ",\n") << "{\"name\":";
+			write_json_string(out, event.name);
+			out << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_id
+				<< ",\"ts\":" << ts_us << ",\"dur\":" << dur_us << "}";
+			first = false;
+		}
+		out << "\n]}\n";
+
+		std::cout << "Wrote " << events.size() << " trace events to " << path << std::endl;
+		return true;
+	}
+}
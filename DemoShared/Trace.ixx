@@ -0,0 +1,68 @@
+// Trace.ixx
+
+module;
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+export module Trace;
+
+// Scoped cpu zones recorded into per-thread ring buffers, which can be dumped as Chrome trace-event JSON
+// (viewable in chrome://tracing or ui.perfetto.dev).
+// Tracing is compiled in when ENABLE_TRACING is defined, otherwise Trace::Zone is an empty type and compiles away.
+// Modules can't export macros, so zones are plain RAII objects: Trace::Zone zone{ "Scene::Update" };
+namespace Trace
+{
+#ifdef ENABLE_TRACING
+	export constexpr bool Enabled = true;
+#else
+	export constexpr bool Enabled = false;
+#endif
+
+	// Timestamps are std::chrono::steady_clock nanoseconds, the same clock is used by the renderers' trace hooks
+	export inline std::uint64_t NowNs()
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// The name must outlive the trace buffers, string literals are expected
+	export void RecordZone(char const * name, std::uint64_t begin_ns, std::uint64_t end_ns);
+
+	// Names the calling thread in the dumped trace
+	export void SetThreadName(char const * name);
+
+	// Writes every zone that ended in the last `last_seconds` seconds, safe to call while other threads are recording
+	export bool DumpChromeTrace(std::filesystem::path const & path, double last_seconds);
+
+#ifdef ENABLE_TRACING
+	export class Zone
+	{
+	public:
+		explicit Zone(char const * name)
+			: m_name(name)
+			, m_begin_ns(NowNs())
+		{
+		}
+
+		~Zone() { RecordZone(m_name, m_begin_ns, NowNs()); }
+
+		Zone(Zone const &) = delete;
+		Zone & operator=(Zone const &) = delete;
+
+	private:
+		char const * m_name;
+		std::uint64_t m_begin_ns;
+	};
+#else
+	export class Zone
+	{
+	public:
+		explicit constexpr Zone(char const * /*name*/) {}
+
+		Zone(Zone const &) = delete;
+		Zone & operator=(Zone const &) = delete;
+	};
+#endif
+}
@@ -0,0 +1,243 @@
+// TransformStore.cpp
+
+module;
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_STORE_SSE2
+#include <emmintrin.h>
+#endif
+
+module TransformStore;
+
+import Trace;
+
+TransformId TransformStore::Add(Transform const & local, TransformId parent /*= NoParentTransform*/)
+{
+	TransformId id = static_cast<TransformId>(m_parents.size());
+
+	m_pos_x.push_back(local.translation.x);
+	m_pos_y.push_back(local.translation.y);
+	m_pos_z.push_back(local.translation.z);
+	m_rot_x.push_back(0.0f);
+	m_rot_y.push_back(0.0f);
+	m_rot_z.push_back(0.0f);
+	m_rot_w.push_back(1.0f);
+	m_scale_x.push_back(local.scale.x);
+	m_scale_y.push_back(local.scale.y);
+	m_scale_z.push_back(local.scale.z);
+	m_parents.push_back(parent < id ? parent : NoParentTransform);
+	m_dirty.push_back(1);
+	m_world_matrices.emplace_back(1.0f);
+	m_outputs.push_back(nullptr);
+
+	set_rotation(id, local.rotation);
+	return id;
+}
+
+void TransformStore::SetOutput(TransformId id, glm::mat4 * world_matrix)
+{
+	m_outputs[id] = world_matrix;
+	m_dirty[id] = 1;
+}
+
+void TransformStore::SetTranslation(TransformId id, glm::vec3 const & translation)
+{
+	m_pos_x[id] = translation.x;
+	m_pos_y[id] = translation.y;
+	m_pos_z[id] = translation.z;
+	m_dirty[id] = 1;
+}
+
+void TransformStore::SetRotation(TransformId id, glm::quat const & rotation)
+{
+	set_rotation(id, rotation);
+}
+
+void TransformStore::SetScale(TransformId id, glm::vec3 const & scale)
+{
+	m_scale_x[id] = scale.x;
+	m_scale_y[id] = scale.y;
+	m_scale_z[id] = scale.z;
+	m_dirty[id] = 1;
+}
+
+void TransformStore::Rotate(TransformId id, float angle, glm::vec3 const & axis)
+{
+	set_rotation(id, glm::angleAxis(angle, axis) * GetRotation(id));
+}
+
+void TransformStore::RotateLocal(TransformId id, float angle, glm::vec3 const & axis)
+{
+	set_rotation(id, GetRotation(id) * glm::angleAxis(angle, axis));
+}
+
+void TransformStore::set_rotation(TransformId id, glm::quat const & rotation)
+{
+	// Normalized here so repeated rotations don't drift and the update can assume unit quaternions
+	glm::quat const unit = glm::normalize(rotation);
+	m_rot_x[id] = unit.x;
+	m_rot_y[id] = unit.y;
+	m_rot_z[id] = unit.z;
+	m_rot_w[id] = unit.w;
+	m_dirty[id] = 1;
+}
+
+namespace
+{
+	struct TransformArrays
+	{
+		float const * pos_x;
+		float const * pos_y;
+		float const * pos_z;
+		float const * rot_x;
+		float const * rot_y;
+		float const * rot_z;
+		float const * rot_w;
+		float const * scale_x;
+		float const * scale_y;
+		float const * scale_z;
+	};
+
+	// Translation * rotation * scale, the rotation matrix comes straight from the unit quaternion
+	void compose_local(TransformArrays const & arrays, TransformId id, glm::mat4 & out)
+	{
+		float const x = arrays.rot_x[id], y = arrays.rot_y[id], z = arrays.rot_z[id], w = arrays.rot_w[id];
+		float const xx = x * x * 2.0f, yy = y * y * 2.0f, zz = z * z * 2.0f;
+		float const xy = x * y * 2.0f, xz = x * z * 2.0f, yz = y * z * 2.0f;
+		float const wx = w * x * 2.0f, wy = w * y * 2.0f, wz = w * z * 2.0f;
+
+		out[0] = glm::vec4{ 1.0f - (yy + zz), xy + wz, xz - wy, 0.0f } * arrays.scale_x[id];
+		out[1] = glm::vec4{ xy - wz, 1.0f - (xx + zz), yz + wx, 0.0f } * arrays.scale_y[id];
+		out[2] = glm::vec4{ xz + wy, yz - wx, 1.0f - (xx + yy), 0.0f } * arrays.scale_z[id];
+		out[3] = glm::vec4{ arrays.pos_x[id], arrays.pos_y[id], arrays.pos_z[id], 1.0f };
+	}
+
+#ifdef TRANSFORM_STORE_SSE2
+	// compose_local for 4 transforms at once, the lanes are transposed into the columns of the matrices at the end
+	void compose_local_x4(TransformArrays const & arrays, TransformId const * ids, std::vector<glm::mat4> & out)
+	{
+		auto gather = [&](float const * values)
+			{
+				return _mm_setr_ps(values[ids[0]], values[ids[1]], values[ids[2]], values[ids[3]]);
+			};
+
+		__m128 const x = gather(arrays.rot_x);
+		__m128 const y = gather(arrays.rot_y);
+		__m128 const z = gather(arrays.rot_z);
+		__m128 const w = gather(arrays.rot_w);
+		__m128 const two = _mm_set1_ps(2.0f);
+		__m128 const one = _mm_set1_ps(1.0f);
+
+		__m128 const x2 = _mm_mul_ps(x, two);
+		__m128 const y2 = _mm_mul_ps(y, two);
+		__m128 const z2 = _mm_mul_ps(z, two);
+		__m128 const xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+		__m128 const xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+		__m128 const wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+		__m128 const scale_x = gather(arrays.scale_x);
+		__m128 const scale_y = gather(arrays.scale_y);
+		__m128 const scale_z = gather(arrays.scale_z);
+
+		__m128 const zero = _mm_setzero_ps();
+		std::array<std::array<__m128, 4>, 4> columns{ {
+			{ _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scale_x), _mm_mul_ps(_mm_add_ps(xy, wz), scale_x),
+				_mm_mul_ps(_mm_sub_ps(xz, wy), scale_x), zero },
+			{ _mm_mul_ps(_mm_sub_ps(xy, wz), scale_y), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scale_y),
+				_mm_mul_ps(_mm_add_ps(yz, wx), scale_y), zero },
+			{ _mm_mul_ps(_mm_add_ps(xz, wy), scale_z), _mm_mul_ps(_mm_sub_ps(yz, wx), scale_z),
+				_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scale_z), zero },
+			{ gather(arrays.pos_x), gather(arrays.pos_y), gather(arrays.pos_z), one }
+		} };
+
+		for (std::size_t column = 0; column < 4; ++column)
+		{
+			std::array<__m128, 4> & rows = columns[column];
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+			for (std::size_t lane = 0; lane < 4; ++lane)
+				_mm_storeu_ps(&out[ids[lane]][column][0], rows[lane]);
+		}
+	}
+
+	void multiply(glm::mat4 const & parent, glm::mat4 const & local, glm::mat4 & out)
+	{
+		__m128 const parent_columns[4] = {
+			_mm_loadu_ps(&parent[0][0]), _mm_loadu_ps(&parent[1][0]), _mm_loadu_ps(&parent[2][0]), _mm_loadu_ps(&parent[3][0])
+		};
+
+		for (int column = 0; column < 4; ++column)
+		{
+			__m128 result = _mm_mul_ps(parent_columns[0], _mm_set1_ps(local[column][0]));
+			result = _mm_add_ps(result, _mm_mul_ps(parent_columns[1], _mm_set1_ps(local[column][1])));
+			result = _mm_add_ps(result, _mm_mul_ps(parent_columns[2], _mm_set1_ps(local[column][2])));
+			result = _mm_add_ps(result, _mm_mul_ps(parent_columns[3], _mm_set1_ps(local[column][3])));
+			_mm_storeu_ps(&out[column][0], result);
+		}
+	}
+#else
+	void multiply(glm::mat4 const & parent, glm::mat4 const & local, glm::mat4 & out)
+	{
+		out = parent * local;
+	}
+#endif
+}
+
+void TransformStore::Update()
+{
+	Trace::Zone zone{ "TransformStore::Update" };
+
+	// A parent always has a lower index than its children, so its flag is final by the time they are visited
+	m_dirty_ids.clear();
+	for (TransformId id = 0; id < m_parents.size(); ++id)
+	{
+		TransformId const parent = m_parents[id];
+		if (parent != NoParentTransform && m_dirty[parent])
+			m_dirty[id] = 1;
+		if (m_dirty[id])
+			m_dirty_ids.push_back(id);
+	}
+
+	TransformArrays const arrays{
+		.pos_x = m_pos_x.data(),
+		.pos_y = m_pos_y.data(),
+		.pos_z = m_pos_z.data(),
+		.rot_x = m_rot_x.data(),
+		.rot_y = m_rot_y.data(),
+		.rot_z = m_rot_z.data(),
+		.rot_w = m_rot_w.data(),
+		.scale_x = m_scale_x.data(),
+		.scale_y = m_scale_y.data(),
+		.scale_z = m_scale_z.data()
+	};
+
+	std::size_t i = 0;
+#ifdef TRANSFORM_STORE_SSE2
+	for (; i + 4 <= m_dirty_ids.size(); i += 4)
+		compose_local_x4(arrays, &m_dirty_ids[i], m_world_matrices);
+#endif
+	for (; i < m_dirty_ids.size(); ++i)
+		compose_local(arrays, m_dirty_ids[i], m_world_matrices[m_dirty_ids[i]]);
+
+	// In index order, so the parent's world matrix is already up to date
+	for (TransformId id : m_dirty_ids)
+	{
+		glm::mat4 & world = m_world_matrices[id];
+		if (m_parents[id] != NoParentTransform)
+			multiply(m_world_matrices[m_parents[id]], glm::mat4{ world }, world);
+
+		if (m_outputs[id])
+			*m_outputs[id] = world;
+		m_dirty[id] = 0;
+	}
+
+	m_stats.transform_count = static_cast<std::uint32_t>(m_parents.size());
+	m_stats.updated_count = static_cast<std::uint32_t>(m_dirty_ids.size());
+}
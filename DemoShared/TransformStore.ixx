@@ -0,0 +1,86 @@
+// TransformStore.ixx
+
+module;
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+export module TransformStore;
+
+export using TransformId = std::uint32_t;
+
+export constexpr TransformId NoParentTransform = std::numeric_limits<TransformId>::max();
+
+// Local transform relative to the parent, applied as scale, then rotation, then translation
+export struct Transform
+{
+	glm::vec3 translation{ 0.0f };
+	glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	glm::vec3 scale{ 1.0f };
+};
+
+export struct TransformStats
+{
+	std::uint32_t transform_count = 0;
+	std::uint32_t updated_count = 0; // world matrices recomputed by the last Update
+};
+
+// Transforms of the scene's objects, one array per component so the batch update streams through them.
+// A transform is only recomputed when it or one of its ancestors changed since the last Update, its world matrix is
+// then composed 4 transforms at a time and written to the matrix bound with SetOutput, e.g. an ObjectData's model.
+// Parents are added before their children, so a single pass in index order sees every parent before its children.
+export class TransformStore
+{
+public:
+	TransformId Add(Transform const & local, TransformId parent = NoParentTransform);
+
+	// The matrix the world matrix is written to when it changes, it has to outlive the store or be unbound
+	void SetOutput(TransformId id, glm::mat4 * world_matrix);
+
+	void SetTranslation(TransformId id, glm::vec3 const & translation);
+	void SetRotation(TransformId id, glm::quat const & rotation);
+	void SetScale(TransformId id, glm::vec3 const & scale);
+	// Rotates around an axis of the parent's space
+	void Rotate(TransformId id, float angle, glm::vec3 const & axis);
+	// Rotates around an axis of the transform's own space
+	void RotateLocal(TransformId id, float angle, glm::vec3 const & axis);
+
+	glm::vec3 GetTranslation(TransformId id) const { return glm::vec3{ m_pos_x[id], m_pos_y[id], m_pos_z[id] }; }
+	glm::quat GetRotation(TransformId id) const { return glm::quat{ m_rot_w[id], m_rot_x[id], m_rot_y[id], m_rot_z[id] }; }
+	glm::vec3 GetScale(TransformId id) const { return glm::vec3{ m_scale_x[id], m_scale_y[id], m_scale_z[id] }; }
+
+	// As of the last Update
+	glm::mat4 const & GetWorldMatrix(TransformId id) const { return m_world_matrices[id]; }
+
+	// Recomputes the world matrices of the changed transforms and their descendants
+	void Update();
+
+	TransformStats const & GetStats() const { return m_stats; }
+
+private:
+	void set_rotation(TransformId id, glm::quat const & rotation);
+
+	std::vector<float> m_pos_x;
+	std::vector<float> m_pos_y;
+	std::vector<float> m_pos_z;
+	std::vector<float> m_rot_x;
+	std::vector<float> m_rot_y;
+	std::vector<float> m_rot_z;
+	std::vector<float> m_rot_w;
+	std::vector<float> m_scale_x;
+	std::vector<float> m_scale_y;
+	std::vector<float> m_scale_z;
+	std::vector<TransformId> m_parents;
+	std::vector<std::uint8_t> m_dirty; // set when the local transform changed, or in Update when the parent's did
+
+	std::vector<glm::mat4> m_world_matrices;
+	std::vector<glm::mat4 *> m_outputs;
+
+	std::vector<TransformId> m_dirty_ids; // of the current Update, reused between frames
+	TransformStats m_stats;
+};
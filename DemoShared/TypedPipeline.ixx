@@ -0,0 +1,97 @@
+// TypedPipeline.ixx
+
+module;
+
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+export module TypedPipeline;
+
+import GraphicsPipeline;
+
+// Draws are sorted by pass first, see DrawList
+export enum class RenderPass : std::uint8_t
+{
+	GEOMETRY = 0, // opaque meshes
+	SKYBOX = 1, // after opaque geometry so it's only shaded where nothing else was drawn
+	BLENDED = 2,
+	OVERLAY = 3 // 2d on top of the scene, drawn at native resolution after the scene is upscaled, see Renderer::BeginOverlay
+};
+
+export constexpr bool IsBlendedPass(RenderPass pass) { return pass == RenderPass::BLENDED || pass == RenderPass::OVERLAY; }
+
+// A pipeline traits type describes everything that is known about a pipeline at compile time:
+// its vertex type, the per-frame data it reads its uniforms from and how its per-object data is pushed.
+// The hooks are static inline functions, so TypedPipeline calls them directly and they get inlined into the draw loop.
+export template <typename Traits>
+concept PipelineTraits = requires (GraphicsPipeline const & pipeline, typename Traits::FrameData const & frame_data)
+{
+	typename Traits::VertexT;
+	{ Traits::Name } -> std::convertible_to<char const *>;
+	{ Traits::Pass } -> std::convertible_to<RenderPass>;
+	{ Traits::UpdatePerFrameConstants(pipeline, frame_data) } -> std::same_as<void>;
+};
+
+export template <typename Traits>
+concept PipelineHasObjectData = requires (GraphicsPipeline const & pipeline, typename Traits::ObjectData const & object_data)
+{
+	{ Traits::UpdatePerObjectConstants(pipeline, object_data) } -> std::same_as<void>;
+};
+
+template <typename Traits>
+struct PipelineObjectData
+{
+	using Type = std::nullopt_t;
+};
+
+template <PipelineHasObjectData Traits>
+struct PipelineObjectData<Traits>
+{
+	using Type = typename Traits::ObjectData;
+};
+
+// The per-object data type of a pipeline, std::nullopt_t for pipelines without object data
+export template <typename Traits>
+using PipelineObjectDataT = typename PipelineObjectData<Traits>::Type;
+
+export template <PipelineTraits Traits>
+class TypedPipeline
+{
+public:
+	using TraitsT = Traits;
+	using VertexT = typename Traits::VertexT;
+	using FrameData = typename Traits::FrameData;
+	using ObjectData = PipelineObjectDataT<Traits>;
+
+	TypedPipeline(GraphicsPipeline pipeline, FrameData const & frame_data)
+		: m_pipeline(std::move(pipeline))
+		, m_frame_data(frame_data)
+	{}
+
+	TypedPipeline(TypedPipeline && other) = default;
+	TypedPipeline & operator=(TypedPipeline && other) = default;
+
+	TypedPipeline(TypedPipeline const &) = delete;
+	TypedPipeline & operator=(TypedPipeline const &) = delete;
+
+	// Binds the pipeline and uploads the per-frame uniforms
+	void Activate() const
+	{
+		m_pipeline.Activate();
+		Traits::UpdatePerFrameConstants(m_pipeline, m_frame_data);
+	}
+
+	void SetObjectData(ObjectData const & object_data) const
+		requires PipelineHasObjectData<Traits>
+	{
+		Traits::UpdatePerObjectConstants(m_pipeline, object_data);
+	}
+
+	GraphicsPipeline const & GetGraphicsPipeline() const { return m_pipeline; }
+
+private:
+	GraphicsPipeline m_pipeline;
+	FrameData m_frame_data;
+};
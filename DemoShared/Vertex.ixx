@@ -3,10 +3,13 @@
 module;
 
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 export module Vertex;
 
@@ -106,10 +109,36 @@ export struct Texture2dVertex
 	static Vertex::LayoutDesc CreateLayout() { return create_layout<Texture2dVertex>(); }
 };
 
+// One glyph of screen space text, drawn as an instance of a quad that the vertex shader expands from the rects
+export struct GlyphInstance
+{
+	glm::vec4 rect; // left, bottom, right, top in normalized device coordinates
+	glm::vec4 uv_rect; // left, bottom, right, top in the font atlas
+	glm::vec4 color;
+	glm::vec4 bg_color;
+	glm::vec4 params; // x is the screen px range of the msdf, the rest is up to the pipeline's effect
+
+	static Vertex::LayoutDesc CreateLayout()
+	{
+		Vertex::LayoutDesc layout{ .stride = sizeof(GlyphInstance), .input_rate = Vertex::InputRate::Instance };
+		for (std::size_t offset : { offsetof(GlyphInstance, rect), offsetof(GlyphInstance, uv_rect), offsetof(GlyphInstance, color),
+			offsetof(GlyphInstance, bg_color), offsetof(GlyphInstance, params) })
+		{
+			layout.attributes.push_back(Vertex::AttributeDesc{
+				.type = Vertex::AttributeType::Float4,
+				.offset = offset,
+				.location = static_cast<std::uint32_t>(layout.attributes.size())
+				});
+		}
+		return layout;
+	}
+};
+
 export template <typename T>
 concept IsVertex =
 	std::same_as<T, PositionVertex>
 	|| std::same_as<T, NormalVertex>
 	|| std::same_as<T, TextureVertex>
 	|| std::same_as<T, ColorVertex>
-	|| std::same_as<T, Texture2dVertex>;
+	|| std::same_as<T, Texture2dVertex>
+	|| std::same_as<T, GlyphInstance>;
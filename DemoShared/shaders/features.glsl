@@ -0,0 +1,21 @@
+// features.glsl
+// Optional features of a shader variant, the ids and names have to match ShaderFeature. Vulkan sets the constants
+// with specialization constants when the pipeline is created, the opengl shader loader defines SHADER_FEATURE_<name>.
+// Either way a disabled feature is a constant false, so the code it guards is compiled out.
+
+#ifndef FEATURES_GLSL
+#define FEATURES_GLSL
+
+#ifdef BUILD_VULKAN
+layout(constant_id = 0) const bool FEATURE_POINT_LIGHTS = true;
+layout(constant_id = 1) const bool FEATURE_SPOT_LIGHTS = true;
+layout(constant_id = 2) const bool FEATURE_FOG = false;
+
+#else // OpenGL
+const bool FEATURE_POINT_LIGHTS = SHADER_FEATURE_POINT_LIGHTS != 0;
+const bool FEATURE_SPOT_LIGHTS = SHADER_FEATURE_SPOT_LIGHTS != 0;
+const bool FEATURE_FOG = SHADER_FEATURE_FOG != 0;
+
+#endif
+
+#endif // FEATURES_GLSL
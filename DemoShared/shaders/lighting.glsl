@@ -0,0 +1,112 @@
+// lighting.glsl
+// Clustered lighting and fog of the lit fragment shaders, see LightsManager. The including shader declares
+// in_pos_world and defines LIGHTS_STORAGE_BINDING, the binding of the first light storage buffer, beforehand.
+
+#ifndef LIGHTING_GLSL
+#define LIGHTING_GLSL
+
+#include "features.glsl"
+
+struct Light
+{
+	vec3 pos;
+	float range;
+	vec3 color;
+	float inner_radius;
+	vec3 dir; // zero for point lights
+	float outer_radius;
+};
+
+layout(std140, binding = 1) uniform LightsUniform {
+	vec3 ambient_light_color;
+	uvec4 cluster_grid; // cluster counts in xyz, the light count in w
+	vec4 view_depth_row;
+	vec4 cluster_params; // 1 / viewport size in xy, depth slice scale and bias in zw
+	vec4 fog; // color in rgb, density in w
+} lights;
+
+layout(std430, binding = LIGHTS_STORAGE_BINDING) readonly buffer LightsBuffer {
+	Light lights[];
+} light_list;
+
+layout(std430, binding = LIGHTS_STORAGE_BINDING + 1) readonly buffer ClusterBuffer {
+	uvec2 clusters[]; // offset into the light indices and light count
+} light_clusters;
+
+layout(std430, binding = LIGHTS_STORAGE_BINDING + 2) readonly buffer LightIndexBuffer {
+	uint indices[];
+} light_indices;
+
+#ifndef BUILD_VULKAN
+// Same origin as vulkan, the clusters are numbered from the top of the screen
+layout(origin_upper_left) in vec4 gl_FragCoord;
+#endif
+
+vec3 ColorFromPointLight(Light light, vec3 normal)
+{
+	vec3 pos_to_light = normalize(light.pos - in_pos_world);
+	float light_ratio = max(dot(normal, pos_to_light), 0.0f);
+	float attenuation = pow(max(0.0f, 1.0f - distance(light.pos, in_pos_world) / light.range), 2.0f);
+	return light_ratio * attenuation * light.color;
+}
+
+vec3 ColorFromSpotLight(Light light, vec3 normal)
+{
+	vec3 pos_to_light = normalize(light.pos - in_pos_world);
+	float surface_ratio = max(0.0f, dot(-pos_to_light, light.dir));
+	float spot_factor = (surface_ratio > light.outer_radius && distance(light.pos, in_pos_world) < light.range) ? 1 : 0;
+	float light_ratio = max(0.0f, dot(pos_to_light, normal));
+	float attenuation = pow(1.0f - max(0.0f, (light.inner_radius - surface_ratio) / (light.inner_radius - light.outer_radius)), 2.0f);
+	return light_ratio * attenuation * spot_factor * light.color;
+}
+
+float GetViewDepth()
+{
+	return -dot(lights.view_depth_row, vec4(in_pos_world, 1.0));
+}
+
+// Offset and count of the lights in the fragment's cluster, the mapping has to match LightsManager
+uvec2 GetLightCluster()
+{
+	uvec3 grid = lights.cluster_grid.xyz;
+	float slice = log(max(GetViewDepth(), 0.0001f)) * lights.cluster_params.z - lights.cluster_params.w;
+	uint z = uint(clamp(slice, 0.0f, float(grid.z - 1)));
+	uvec2 xy = min(uvec2(gl_FragCoord.xy * lights.cluster_params.xy * vec2(grid.xy)), grid.xy - 1);
+	return light_clusters.clusters[(z * grid.y + xy.y) * grid.x + xy.x];
+}
+
+vec3 ColorFromClusterLights(vec3 normal)
+{
+	vec3 light_color = vec3(0.0f);
+	if (!FEATURE_POINT_LIGHTS && !FEATURE_SPOT_LIGHTS)
+		return light_color;
+
+	uvec2 cluster = GetLightCluster();
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		Light light = light_list.lights[light_indices.indices[cluster.x + i]];
+		if (light.dir == vec3(0.0f))
+		{
+			if (FEATURE_POINT_LIGHTS)
+				light_color += ColorFromPointLight(light, normal);
+		}
+		else if (FEATURE_SPOT_LIGHTS)
+		{
+			light_color += ColorFromSpotLight(light, normal);
+		}
+	}
+
+	return light_color;
+}
+
+// Fades to the fog color with the view depth
+vec3 ApplyFog(vec3 color)
+{
+	if (!FEATURE_FOG)
+		return color;
+
+	float fog_amount = 1.0f - exp(-lights.fog.w * GetViewDepth());
+	return mix(color, lights.fog.rgb, fog_amount);
+}
+
+#endif // LIGHTING_GLSL
@@ -2,23 +2,10 @@
 
 layout(binding = 0) uniform sampler2D msdf_texture;
 
-#ifdef BUILD_VULKAN
-layout(push_constant) uniform ObjectData {
-	float screen_px_range;
-	vec4 bg_color;
-	vec4 text_color;
-} obj_data;
-
-#else // OpenGL
-layout(std140, binding = 9) uniform ObjectDataFS {
-	float screen_px_range;
-	vec4 bg_color;
-	vec4 text_color;
-} obj_data;
-
-#endif
-
 layout(location = 0) in vec2 in_uv;
+layout(location = 1) flat in vec4 in_color;
+layout(location = 2) flat in vec4 in_bg_color;
+layout(location = 3) flat in vec4 in_params; // x: screen px range
 
 layout(location = 0) out vec4 out_frag_color;
 
@@ -31,8 +18,8 @@ void main()
 {
 	vec3 msd = texture(msdf_texture, in_uv).rgb;
 	float sd = median(msd.r, msd.g, msd.b);
-	float screen_px_dist = obj_data.screen_px_range * (sd - 0.5);
+	float screen_px_dist = in_params.x * (sd - 0.5);
 	float opacity = clamp(screen_px_dist + 0.5, 0.0, 1.0);
 
-	out_frag_color = mix(obj_data.bg_color, obj_data.text_color, opacity);
+	out_frag_color = mix(in_bg_color, in_color, opacity);
 }
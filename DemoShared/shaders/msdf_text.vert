@@ -1,13 +1,33 @@
 #version 420 core
 
-layout(location = 0) in vec2 in_pos;
-layout(location = 1) in vec2 in_uv;
+// One instance per glyph, see GlyphInstance
+layout(location = 0) in vec4 in_rect; // left, bottom, right, top
+layout(location = 1) in vec4 in_uv_rect;
+layout(location = 2) in vec4 in_color;
+layout(location = 3) in vec4 in_bg_color;
+layout(location = 4) in vec4 in_params;
 
 layout(location = 0) out vec2 out_uv;
+layout(location = 1) flat out vec4 out_color;
+layout(location = 2) flat out vec4 out_bg_color;
+layout(location = 3) flat out vec4 out_params;
 
 void main()
 {
-	out_uv = in_uv;
+#ifdef BUILD_VULKAN
+	int corner = gl_VertexIndex;
+#else
+	int corner = gl_VertexID;
+#endif
 
-	gl_Position = vec4(in_pos, 0.0, 1.0);
+	// The index buffer holds the corners of one quad: 0 top-left, 1 top-right, 2 bottom-left, 3 bottom-right
+	bool right = (corner & 1) != 0;
+	bool bottom = (corner & 2) != 0;
+
+	out_uv = vec2(right ? in_uv_rect.z : in_uv_rect.x, bottom ? in_uv_rect.y : in_uv_rect.w);
+	out_color = in_color;
+	out_bg_color = in_bg_color;
+	out_params = in_params;
+
+	gl_Position = vec4(right ? in_rect.z : in_rect.x, bottom ? in_rect.y : in_rect.w, 0.0, 1.0);
 }
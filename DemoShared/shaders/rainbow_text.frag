@@ -4,20 +4,12 @@ layout(binding = 0) uniform sampler2D msdf_texture;
 
 #ifdef BUILD_VULKAN
 layout(push_constant) uniform ObjectData {
-    vec4 bg_color;
-    float screen_px_range;
     float time;
-    float rainbow_width;
-    float slant_factor;
 } obj_data;
 
 #else // OpenGL
 layout(std140, binding = 9) uniform ObjectDataFS {
-	vec4 bg_color;
-	float screen_px_range;
 	float time;
-	float rainbow_width;
-	float slant_factor;
 } obj_data;
 
 #endif
@@ -26,6 +18,9 @@ layout(std140, binding = 9) uniform ObjectDataFS {
 layout(origin_upper_left) in vec4 gl_FragCoord;
 
 layout(location = 0) in vec2 in_uv;
+layout(location = 1) flat in vec4 in_color; // unused, the rainbow replaces it
+layout(location = 2) flat in vec4 in_bg_color;
+layout(location = 3) flat in vec4 in_params; // x: screen px range, y: rainbow width in pixels, z: slant factor
 
 layout(location = 0) out vec4 out_frag_color;
 
@@ -45,13 +40,13 @@ void main()
 {
     vec3 msd = texture(msdf_texture, in_uv).rgb;
     float sd = median(msd.r, msd.g, msd.b);
-    float screen_px_dist = obj_data.screen_px_range * (sd - 0.5);
+    float screen_px_dist = in_params.x * (sd - 0.5);
     float opacity = clamp(screen_px_dist + 0.5, 0.0, 1.0);
 
     // Use both x and y screen position for a slanted rainbow effect
-    float hue = mod(((gl_FragCoord.x + gl_FragCoord.y * obj_data.slant_factor) / obj_data.rainbow_width) + obj_data.time * 0.2, 1.0);
+    float hue = mod(((gl_FragCoord.x + gl_FragCoord.y * in_params.z) / in_params.y) + obj_data.time * 0.2, 1.0);
     vec3 rainbow = hsv_to_rgb(vec3(hue, 1.0, 1.0));
     vec4 rainbow_color = vec4(rainbow, 1.0);
 
-    out_frag_color = mix(obj_data.bg_color, rainbow_color, opacity);
+    out_frag_color = mix(in_bg_color, rainbow_color, opacity);
 }
@@ -1,42 +1,20 @@
 #version 450
-
-struct PointLight
-{
-	vec3 pos;
-	vec3 color;
-	float radius;
-};
-
-struct SpotLight
-{
-	vec3 pos;
-	vec3 dir;
-	vec3 color;
-	float inner_radius;
-	float outer_radius;
-};
-
-layout(std140, binding = 1) uniform LightsUniform {
-	vec3 ambient_light_color;
-
-	PointLight pointlight_1;
-	PointLight pointlight_2;
-	PointLight pointlight_3;
-
-	SpotLight spotlight_1;
-} lights;
+#extension GL_GOOGLE_include_directive : require
 
 layout(std140, binding = 2) uniform CameraUniform {
 	vec3 pos_world;
 } camera;
 
-layout(binding = 3) uniform samplerCube cube_map_sampler;
+layout(binding = 6) uniform samplerCube cube_map_sampler; // after the uniforms and the light storage buffers
 
 layout(location = 0) in vec3 in_pos_world;
 layout(location = 1) in vec3 in_normal_world;
 
 layout(location = 0) out vec4 out_frag_color;
 
+#define LIGHTS_STORAGE_BINDING 3
+#include "lighting.glsl"
+
 // returns a 90 degree x-axis rotation matrix
 mat3 get_z_correction_matrix()
 {
@@ -49,39 +27,16 @@ mat3 get_z_correction_matrix()
 	);
 }
 
-vec3 ColorFromPointLight(PointLight light, vec3 normal)
-{
-	vec3 pos_to_light = normalize(light.pos - in_pos_world);
-	float light_ratio = max(dot(normal, pos_to_light), 0.0f);
-	float attenuation = pow(1.0f - max(0.0f, distance(light.pos, in_pos_world) / light.radius), 2.0f);
-	return light_ratio * attenuation * light.color;
-}
-
-vec3 ColorFromSpotLight(SpotLight light, vec3 normal)
-{
-	vec3 pos_to_light = normalize(light.pos - in_pos_world);
-	float surface_ratio = max(0.0f, dot(-pos_to_light, light.dir));
-	float spot_factor = (surface_ratio > light.outer_radius) ? 1 : 0;
-	float light_ratio = max(0.0f, dot(pos_to_light, normal));
-	float attenuation = pow(1.0f - max(0.0f, (light.inner_radius - surface_ratio) / (light.inner_radius - light.outer_radius)), 2.0f);
-	return light_ratio * attenuation * spot_factor * light.color;
-}
-
 void main()
 {
 	vec3 normal = normalize(in_normal_world);
 
-	vec3 light_color = lights.ambient_light_color;
-
-	light_color += ColorFromPointLight(lights.pointlight_1, normal);
-	light_color += ColorFromPointLight(lights.pointlight_2, normal);
-	light_color += ColorFromPointLight(lights.pointlight_3, normal);
-
-	light_color += ColorFromSpotLight(lights.spotlight_1, normal);
+	vec3 light_color = lights.ambient_light_color + ColorFromClusterLights(normal);
 
 	vec3 camera_to_surface = in_pos_world - camera.pos_world;
 	vec3 reflect_dir = reflect(camera_to_surface, normal);
 	vec3 sample_dir = get_z_correction_matrix() * reflect_dir;
 
-	out_frag_color = texture(cube_map_sampler, sample_dir) * vec4(light_color, 1.0);
+	vec4 color = texture(cube_map_sampler, sample_dir) * vec4(light_color, 1.0);
+	out_frag_color = vec4(ApplyFog(color.rgb), color.a);
 }
@@ -13,7 +13,11 @@ module;
 module OpenGLApp;
 
 import GraphicsApi;
+import PlatformUtils;
 import Scene;
+import Trace;
+
+constexpr double TraceDumpSeconds = 10.0;
 
 OpenGLApp::OpenGLApp(WindowSize window_size_screen_coords, std::string const & title)
 	: m_title(title)
@@ -79,6 +83,8 @@ void OpenGLApp::Run()
 
 	std::jthread update_render_loop([this](std::stop_token s_token)
 		{
+			Trace::SetThreadName("Update/Render");
+
 			glfwMakeContextCurrent(m_window);
 			glfwSwapInterval(0); // vsync is sometimes on by default, disable it for more accurate timing measurements
 
@@ -98,10 +104,15 @@ void OpenGLApp::Run()
 				double delta_time = cur_time - last_update_time;
 				last_update_time = cur_time;
 
+				m_input.BeginFrame();
 				scene.Update(delta_time, m_input);
 
 				scene.Render();
-				glfwSwapBuffers(m_window);
+				{
+					Trace::Zone zone{ "glfwSwapBuffers" };
+					glfwSwapBuffers(m_window);
+				}
+				m_input.OnFramePresented();
 
 				WindowSize new_size = m_window_size_pixels.load();
 				if (new_size != size)
@@ -119,6 +130,8 @@ void OpenGLApp::Run()
 			}
 		});
 
+	Trace::SetThreadName("Main");
+
 	while (!glfwWindowShouldClose(m_window))
 		glfwPollEvents(); // must only be called from main thread
 }
@@ -128,6 +141,9 @@ void OpenGLApp::OnKeyEvent(int key, int /*scan_code*/, int action, int /*mods*/)
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(m_window, true);
 
+	if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+		Trace::DumpChromeTrace(PlatformUtils::GetExecutableDir() / "trace.json", TraceDumpSeconds);
+
 	if (action == GLFW_PRESS)
 		m_input.SetKey(key, true /*pressed*/);
 	else if (action == GLFW_RELEASE)
@@ -2,7 +2,8 @@
 
 module;
 
-#include <iostream>
+#include <cstddef>
+#include <utility>
 
 #include <glad/glad.h>
 
@@ -30,15 +31,17 @@ Buffer & Buffer::operator=(Buffer && other) noexcept
 	return *this;
 }
 
-void Buffer::Create()
+void Buffer::Create(std::size_t size, void const * data, GLbitfield flags /*= 0*/)
 {
 	Destroy();
 
-	glGenBuffers(1, &m_id);
+	glCreateBuffers(1, &m_id);
+	glNamedBufferStorage(m_id, static_cast<GLsizeiptr>(size), data, flags);
 }
 
 void Buffer::Destroy()
 {
 	if (m_id != 0)
 		glDeleteBuffers(1, &m_id);
+	m_id = 0;
 }
@@ -2,6 +2,10 @@
 
 module;
 
+#include <cstddef>
+
+#include <glad/glad.h>
+
 export module Buffer;
 
 export class Buffer
@@ -16,11 +20,12 @@ public:
 	Buffer(Buffer const &) = delete;
 	Buffer & operator=(Buffer const &) = delete;
 
-	void Create();
+	// Creates immutable storage, flags are the glNamedBufferStorage flags (0 for static data)
+	void Create(std::size_t size, void const * data, GLbitfield flags = 0);
 	void Destroy();
 
-	unsigned int GetId() const { return m_id; }
+	GLuint GetId() const { return m_id; }
 
 private:
-	unsigned int m_id = 0;
+	GLuint m_id = 0;
 };
@@ -0,0 +1,134 @@
+// GpuProfiler.cpp
+
+module;
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glad/glad.h>
+
+module GpuProfiler;
+
+constexpr std::uint32_t DroppedZone = std::numeric_limits<std::uint32_t>::max();
+
+GpuProfiler::GpuProfiler()
+{
+	for (FrameQueries & frame : m_frames)
+	{
+		glGenQueries(1, &frame.elapsed_query);
+		glGenQueries(static_cast<GLsizei>(frame.timestamp_queries.size()), frame.timestamp_queries.data());
+		frame.zones.reserve(m_max_zones_per_frame);
+	}
+
+	m_open_zones.reserve(m_max_zones_per_frame);
+	m_latest_timings.zones.reserve(m_max_zones_per_frame);
+	m_supported = true;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (FrameQueries & frame : m_frames)
+	{
+		glDeleteQueries(1, &frame.elapsed_query);
+		glDeleteQueries(static_cast<GLsizei>(frame.timestamp_queries.size()), frame.timestamp_queries.data());
+	}
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (!m_supported)
+		return;
+
+	FrameQueries & frame = m_frames[m_frame_index];
+
+	// If the gpu still hasn't finished this slot's frame we drop its results rather than waiting on them
+	if (frame.pending)
+		resolve(frame);
+
+	frame.zones.clear();
+	m_open_zones.clear();
+
+	glBeginQuery(GL_TIME_ELAPSED, frame.elapsed_query);
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!m_supported)
+		return;
+
+	while (!m_open_zones.empty())
+		EndZone();
+
+	glEndQuery(GL_TIME_ELAPSED);
+
+	m_frames[m_frame_index].pending = true;
+	m_frame_index = (m_frame_index + 1) % m_latency_frames;
+}
+
+void GpuProfiler::BeginZone(char const * name)
+{
+	if (!m_supported)
+		return;
+
+	FrameQueries & frame = m_frames[m_frame_index];
+	if (frame.zones.size() >= m_max_zones_per_frame)
+	{
+		m_open_zones.push_back(DroppedZone);
+		return;
+	}
+
+	std::uint32_t zone_index = static_cast<std::uint32_t>(frame.zones.size());
+	glQueryCounter(frame.timestamp_queries[zone_index * 2], GL_TIMESTAMP);
+
+	m_open_zones.push_back(zone_index);
+	frame.zones.push_back(Zone{ .name = name });
+}
+
+void GpuProfiler::EndZone()
+{
+	if (!m_supported || m_open_zones.empty())
+		return;
+
+	std::uint32_t zone_index = m_open_zones.back();
+	m_open_zones.pop_back();
+	if (zone_index == DroppedZone)
+		return;
+
+	FrameQueries & frame = m_frames[m_frame_index];
+	glQueryCounter(frame.timestamp_queries[zone_index * 2 + 1], GL_TIMESTAMP);
+	frame.zones[zone_index].ended = true;
+}
+
+bool GpuProfiler::resolve(FrameQueries & frame)
+{
+	frame.pending = false;
+
+	// The elapsed query ends after every timestamp of the frame, so once it's available the rest are too
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(frame.elapsed_query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available != GL_TRUE)
+		return false;
+
+	GLuint64 elapsed_ns = 0;
+	glGetQueryObjectui64v(frame.elapsed_query, GL_QUERY_RESULT, &elapsed_ns);
+	m_latest_timings.frame_ms = static_cast<double>(elapsed_ns) / 1'000'000.0;
+
+	m_latest_timings.zones.clear();
+	for (std::size_t i = 0; i < frame.zones.size(); ++i)
+	{
+		if (!frame.zones[i].ended)
+			continue;
+
+		GLuint64 begin_ns = 0, end_ns = 0;
+		glGetQueryObjectui64v(frame.timestamp_queries[i * 2], GL_QUERY_RESULT, &begin_ns);
+		glGetQueryObjectui64v(frame.timestamp_queries[i * 2 + 1], GL_QUERY_RESULT, &end_ns);
+
+		m_latest_timings.zones.push_back(GpuZoneTiming{
+			.name = frame.zones[i].name,
+			.ms = end_ns > begin_ns ? static_cast<double>(end_ns - begin_ns) / 1'000'000.0 : 0.0
+			});
+	}
+
+	return true;
+}
@@ -0,0 +1,76 @@
+// GpuProfiler.ixx
+
+module;
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+export module GpuProfiler;
+
+export struct GpuZoneTiming
+{
+	char const * name = nullptr;
+	double ms = 0.0;
+};
+
+export struct GpuFrameTimings
+{
+	double frame_ms = 0.0;
+	std::vector<GpuZoneTiming> zones;
+};
+
+// Measures the whole frame with a GL_TIME_ELAPSED query and named zones (e.g. pipeline buckets) with GL_TIMESTAMP queries.
+// Queries are kept in a ring of m_latency_frames frames and are only read back once they are available,
+// so reading results never stalls the cpu, a frame whose results aren't ready yet is simply skipped.
+export class GpuProfiler
+{
+public:
+	constexpr static std::uint32_t m_latency_frames = 3;
+	constexpr static std::uint32_t m_max_zones_per_frame = 64;
+
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(GpuProfiler const &) = delete;
+	GpuProfiler & operator=(GpuProfiler const &) = delete;
+
+	bool IsSupported() const { return m_supported; }
+
+	void BeginFrame();
+	void EndFrame();
+
+	// The name must outlive the profiler, string literals are expected
+	void BeginZone(char const * name);
+	void EndZone();
+
+	GpuFrameTimings const & GetLatestTimings() const { return m_latest_timings; }
+
+private:
+	struct Zone
+	{
+		char const * name = nullptr;
+		bool ended = false;
+	};
+
+	struct FrameQueries
+	{
+		std::uint32_t elapsed_query = 0;
+		// begin and end timestamp for every zone
+		std::array<std::uint32_t, m_max_zones_per_frame * 2> timestamp_queries{};
+		std::vector<Zone> zones;
+		bool pending = false;
+	};
+
+	bool resolve(FrameQueries & frame);
+
+private:
+	bool m_supported = false;
+
+	std::array<FrameQueries, m_latency_frames> m_frames;
+	std::uint32_t m_frame_index = 0;
+	std::vector<std::uint32_t> m_open_zones;
+
+	GpuFrameTimings m_latest_timings;
+};
@@ -65,6 +65,8 @@ GraphicsApi::GraphicsApi(LoadProcFn * load_proc_fn)
 	glDebugMessageCallback(debug_message_callback, 0);
 
 	glEnable(GL_FRAMEBUFFER_SRGB);
+
+	m_uniform_ring.Create(m_max_frames_in_flight, m_uniform_ring_frame_size);
 }
 
 GraphicsApi::~GraphicsApi()
@@ -2,11 +2,20 @@
 
 module;
 
+#include <cstdint>
+
 export module GraphicsApi;
 
+import StateCache;
+import UniformRing;
+import VertexArrayCache;
+
 export class GraphicsApi
 {
 public:
+	constexpr static std::uint32_t m_max_frames_in_flight = 3;
+	constexpr static std::uint32_t m_uniform_ring_frame_size = 1 << 20;
+
 	using LoadProcFn = void * (char const *);
 
 	explicit GraphicsApi(LoadProcFn * load_proc_fn);
@@ -15,4 +24,17 @@ public:
 	void SetViewport(int width_pixels, int height_pixels) const;
 
 	bool ShouldFlipScreenY() const { return false; }
+
+	// GL state is global to the context, so the cache lives here and is shared by everything that draws
+	StateCache & GetStateCache() const { return m_state_cache; }
+	// Per-object and per-frame uniform data is written here, the renderer moves it to the next frame
+	UniformRing & GetUniformRing() const { return m_uniform_ring; }
+	// Frame in flight being recorded, only valid once the renderer began the frame
+	std::uint32_t GetCurFrameIndex() const { return m_uniform_ring.GetFrameIndex(); }
+	VertexArrayCache & GetVertexArrayCache() const { return m_vertex_array_cache; }
+
+private:
+	mutable StateCache m_state_cache;
+	mutable UniformRing m_uniform_ring;
+	mutable VertexArrayCache m_vertex_array_cache;
 };
@@ -10,7 +10,11 @@ module;
 
 module GraphicsPipeline;
 
+import GraphicsApi;
 import GraphicsError;
+import StateCache;
+import StorageBuffer;
+import TextureTable;
 
 Program::~Program()
 {
@@ -42,14 +46,22 @@ void Program::Create()
 	m_id = glCreateProgram();
 }
 
-GraphicsPipeline::GraphicsPipeline(
-	PerFrameConstantsCallback per_frame_constants_callback,
-	PerObjectConstantsCallback per_object_constants_callback)
-	: m_per_frame_constants_callback(per_frame_constants_callback)
-	, m_per_object_constants_callback(per_object_constants_callback)
+GraphicsPipeline::GraphicsPipeline(GraphicsApi const & graphics_api)
+	: m_graphics_api(graphics_api)
 {
 }
 
+GLuint get_uniform_block_binding(GLuint program, char const * block_name)
+{
+	GLuint block_index = glGetUniformBlockIndex(program, block_name);
+	if (block_index == GL_INVALID_INDEX)
+		return 0;
+
+	GLint binding = 0;
+	glGetActiveUniformBlockiv(program, block_index, GL_UNIFORM_BLOCK_BINDING, &binding);
+	return static_cast<GLuint>(binding);
+}
+
 std::expected<void, GraphicsError> GraphicsPipeline::Create(
 	unsigned int vert_shader_id,
 	unsigned int frag_shader_id,
@@ -57,7 +69,9 @@ std::expected<void, GraphicsError> GraphicsPipeline::Create(
 	size_t fs_object_uniform_size,
 	std::vector<size_t> vs_uniform_sizes,
 	std::vector<size_t> fs_uniform_sizes,
+	std::vector<StorageBuffer const *> const & fs_storage_buffers,
 	Texture const * texture,
+	TextureTable const * texture_table,
 	DepthTestOptions const & depth_options,
 	BlendOptions const & blend_options,
 	CullMode cull_mode)
@@ -65,6 +79,7 @@ std::expected<void, GraphicsError> GraphicsPipeline::Create(
 	m_depth_test_options = depth_options;
 	m_blend_options = blend_options;
 	m_cull_mode = cull_mode;
+	m_texture_table = texture_table;
 
 	m_program.Create();
 	glAttachShader(m_program.GetId(), vert_shader_id);
@@ -82,38 +97,25 @@ std::expected<void, GraphicsError> GraphicsPipeline::Create(
 
 	if (vs_object_uniform_size > 0)
 	{
-		m_vs_object_uniform.buffer.Create();
-		m_vs_object_uniform.size = vs_object_uniform_size;
-		glBindBuffer(GL_UNIFORM_BUFFER, m_vs_object_uniform.buffer.GetId());
-		glBufferData(GL_UNIFORM_BUFFER, m_vs_object_uniform.size, nullptr, GL_DYNAMIC_DRAW);
+		m_vs_object_binding = get_uniform_block_binding(m_program.GetId(), "ObjectDataVS");
+		m_vs_object_uniform_size = vs_object_uniform_size;
 	}
 	if (fs_object_uniform_size > 0)
 	{
-		m_fs_object_uniform.buffer.Create();
-		m_fs_object_uniform.size = fs_object_uniform_size;
-		glBindBuffer(GL_UNIFORM_BUFFER, m_fs_object_uniform.buffer.GetId());
-		glBufferData(GL_UNIFORM_BUFFER, m_fs_object_uniform.size, nullptr, GL_DYNAMIC_DRAW);
+		m_fs_object_binding = get_uniform_block_binding(m_program.GetId(), "ObjectDataFS");
+		m_fs_object_uniform_size = fs_object_uniform_size;
 	}
 
-	std::vector<size_t> uniform_sizes{ vs_uniform_sizes };
+	std::vector<size_t> & uniform_sizes = m_descriptor_set.uniform_sizes;
+	uniform_sizes = vs_uniform_sizes;
 	uniform_sizes.insert(uniform_sizes.end(), fs_uniform_sizes.begin(), fs_uniform_sizes.end());
 
-	m_descriptor_set.uniform_buffers.reserve(uniform_sizes.size());
-	for (size_t binding = 0; binding < uniform_sizes.size(); ++binding)
-	{
-		UniformBuffer & uniform = m_descriptor_set.uniform_buffers.emplace_back();
-		uniform.buffer.Create();
-		uniform.size = uniform_sizes[binding];
-		glBindBuffer(GL_UNIFORM_BUFFER, uniform.buffer.GetId());
-		glBufferData(GL_UNIFORM_BUFFER, uniform.size, nullptr, GL_DYNAMIC_DRAW);
-	}
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	m_descriptor_set.storage_buffers = fs_storage_buffers;
 
 	if (texture && texture->IsValid())
 	{
-		m_descriptor_set.texture_binding = uniform_sizes.size();
+		m_descriptor_set.texture_binding = uniform_sizes.size() + fs_storage_buffers.size();
 		m_descriptor_set.texture_id = texture->GetId();
-		m_descriptor_set.texture_type = texture->GetType();
 	}
 
 	return {};
@@ -124,51 +126,34 @@ void GraphicsPipeline::Activate() const
 	if (m_program.GetId() == 0)
 		return;
 
+	StateCache & state_cache = m_graphics_api.get().GetStateCache();
+
+	state_cache.SetDepthTest(m_depth_test_options.enable_depth_test);
 	if (m_depth_test_options.enable_depth_test)
 	{
-		glEnable(GL_DEPTH_TEST);
-		glDepthMask(m_depth_test_options.enable_depth_write ? GL_TRUE : GL_FALSE);
-		glDepthFunc(static_cast<GLenum>(m_depth_test_options.depth_compare_op));
-	}
-	else
-	{
-		glDisable(GL_DEPTH_TEST);
+		state_cache.SetDepthWrite(m_depth_test_options.enable_depth_write);
+		state_cache.SetDepthFunc(static_cast<GLenum>(m_depth_test_options.depth_compare_op));
 	}
 
+	state_cache.SetBlend(m_blend_options.enable_blend);
 	if (m_blend_options.enable_blend)
-	{
-		glEnable(GL_BLEND);
-		glBlendFunc(static_cast<GLenum>(m_blend_options.src_factor), static_cast<GLenum>(m_blend_options.dst_factor));
-	}
-	else
-	{
-		glDisable(GL_BLEND);
-	}
+		state_cache.SetBlendFunc(static_cast<GLenum>(m_blend_options.src_factor), static_cast<GLenum>(m_blend_options.dst_factor));
 
-	if (m_cull_mode != CullMode::NONE)
-	{
-		glEnable(GL_CULL_FACE);
-		glCullFace(static_cast<GLenum>(m_cull_mode));
-	}
-	else
+	state_cache.SetCullMode(static_cast<GLenum>(m_cull_mode));
+
+	state_cache.UseProgram(m_program.GetId());
+
+	GLuint storage_binding = static_cast<GLuint>(m_descriptor_set.uniform_sizes.size());
+	for (StorageBuffer const * storage_buffer : m_descriptor_set.storage_buffers)
 	{
-		glDisable(GL_CULL_FACE);
+		// The region of the frame being recorded, see StorageBuffer
+		state_cache.BindStorageBufferRange(storage_binding++, storage_buffer->GetId(),
+			storage_buffer->GetFrameOffset(), static_cast<GLsizeiptr>(storage_buffer->GetSize()));
 	}
 
-	glUseProgram(m_program.GetId());
-
 	if (m_descriptor_set.texture_id != 0)
-		Texture::Bind(m_descriptor_set.texture_id, m_descriptor_set.texture_type, m_descriptor_set.texture_binding);
-}
+		state_cache.BindTexture(m_descriptor_set.texture_binding, m_descriptor_set.texture_id);
 
-void GraphicsPipeline::UpdatePerFrameConstants() const
-{
-	if (m_per_frame_constants_callback)
-		m_per_frame_constants_callback(*this);
-}
-
-void GraphicsPipeline::UpdatePerObjectConstants(void const * object_data) const
-{
-	if (m_per_object_constants_callback)
-		m_per_object_constants_callback(*this, object_data);
+	if (m_texture_table)
+		m_texture_table->Bind(state_cache);
 }
@@ -2,6 +2,8 @@
 
 module;
 
+#include <cstdint>
+#include <cstring>
 #include <expected>
 #include <filesystem>
 #include <functional>
@@ -12,22 +14,22 @@ module;
 
 export module GraphicsPipeline;
 
-import Buffer;
+import GraphicsApi;
 import GraphicsError;
+import StateCache;
+import StorageBuffer;
 import Texture;
-
-struct UniformBuffer
-{
-	Buffer buffer;
-	size_t size = 0;
-};
+import TextureTable;
+import UniformRing;
 
 struct DescriptorSet
 {
-	std::vector<UniformBuffer> uniform_buffers;
+	// Uniform data lives in the GraphicsApi's uniform ring, only the expected sizes are kept here
+	std::vector<size_t> uniform_sizes;
+	// Bound right after the uniforms, so the bindings match the vulkan descriptor set of the same shaders
+	std::vector<StorageBuffer const *> storage_buffers;
 	unsigned int texture_binding = 0;
 	unsigned int texture_id = 0;
-	unsigned int texture_type = 0;
 };
 
 export enum class DepthCompareOp
@@ -105,12 +107,7 @@ private:
 export class GraphicsPipeline
 {
 public:
-	using PerFrameConstantsCallback = std::function<void(GraphicsPipeline const & pipeline)>;
-	using PerObjectConstantsCallback = std::function<void(GraphicsPipeline const & pipeline, void const * object_data)>;
-
-	explicit GraphicsPipeline(
-		PerFrameConstantsCallback per_frame_constants_callback,
-		PerObjectConstantsCallback per_object_constants_callback);
+	explicit GraphicsPipeline(GraphicsApi const & graphics_api);
 	~GraphicsPipeline() = default;
 
 	GraphicsPipeline(GraphicsPipeline && other) = default;
@@ -126,7 +123,9 @@ public:
 		size_t fs_object_uniform_size,
 		std::vector<size_t> vs_uniform_sizes,
 		std::vector<size_t> fs_uniform_sizes,
+		std::vector<StorageBuffer const *> const & fs_storage_buffers,
 		Texture const * texture,
+		TextureTable const * texture_table,
 		DepthTestOptions const & depth_options,
 		BlendOptions const & blend_options,
 		CullMode cull_mode);
@@ -134,8 +133,6 @@ public:
 	bool IsValid() const { return m_program.GetId() != 0; }
 
 	void Activate() const;
-	void UpdatePerFrameConstants() const;
-	void UpdatePerObjectConstants(void const * object_data) const;
 
 	template <typename UniformData>
 	void SetUniform(std::uint32_t binding, UniformData const & data) const;
@@ -144,51 +141,53 @@ public:
 	void SetObjectData(ObjectDataVS const & vs_data, ObjectDataFS const & fs_data) const;
 
 private:
+	std::reference_wrapper<GraphicsApi const> m_graphics_api;
+
 	Program m_program;
 
 	DescriptorSet m_descriptor_set;
-	UniformBuffer m_vs_object_uniform;
-	UniformBuffer m_fs_object_uniform;
+	TextureTable const * m_texture_table = nullptr;
+	size_t m_vs_object_uniform_size = 0;
+	size_t m_fs_object_uniform_size = 0;
+
+	// Block bindings of ObjectDataVS and ObjectDataFS, looked up once when the program is linked
+	GLuint m_vs_object_binding = 0;
+	GLuint m_fs_object_binding = 0;
 
 	DepthTestOptions m_depth_test_options;
 	BlendOptions m_blend_options;
 	CullMode m_cull_mode = CullMode::NONE;
-
-	PerFrameConstantsCallback m_per_frame_constants_callback;
-	PerObjectConstantsCallback m_per_object_constants_callback;
 };
 
 template <typename UniformData>
-void set_uniform(std::uint32_t binding, UniformBuffer const & uniform, UniformData const & data)
+void set_uniform(GraphicsApi const & graphics_api, std::uint32_t binding, size_t uniform_size, UniformData const & data)
 {
-	if (uniform.buffer.GetId() == 0)
-	{
-		std::cout << "Uniform buffer not initialized for binding: " << binding << std::endl;
-		return;
-	}
-	if (uniform.size != sizeof(data))
+	if (uniform_size != sizeof(data))
 	{
 		std::cout << "Uniform buffer size is different from data size: " << binding << std::endl;
 		return;
 	}
 
-	glBindBuffer(GL_UNIFORM_BUFFER, uniform.buffer.GetId());
-	glBindBufferBase(GL_UNIFORM_BUFFER, binding, uniform.buffer.GetId());
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), &data);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	UniformRing & uniform_ring = graphics_api.GetUniformRing();
+	std::optional<UniformAllocation> allocation = uniform_ring.Allocate(sizeof(data));
+	if (!allocation)
+		return;
+
+	// The ring is mapped coherently, so the write is visible to draws issued after it without any gl call
+	std::memcpy(allocation->mapping, &data, sizeof(data));
+	graphics_api.GetStateCache().BindUniformBufferRange(binding, uniform_ring.GetBufferId(), allocation->offset, sizeof(data));
 }
 
 template <typename UniformData>
 void GraphicsPipeline::SetUniform(std::uint32_t binding, UniformData const & data) const
 {
-	if (binding >= m_descriptor_set.uniform_buffers.size())
+	if (binding >= m_descriptor_set.uniform_sizes.size())
 	{
 		std::cout << "Invalid uniform binding: " << binding << std::endl;
 		return;
 	}
 
-	UniformBuffer const & uniform = m_descriptor_set.uniform_buffers[binding];
-	set_uniform(binding, uniform, data);
+	set_uniform(m_graphics_api.get(), binding, m_descriptor_set.uniform_sizes[binding], data);
 }
 
 template <typename ObjectDataVS /*= std::nullopt_t*/, typename ObjectDataFS /*= std::nullopt_t*/>
@@ -198,18 +197,8 @@ void GraphicsPipeline::SetObjectData(ObjectDataVS const & vs_data, ObjectDataFS
 		"At least one object data must be provided");
 
 	if constexpr (!std::same_as<ObjectDataVS, std::nullopt_t>)
-	{
-		GLuint blockIndex = glGetUniformBlockIndex(m_program.GetId(), "ObjectDataVS");
-		GLint binding = 0;
-		glGetActiveUniformBlockiv(m_program.GetId(), blockIndex, GL_UNIFORM_BLOCK_BINDING, &binding);
-		set_uniform(binding, m_vs_object_uniform, vs_data);
-	}
+		set_uniform(m_graphics_api.get(), m_vs_object_binding, m_vs_object_uniform_size, vs_data);
 
 	if constexpr (!std::same_as<ObjectDataFS, std::nullopt_t>)
-	{
-		GLuint blockIndex = glGetUniformBlockIndex(m_program.GetId(), "ObjectDataFS");
-		GLint binding = 0;
-		glGetActiveUniformBlockiv(m_program.GetId(), blockIndex, GL_UNIFORM_BLOCK_BINDING, &binding);
-		set_uniform(binding, m_fs_object_uniform, fs_data);
-	}
+		set_uniform(m_graphics_api.get(), m_fs_object_binding, m_fs_object_uniform_size, fs_data);
 }
@@ -2,59 +2,63 @@
 
 module;
 
+#include <algorithm>
 #include <cstdint>
-#include <utility>
+#include <span>
 
 #include <glad/glad.h>
 
 module Mesh;
 
-VertexArrayObject::~VertexArrayObject()
-{
-	if (m_id != 0)
-		glDeleteVertexArrays(1, &m_id);
-}
+import StateCache;
 
-VertexArrayObject::VertexArrayObject(VertexArrayObject && other)
+bool Mesh::IsInitialized() const
 {
-	*this = std::move(other);
+	return m_vao != 0
+		&& (m_vertex_buffer.GetId() != 0 || IsDynamic())
+		&& m_element_buffer.GetId() != 0
+		&& !m_lods.empty();
 }
 
-VertexArrayObject & VertexArrayObject::operator=(VertexArrayObject && other)
+void Mesh::SetIndexCount(std::uint32_t index_count)
 {
-	if (this != &other)
-	{
-		if (m_id != 0)
-			glDeleteVertexArrays(1, &m_id);
+	if (!IsDynamic() || m_lods.empty())
+		return;
 
-		std::swap(m_id, other.m_id);
-	}
-	return *this;
+	// The indices are laid out for the full capacity, this only picks how many of them are drawn
+	m_lods[0].index_count = std::min(index_count, m_index_capacity);
 }
 
-void VertexArrayObject::Create()
+void Mesh::Render(std::uint32_t lod /*= 0*/) const
 {
-	glGenVertexArrays(1, &m_id);
-}
+	if (!IsInitialized())
+		return;
 
-bool Mesh::IsInitialized() const
-{
-	return m_vao.GetId() != 0
-		&& m_vertex_buffer.GetId() != 0
-		&& m_element_buffer.GetId() != 0
-		&& m_index_count > 0;
+	MeshLod const & mesh_lod = m_lods[std::min(lod, GetLodCount() - 1)];
+	MeshIndexRange const range{ .first_index = mesh_lod.first_index, .index_count = mesh_lod.index_count };
+	Render(std::span<MeshIndexRange const>{ &range, 1 });
 }
 
-void Mesh::Render() const
+void Mesh::Render(std::span<MeshIndexRange const> ranges) const
 {
-	if (!IsInitialized())
+	if (!IsInitialized() || ranges.empty() || m_instance_count == 0)
 		return;
 
-	glBindVertexArray(m_vao.GetId());
-
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	StateCache & state_cache = m_graphics_api.get().GetStateCache();
+	state_cache.SetPolygonMode(GL_FILL);
+	state_cache.BindVertexArray(m_vao);
+	GLuint const vertex_buffer = IsDynamic()
+		? m_frame_vertex_buffers[m_graphics_api.get().GetCurFrameIndex()].GetId()
+		: m_vertex_buffer.GetId();
+	state_cache.BindVertexBuffer(m_vao, vertex_buffer, m_vertex_stride);
+	state_cache.BindElementBuffer(m_vao, m_element_buffer.GetId());
 
 	static_assert(std::is_same_v<IndexT, std::uint16_t>,
 		"Mesh::Render only supports 16-bit indices");
-	glDrawElements(GL_TRIANGLES, m_index_count, GL_UNSIGNED_SHORT, nullptr);
+	for (MeshIndexRange const & range : ranges)
+	{
+		glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(range.index_count), GL_UNSIGNED_SHORT,
+			reinterpret_cast<void const *>(std::uintptr_t{ range.first_index } * sizeof(IndexT)),
+			static_cast<GLsizei>(m_instance_count));
+	}
 }
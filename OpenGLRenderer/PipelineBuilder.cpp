@@ -2,9 +2,14 @@
 
 module;
 
+#include <algorithm>
+#include <cstddef>
 #include <expected>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <glad/glad.h>
@@ -13,6 +18,7 @@ module PipelineBuilder;
 
 import GraphicsApi;
 import GraphicsError;
+import ShaderVariant;
 
 std::expected<std::vector<char>, GraphicsError> read_file(std::filesystem::path const & path)
 {
@@ -30,20 +36,87 @@ std::expected<std::vector<char>, GraphicsError> read_file(std::filesystem::path
 	return buffer;
 }
 
-std::expected<unsigned int, GraphicsError> load_shader(
-	GLenum shader_type,
-	std::filesystem::path const & shader_path)
+// Inlines the #include "file" lines of a shader, paths are relative to the including file. The vulkan shaders
+// get the same from glslang with GL_GOOGLE_include_directive, its #extension line is dropped here.
+std::expected<std::string, GraphicsError> resolve_includes(std::filesystem::path const & shader_path, int depth = 0)
 {
+	constexpr int max_include_depth = 8;
+	if (depth > max_include_depth)
+		return std::unexpected{ GraphicsError{ "Shader includes are nested too deep: " + shader_path.string() } };
+
 	std::expected<std::vector<char>, GraphicsError> read_result = read_file(shader_path);
 	if (!read_result.has_value())
 		return std::unexpected{ read_result.error() };
 
-	std::vector<char> & file_data = read_result.value();
-	if (file_data.empty())
+	std::vector<char> const & file_data = read_result.value();
+	std::istringstream stream{ std::string{ file_data.begin(), file_data.end() } };
+
+	std::string source;
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::string_view directive{ line };
+		directive.remove_prefix(std::min(directive.find_first_not_of(" \t"), directive.size()));
+
+		if (directive.starts_with("#extension GL_GOOGLE_include_directive"))
+			continue;
+
+		if (directive.starts_with("#include"))
+		{
+			std::size_t name_begin = directive.find('"');
+			std::size_t name_end = directive.rfind('"');
+			if (name_begin == std::string_view::npos || name_end <= name_begin)
+				return std::unexpected{ GraphicsError{ "Invalid shader include in " + shader_path.string() + ": " + line } };
+
+			std::filesystem::path include_path = shader_path.parent_path() / directive.substr(name_begin + 1, name_end - name_begin - 1);
+			std::expected<std::string, GraphicsError> include_result = resolve_includes(include_path, depth + 1);
+			if (!include_result.has_value())
+				return std::unexpected{ include_result.error() };
+
+			source += include_result.value();
+			continue;
+		}
+
+		source += line;
+		source += '\n';
+	}
+
+	return source;
+}
+
+// Defines SHADER_FEATURE_<name> to 0 or 1 for every feature, right after the #version line that has to come first
+void add_variant_defines(std::string & source, ShaderVariant const & variant)
+{
+	std::string defines;
+	for (std::size_t i = 0; i < shader_feature_names.size(); ++i)
+	{
+		bool enabled = variant.Has(static_cast<ShaderFeature>(i));
+		defines += std::string{ "#define SHADER_FEATURE_" } + shader_feature_names[i] + (enabled ? " 1\n" : " 0\n");
+	}
+
+	// resolve_includes ends every line with a newline
+	std::size_t version_pos = source.find("#version");
+	std::size_t insert_pos = version_pos == std::string::npos ? 0 : source.find('\n', version_pos) + 1;
+	source.insert(insert_pos, defines);
+}
+
+std::expected<unsigned int, GraphicsError> load_shader(
+	GLenum shader_type,
+	std::filesystem::path const & shader_path,
+	ShaderVariant const & variant)
+{
+	std::expected<std::string, GraphicsError> source_result = resolve_includes(shader_path);
+	if (!source_result.has_value())
+		return std::unexpected{ source_result.error() };
+
+	std::string & source = source_result.value();
+	if (source.empty())
 		return std::unexpected{ GraphicsError{ "Shader file was empty: " + shader_path.string() } };
 
-	const GLchar * shader_source = file_data.data();
-	GLint length = static_cast<GLint>(file_data.size());
+	add_variant_defines(source, variant);
+
+	const GLchar * shader_source = source.data();
+	GLint length = static_cast<GLint>(source.size());
 
 	unsigned int shader_id = glCreateShader(shader_type); // returns 0 on error
 	glShaderSource(shader_id, 1, &shader_source, &length);
@@ -69,13 +142,16 @@ PipelineBuilder::~PipelineBuilder()
 	m_frag_shader_id = 0;
 }
 
-std::expected<void, GraphicsError> PipelineBuilder::LoadShaders(std::filesystem::path const & vs_path, std::filesystem::path const & fs_path)
+std::expected<void, GraphicsError> PipelineBuilder::LoadShaders(
+	std::filesystem::path const & vs_path,
+	std::filesystem::path const & fs_path,
+	ShaderVariant const & variant /*= {}*/)
 {
-	std::expected<unsigned int, GraphicsError> vert_shader_result = load_shader(GL_VERTEX_SHADER, vs_path);
+	std::expected<unsigned int, GraphicsError> vert_shader_result = load_shader(GL_VERTEX_SHADER, vs_path, variant);
 	if (!vert_shader_result.has_value())
 		return std::unexpected{ vert_shader_result.error() };
 
-	std::expected<unsigned int, GraphicsError> frag_shader_result = load_shader(GL_FRAGMENT_SHADER, fs_path);
+	std::expected<unsigned int, GraphicsError> frag_shader_result = load_shader(GL_FRAGMENT_SHADER, fs_path, variant);
 	if (!frag_shader_result.has_value())
 		return std::unexpected{ frag_shader_result.error() };
 
@@ -94,10 +170,7 @@ std::expected<GraphicsPipeline, GraphicsError> PipelineBuilder::CreatePipeline()
 	if (!m_cull_mode.has_value())
 		return std::unexpected{ GraphicsError{ "Cull mode not set" } };
 
-	GraphicsPipeline pipeline{
-		m_per_frame_constants_callback,
-		m_per_object_constants_callback
-	};
+	GraphicsPipeline pipeline{ m_graphics_api };
 
 	std::expected<void, GraphicsError> result = pipeline.Create(
 		m_vert_shader_id,
@@ -106,7 +179,9 @@ std::expected<GraphicsPipeline, GraphicsError> PipelineBuilder::CreatePipeline()
 		m_fs_object_uniform_size,
 		m_vs_uniform_sizes,
 		m_fs_uniform_sizes,
+		m_fs_storage_buffers,
 		m_texture,
+		m_texture_table,
 		m_depth_test_options,
 		m_blend_options,
 		m_cull_mode.value());
@@ -5,6 +5,7 @@ module;
 #include <expected>
 #include <filesystem>
 #include <optional>
+#include <utility>
 #include <vector>
 
 export module PipelineBuilder;
@@ -12,19 +13,23 @@ export module PipelineBuilder;
 import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
+import ShaderVariant;
+import StorageBuffer;
 import Texture;
+import TextureTable;
 import VertexLayout;
 
 export class PipelineBuilder
 {
 public:
-	using PerFrameConstantsCallback = GraphicsPipeline::PerFrameConstantsCallback;
-	using PerObjectConstantsCallback = GraphicsPipeline::PerObjectConstantsCallback;
-
-	explicit PipelineBuilder(GraphicsApi const & /*graphics_api*/) {}
+	explicit PipelineBuilder(GraphicsApi const & graphics_api) : m_graphics_api(graphics_api) {}
 	~PipelineBuilder();
 
-	std::expected<void, GraphicsError> LoadShaders(std::filesystem::path const & vs_path, std::filesystem::path const & fs_path);
+	// Features missing from the variant are compiled out of the shaders, see ShaderVariant
+	std::expected<void, GraphicsError> LoadShaders(
+		std::filesystem::path const & vs_path,
+		std::filesystem::path const & fs_path,
+		ShaderVariant const & variant = {});
 
 	template <Vertex::VertexWithLayout VertexT>
 	void SetVertexType();
@@ -38,17 +43,20 @@ public:
 	template <typename... UniformTypes>
 	void SetFSUniformTypes();
 
+	// Bound after the fs uniforms, in order, the buffers have to outlive the pipeline
+	void SetFSStorageBuffers(std::vector<StorageBuffer const *> storage_buffers) { m_fs_storage_buffers = std::move(storage_buffers); }
 	void SetTexture(Texture const & texture) { m_texture = &texture; }
+	// Textures picked per object by an index into the table, see TextureTable
+	void SetTextureTable(TextureTable const & texture_table) { m_texture_table = &texture_table; }
 	void SetDepthTestOptions(DepthTestOptions const & options) { m_depth_test_options = options; }
 	void SetCullMode(CullMode cull_mode) { m_cull_mode = cull_mode; }
 	void SetBlendOptions(BlendOptions const & options) { m_blend_options = options; }
 
-	void SetPerFrameConstantsCallback(PerFrameConstantsCallback callback) { m_per_frame_constants_callback = callback; }
-	void SetPerObjectConstantsCallback(PerObjectConstantsCallback callback) { m_per_object_constants_callback = callback; }
-
 	std::expected<GraphicsPipeline, GraphicsError> CreatePipeline() const;
 
 private:
+	GraphicsApi const & m_graphics_api;
+
 	unsigned int m_vert_shader_id = 0;
 	unsigned int m_frag_shader_id = 0;
 
@@ -56,7 +64,9 @@ private:
 	size_t m_fs_object_uniform_size = 0;
 	std::vector<size_t> m_vs_uniform_sizes;
 	std::vector<size_t> m_fs_uniform_sizes;
+	std::vector<StorageBuffer const *> m_fs_storage_buffers;
 	Texture const * m_texture = nullptr;
+	TextureTable const * m_texture_table = nullptr;
 
 	DepthTestOptions m_depth_test_options;
 	BlendOptions m_blend_options;
@@ -64,9 +74,6 @@ private:
 	// PipelineBuilder does not have a default state for the cull mode, a null optional here means "not set yet".
 	// PipelineBuilder requires the cull mode to be set explicitly before calling CreatePipeline().
 	std::optional<CullMode> m_cull_mode;
-
-	PerFrameConstantsCallback m_per_frame_constants_callback;
-	PerObjectConstantsCallback m_per_object_constants_callback;
 };
 
 template <Vertex::VertexWithLayout VertexT>
@@ -2,27 +2,137 @@
 
 module;
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
 #include <glad/glad.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 
 module Renderer;
 
+import StateCache;
+import UniformRing;
+
 Renderer::Renderer(GraphicsApi const & graphics_api)
 	: m_graphics_api(graphics_api)
 {
 }
 
-void Renderer::BeginDraw() const
+Renderer::~Renderer()
+{
+	destroy_scene_target();
+}
+
+void Renderer::OnViewportResized(int width, int height)
 {
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_TRUE);
-	glDepthFunc(GL_LESS);
+	m_viewport_size = glm::ivec2{ std::max(width, 1), std::max(height, 1) };
+	destroy_scene_target();
+}
+
+void Renderer::SetRenderScale(float scale)
+{
+	m_render_scale = std::clamp(scale, 0.01f, 1.0f);
+}
+
+glm::ivec2 Renderer::GetSceneSize() const
+{
+	return glm::ivec2{
+		std::max(static_cast<int>(std::lround(m_viewport_size.x * m_render_scale)), 1),
+		std::max(static_cast<int>(std::lround(m_viewport_size.y * m_render_scale)), 1)
+	};
+}
+
+bool Renderer::create_scene_target()
+{
+	glCreateRenderbuffers(1, &m_scene_color_buffer);
+	glNamedRenderbufferStorage(m_scene_color_buffer, GL_SRGB8_ALPHA8, m_viewport_size.x, m_viewport_size.y);
+
+	glCreateRenderbuffers(1, &m_scene_depth_buffer);
+	glNamedRenderbufferStorage(m_scene_depth_buffer, GL_DEPTH_COMPONENT24, m_viewport_size.x, m_viewport_size.y);
+
+	glCreateFramebuffers(1, &m_scene_framebuffer);
+	glNamedFramebufferRenderbuffer(m_scene_framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_scene_color_buffer);
+	glNamedFramebufferRenderbuffer(m_scene_framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_scene_depth_buffer);
+
+	if (glCheckNamedFramebufferStatus(m_scene_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Renderer: failed to create the scene target, drawing at native resolution" << std::endl;
+		destroy_scene_target();
+		m_render_scale = 1.0f;
+		return false;
+	}
+
+	return true;
+}
+
+void Renderer::destroy_scene_target()
+{
+	glDeleteFramebuffers(1, &m_scene_framebuffer);
+	glDeleteRenderbuffers(1, &m_scene_color_buffer);
+	glDeleteRenderbuffers(1, &m_scene_depth_buffer);
+	m_scene_framebuffer = 0;
+	m_scene_color_buffer = 0;
+	m_scene_depth_buffer = 0;
+}
+
+void Renderer::BeginDraw()
+{
+	m_gpu_profiler.BeginFrame();
+	m_graphics_api.GetUniformRing().BeginFrame();
+
+	// Anything may have touched the GL state since the last frame (resource creation, the window system)
+	StateCache & state_cache = m_graphics_api.GetStateCache();
+	state_cache.BeginFrame();
+
+	glm::ivec2 scene_size = GetSceneSize();
+	m_drawing_scene_target = scene_size != m_viewport_size && (m_scene_framebuffer != 0 || create_scene_target());
+	if (m_drawing_scene_target)
+	{
+		// The scene goes to the top of the target, the shaders use an upper left gl_FragCoord origin
+		// that is relative to the framebuffer, so this keeps it in [0, scene_size) like it is in vulkan
+		glBindFramebuffer(GL_FRAMEBUFFER, m_scene_framebuffer);
+		glViewport(0, m_viewport_size.y - scene_size.y, scene_size.x, scene_size.y);
+	}
+	else
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_viewport_size.x, m_viewport_size.y);
+	}
+
+	// Depth writes have to be enabled for the depth clear
+	state_cache.SetDepthTest(true);
+	state_cache.SetDepthWrite(true);
+	state_cache.SetDepthFunc(GL_LESS);
 
 	glClearColor(m_clear_color.r, m_clear_color.g, m_clear_color.b, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void Renderer::EndDraw() const
+void Renderer::BeginOverlay()
+{
+	if (!m_drawing_scene_target)
+		return;
+	m_drawing_scene_target = false;
+
+	glm::ivec2 scene_size = GetSceneSize();
+	glBlitNamedFramebuffer(
+		m_scene_framebuffer,
+		0, // default framebuffer
+		0, m_viewport_size.y - scene_size.y, scene_size.x, m_viewport_size.y,
+		0, 0, m_viewport_size.x, m_viewport_size.y,
+		GL_COLOR_BUFFER_BIT,
+		GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_viewport_size.x, m_viewport_size.y);
+}
+
+void Renderer::EndDraw()
 {
+	BeginOverlay(); // in case nothing was drawn in the overlay
+
+	m_graphics_api.GetUniformRing().EndFrame();
+	m_gpu_profiler.EndFrame();
 }
@@ -2,25 +2,68 @@
 
 module;
 
+#include <glad/glad.h>
+
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
 export module Renderer;
 
+import GpuProfiler;
 import GraphicsApi;
 import GraphicsError;
+import StateCache;
 
+// Draws a frame in two parts: the scene passes between BeginDraw and BeginOverlay, and the overlay (2d text) between
+// BeginOverlay and EndDraw. With a render scale below 1 the scene is drawn to an offscreen target at the scaled
+// resolution, which BeginOverlay upscales to the window with a filtered blit, the overlay stays at native resolution.
 export class Renderer
 {
 public:
 	explicit Renderer(GraphicsApi const & graphics_api);
+	~Renderer();
+
+	Renderer(Renderer const &) = delete;
+	Renderer & operator=(Renderer const &) = delete;
+
+	// Size of the default framebuffer
+	void OnViewportResized(int width, int height);
 
-	void BeginDraw() const;
-	void EndDraw() const;
+	// Clamped to (0, 1], see ResolutionScaler
+	void SetRenderScale(float scale);
+	float GetRenderScale() const { return m_render_scale; }
+	// Resolution the scene passes are drawn at
+	glm::ivec2 GetSceneSize() const;
+
+	void BeginDraw();
+	void BeginOverlay();
+	void EndDraw();
 
 	void SetClearColor(glm::vec3 const & color) { m_clear_color = color; }
 
+	GpuProfiler & GetGpuProfiler() { return m_gpu_profiler; }
+	GpuProfiler const & GetGpuProfiler() const { return m_gpu_profiler; }
+
+	// Counts of state changes issued and skipped as redundant during the last frame
+	StateCounters const & GetStateCounters() const { return m_graphics_api.GetStateCache().GetLastFrameCounters(); }
+
+private:
+	bool create_scene_target();
+	void destroy_scene_target();
+
 private:
 	GraphicsApi const & m_graphics_api;
 
 	glm::vec3 m_clear_color;
+
+	GpuProfiler m_gpu_profiler;
+
+	glm::ivec2 m_viewport_size{ 1, 1 };
+	float m_render_scale = 1.0f;
+
+	// Created at the viewport size the first time the scale drops below 1, a scaled frame only draws to part of it
+	GLuint m_scene_framebuffer = 0;
+	GLuint m_scene_color_buffer = 0;
+	GLuint m_scene_depth_buffer = 0;
+	bool m_drawing_scene_target = false;
 };
@@ -0,0 +1,174 @@
+// StateCache.cpp
+
+module;
+
+#include <cstdint>
+#include <optional>
+
+#include <glad/glad.h>
+
+module StateCache;
+
+void StateCache::BeginFrame()
+{
+	m_last_frame_counters = m_counters;
+	m_counters = StateCounters{};
+
+	Invalidate();
+}
+
+void StateCache::Invalidate()
+{
+	m_depth_test.reset();
+	m_depth_write.reset();
+	m_depth_func.reset();
+	m_blend.reset();
+	m_blend_func.reset();
+	m_cull_face.reset();
+	m_cull_mode.reset();
+	m_polygon_mode.reset();
+
+	m_program.reset();
+	m_vao.reset();
+	m_vertex_buffer.reset();
+	m_element_buffer.reset();
+	m_textures.fill(std::nullopt);
+	m_uniform_buffer_ranges.fill(std::nullopt);
+	m_storage_buffer_ranges.fill(std::nullopt);
+}
+
+void StateCache::set_capability(std::optional<bool> & cached, GLenum capability, bool enable)
+{
+	if (!should_issue(cached, enable))
+		return;
+
+	if (enable)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+void StateCache::SetDepthTest(bool enable)
+{
+	set_capability(m_depth_test, GL_DEPTH_TEST, enable);
+}
+
+void StateCache::SetDepthWrite(bool enable)
+{
+	if (should_issue(m_depth_write, enable))
+		glDepthMask(enable ? GL_TRUE : GL_FALSE);
+}
+
+void StateCache::SetDepthFunc(GLenum func)
+{
+	if (should_issue(m_depth_func, func))
+		glDepthFunc(func);
+}
+
+void StateCache::SetBlend(bool enable)
+{
+	set_capability(m_blend, GL_BLEND, enable);
+}
+
+void StateCache::SetBlendFunc(GLenum src_factor, GLenum dst_factor)
+{
+	if (should_issue(m_blend_func, BlendFunc{ .src_factor = src_factor, .dst_factor = dst_factor }))
+		glBlendFunc(src_factor, dst_factor);
+}
+
+void StateCache::SetCullMode(GLenum mode)
+{
+	set_capability(m_cull_face, GL_CULL_FACE, mode != GL_NONE);
+
+	if (mode != GL_NONE && should_issue(m_cull_mode, mode))
+		glCullFace(mode);
+}
+
+void StateCache::SetPolygonMode(GLenum mode)
+{
+	if (should_issue(m_polygon_mode, mode))
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void StateCache::UseProgram(GLuint program)
+{
+	if (should_issue(m_program, program))
+		glUseProgram(program);
+}
+
+void StateCache::BindVertexArray(GLuint vao)
+{
+	if (!should_issue(m_vao, vao))
+		return;
+
+	glBindVertexArray(vao);
+	m_vertex_buffer.reset();
+	m_element_buffer.reset();
+}
+
+void StateCache::BindVertexBuffer(GLuint vao, GLuint buffer, GLsizei stride)
+{
+	if (m_vao != vao)
+	{
+		glVertexArrayVertexBuffer(vao, 0 /*bindingindex*/, buffer, 0 /*offset*/, stride);
+		++m_counters.issued;
+		return;
+	}
+
+	if (should_issue(m_vertex_buffer, VertexBufferBinding{ .buffer = buffer, .stride = stride }))
+		glVertexArrayVertexBuffer(vao, 0 /*bindingindex*/, buffer, 0 /*offset*/, stride);
+}
+
+void StateCache::BindElementBuffer(GLuint vao, GLuint buffer)
+{
+	if (m_vao != vao)
+	{
+		glVertexArrayElementBuffer(vao, buffer);
+		++m_counters.issued;
+		return;
+	}
+
+	if (should_issue(m_element_buffer, buffer))
+		glVertexArrayElementBuffer(vao, buffer);
+}
+
+void StateCache::BindTexture(GLuint unit, GLuint texture)
+{
+	if (unit >= m_max_texture_units)
+	{
+		glBindTextureUnit(unit, texture);
+		++m_counters.issued;
+		return;
+	}
+
+	if (should_issue(m_textures[unit], texture))
+		glBindTextureUnit(unit, texture);
+}
+
+void StateCache::BindUniformBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (binding >= m_max_uniform_bindings)
+	{
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+		++m_counters.issued;
+		return;
+	}
+
+	BufferRange range{ .buffer = buffer, .offset = offset, .size = size };
+	if (should_issue(m_uniform_buffer_ranges[binding], range))
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+}
+
+void StateCache::BindStorageBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (binding >= m_max_storage_bindings)
+	{
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, offset, size);
+		++m_counters.issued;
+		return;
+	}
+
+	BufferRange range{ .buffer = buffer, .offset = offset, .size = size };
+	if (should_issue(m_storage_buffer_ranges[binding], range))
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, offset, size);
+}
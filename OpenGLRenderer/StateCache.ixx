@@ -0,0 +1,119 @@
+// StateCache.ixx
+
+module;
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include <glad/glad.h>
+
+export module StateCache;
+
+export struct StateCounters
+{
+	std::uint32_t issued = 0;
+	std::uint32_t skipped = 0;
+};
+
+// Shadow copy of the GL state set while drawing, calls that wouldn't change anything are skipped.
+// Unknown state is a null optional, so the first call after Invalidate() is always issued.
+// Resources are created through DSA and don't disturb the bindings, but anything else that changes this state
+// behind the cache's back has to run outside of a frame or call Invalidate() afterwards.
+export class StateCache
+{
+public:
+	constexpr static std::uint32_t m_max_texture_units = 32; // covers the texture table, see TextureTable
+	constexpr static std::uint32_t m_max_uniform_bindings = 16;
+	constexpr static std::uint32_t m_max_storage_bindings = 8;
+
+public:
+	// Publishes the counters of the previous frame and forgets all state
+	void BeginFrame();
+	void Invalidate();
+
+	void SetDepthTest(bool enable);
+	void SetDepthWrite(bool enable);
+	void SetDepthFunc(GLenum func);
+	void SetBlend(bool enable);
+	void SetBlendFunc(GLenum src_factor, GLenum dst_factor);
+	void SetCullMode(GLenum mode); // GL_NONE disables culling
+	void SetPolygonMode(GLenum mode);
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	// Buffer bindings are state of the vao, they are only cached for the currently bound one
+	void BindVertexBuffer(GLuint vao, GLuint buffer, GLsizei stride);
+	void BindElementBuffer(GLuint vao, GLuint buffer);
+	void BindTexture(GLuint unit, GLuint texture);
+	void BindUniformBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void BindStorageBufferRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	StateCounters const & GetLastFrameCounters() const { return m_last_frame_counters; }
+
+private:
+	struct VertexBufferBinding
+	{
+		GLuint buffer = 0;
+		GLsizei stride = 0;
+
+		bool operator==(VertexBufferBinding const & other) const = default;
+	};
+
+	struct BufferRange
+	{
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+		GLsizeiptr size = 0;
+
+		bool operator==(BufferRange const & other) const = default;
+	};
+
+	struct BlendFunc
+	{
+		GLenum src_factor = 0;
+		GLenum dst_factor = 0;
+
+		bool operator==(BlendFunc const & other) const = default;
+	};
+
+	template <typename T>
+	bool should_issue(std::optional<T> & cached, T const & value);
+
+	void set_capability(std::optional<bool> & cached, GLenum capability, bool enable);
+
+private:
+	std::optional<bool> m_depth_test;
+	std::optional<bool> m_depth_write;
+	std::optional<GLenum> m_depth_func;
+	std::optional<bool> m_blend;
+	std::optional<BlendFunc> m_blend_func;
+	std::optional<bool> m_cull_face;
+	std::optional<GLenum> m_cull_mode;
+	std::optional<GLenum> m_polygon_mode;
+
+	std::optional<GLuint> m_program;
+	std::optional<GLuint> m_vao;
+	std::optional<VertexBufferBinding> m_vertex_buffer;
+	std::optional<GLuint> m_element_buffer;
+	std::array<std::optional<GLuint>, m_max_texture_units> m_textures;
+	std::array<std::optional<BufferRange>, m_max_uniform_bindings> m_uniform_buffer_ranges;
+	std::array<std::optional<BufferRange>, m_max_storage_bindings> m_storage_buffer_ranges;
+
+	StateCounters m_counters;
+	StateCounters m_last_frame_counters;
+};
+
+template <typename T>
+bool StateCache::should_issue(std::optional<T> & cached, T const & value)
+{
+	if (cached.has_value() && cached.value() == value)
+	{
+		++m_counters.skipped;
+		return false;
+	}
+
+	cached = value;
+	++m_counters.issued;
+	return true;
+}
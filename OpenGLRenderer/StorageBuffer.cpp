@@ -0,0 +1,55 @@
+// StorageBuffer.cpp
+
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <expected>
+
+#include <glad/glad.h>
+
+module StorageBuffer;
+
+std::expected<void, GraphicsError> StorageBuffer::Create(std::size_t size)
+{
+	if (size == 0)
+		return std::unexpected{ GraphicsError{ "StorageBuffer::Create: size must not be 0" } };
+
+	GLint offset_alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+	std::size_t const alignment = static_cast<std::size_t>(std::max(offset_alignment, 1));
+	std::size_t const region_size = (size + alignment - 1) / alignment * alignment;
+	std::size_t const buffer_size = region_size * GraphicsApi::m_max_frames_in_flight;
+
+	GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	m_buffer.Create(buffer_size, nullptr, flags);
+	if (m_buffer.GetId() == 0)
+		return std::unexpected{ GraphicsError{ "StorageBuffer::Create: failed to create buffer" } };
+
+	m_mapping = static_cast<std::byte *>(glMapNamedBufferRange(m_buffer.GetId(), 0, static_cast<GLsizeiptr>(buffer_size), flags));
+	if (m_mapping == nullptr)
+	{
+		m_buffer.Destroy();
+		return std::unexpected{ GraphicsError{ "StorageBuffer::Create: failed to map buffer" } };
+	}
+
+	m_size = size;
+	m_region_size = region_size;
+	return {};
+}
+
+void StorageBuffer::Update(void const * data, std::size_t size, std::size_t offset /*= 0*/)
+{
+	if (!IsValid() || offset >= m_size)
+		return;
+
+	size = std::min(size, m_size - offset);
+	std::memcpy(m_mapping + GetFrameOffset() + offset, data, size);
+}
+
+GLintptr StorageBuffer::GetFrameOffset() const
+{
+	return static_cast<GLintptr>(m_region_size * m_graphics_api.get().GetCurFrameIndex());
+}
@@ -0,0 +1,47 @@
+// StorageBuffer.ixx
+
+module;
+
+#include <cstddef>
+#include <expected>
+#include <functional>
+
+#include <glad/glad.h>
+
+export module StorageBuffer;
+
+import Buffer;
+import GraphicsApi;
+import GraphicsError;
+
+// Shader storage buffer that is rewritten every frame, pipelines bind it with PipelineBuilder::SetFSStorageBuffers.
+// One persistently and coherently mapped buffer split into a region per frame in flight, like the UniformRing, and
+// guarded by the ring's fences: an update writes the region of the current frame, which the ring only hands out
+// once the gpu is done with the frame that last used it. So updates have to happen after the frame began.
+export class StorageBuffer
+{
+public:
+	explicit StorageBuffer(GraphicsApi const & graphics_api) : m_graphics_api(graphics_api) {}
+
+	StorageBuffer(StorageBuffer const &) = delete;
+	StorageBuffer & operator=(StorageBuffer const &) = delete;
+
+	std::expected<void, GraphicsError> Create(std::size_t size);
+
+	// Data past the end of the buffer is dropped
+	void Update(void const * data, std::size_t size, std::size_t offset = 0);
+
+	bool IsValid() const { return m_mapping != nullptr; }
+	std::size_t GetSize() const { return m_size; }
+	GLuint GetId() const { return m_buffer.GetId(); }
+	// Of the current frame's region
+	GLintptr GetFrameOffset() const;
+
+private:
+	std::reference_wrapper<GraphicsApi const> m_graphics_api;
+
+	Buffer m_buffer;
+	std::byte * m_mapping = nullptr;
+	std::size_t m_size = 0;
+	std::size_t m_region_size = 0; // m_size rounded up to the storage buffer offset alignment
+};
@@ -4,6 +4,7 @@ module;
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cstdint>
 #include <expected>
 #include <string>
@@ -88,9 +89,16 @@ Image & Image::operator=(Image && other)
 	return *this;
 }
 
-void Image::Create()
+void Image::Create(unsigned int target)
 {
-	glGenTextures(1, &m_id);
+	if (m_id != 0)
+		glDeleteTextures(1, &m_id);
+	glCreateTextures(target, 1, &m_id);
+}
+
+GLsizei get_mip_level_count(std::uint32_t width, std::uint32_t height)
+{
+	return static_cast<GLsizei>(std::bit_width(std::max(width, height)));
 }
 
 std::expected<void, GraphicsError> Texture::Create(GraphicsApi const & /*graphics_api*/, ImageData const & image_data, bool use_mip_map /*= true*/)
@@ -107,27 +115,33 @@ std::expected<void, GraphicsError> Texture::Create(GraphicsApi const & /*graphic
 	m_height = image_data.height;
 
 	m_type = GL_TEXTURE_2D;
-	m_image.Create();
-	glBindTexture(m_type, m_image.GetId());
+	m_image.Create(m_type);
+	GLuint id = m_image.GetId();
+
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, use_mip_map ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	glTexParameteri(m_type, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(m_type, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(m_type, GL_TEXTURE_MIN_FILTER, use_mip_map ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(m_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GLsizei levels = use_mip_map ? get_mip_level_count(m_width, m_height) : 1;
+	glTextureStorage2D(id, levels, internal_format, m_width, m_height);
 
-	glTexImage2D(
-		m_type,
+	// Rows of RGB images aren't necessarily 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(
+		id,
 		0 /*level*/,
-		internal_format,
+		0 /*xoffset*/,
+		0 /*yoffset*/,
 		m_width,
 		m_height,
-		0 /*border*/,
 		format,
 		GL_UNSIGNED_BYTE,
 		image_data.data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	if (use_mip_map)
-		glGenerateMipmap(m_type);
+		glGenerateTextureMipmap(id);
 
 	return {};
 }
@@ -146,43 +160,67 @@ std::expected<void, GraphicsError> Texture::Create(GraphicsApi const & /*graphic
 	m_height = image_data.height;
 
 	m_type = GL_TEXTURE_CUBE_MAP;
-	m_image.Create();
-	glBindTexture(m_type, m_image.GetId());
+	m_image.Create(m_type);
+	GLuint id = m_image.GetId();
 
-	glTexParameteri(m_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(m_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(m_type, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(m_type, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(m_type, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+	glTextureStorage2D(id, 1 /*levels*/, internal_format, m_width, m_height);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	for (unsigned int i = 0; i < image_data.data.size(); i++)
 	{
-		glTexImage2D(
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-			0,
-			internal_format,
+		// DSA addresses the faces of a cube map as layers
+		glTextureSubImage3D(
+			id,
+			0 /*level*/,
+			0 /*xoffset*/,
+			0 /*yoffset*/,
+			static_cast<GLint>(i) /*zoffset*/,
 			m_width,
 			m_height,
-			0,
+			1 /*depth*/,
 			format,
 			GL_UNSIGNED_BYTE,
 			image_data.data[i]);
 	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	return {};
 }
 
-bool Texture::IsValid() const
+std::expected<void, GraphicsError> Texture::Update(GraphicsApi const & /*graphics_api*/, ImageData const & image_data, std::uint32_t x, std::uint32_t y)
 {
-	return m_image.GetId() != 0 && m_type != 0 && m_width != 0 && m_height != 0;
+	if (!image_data.IsValid())
+		return std::unexpected{ GraphicsError{ "Texture::Update: image_data not valid" } };
+	if (m_type != GL_TEXTURE_2D || x + image_data.width > m_width || y + image_data.height > m_height)
+		return std::unexpected{ GraphicsError{ "Texture::Update: region outside of the texture" } };
+
+	GLenum format = to_gl_format(image_data.format);
+	if (format == 0)
+		return std::unexpected{ GraphicsError{ "Texture::Update: Unsupported pixel format: " + std::to_string(format) } };
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(
+		m_image.GetId(),
+		0 /*level*/,
+		static_cast<GLint>(x),
+		static_cast<GLint>(y),
+		static_cast<GLsizei>(image_data.width),
+		static_cast<GLsizei>(image_data.height),
+		format,
+		GL_UNSIGNED_BYTE,
+		image_data.data);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	return {};
 }
 
-// static
-void Texture::Bind(unsigned int id, unsigned int type, unsigned int binding)
+bool Texture::IsValid() const
 {
-	if (id == 0 || type == 0)
-		return;
-
-	glActiveTexture(GL_TEXTURE0 + binding);
-	glBindTexture(type, id);
+	return m_image.GetId() != 0 && m_type != 0 && m_width != 0 && m_height != 0;
 }
@@ -56,7 +56,7 @@ public:
 	Image(Image const &) = delete;
 	Image & operator=(Image const &) = delete;
 
-	void Create();
+	void Create(unsigned int target);
 
 	unsigned int GetId() const { return m_id; }
 
@@ -78,6 +78,10 @@ public:
 	std::expected<void, GraphicsError> Create(GraphicsApi const & graphics_api, ImageData const & image_data, bool use_mip_map = true);
 	std::expected<void, GraphicsError> Create(GraphicsApi const & graphics_api, CubeImageData const & image_data);
 
+	// Overwrites the region of a 2d texture at x, y with the image, which has the format the texture was created with.
+	// Only the first mip level is written, so it's meant for textures created without mip maps.
+	std::expected<void, GraphicsError> Update(GraphicsApi const & graphics_api, ImageData const & image_data, std::uint32_t x, std::uint32_t y);
+
 	bool IsValid() const;
 
 	unsigned int GetId() const { return m_image.GetId(); }
@@ -86,8 +90,6 @@ public:
 	std::uint32_t GetWidth() const { return m_width; }
 	std::uint32_t GetHeight() const { return m_height; }
 
-	static void Bind(unsigned int id, unsigned int type, unsigned int binding);
-
 private:
 	unsigned int m_type = 0;
 	Image m_image;
@@ -0,0 +1,28 @@
+// TextureTable.cpp
+
+module;
+
+#include <cstdint>
+#include <expected>
+#include <string>
+
+#include <glad/glad.h>
+
+module TextureTable;
+
+std::expected<std::uint32_t, GraphicsError> TextureTable::Add(Texture const & texture)
+{
+	if (!texture.IsValid() || texture.GetType() != GL_TEXTURE_2D)
+		return std::unexpected{ GraphicsError{ "TextureTable::Add: invalid texture, only 2d textures are supported" } };
+	if (m_size == m_max_textures)
+		return std::unexpected{ GraphicsError{ "TextureTable::Add: table is full (" + std::to_string(m_max_textures) + " textures)" } };
+
+	m_textures[m_size] = texture.GetId();
+	return m_size++;
+}
+
+void TextureTable::Bind(StateCache & state_cache) const
+{
+	for (std::uint32_t i = 0; i < m_size; ++i)
+		state_cache.BindTexture(m_first_unit + i, m_textures[i]);
+}
@@ -0,0 +1,45 @@
+// TextureTable.ixx
+
+module;
+
+#include <array>
+#include <cstdint>
+#include <expected>
+
+#include <glad/glad.h>
+
+export module TextureTable;
+
+import GraphicsApi;
+import GraphicsError;
+import StateCache;
+import Texture;
+
+// All the 2d textures a scene uses, bound to consecutive texture units that the shaders see as one sampler array.
+// Pipelines created with the table pick their texture with an index from the object data, so one pipeline can draw
+// differently textured objects. Without bindless textures the table is limited by the fragment shader's
+// texture unit count, so it only has room for m_max_textures.
+export class TextureTable
+{
+public:
+	// Has to match the array size and binding of the texture table in the shaders
+	constexpr static std::uint32_t m_max_textures = 16;
+	constexpr static GLuint m_first_unit = 16;
+
+public:
+	explicit TextureTable(GraphicsApi const & /*graphics_api*/) {}
+
+	TextureTable(TextureTable const &) = delete;
+	TextureTable & operator=(TextureTable const &) = delete;
+
+	// Returns the index the shaders use to sample the texture, the texture has to outlive the table
+	std::expected<std::uint32_t, GraphicsError> Add(Texture const & texture);
+
+	std::uint32_t GetSize() const { return m_size; }
+
+	void Bind(StateCache & state_cache) const;
+
+private:
+	std::array<GLuint, m_max_textures> m_textures{};
+	std::uint32_t m_size = 0;
+};
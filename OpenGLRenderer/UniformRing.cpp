@@ -0,0 +1,111 @@
+// UniformRing.cpp
+
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include <glad/glad.h>
+
+module UniformRing;
+
+UniformRing::~UniformRing()
+{
+	for (Region & region : m_regions)
+	{
+		if (region.fence != nullptr)
+			glDeleteSync(region.fence);
+	}
+	// Deleting the buffer unmaps it
+}
+
+void UniformRing::Create(std::uint32_t frame_count, GLsizeiptr frame_size)
+{
+	GLint offset_alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offset_alignment);
+	m_offset_alignment = std::max<GLintptr>(offset_alignment, 1);
+
+	// Keep every region aligned so that the first allocation of a frame is too
+	m_frame_size = (frame_size + m_offset_alignment - 1) / m_offset_alignment * m_offset_alignment;
+
+	GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	m_buffer.Create(static_cast<std::size_t>(m_frame_size * frame_count), nullptr, flags);
+	m_mapping = static_cast<std::byte *>(glMapNamedBufferRange(m_buffer.GetId(), 0, m_frame_size * frame_count, flags));
+
+	if (m_mapping == nullptr)
+	{
+		std::cout << "Failed to map the uniform ring buffer" << std::endl;
+		return;
+	}
+
+	m_regions.resize(frame_count);
+	for (std::uint32_t i = 0; i < frame_count; ++i)
+		m_regions[i].begin = m_frame_size * i;
+
+	// The first BeginFrame() moves to region 0
+	m_region_index = frame_count - 1;
+	m_head = m_frame_size;
+}
+
+void UniformRing::BeginFrame()
+{
+	if (m_regions.empty())
+		return;
+
+	m_region_index = (m_region_index + 1) % static_cast<std::uint32_t>(m_regions.size());
+	m_head = 0;
+
+	Region & region = m_regions[m_region_index];
+	if (region.fence == nullptr)
+		return;
+
+	GLbitfield wait_flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	constexpr GLuint64 timeout_ns = 1'000'000;
+	while (true)
+	{
+		GLenum result = glClientWaitSync(region.fence, wait_flags, timeout_ns);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+			break;
+		wait_flags = 0; // the commands only have to be flushed once
+	}
+
+	glDeleteSync(region.fence);
+	region.fence = nullptr;
+}
+
+void UniformRing::EndFrame()
+{
+	if (m_regions.empty())
+		return;
+
+	Region & region = m_regions[m_region_index];
+	if (region.fence != nullptr)
+		glDeleteSync(region.fence);
+	region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+std::optional<UniformAllocation> UniformRing::Allocate(GLsizeiptr size)
+{
+	if (m_head + size > m_frame_size)
+	{
+		if (!m_reported_overflow)
+		{
+			std::cout << "Uniform ring frame region of " << m_frame_size << " bytes is full" << std::endl;
+			m_reported_overflow = true;
+		}
+		return std::nullopt;
+	}
+
+	GLintptr offset = m_regions[m_region_index].begin + m_head;
+	m_head += (size + m_offset_alignment - 1) / m_offset_alignment * m_offset_alignment;
+
+	return UniformAllocation{
+		.offset = offset,
+		.mapping = m_mapping + offset
+	};
+}
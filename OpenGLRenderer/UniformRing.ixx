@@ -0,0 +1,65 @@
+// UniformRing.ixx
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <glad/glad.h>
+
+export module UniformRing;
+
+import Buffer;
+
+export struct UniformAllocation
+{
+	GLintptr offset = 0;
+	void * mapping = nullptr;
+};
+
+// One persistently and coherently mapped uniform buffer split into a region per frame in flight.
+// All uniform data of a frame is written linearly into its region and bound with glBindBufferRange,
+// a fence placed at the end of the frame guards the region until the gpu is done reading it.
+export class UniformRing
+{
+public:
+	UniformRing() = default;
+	~UniformRing();
+
+	UniformRing(UniformRing const &) = delete;
+	UniformRing & operator=(UniformRing const &) = delete;
+
+	void Create(std::uint32_t frame_count, GLsizeiptr frame_size);
+
+	// Moves to the next region, waiting for the gpu if it is still reading the frame that last used it
+	void BeginFrame();
+	void EndFrame();
+
+	// Returns std::nullopt when the frame's region is full
+	std::optional<UniformAllocation> Allocate(GLsizeiptr size);
+
+	GLuint GetBufferId() const { return m_buffer.GetId(); }
+	// Index of the current frame's region, data kept per frame in flight can be guarded by the same fences
+	std::uint32_t GetFrameIndex() const { return m_region_index; }
+
+private:
+	struct Region
+	{
+		GLintptr begin = 0;
+		GLsync fence = nullptr;
+	};
+
+private:
+	Buffer m_buffer;
+	std::byte * m_mapping = nullptr;
+
+	GLsizeiptr m_frame_size = 0;
+	GLintptr m_offset_alignment = 0;
+
+	std::vector<Region> m_regions;
+	std::uint32_t m_region_index = 0;
+	GLintptr m_head = 0;
+	bool m_reported_overflow = false;
+};
@@ -0,0 +1,58 @@
+// VertexArrayCache.cpp
+
+module;
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+module VertexArrayCache;
+
+VertexArrayObject::~VertexArrayObject()
+{
+	if (m_id != 0)
+		glDeleteVertexArrays(1, &m_id);
+}
+
+VertexArrayObject::VertexArrayObject(VertexArrayObject && other) noexcept
+{
+	*this = std::move(other);
+}
+
+VertexArrayObject & VertexArrayObject::operator=(VertexArrayObject && other) noexcept
+{
+	if (this != &other)
+	{
+		if (m_id != 0)
+			glDeleteVertexArrays(1, &m_id);
+		m_id = 0;
+
+		std::swap(m_id, other.m_id);
+	}
+	return *this;
+}
+
+void VertexArrayObject::Create()
+{
+	if (m_id != 0)
+		return;
+	glCreateVertexArrays(1, &m_id);
+}
+
+GLuint VertexArrayCache::Get(Vertex::LayoutDesc const & layout)
+{
+	auto it = std::ranges::find_if(m_vertex_arrays,
+		[&layout](auto const & entry) { return entry.first == layout; });
+	if (it != m_vertex_arrays.end())
+		return it->second.GetId();
+
+	VertexArrayObject vao;
+	vao.Create();
+	Vertex::SetAttributes(vao.GetId(), layout);
+
+	GLuint id = vao.GetId();
+	m_vertex_arrays.emplace_back(layout, std::move(vao));
+	return id;
+}
@@ -0,0 +1,44 @@
+// VertexArrayCache.ixx
+
+module;
+
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+export module VertexArrayCache;
+
+import VertexLayout;
+
+class VertexArrayObject
+{
+public:
+	VertexArrayObject() = default;
+	~VertexArrayObject();
+
+	VertexArrayObject(VertexArrayObject && other) noexcept;
+	VertexArrayObject & operator=(VertexArrayObject && other) noexcept;
+
+	VertexArrayObject(VertexArrayObject const &) = delete;
+	VertexArrayObject & operator=(VertexArrayObject const &) = delete;
+
+	void Create();
+
+	GLuint GetId() const { return m_id; }
+
+private:
+	GLuint m_id = 0;
+};
+
+// One VAO per vertex layout, holding only the attribute formats. Meshes attach their own buffers at draw time,
+// so switching between meshes with the same layout is a buffer rebind rather than a VAO switch.
+export class VertexArrayCache
+{
+public:
+	GLuint Get(Vertex::LayoutDesc const & layout);
+
+private:
+	// There are only a handful of layouts, a linear search is fine
+	std::vector<std::pair<Vertex::LayoutDesc, VertexArrayObject>> m_vertex_arrays;
+};
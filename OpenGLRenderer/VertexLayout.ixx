@@ -19,17 +19,29 @@ namespace Vertex
 		Float4,
 	};
 
+	// Instance attributes advance once per instance, e.g. a quad expanded in the vertex shader for every glyph
+	export enum class InputRate
+	{
+		Vertex,
+		Instance,
+	};
+
 	export struct AttributeDesc
 	{
 		AttributeType type;
 		std::size_t offset;
 		uint32_t location; // shader location
+
+		bool operator==(AttributeDesc const & other) const = default;
 	};
 
 	export struct LayoutDesc
 	{
 		std::size_t stride;
 		std::vector<AttributeDesc> attributes;
+		InputRate input_rate = InputRate::Vertex;
+
+		bool operator==(LayoutDesc const & other) const = default;
 	};
 
 	export template<typename VertexT>
@@ -37,9 +49,12 @@ namespace Vertex
 		{ VertexT::CreateLayout() } -> std::same_as<LayoutDesc>;
 	};
 
-	// Set OpenGL vertex attributes from a VertexLayoutDesc
-	export void SetAttributes(const LayoutDesc & layout)
+	// Set the attribute formats of a vertex array object from a LayoutDesc, all attributes read from buffer binding 0.
+	// The stride is given when a vertex buffer is attached to the binding.
+	export void SetAttributes(GLuint vao, const LayoutDesc & layout)
 	{
+		glVertexArrayBindingDivisor(vao, 0 /*bindingindex*/, layout.input_rate == InputRate::Instance ? 1 : 0);
+
 		for (const auto & attr : layout.attributes)
 		{
 			GLint size = 0;
@@ -61,14 +76,9 @@ namespace Vertex
 				break;
 			}
 
-			glVertexAttribPointer(
-				attr.location,
-				size,
-				type,
-				normalize,
-				static_cast<GLsizei>(layout.stride),
-				reinterpret_cast<const void *>(attr.offset));
-			glEnableVertexAttribArray(attr.location);
+			glEnableVertexArrayAttrib(vao, attr.location);
+			glVertexArrayAttribFormat(vao, attr.location, size, type, normalize, static_cast<GLuint>(attr.offset));
+			glVertexArrayAttribBinding(vao, attr.location, 0 /*bindingindex*/);
 		}
 	}
 }
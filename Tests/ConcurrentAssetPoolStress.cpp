@@ -0,0 +1,194 @@
+// ConcurrentAssetPoolStress.cpp
+
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+import AssetPool;
+import ConcurrentAssetPool;
+
+// Built with -fsanitize=thread. Writers add assets, publish their ids in shared slots and remove the ids they take
+// out of the slots, readers get the assets of the published ids and check them. Every round ends with the readers
+// stopped while the writers go on and the pool reclaims the removed assets, as the owner would once per frame.
+
+constexpr std::uint32_t WriterCount = 4;
+constexpr std::uint32_t ReaderCount = 4;
+constexpr std::uint32_t RoundCount = 200;
+constexpr std::uint32_t OpsPerRound = 500;
+constexpr std::uint32_t SharedSlotCount = 64;
+
+std::atomic<std::int64_t> g_live_payloads{ 0 };
+std::atomic<std::uint32_t> g_error_count{ 0 };
+
+// The payload is on the heap, so a read of a destroyed asset races with its delete
+struct StressAsset
+{
+	StressAsset(std::uint32_t writer, std::uint32_t serial)
+		: writer{ writer }
+		, payload{ std::make_unique<std::uint64_t>(std::uint64_t{ writer } << 32 | serial) }
+	{
+		g_live_payloads.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	StressAsset(StressAsset && other) noexcept = default;
+
+	~StressAsset()
+	{
+		if (payload)
+			g_live_payloads.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	std::uint32_t writer = 0;
+	std::unique_ptr<std::uint64_t> payload;
+};
+
+// A small generation width, so slots get retired within the test
+using StressPool = ConcurrentAssetPool<StressAsset, 14, 6>;
+using StressId = StressPool::IdT;
+
+constexpr std::uint64_t NoId = ~std::uint64_t{ 0 };
+
+std::uint64_t pack_id(StressId id)
+{
+	return std::uint64_t{ id.GetGeneration() } << 32 | id.GetIndex();
+}
+
+StressId unpack_id(std::uint64_t packed)
+{
+	return StressId{ static_cast<std::uint32_t>(packed), static_cast<std::uint32_t>(packed >> 32) };
+}
+
+void report_error(char const * message)
+{
+	if (g_error_count.fetch_add(1, std::memory_order_relaxed) < 10)
+		std::cout << "ConcurrentAssetPoolStress: " << message << std::endl;
+}
+
+bool check_asset(StressAsset const & asset)
+{
+	return asset.payload && static_cast<std::uint32_t>(*asset.payload >> 32) == asset.writer;
+}
+
+void write(StressPool & pool, std::array<std::atomic<std::uint64_t>, SharedSlotCount> & shared_ids,
+	std::uint32_t writer, std::uint32_t & serial, std::mt19937 & random)
+{
+	StressId id = pool.Add(StressAsset{ writer, serial++ });
+	if (!id.IsValid())
+		return; // every slot is in use or retired, the removals below free some
+
+	StressAsset const * asset = pool.Get(id);
+	if (!asset || asset->writer != writer || !check_asset(*asset))
+		report_error("an added asset isn't the one that was added");
+
+	std::uint64_t old_id = shared_ids[random() % SharedSlotCount].exchange(pack_id(id), std::memory_order_acq_rel);
+	if (old_id != NoId)
+	{
+		pool.Remove(unpack_id(old_id));
+		if (pool.Get(unpack_id(old_id)))
+			report_error("a removed asset is still returned");
+	}
+}
+
+void read(StressPool const & pool, std::array<std::atomic<std::uint64_t>, SharedSlotCount> const & shared_ids,
+	std::mt19937 & random)
+{
+	std::uint64_t id = shared_ids[random() % SharedSlotCount].load(std::memory_order_acquire);
+	if (id == NoId)
+		return;
+
+	// May be removed meanwhile, but not destroyed before the round ends
+	if (StressAsset const * asset = pool.Get(unpack_id(id)); asset && !check_asset(*asset))
+		report_error("a published asset is corrupted");
+}
+
+int main()
+{
+	{
+		StressPool pool;
+		std::array<std::atomic<std::uint64_t>, SharedSlotCount> shared_ids;
+		for (std::atomic<std::uint64_t> & id : shared_ids)
+			id.store(NoId, std::memory_order_relaxed);
+
+		// The main thread takes part in both barriers of every round, it reclaims between them
+		std::barrier reads_done{ WriterCount + ReaderCount + 1 };
+		std::barrier round_done{ WriterCount + ReaderCount + 1 };
+
+		std::vector<std::jthread> threads;
+		for (std::uint32_t writer = 0; writer < WriterCount; ++writer)
+		{
+			threads.emplace_back([&, writer]
+				{
+					std::mt19937 random{ writer };
+					std::uint32_t serial = 0;
+					for (std::uint32_t round = 0; round < RoundCount; ++round)
+					{
+						for (std::uint32_t op = 0; op < OpsPerRound; ++op)
+							write(pool, shared_ids, writer, serial, random);
+						reads_done.arrive_and_wait();
+
+						// Adds and removes while the pool reclaims
+						for (std::uint32_t op = 0; op < OpsPerRound / 10; ++op)
+							write(pool, shared_ids, writer, serial, random);
+						round_done.arrive_and_wait();
+					}
+				});
+		}
+		for (std::uint32_t reader = 0; reader < ReaderCount; ++reader)
+		{
+			threads.emplace_back([&, reader]
+				{
+					std::mt19937 random{ WriterCount + reader };
+					for (std::uint32_t round = 0; round < RoundCount; ++round)
+					{
+						for (std::uint32_t op = 0; op < OpsPerRound * 4; ++op)
+							read(pool, shared_ids, random);
+						reads_done.arrive_and_wait();
+						round_done.arrive_and_wait();
+					}
+				});
+		}
+
+		for (std::uint32_t round = 0; round < RoundCount; ++round)
+		{
+			reads_done.arrive_and_wait();
+			pool.Reclaim();
+			round_done.arrive_and_wait();
+		}
+		threads.clear();
+
+		// Every published asset is still there, the others were all removed
+		std::int64_t published_count = 0;
+		for (std::atomic<std::uint64_t> & id : shared_ids)
+		{
+			std::uint64_t const packed = id.load(std::memory_order_relaxed);
+			if (packed == NoId)
+				continue;
+
+			++published_count;
+			if (!pool.Get(unpack_id(packed)))
+				report_error("a published asset is missing");
+		}
+
+		pool.Reclaim();
+		if (g_live_payloads.load() != published_count)
+			report_error("the removed assets weren't all destroyed by Reclaim");
+	}
+
+	if (g_live_payloads.load() != 0)
+		report_error("the pool didn't destroy its assets");
+
+	if (g_error_count.load() > 0)
+	{
+		std::cout << "ConcurrentAssetPoolStress: failed with " << g_error_count.load() << " errors" << std::endl;
+		return 1;
+	}
+
+	std::cout << "ConcurrentAssetPoolStress: passed" << std::endl;
+	return 0;
+}
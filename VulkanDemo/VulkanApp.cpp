@@ -13,8 +13,12 @@ module;
 module VulkanApp;
 
 import GraphicsApi;
+import PlatformUtils;
 import Renderer;
 import Scene;
+import Trace;
+
+constexpr double TraceDumpSeconds = 10.0;
 
 VulkanApp::VulkanApp(WindowSize window_size_screen_coords, std::string const & title)
 	: m_title(title)
@@ -78,6 +82,8 @@ void VulkanApp::Run()
 
 	std::jthread update_render_loop([this](std::stop_token s_token)
 		{
+			Trace::SetThreadName("Update/Render");
+
 			WindowSize size = m_window_size_pixels.load();
 			float scale_factor = m_window_scale_factor.load();
 
@@ -87,6 +93,8 @@ void VulkanApp::Run()
 			GraphicsApi graphics_api{
 				m_window, size.width, size.height,
 				m_title, extension_count, extensions };
+			if constexpr (Trace::Enabled)
+				graphics_api.SetTraceZoneCallback(&Trace::RecordZone);
 
 			Scene scene{ graphics_api, m_title, scale_factor };
 			scene.OnViewportResized(size.width, size.height);
@@ -99,11 +107,16 @@ void VulkanApp::Run()
 				double delta_time = cur_time - last_update_time;
 				last_update_time = cur_time;
 
+				m_input.BeginFrame();
 				scene.Update(delta_time, m_input);
 
 				bool swap_chain_out_of_date = false;
 				if (graphics_api.SwapChainIsValid())
+				{
+					Trace::Zone zone{ "GraphicsApi::DrawFrame" };
 					graphics_api.DrawFrame([&scene]() { scene.Render(); }, swap_chain_out_of_date);
+					m_input.OnFramePresented();
+				}
 				else
 					swap_chain_out_of_date = true;
 
@@ -125,6 +138,8 @@ void VulkanApp::Run()
 			graphics_api.WaitForLastFrame();
 		}); // the GraphicsApi and Scene are destroyed in the reverse order they were created
 
+	Trace::SetThreadName("Main");
+
 	while (!glfwWindowShouldClose(m_window))
 		glfwPollEvents(); // must only be called from main thread
 }
@@ -134,6 +149,9 @@ void VulkanApp::OnKeyEvent(int key, int /*scan_code*/, int action, int /*mods*/)
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(m_window, true);
 
+	if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+		Trace::DumpChromeTrace(PlatformUtils::GetExecutableDir() / "trace.json", TraceDumpSeconds);
+
 	if (action == GLFW_PRESS)
 		m_input.SetKey(key, true /*pressed*/);
 	else if (action == GLFW_RELEASE)
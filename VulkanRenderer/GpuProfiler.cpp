@@ -0,0 +1,158 @@
+// GpuProfiler.cpp
+
+module;
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+module GpuProfiler;
+
+constexpr std::uint32_t DroppedZone = std::numeric_limits<std::uint32_t>::max();
+
+GpuProfiler::GpuProfiler(GraphicsApi const & graphics_api)
+	: m_graphics_api(graphics_api)
+{
+	vk::PhysicalDeviceLimits const & limits = graphics_api.GetPhysicalDeviceInfo().properties.limits;
+	if (!limits.timestampComputeAndGraphics)
+	{
+		std::cout << "GpuProfiler: timestamps are not supported on the graphics queue" << std::endl;
+		return;
+	}
+	m_ns_per_tick = static_cast<double>(limits.timestampPeriod);
+
+	try
+	{
+		vk::QueryPoolCreateInfo pool_info{
+			.queryType = vk::QueryType::eTimestamp,
+			.queryCount = m_max_queries_per_frame
+		};
+
+		for (FrameQueries & frame : m_frames)
+		{
+			frame.query_pool = vk::raii::QueryPool{ graphics_api.GetDevice(), pool_info };
+			frame.zones.reserve(m_max_zones_per_frame);
+		}
+	}
+	catch (vk::SystemError const & err)
+	{
+		std::cout << "GpuProfiler: failed to create query pools: " << err.what() << std::endl;
+		return;
+	}
+
+	m_open_zones.reserve(m_max_zones_per_frame);
+	m_latest_timings.zones.reserve(m_max_zones_per_frame);
+	m_supported = true;
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (!m_supported)
+		return;
+
+	FrameQueries & frame = m_frames[m_graphics_api.GetCurFrameIndex()];
+
+	// The fence for this frame slot has already been waited on, so the previous results are available
+	if (frame.pending)
+		resolve(frame);
+
+	m_graphics_api.GetCurCommandBuffer().resetQueryPool(*frame.query_pool, 0, m_max_queries_per_frame);
+
+	frame.query_count = 0;
+	frame.zones.clear();
+	m_open_zones.clear();
+
+	write_timestamp(frame);
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!m_supported)
+		return;
+
+	FrameQueries & frame = m_frames[m_graphics_api.GetCurFrameIndex()];
+
+	while (!m_open_zones.empty())
+		EndZone();
+
+	write_timestamp(frame);
+	frame.pending = true;
+}
+
+void GpuProfiler::BeginZone(char const * name)
+{
+	if (!m_supported)
+		return;
+
+	FrameQueries & frame = m_frames[m_graphics_api.GetCurFrameIndex()];
+
+	// Keep room for the end of frame timestamp
+	if (frame.zones.size() >= m_max_zones_per_frame || frame.query_count + 3 > m_max_queries_per_frame)
+	{
+		m_open_zones.push_back(DroppedZone);
+		return;
+	}
+
+	m_open_zones.push_back(static_cast<std::uint32_t>(frame.zones.size()));
+	frame.zones.push_back(Zone{ .name = name, .begin_query = write_timestamp(frame) });
+}
+
+void GpuProfiler::EndZone()
+{
+	if (!m_supported || m_open_zones.empty())
+		return;
+
+	std::uint32_t zone_index = m_open_zones.back();
+	m_open_zones.pop_back();
+	if (zone_index == DroppedZone)
+		return;
+
+	FrameQueries & frame = m_frames[m_graphics_api.GetCurFrameIndex()];
+	frame.zones[zone_index].end_query = write_timestamp(frame);
+}
+
+std::uint32_t GpuProfiler::write_timestamp(FrameQueries & frame)
+{
+	std::uint32_t query = frame.query_count++;
+	m_graphics_api.GetCurCommandBuffer().writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *frame.query_pool, query);
+	return query;
+}
+
+void GpuProfiler::resolve(FrameQueries & frame)
+{
+	frame.pending = false;
+	if (frame.query_count < 2)
+		return;
+
+	// Use the raw entry point so the results land in our preallocated array instead of a new vector every frame
+	vk::raii::Device const & device = m_graphics_api.GetDevice();
+	VkResult result = device.getDispatcher()->vkGetQueryPoolResults(
+		static_cast<VkDevice>(*device),
+		static_cast<VkQueryPool>(*frame.query_pool),
+		0,
+		frame.query_count,
+		frame.query_count * sizeof(std::uint64_t),
+		m_results.data(),
+		sizeof(std::uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return;
+
+	auto ticks_to_ms = [this](std::uint64_t begin, std::uint64_t end)
+		{
+			return end > begin ? static_cast<double>(end - begin) * m_ns_per_tick / 1'000'000.0 : 0.0;
+		};
+
+	m_latest_timings.frame_ms = ticks_to_ms(m_results[0], m_results[frame.query_count - 1]);
+	m_latest_timings.zones.clear();
+	for (Zone const & zone : frame.zones)
+	{
+		m_latest_timings.zones.push_back(GpuZoneTiming{
+			.name = zone.name,
+			.ms = ticks_to_ms(m_results[zone.begin_query], m_results[zone.end_query])
+			});
+	}
+}
@@ -0,0 +1,85 @@
+// GpuProfiler.ixx
+
+module;
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+export module GpuProfiler;
+
+import GraphicsApi;
+
+export struct GpuZoneTiming
+{
+	char const * name = nullptr;
+	double ms = 0.0;
+};
+
+export struct GpuFrameTimings
+{
+	double frame_ms = 0.0;
+	std::vector<GpuZoneTiming> zones;
+};
+
+// Records GPU timestamps around the whole frame and around named zones (e.g. pipeline buckets).
+// Results are read back when the frame slot is reused, after its fence has been waited on,
+// so timings are m_max_frames_in_flight frames old and reading them never stalls the cpu.
+export class GpuProfiler
+{
+public:
+	constexpr static std::uint32_t m_max_zones_per_frame = 64;
+	constexpr static std::uint32_t m_max_queries_per_frame = 2 + m_max_zones_per_frame * 2;
+
+public:
+	explicit GpuProfiler(GraphicsApi const & graphics_api);
+
+	GpuProfiler(GpuProfiler const &) = delete;
+	GpuProfiler & operator=(GpuProfiler const &) = delete;
+
+	bool IsSupported() const { return m_supported; }
+
+	// Must be called after the command buffer has begun and before rendering begins
+	void BeginFrame();
+	// Must be called before the command buffer ends
+	void EndFrame();
+
+	// The name must outlive the profiler, string literals are expected
+	void BeginZone(char const * name);
+	void EndZone();
+
+	GpuFrameTimings const & GetLatestTimings() const { return m_latest_timings; }
+
+private:
+	struct Zone
+	{
+		char const * name = nullptr;
+		std::uint32_t begin_query = 0;
+		std::uint32_t end_query = 0;
+	};
+
+	struct FrameQueries
+	{
+		vk::raii::QueryPool query_pool = nullptr;
+		std::uint32_t query_count = 0;
+		std::vector<Zone> zones;
+		bool pending = false;
+	};
+
+	std::uint32_t write_timestamp(FrameQueries & frame);
+	void resolve(FrameQueries & frame);
+
+private:
+	GraphicsApi const & m_graphics_api;
+
+	bool m_supported = false;
+	double m_ns_per_tick = 1.0;
+
+	std::array<FrameQueries, GraphicsApi::m_max_frames_in_flight> m_frames;
+	std::vector<std::uint32_t> m_open_zones;
+	std::array<std::uint64_t, m_max_queries_per_frame> m_results{};
+
+	GpuFrameTimings m_latest_timings;
+};
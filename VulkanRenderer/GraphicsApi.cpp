@@ -3,11 +3,15 @@
 module;
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <limits>
 #include <ranges>
+#include <span>
 #include <vector>
 
 #include <vulkan/vulkan_raii.hpp>
@@ -135,12 +139,14 @@ bool device_is_suitable(
 	if (swap_chain_support.formats.empty() || swap_chain_support.present_modes.empty())
 		return false;
 
+	// The texture table is indexed with the push constant texture index, which is dynamically uniform
 	auto features = device.getFeatures();
-	if (!features.samplerAnisotropy)
+	if (!features.samplerAnisotropy || !features.shaderSampledImageArrayDynamicIndexing)
 		return false;
 
 	auto features2 = device.template getFeatures2<
 		vk::PhysicalDeviceFeatures2,
+		vk::PhysicalDeviceVulkan12Features,
 		vk::PhysicalDeviceVulkan13Features,
 		vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
 
@@ -148,6 +154,11 @@ bool device_is_suitable(
 		!features2.template get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState)
 		return false;
 
+	// Needed by the texture table
+	auto const & features12 = features2.template get<vk::PhysicalDeviceVulkan12Features>();
+	if (!features12.descriptorBindingPartiallyBound || !features12.descriptorBindingSampledImageUpdateAfterBind)
+		return false;
+
 	auto mem_properties = device.getMemoryProperties();
 	out_device_info = PhysicalDeviceInfo{ device, queue_index, swap_chain_support, mem_properties, properties };
 	return true;
@@ -187,12 +198,20 @@ vk::raii::Device create_logical_device(
 
 	vk::StructureChain<
 		vk::PhysicalDeviceFeatures2,
+		vk::PhysicalDeviceVulkan12Features,
 		vk::PhysicalDeviceVulkan13Features,
 		vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>
 		feature_chain =
 	{
 		{
-			.features = {.samplerAnisotropy = VK_TRUE }
+			.features = {
+				.samplerAnisotropy = VK_TRUE,
+				.shaderSampledImageArrayDynamicIndexing = VK_TRUE // the texture table's index, see device_is_suitable
+			}
+		},
+		{
+			.descriptorBindingSampledImageUpdateAfterBind = true,
+			.descriptorBindingPartiallyBound = true
 		},
 		{
 			.synchronization2 = true,
@@ -287,7 +306,7 @@ vk::raii::SwapchainKHR create_swap_chain(
 		.imageColorSpace = surface_format.colorSpace,
 		.imageExtent = extent,
 		.imageArrayLayers = 1,
-		.imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+		.imageUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst, // the scene target is blitted to it, see Renderer
 		.imageSharingMode = vk::SharingMode::eExclusive,
 		.queueFamilyIndexCount = 0,
 		.pQueueFamilyIndices = nullptr,
@@ -521,6 +540,23 @@ void GraphicsApi::RecreateSwapChain(int width_pixels, int height_pixels)
 	}
 }
 
+std::uint64_t trace_now_ns()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Records the stage that started at stage_begin_ns and starts the next one
+void GraphicsApi::trace_stage(char const * name, std::uint64_t & stage_begin_ns) const
+{
+	if (!m_trace_zone_fn)
+		return;
+
+	std::uint64_t now_ns = trace_now_ns();
+	m_trace_zone_fn(name, stage_begin_ns, now_ns);
+	stage_begin_ns = now_ns;
+}
+
 bool GraphicsApi::SwapChainIsValid() const
 {
 	return *m_swap_chain != VK_NULL_HANDLE && !m_swap_chain_image_views.empty();
@@ -528,10 +564,14 @@ bool GraphicsApi::SwapChainIsValid() const
 
 void GraphicsApi::DrawFrame(std::function<void()> render_fn, bool & out_swap_chain_out_of_date)
 {
+	std::uint64_t stage_begin_ns = m_trace_zone_fn ? trace_now_ns() : 0;
+
 	vk::Result fence_result = m_logical_device.waitForFences(*m_draw_fences[m_current_frame], VK_TRUE, UINT64_MAX);
 	if (fence_result != vk::Result::eSuccess)
 		throw std::runtime_error("Failed to wait for draw fence!");
 
+	trace_stage("GraphicsApi::DrawFrame wait for fence", stage_begin_ns);
+
 	try
 	{
 		auto [ani_result, image_index] = m_swap_chain.acquireNextImage(UINT64_MAX, *m_present_complete_semaphores[m_current_frame], nullptr);
@@ -548,6 +588,8 @@ void GraphicsApi::DrawFrame(std::function<void()> render_fn, bool & out_swap_cha
 		return;
 	}
 
+	trace_stage("GraphicsApi::DrawFrame acquire image", stage_begin_ns);
+
 	// Only reset the fence if we are submitting work
 	m_logical_device.resetFences(*m_draw_fences[m_current_frame]);
 
@@ -555,6 +597,9 @@ void GraphicsApi::DrawFrame(std::function<void()> render_fn, bool & out_swap_cha
 
 	render_fn();
 
+	// render_fn is expected to trace itself
+	stage_begin_ns = m_trace_zone_fn ? trace_now_ns() : 0;
+
 	vk::PipelineStageFlags wait_stages{ vk::PipelineStageFlagBits::eColorAttachmentOutput };
 	vk::SubmitInfo submit_info{
 		.waitSemaphoreCount = 1,
@@ -568,6 +613,8 @@ void GraphicsApi::DrawFrame(std::function<void()> render_fn, bool & out_swap_cha
 
 	m_queue.submit(submit_info, *m_draw_fences[m_current_frame]);
 
+	trace_stage("GraphicsApi::DrawFrame submit", stage_begin_ns);
+
 	vk::PresentInfoKHR present_info{
 		.waitSemaphoreCount = 1,
 		.pWaitSemaphores = &*m_render_finished_semaphores[m_current_image_index],
@@ -587,6 +634,8 @@ void GraphicsApi::DrawFrame(std::function<void()> render_fn, bool & out_swap_cha
 		out_swap_chain_out_of_date = true;
 	}
 
+	trace_stage("GraphicsApi::DrawFrame present", stage_begin_ns);
+
 	m_current_frame = (m_current_frame + 1) % m_max_frames_in_flight;
 }
 
@@ -805,3 +854,133 @@ void GraphicsApi::TransitionImageLayout(vk::Image image, std::uint32_t layers, v
 				{}, {}, barrier);
 		});
 }
+
+std::span<std::byte> GraphicsApi::QueueImageUpdate(vk::Image image, vk::Offset2D offset, vk::Extent2D extent, vk::DeviceSize size) const
+{
+	// The copies' buffer offsets have to be a multiple of the texel size, 3 or 4 bytes
+	constexpr vk::DeviceSize alignment = 12;
+	vk::DeviceSize const data_offset = (m_pending_image_data.size() + alignment - 1) / alignment * alignment;
+	m_pending_image_data.resize(data_offset + size);
+
+	m_pending_image_updates.push_back(PendingImageUpdate{
+		.image = image,
+		.data_offset = data_offset,
+		.offset = offset,
+		.extent = extent
+	});
+
+	return std::span<std::byte>{ m_pending_image_data.data() + data_offset, size };
+}
+
+GraphicsApi::StagingBuffer & GraphicsApi::get_staging_buffer(vk::DeviceSize size) const
+{
+	StagingBuffer & staging_buffer = m_staging_buffers[m_current_frame];
+	if (staging_buffer.size >= size)
+		return staging_buffer;
+
+	// Grows to the largest frame's updates, so it's soon no longer recreated
+	vk::DeviceSize const new_size = std::max(size, 2 * staging_buffer.size);
+	staging_buffer = StagingBuffer{ .size = new_size };
+
+	vk::BufferCreateInfo buffer_info{
+		.size = staging_buffer.size,
+		.usage = vk::BufferUsageFlagBits::eTransferSrc,
+		.sharingMode = vk::SharingMode::eExclusive,
+	};
+	staging_buffer.buffer = vk::raii::Buffer{ m_logical_device, buffer_info };
+
+	vk::MemoryRequirements mem_requirements = staging_buffer.buffer.getMemoryRequirements();
+	vk::MemoryAllocateInfo alloc_info{
+		.allocationSize = mem_requirements.size,
+		.memoryTypeIndex = FindMemoryType(mem_requirements.memoryTypeBits,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+	};
+	staging_buffer.memory = vk::raii::DeviceMemory{ m_logical_device, alloc_info };
+	staging_buffer.buffer.bindMemory(staging_buffer.memory, 0);
+
+	// Stays mapped, freeing the memory unmaps it
+	staging_buffer.mapping = static_cast<std::byte *>(staging_buffer.memory.mapMemory(0, staging_buffer.size));
+
+	return staging_buffer;
+}
+
+void GraphicsApi::RecordImageUpdates(vk::raii::CommandBuffer const & command_buffer) const
+{
+	if (m_pending_image_updates.empty())
+		return;
+
+	// The frame's fence was waited for, the gpu is done reading its staging buffer
+	StagingBuffer * staging_buffer_ptr = nullptr;
+	try
+	{
+		staging_buffer_ptr = &get_staging_buffer(m_pending_image_data.size());
+	}
+	catch (vk::SystemError const & err)
+	{
+		std::cout << "GraphicsApi::RecordImageUpdates: Failed to create the staging buffer. " << err.what() << std::endl;
+		m_pending_image_data.clear();
+		m_pending_image_updates.clear();
+		return;
+	}
+
+	StagingBuffer & staging_buffer = *staging_buffer_ptr;
+	std::memcpy(staging_buffer.mapping, m_pending_image_data.data(), m_pending_image_data.size());
+
+	// One barrier per image, so the images updated several times in a frame wait for the previous frames' reads once
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	for (PendingImageUpdate const & update : m_pending_image_updates)
+	{
+		if (std::ranges::find(barriers, update.image, &vk::ImageMemoryBarrier::image) != barriers.end())
+			continue;
+
+		barriers.push_back(vk::ImageMemoryBarrier{
+			.srcAccessMask = vk::AccessFlagBits::eShaderRead,
+			.dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+			.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+			.newLayout = vk::ImageLayout::eTransferDstOptimal,
+			.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.image = update.image,
+			.subresourceRange{
+				.aspectMask = vk::ImageAspectFlagBits::eColor,
+				.levelCount = 1,
+				.layerCount = 1,
+			}
+		});
+	}
+	command_buffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+		vk::DependencyFlags{}, {}, {}, barriers);
+
+	for (PendingImageUpdate const & update : m_pending_image_updates)
+	{
+		vk::BufferImageCopy region{
+			.bufferOffset = update.data_offset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource{
+				.aspectMask = vk::ImageAspectFlagBits::eColor,
+				.mipLevel = 0,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.imageOffset{ update.offset.x, update.offset.y, 0 },
+			.imageExtent{ update.extent.width, update.extent.height, 1 }
+		};
+		command_buffer.copyBufferToImage(*staging_buffer.buffer, update.image, vk::ImageLayout::eTransferDstOptimal, region);
+	}
+
+	for (vk::ImageMemoryBarrier & barrier : barriers)
+	{
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	}
+	command_buffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+		vk::DependencyFlags{}, {}, {}, barriers);
+
+	m_pending_image_data.clear();
+	m_pending_image_updates.clear();
+}
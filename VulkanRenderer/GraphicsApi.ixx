@@ -2,8 +2,11 @@
 
 module;
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -14,6 +17,8 @@ module;
 
 export module GraphicsApi;
 
+import StateCache;
+
 struct SwapChainSupportDetails
 {
 	vk::SurfaceCapabilitiesKHR capabilities;
@@ -39,6 +44,9 @@ export class GraphicsApi
 public:
 	constexpr static std::uint32_t m_max_frames_in_flight = 2;
 
+	// Optional hook for cpu profiling of the frame stages, timestamps are std::chrono::steady_clock nanoseconds
+	using TraceZoneFn = void (*)(char const * name, std::uint64_t begin_ns, std::uint64_t end_ns);
+
 public:
 	explicit GraphicsApi(
 		GLFWwindow * window, // Reminder: Do not call any glfw functions that require being on the main thread
@@ -54,6 +62,8 @@ public:
 	void DrawFrame(std::function<void()> render_fn, bool & out_window_size_out_of_date);
 	void WaitForLastFrame() const;
 
+	void SetTraceZoneCallback(TraceZoneFn trace_zone_fn) { m_trace_zone_fn = trace_zone_fn; }
+
 	std::uint32_t FindMemoryType(std::uint32_t type_filter, vk::MemoryPropertyFlags properties) const;
 
 	vk::raii::Image Create2dImage(
@@ -81,6 +91,13 @@ public:
 	void CopyBufferToImage(vk::Buffer buffer, vk::Image image, std::uint32_t width, std::uint32_t height, std::uint32_t layers) const;
 	void TransitionImageLayout(vk::Image image, std::uint32_t layers, vk::Format format, vk::ImageLayout old_layout, vk::ImageLayout new_layout) const;
 
+	// Queues a copy into a region of the first layer and mip level of a color image in eShaderReadOnlyOptimal layout.
+	// The caller writes the region's tightly packed texels into the returned bytes. The copy is recorded into the next
+	// frame's command buffer, so the image has to live until that frame is done.
+	std::span<std::byte> QueueImageUpdate(vk::Image image, vk::Offset2D offset, vk::Extent2D extent, vk::DeviceSize size) const;
+	// Records the queued image updates, called by the renderer once recording began and before rendering does
+	void RecordImageUpdates(vk::raii::CommandBuffer const & command_buffer) const;
+
 	// glm expects opengl style screen coordinates, so we need to flip the Y axis
 	bool ShouldFlipScreenY() const { return true; }
 
@@ -97,10 +114,33 @@ public:
 
 	PhysicalDeviceInfo const & GetPhysicalDeviceInfo() const { return m_phys_device_info; }
 
+	// Tracks the binds recorded into the current command buffer, reset by the renderer when recording begins
+	StateCache & GetStateCache() const { return m_state_cache; }
+
 private:
 	void create_depth_resources();
 	void destroy_swap_chain();
 
+	void trace_stage(char const * name, std::uint64_t & stage_begin_ns) const;
+
+	struct PendingImageUpdate
+	{
+		vk::Image image;
+		vk::DeviceSize data_offset = 0; // into m_pending_image_data
+		vk::Offset2D offset;
+		vk::Extent2D extent;
+	};
+
+	struct StagingBuffer
+	{
+		vk::raii::Buffer buffer = nullptr;
+		vk::raii::DeviceMemory memory = nullptr;
+		std::byte * mapping = nullptr;
+		vk::DeviceSize size = 0;
+	};
+
+	StagingBuffer & get_staging_buffer(vk::DeviceSize size) const;
+
 private:
 	vk::raii::Context m_context;
 	vk::raii::Instance m_instance = nullptr;
@@ -126,6 +166,11 @@ private:
 	vk::raii::CommandPool m_command_pool = nullptr;
 	vk::raii::CommandBuffers m_command_buffers = nullptr;
 
+	// The image updates wait on the cpu until the next frame is recorded, only then is its staging buffer no longer read
+	mutable std::vector<std::byte> m_pending_image_data;
+	mutable std::vector<PendingImageUpdate> m_pending_image_updates;
+	mutable std::array<StagingBuffer, m_max_frames_in_flight> m_staging_buffers;
+
 	// VkSemaphore is used for synchronizing commands on the gpu
 	std::vector<vk::raii::Semaphore> m_present_complete_semaphores;
 	std::vector<vk::raii::Semaphore> m_render_finished_semaphores;
@@ -134,6 +179,10 @@ private:
 
 	std::uint32_t m_current_frame = 0;
 
+	TraceZoneFn m_trace_zone_fn = nullptr;
+
+	mutable StateCache m_state_cache;
+
 	std::vector<const char *> const m_device_extensions = {
 		vk::KHRSwapchainExtensionName
 	};
@@ -14,6 +14,9 @@ module GraphicsPipeline;
 
 import GraphicsApi;
 import GraphicsError;
+import StateCache;
+import StorageBuffer;
+import TextureTable;
 
 DescriptorSets::DescriptorSets(GraphicsApi const & graphics_api)
 	: m_graphics_api(graphics_api)
@@ -24,10 +27,11 @@ vk::raii::DescriptorSetLayout create_descriptor_set_layout(
 	vk::raii::Device const & device,
 	std::uint32_t vs_descriptor_set_count,
 	std::uint32_t fs_descriptor_set_count,
+	std::uint32_t fs_storage_buffer_count,
 	bool has_texture)
 {
 	std::vector<vk::DescriptorSetLayoutBinding> layout_bindings;
-	layout_bindings.reserve(vs_descriptor_set_count + fs_descriptor_set_count + (has_texture ? 1 : 0));
+	layout_bindings.reserve(vs_descriptor_set_count + fs_descriptor_set_count + fs_storage_buffer_count + (has_texture ? 1 : 0));
 
 	for (std::uint32_t i = 0; i < vs_descriptor_set_count; ++i)
 	{
@@ -51,6 +55,17 @@ vk::raii::DescriptorSetLayout create_descriptor_set_layout(
 				.pImmutableSamplers = nullptr
 			});
 	}
+	for (std::uint32_t i = 0; i < fs_storage_buffer_count; ++i)
+	{
+		layout_bindings.emplace_back(
+			vk::DescriptorSetLayoutBinding{
+				.binding = static_cast<std::uint32_t>(layout_bindings.size()),
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+				.descriptorCount = 1,
+				.stageFlags = vk::ShaderStageFlagBits::eFragment,
+				.pImmutableSamplers = nullptr
+			});
+	}
 
 	if (has_texture)
 	{
@@ -75,6 +90,7 @@ vk::raii::DescriptorSetLayout create_descriptor_set_layout(
 vk::raii::DescriptorPool create_descriptor_pool(
 	vk::raii::Device const & device,
 	std::uint32_t uniform_count,
+	std::uint32_t storage_buffer_count,
 	std::uint32_t descriptor_set_count,
 	bool has_texture)
 {
@@ -88,6 +104,15 @@ vk::raii::DescriptorPool create_descriptor_pool(
 			});
 	}
 
+	if (storage_buffer_count > 0)
+	{
+		pool_sizes.emplace_back(
+			vk::DescriptorPoolSize{
+				.type = vk::DescriptorType::eStorageBuffer,
+				.descriptorCount = storage_buffer_count * descriptor_set_count
+			});
+	}
+
 	if (has_texture)
 	{
 		pool_sizes.emplace_back(
@@ -112,8 +137,9 @@ std::vector<vk::raii::DescriptorSet> create_descriptor_sets(
 	vk::raii::Device const & device,
 	vk::raii::DescriptorSetLayout const & layout,
 	vk::DescriptorPool pool,
-	std::array<std::vector<vk::Buffer>, count> uniform_buffers,
-	std::vector<vk::DeviceSize> uniform_sizes,
+	std::array<std::vector<vk::Buffer>, count> const & uniform_buffers,
+	std::vector<vk::DeviceSize> const & uniform_sizes,
+	std::vector<StorageBuffer const *> const & storage_buffers,
 	Texture const * texture)
 {
 	std::array<vk::DescriptorSetLayout, count> layouts;
@@ -139,6 +165,14 @@ std::vector<vk::raii::DescriptorSet> create_descriptor_sets(
 				.range = uniform_sizes[binding] // or VK_WHOLE_SIZE
 				});
 		}
+		for (StorageBuffer const * storage_buffer : storage_buffers)
+		{
+			buffer_infos.emplace_back(vk::DescriptorBufferInfo{
+				.buffer = storage_buffer->GetBuffer(static_cast<std::uint32_t>(frame)),
+				.offset = 0,
+				.range = storage_buffer->GetSize()
+				});
+		}
 
 		if (texture != nullptr && texture->IsValid())
 		{
@@ -166,6 +200,19 @@ std::vector<vk::raii::DescriptorSet> create_descriptor_sets(
 				.pTexelBufferView = nullptr
 				});
 		}
+		for (size_t i = 0; i < storage_buffers.size(); ++i)
+		{
+			descriptor_writes.emplace_back(vk::WriteDescriptorSet{
+				.dstSet = descriptor_sets[frame],
+				.dstBinding = static_cast<std::uint32_t>(uniform_sizes.size() + i),
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+				.pImageInfo = nullptr,
+				.pBufferInfo = &buffer_infos[descriptor_writes.size()],
+				.pTexelBufferView = nullptr
+				});
+		}
 	}
 	if (texture != nullptr && texture->IsValid())
 	{
@@ -173,7 +220,7 @@ std::vector<vk::raii::DescriptorSet> create_descriptor_sets(
 		{
 			descriptor_writes.emplace_back(vk::WriteDescriptorSet{
 				.dstSet = descriptor_sets[frame],
-				.dstBinding = static_cast<std::uint32_t>(uniform_sizes.size()),
+				.dstBinding = static_cast<std::uint32_t>(uniform_sizes.size() + storage_buffers.size()),
 				.dstArrayElement = 0,
 				.descriptorCount = 1,
 				.descriptorType = vk::DescriptorType::eCombinedImageSampler,
@@ -206,6 +253,7 @@ void create_uniform_buffer(
 void DescriptorSets::Create(
 	std::vector<vk::DeviceSize> const & vs_uniform_sizes,
 	std::vector<vk::DeviceSize> const & fs_uniform_sizes,
+	std::vector<StorageBuffer const *> const & fs_storage_buffers,
 	Texture const * texture)
 {
 	vk::raii::Device const & device = m_graphics_api.get().GetDevice();
@@ -214,13 +262,15 @@ void DescriptorSets::Create(
 	m_descriptor_set_layout = create_descriptor_set_layout(device,
 		static_cast<std::uint32_t>(vs_uniform_sizes.size()),
 		static_cast<std::uint32_t>(fs_uniform_sizes.size()),
+		static_cast<std::uint32_t>(fs_storage_buffers.size()),
 		has_texture);
 
 	std::vector<VkDeviceSize> uniform_sizes{ vs_uniform_sizes };
 	uniform_sizes.insert(uniform_sizes.end(), fs_uniform_sizes.begin(), fs_uniform_sizes.end());
 
 	m_descriptor_pool = create_descriptor_pool(device,
-		static_cast<std::uint32_t>(uniform_sizes.size()) /*descriptor_count*/,
+		static_cast<std::uint32_t>(uniform_sizes.size()) /*uniform_count*/,
+		static_cast<std::uint32_t>(fs_storage_buffers.size()) /*storage_buffer_count*/,
 		GraphicsApi::m_max_frames_in_flight /*descriptor_set_count*/,
 		has_texture);
 
@@ -237,7 +287,7 @@ void DescriptorSets::Create(
 	}
 
 	std::vector<vk::raii::DescriptorSet> descriptor_sets = create_descriptor_sets<GraphicsApi::m_max_frames_in_flight>(
-		device, m_descriptor_set_layout, m_descriptor_pool, uniform_buffers, uniform_sizes, texture);
+		device, m_descriptor_set_layout, m_descriptor_pool, uniform_buffers, uniform_sizes, fs_storage_buffers, texture);
 
 	for (size_t frame = 0; frame < GraphicsApi::m_max_frames_in_flight; ++frame)
 		m_descriptor_sets[frame].descriptor_set = std::move(descriptor_sets[frame]);
@@ -245,12 +295,12 @@ void DescriptorSets::Create(
 
 vk::raii::PipelineLayout create_pipeline_layout(
 	vk::raii::Device const & device,
-	vk::DescriptorSetLayout descriptor_set_layout,
+	std::vector<vk::DescriptorSetLayout> const & descriptor_set_layouts,
 	std::vector<vk::PushConstantRange> const & push_constant_ranges)
 {
 	vk::PipelineLayoutCreateInfo pipeline_layout_info{
-		.setLayoutCount = 1,
-		.pSetLayouts = &descriptor_set_layout,
+		.setLayoutCount = static_cast<std::uint32_t>(descriptor_set_layouts.size()),
+		.pSetLayouts = descriptor_set_layouts.data(),
 		.pushConstantRangeCount = static_cast<std::uint32_t>(push_constant_ranges.size()),
 		.pPushConstantRanges = push_constant_ranges.data(),
 	};
@@ -362,13 +412,9 @@ vk::raii::Pipeline create_pipeline(
 	return vk::raii::Pipeline(device, nullptr, pipeline_info.get<vk::GraphicsPipelineCreateInfo>());
 }
 
-GraphicsPipeline::GraphicsPipeline(GraphicsApi const & graphics_api,
-	PerFrameConstantsCallback per_frame_constants_callback,
-	PerObjectConstantsCallback per_object_constants_callback)
+GraphicsPipeline::GraphicsPipeline(GraphicsApi const & graphics_api)
 	: m_graphics_api(graphics_api)
 	, m_descriptor_sets(graphics_api)
-	, m_per_frame_constants_callback(per_frame_constants_callback)
-	, m_per_object_constants_callback(per_object_constants_callback)
 {
 }
 
@@ -379,18 +425,25 @@ std::expected<void, GraphicsError> GraphicsPipeline::Create(
 	std::vector<vk::PushConstantRange> const & push_constants_ranges,
 	std::vector<vk::DeviceSize> const & vs_uniform_sizes,
 	std::vector<vk::DeviceSize> const & fs_uniform_sizes,
+	std::vector<StorageBuffer const *> const & fs_storage_buffers,
 	Texture const * texture,
+	TextureTable const * texture_table,
 	DepthTestOptions const & depth_options,
 	BlendOptions const & blend_options,
 	CullMode cull_mode)
 {
 	try
 	{
-		m_descriptor_sets.Create(vs_uniform_sizes, fs_uniform_sizes, texture);
+		m_descriptor_sets.Create(vs_uniform_sizes, fs_uniform_sizes, fs_storage_buffers, texture);
+		m_texture_table = texture_table;
+
+		std::vector<vk::DescriptorSetLayout> descriptor_set_layouts{ *m_descriptor_sets.GetLayout() };
+		if (m_texture_table)
+			descriptor_set_layouts.push_back(m_texture_table->GetLayout()); // TextureTable::m_descriptor_set_index
 
 		m_pipeline_layout = create_pipeline_layout(
 			m_graphics_api.get().GetDevice(),
-			m_descriptor_sets.GetLayout(),
+			descriptor_set_layouts,
 			push_constants_ranges);
 
 		m_pipeline = create_pipeline(
@@ -418,27 +471,13 @@ void GraphicsPipeline::Activate() const
 	if (m_pipeline == nullptr)
 		return;
 
-	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.get().GetCurCommandBuffer();
+	GraphicsApi const & graphics_api = m_graphics_api.get();
+	vk::raii::CommandBuffer const & command_buffer = graphics_api.GetCurCommandBuffer();
+	StateCache & state_cache = graphics_api.GetStateCache();
 
-	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *m_pipeline);
-
-	command_buffer.bindDescriptorSets(
-		vk::PipelineBindPoint::eGraphics,
-		*m_pipeline_layout,
-		0 /*firstSet*/,
-		vk::DescriptorSet{ m_descriptor_sets.GetCurrent().descriptor_set },
-		{} /*dynamicOffsets*/
-	);
-}
+	state_cache.BindPipeline(command_buffer, *m_pipeline);
+	state_cache.BindDescriptorSet(command_buffer, *m_pipeline_layout, 0 /*set_index*/, *m_descriptor_sets.GetCurrent().descriptor_set);
 
-void GraphicsPipeline::UpdatePerFrameConstants() const
-{
-	if (m_per_frame_constants_callback)
-		m_per_frame_constants_callback(*this);
-}
-
-void GraphicsPipeline::UpdatePerObjectConstants(void const * object_data) const
-{
-	if (m_per_object_constants_callback)
-		m_per_object_constants_callback(*this, object_data);
+	if (m_texture_table)
+		state_cache.BindDescriptorSet(command_buffer, *m_pipeline_layout, TextureTable::m_descriptor_set_index, m_texture_table->GetDescriptorSet());
 }
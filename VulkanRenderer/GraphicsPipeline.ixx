@@ -16,7 +16,10 @@ export module GraphicsPipeline;
 import Buffer;
 import GraphicsApi;
 import GraphicsError;
+import StateCache;
+import StorageBuffer;
 import Texture;
+import TextureTable;
 
 struct UniformBuffer
 {
@@ -44,6 +47,7 @@ public:
 	void Create(
 		std::vector<VkDeviceSize> const & vs_uniform_sizes,
 		std::vector<VkDeviceSize> const & fs_uniform_sizes,
+		std::vector<StorageBuffer const *> const & fs_storage_buffers,
 		Texture const * texture);
 
 	DescriptorSet const & GetCurrent() const { return m_descriptor_sets[m_graphics_api.get().GetCurFrameIndex()]; }
@@ -115,13 +119,7 @@ export struct BlendOptions
 export class GraphicsPipeline
 {
 public:
-	using PerFrameConstantsCallback = std::function<void(GraphicsPipeline const & pipeline)>;
-	using PerObjectConstantsCallback = std::function<void(GraphicsPipeline const & pipeline, void const * object_data)>;
-
-	explicit GraphicsPipeline(
-		GraphicsApi const & graphics_api,
-		PerFrameConstantsCallback per_frame_constants_callback,
-		PerObjectConstantsCallback per_object_constants_callback);
+	explicit GraphicsPipeline(GraphicsApi const & graphics_api);
 	~GraphicsPipeline() = default;
 
 	GraphicsPipeline(GraphicsPipeline && other) = default;
@@ -137,14 +135,14 @@ public:
 		std::vector<vk::PushConstantRange> const & push_constants_ranges,
 		std::vector<vk::DeviceSize> const & vs_uniform_sizes,
 		std::vector<vk::DeviceSize> const & fs_uniform_sizes,
+		std::vector<StorageBuffer const *> const & fs_storage_buffers,
 		Texture const * texture,
+		TextureTable const * texture_table,
 		DepthTestOptions const & depth_options,
 		BlendOptions const & blend_options,
 		CullMode cull_mode);
 
 	void Activate() const;
-	void UpdatePerFrameConstants() const;
-	void UpdatePerObjectConstants(void const * object_data) const;
 
 	template <typename UniformData>
 	void SetUniform(std::uint32_t binding, UniformData const & data) const;
@@ -159,9 +157,7 @@ private:
 	vk::raii::Pipeline m_pipeline = nullptr;
 
 	DescriptorSets m_descriptor_sets;
-
-	PerFrameConstantsCallback m_per_frame_constants_callback;
-	PerObjectConstantsCallback m_per_object_constants_callback;
+	TextureTable const * m_texture_table = nullptr;
 };
 
 template <typename UniformData>
@@ -177,18 +173,20 @@ void GraphicsPipeline::SetObjectData(ObjectDataVS const & vs_data, ObjectDataFS
 	static_assert(!std::same_as<ObjectDataVS, std::nullopt_t> || !std::same_as<ObjectDataFS, std::nullopt_t>,
 		"At least one push constant data must be provided");
 
-	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.get().GetCurCommandBuffer();
+	GraphicsApi const & graphics_api = m_graphics_api.get();
+	vk::raii::CommandBuffer const & command_buffer = graphics_api.GetCurCommandBuffer();
+	StateCache & state_cache = graphics_api.GetStateCache();
 	std::uint32_t offset = 0;
 
 	if constexpr (!std::same_as<ObjectDataVS, std::nullopt_t>)
 	{
-		command_buffer.pushConstants<ObjectDataVS>(m_pipeline_layout, vk::ShaderStageFlagBits::eVertex, offset, vs_data);
+		state_cache.PushConstants(command_buffer, *m_pipeline_layout, vk::ShaderStageFlagBits::eVertex, offset, vs_data);
 
 		offset += static_cast<std::uint32_t>(sizeof(ObjectDataVS));
 	}
 
 	if constexpr (!std::same_as<ObjectDataFS, std::nullopt_t>)
 	{
-		command_buffer.pushConstants<ObjectDataFS>(m_pipeline_layout, vk::ShaderStageFlagBits::eFragment, offset, fs_data);
+		state_cache.PushConstants(command_buffer, *m_pipeline_layout, vk::ShaderStageFlagBits::eFragment, offset, fs_data);
 	}
 }
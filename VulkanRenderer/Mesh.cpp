@@ -2,38 +2,68 @@
 
 module;
 
+#include <algorithm>
 #include <cstdint>
+#include <span>
 #include <utility>
 
 #include <vulkan/vulkan_raii.hpp>
 
 module Mesh;
 
+import StateCache;
+
 bool Mesh::IsInitialized() const
 {
-	return m_vertex_buffer.Get() != nullptr
-		&& m_vertex_buffer.GetMemory() != nullptr
+	return ((m_vertex_buffer.Get() != nullptr && m_vertex_buffer.GetMemory() != nullptr) || IsDynamic())
 		&& m_index_buffer.Get() != nullptr
 		&& m_index_buffer.GetMemory() != nullptr
-		&& m_index_count > 0;
+		&& !m_lods.empty();
+}
+
+void Mesh::SetIndexCount(std::uint32_t index_count)
+{
+	if (!IsDynamic() || m_lods.empty())
+		return;
+
+	// The indices are laid out for the full capacity, this only picks how many of them are drawn
+	m_lods[0].index_count = std::min(index_count, m_index_capacity);
 }
 
-void Mesh::Render() const
+void Mesh::Render(std::uint32_t lod /*= 0*/) const
 {
 	if (!IsInitialized())
 		return;
 
-	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.get().GetCurCommandBuffer();
+	MeshLod const & mesh_lod = m_lods[std::min(lod, GetLodCount() - 1)];
+	MeshIndexRange const range{ .first_index = mesh_lod.first_index, .index_count = mesh_lod.index_count };
+	Render(std::span<MeshIndexRange const>{ &range, 1 });
+}
+
+void Mesh::Render(std::span<MeshIndexRange const> ranges) const
+{
+	if (!IsInitialized() || ranges.empty() || m_instance_count == 0)
+		return;
+
+	GraphicsApi const & graphics_api = m_graphics_api.get();
+	vk::raii::CommandBuffer const & command_buffer = graphics_api.GetCurCommandBuffer();
+	StateCache & state_cache = graphics_api.GetStateCache();
 
-	command_buffer.bindVertexBuffers(0 /*firstBinding*/, *m_vertex_buffer.Get(), vk::DeviceSize{ 0 } /*offsets*/);
+	Buffer const & vertex_buffer = IsDynamic()
+		? m_frame_vertex_buffers[graphics_api.GetCurFrameIndex()]
+		: m_vertex_buffer;
+	state_cache.BindVertexBuffer(command_buffer, *vertex_buffer.Get());
 
 	static_assert(std::same_as<IndexT, std::uint16_t>);
-	command_buffer.bindIndexBuffer(m_index_buffer.Get(), vk::DeviceSize{ 0 } /*offset*/, vk::IndexType::eUint16);
-
-	command_buffer.drawIndexed(
-		m_index_count,
-		1 /*instanceCount*/,
-		0 /*firstIndex*/,
-		0 /*vertexOffset*/,
-		0 /*firstInstance*/);
+	state_cache.BindIndexBuffer(command_buffer, *m_index_buffer.Get(), vk::IndexType::eUint16);
+
+	for (MeshIndexRange const & range : ranges)
+	{
+		command_buffer.drawIndexed(
+			range.index_count,
+			m_instance_count,
+			range.first_index,
+			0 /*vertexOffset*/,
+			0 /*firstInstance*/);
+	}
 }
@@ -2,12 +2,23 @@
 
 module;
 
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <expected>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
 #include <vulkan/vulkan_raii.hpp>
 
 export module Mesh;
@@ -17,6 +28,34 @@ import GraphicsApi;
 import GraphicsError;
 import VertexLayout;
 
+// A level of detail of a mesh, a range of its index buffer. The lods of a mesh share its vertex buffer.
+export struct MeshLod
+{
+	std::uint32_t first_index = 0;
+	std::uint32_t index_count = 0;
+	float error = 0.0f; // distance the lod deviates from the full mesh by, in object space
+	std::uint32_t first_meshlet = 0;
+	std::uint32_t meshlet_count = 0; // 0 if the lod isn't split into meshlets
+};
+
+// A small cluster of triangles of a lod, a range of its index buffer, with the bounds used to cull it
+export struct Meshlet
+{
+	std::uint32_t first_index = 0;
+	std::uint32_t index_count = 0;
+	glm::vec3 center{ 0.0f }; // bounding sphere in object space
+	float radius = 0.0f;
+	glm::vec3 cone_axis{ 0.0f }; // average normal of the triangles
+	float cone_cutoff = 1.0f; // sine of the angle between the axis and the normal furthest from it, 1 if it can't be culled
+};
+
+// A range of the index buffer to draw, e.g. a run of visible meshlets
+export struct MeshIndexRange
+{
+	std::uint32_t first_index = 0;
+	std::uint32_t index_count = 0;
+};
+
 export class Mesh
 {
 public:
@@ -31,14 +70,47 @@ public:
 	Mesh(Mesh const &) = delete;
 	Mesh & operator=(Mesh const &) = delete;
 
+	// Without lods the whole index buffer is the only lod. The meshlets of a lod are referenced by its meshlet range.
 	template <Vertex::VertexWithLayout VertexT>
 	std::expected<void, GraphicsError> Create(
 		std::vector<VertexT> const & vertices,
-		std::vector<IndexT> const & indices);
+		std::vector<IndexT> const & indices,
+		std::vector<MeshLod> lods = {},
+		std::vector<Meshlet> meshlets = {});
+
+	// A mesh whose vertices are rewritten while it's in use, e.g. text. The vertex buffer has a persistently mapped
+	// copy per frame in flight and the indices are static, only the number of indices drawn changes with the content.
+	template <Vertex::VertexWithLayout VertexT>
+	std::expected<void, GraphicsError> CreateDynamic(std::uint32_t vertex_capacity, std::vector<IndexT> const & indices);
 
 	bool IsInitialized() const;
+	bool IsDynamic() const { return m_frame_vertex_mappings[0] != nullptr; }
+	std::uint32_t GetVertexCapacity() const { return m_vertex_capacity; }
 
-	void Render() const;
+	// Copies vertices into the current frame's copy of a dynamic mesh, the other copies keep their old content.
+	// Call it while the frame is recorded, once the frame that last used the copy is done on the gpu.
+	template <typename VertexT>
+	void WriteVertices(std::span<VertexT const> vertices, std::uint32_t first_vertex);
+	// Number of indices a dynamic mesh draws from the start of its index buffer
+	void SetIndexCount(std::uint32_t index_count);
+	// Number of times a dynamic mesh is drawn, for vertex types with per instance attributes. The vertices written
+	// with WriteVertices are then the instances and the index buffer indexes the vertices of one instance.
+	void SetInstanceCount(std::uint32_t instance_count) { m_instance_count = instance_count; }
+
+	// Lods are ordered from the full mesh to the coarsest one
+	std::uint32_t GetLodCount() const { return static_cast<std::uint32_t>(m_lods.size()); }
+	MeshLod const & GetLod(std::uint32_t lod) const { return m_lods[lod]; }
+	std::span<Meshlet const> GetMeshlets(std::uint32_t lod) const
+	{
+		return std::span<Meshlet const>{ m_meshlets }.subspan(m_lods[lod].first_meshlet, m_lods[lod].meshlet_count);
+	}
+
+	glm::vec3 const & GetBoundsCenter() const { return m_bounds_center; }
+	float GetBoundsRadius() const { return m_bounds_radius; }
+
+	void Render(std::uint32_t lod = 0) const;
+	// Draws parts of the index buffer, the ranges come from Mesh::GetMeshlets
+	void Render(std::span<MeshIndexRange const> ranges) const;
 
 private:
 	std::reference_wrapper<GraphicsApi const> m_graphics_api;
@@ -46,9 +118,46 @@ private:
 	Buffer m_vertex_buffer;
 	Buffer m_index_buffer;
 
-	std::uint32_t m_index_count = 0;
+	// Only used by dynamic meshes
+	std::array<Buffer, GraphicsApi::m_max_frames_in_flight> m_frame_vertex_buffers;
+	std::array<void *, GraphicsApi::m_max_frames_in_flight> m_frame_vertex_mappings{};
+	std::size_t m_vertex_stride = 0;
+	std::uint32_t m_vertex_capacity = 0;
+	std::uint32_t m_index_capacity = 0;
+	std::uint32_t m_instance_count = 1;
+
+	std::vector<MeshLod> m_lods;
+	std::vector<Meshlet> m_meshlets;
+	glm::vec3 m_bounds_center{ 0.0f };
+	float m_bounds_radius = 0.0f;
 };
 
+// Bounding sphere around the vertex positions, centered on their bounding box
+template <typename VertexT>
+void compute_bounding_sphere(std::vector<VertexT> const & vertices, glm::vec3 & out_center, float & out_radius)
+{
+	auto get_pos = [](VertexT const & vertex)
+		{
+			if constexpr (std::same_as<decltype(VertexT::pos), glm::vec2>)
+				return glm::vec3{ vertex.pos, 0.0f };
+			else
+				return glm::vec3{ vertex.pos };
+		};
+
+	glm::vec3 min_pos = get_pos(vertices.front());
+	glm::vec3 max_pos = min_pos;
+	for (VertexT const & vertex : vertices)
+	{
+		min_pos = glm::min(min_pos, get_pos(vertex));
+		max_pos = glm::max(max_pos, get_pos(vertex));
+	}
+
+	out_center = (min_pos + max_pos) * 0.5f;
+	out_radius = 0.0f;
+	for (VertexT const & vertex : vertices)
+		out_radius = std::max(out_radius, glm::length(get_pos(vertex) - out_center));
+}
+
 Mesh::Mesh(GraphicsApi const & graphics_api)
 	: m_graphics_api{ graphics_api }
 {
@@ -57,7 +166,7 @@ Mesh::Mesh(GraphicsApi const & graphics_api)
 template <typename T>
 Buffer create_buffer(
 	GraphicsApi const & graphics_api,
-	std::vector<T> objects,
+	std::vector<T> const & objects,
 	vk::BufferUsageFlagBits buffer_usage)
 {
 	VkDeviceSize buffer_size = sizeof(objects[0]) * objects.size();
@@ -87,11 +196,28 @@ Buffer create_buffer(
 template<Vertex::VertexWithLayout VertexT>
 std::expected<void, GraphicsError> Mesh::Create(
 	std::vector<VertexT> const & vertices,
-	std::vector<IndexT> const & indices)
+	std::vector<IndexT> const & indices,
+	std::vector<MeshLod> lods /*= {}*/,
+	std::vector<Meshlet> meshlets /*= {}*/)
 {
 	if (vertices.empty() || indices.empty())
 		return std::unexpected{ GraphicsError{ "Mesh::Create: invalid vertices or indicies." } };
 
+	if (lods.empty())
+		lods.push_back(MeshLod{ .first_index = 0, .index_count = static_cast<std::uint32_t>(indices.size()) });
+	for (MeshLod const & lod : lods)
+	{
+		if (lod.index_count == 0 || std::size_t{ lod.first_index } + lod.index_count > indices.size())
+			return std::unexpected{ GraphicsError{ "Mesh::Create: lod index range is out of bounds." } };
+		if (std::size_t{ lod.first_meshlet } + lod.meshlet_count > meshlets.size())
+			return std::unexpected{ GraphicsError{ "Mesh::Create: lod meshlet range is out of bounds." } };
+	}
+	for (Meshlet const & meshlet : meshlets)
+	{
+		if (std::size_t{ meshlet.first_index } + meshlet.index_count > indices.size())
+			return std::unexpected{ GraphicsError{ "Mesh::Create: meshlet index range is out of bounds." } };
+	}
+
 	try
 	{
 		m_vertex_buffer = create_buffer(
@@ -109,7 +235,60 @@ std::expected<void, GraphicsError> Mesh::Create(
 		return std::unexpected{ GraphicsError{ "Mesh::Create: failed to create buffers. code: " + std::to_string(err.code().value()) } };
 	}
 
-	m_index_count = static_cast<std::uint32_t>(indices.size());
+	m_lods = std::move(lods);
+	m_meshlets = std::move(meshlets);
+	compute_bounding_sphere(vertices, m_bounds_center, m_bounds_radius);
 
 	return {};
 }
+
+template <Vertex::VertexWithLayout VertexT>
+std::expected<void, GraphicsError> Mesh::CreateDynamic(std::uint32_t vertex_capacity, std::vector<IndexT> const & indices)
+{
+	if (vertex_capacity == 0 || indices.empty())
+		return std::unexpected{ GraphicsError{ "Mesh::CreateDynamic: invalid capacity or indicies." } };
+
+	vk::DeviceSize const size = vertex_capacity * sizeof(VertexT);
+	try
+	{
+		for (std::size_t frame = 0; frame < m_frame_vertex_buffers.size(); ++frame)
+		{
+			m_frame_vertex_buffers[frame].Create(
+				m_graphics_api.get(),
+				size,
+				vk::BufferUsageFlagBits::eVertexBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+			m_frame_vertex_mappings[frame] = m_frame_vertex_buffers[frame].GetMemory().mapMemory(0 /*offset*/, size);
+		}
+
+		m_index_buffer = create_buffer(
+			m_graphics_api.get(),
+			indices,
+			vk::BufferUsageFlagBits::eIndexBuffer);
+	}
+	catch (vk::SystemError const & err)
+	{
+		return std::unexpected{ GraphicsError{ "Mesh::CreateDynamic: failed to create buffers. code: " + std::to_string(err.code().value()) } };
+	}
+
+	m_vertex_stride = sizeof(VertexT);
+	m_vertex_capacity = vertex_capacity;
+	m_index_capacity = static_cast<std::uint32_t>(indices.size());
+
+	m_lods = { MeshLod{ .first_index = 0, .index_count = 0 } };
+	m_meshlets.clear();
+
+	return {};
+}
+
+template <typename VertexT>
+void Mesh::WriteVertices(std::span<VertexT const> vertices, std::uint32_t first_vertex)
+{
+	if (!IsDynamic() || sizeof(VertexT) != m_vertex_stride || first_vertex >= m_vertex_capacity)
+		return;
+
+	std::size_t const count = std::min<std::size_t>(vertices.size(), m_vertex_capacity - first_vertex);
+	void * mapping = m_frame_vertex_mappings[m_graphics_api.get().GetCurFrameIndex()];
+	std::ranges::copy(vertices.first(count), static_cast<VertexT *>(mapping) + first_vertex);
+}
@@ -2,6 +2,8 @@
 
 module;
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <expected>
 #include <filesystem>
@@ -14,6 +16,7 @@ module PipelineBuilder;
 
 import GraphicsApi;
 import GraphicsError;
+import ShaderVariant;
 
 std::expected<std::vector<char>, GraphicsError> read_file(std::filesystem::path const & path)
 {
@@ -58,9 +61,13 @@ PipelineBuilder::PipelineBuilder(GraphicsApi const & graphics_api)
 {
 }
 
-std::expected<void, GraphicsError> PipelineBuilder::LoadShaders(std::filesystem::path const & vs_path, std::filesystem::path const & fs_path)
+std::expected<void, GraphicsError> PipelineBuilder::LoadShaders(
+	std::filesystem::path const & vs_path,
+	std::filesystem::path const & fs_path,
+	ShaderVariant const & variant /*= {}*/)
 {
-	// In Vulkan, the shaders are precompiled to SPIR-V
+	// In Vulkan, the shaders are precompiled to SPIR-V, the variant is applied with specialization constants
+	// when the pipeline is created
 	std::filesystem::path vert_spirv_path = vs_path;
 	vert_spirv_path.replace_extension(".vert.spv");
 	std::expected<vk::raii::ShaderModule, GraphicsError> vert_shader_result = load_shader(vert_spirv_path, m_graphics_api.GetDevice());
@@ -75,6 +82,7 @@ std::expected<void, GraphicsError> PipelineBuilder::LoadShaders(std::filesystem:
 
 	m_vert_shader_module = std::move(vert_shader_result.value());
 	m_frag_shader_module = std::move(frag_shader_result.value());
+	m_shader_variant = variant;
 
 	return {};
 }
@@ -90,24 +98,43 @@ std::expected<GraphicsPipeline, GraphicsError> PipelineBuilder::CreatePipeline()
 	if (!m_cull_mode.has_value())
 		return std::unexpected{ GraphicsError{ "Cull mode not set" } };
 
+	// Every feature is specialized, ids that a shader doesn't declare are ignored
+	constexpr std::size_t feature_count = static_cast<std::size_t>(ShaderFeature::COUNT);
+	std::array<vk::Bool32, feature_count> feature_values;
+	std::array<vk::SpecializationMapEntry, feature_count> feature_entries;
+	for (std::uint32_t i = 0; i < feature_count; ++i)
+	{
+		feature_values[i] = m_shader_variant.Has(static_cast<ShaderFeature>(i)) ? vk::True : vk::False;
+		feature_entries[i] = vk::SpecializationMapEntry{
+			.constantID = i,
+			.offset = static_cast<std::uint32_t>(i * sizeof(vk::Bool32)),
+			.size = sizeof(vk::Bool32)
+		};
+	}
+
+	vk::SpecializationInfo specialization_info{
+		.mapEntryCount = static_cast<std::uint32_t>(feature_entries.size()),
+		.pMapEntries = feature_entries.data(),
+		.dataSize = sizeof(feature_values),
+		.pData = feature_values.data()
+	};
+
 	std::vector<vk::PipelineShaderStageCreateInfo> shader_stages{
 		{
 			.stage = vk::ShaderStageFlagBits::eVertex,
 			.module = *m_vert_shader_module,
-			.pName = "main"
+			.pName = "main",
+			.pSpecializationInfo = &specialization_info
 		},
 		{
 			.stage = vk::ShaderStageFlagBits::eFragment,
 			.module = *m_frag_shader_module,
-			.pName = "main"
+			.pName = "main",
+			.pSpecializationInfo = &specialization_info
 		}
 	};
 
-	GraphicsPipeline pipeline{
-		m_graphics_api,
-		m_per_frame_constants_callback,
-		m_per_object_constants_callback
-	};
+	GraphicsPipeline pipeline{ m_graphics_api };
 
 	std::expected<void, GraphicsError> result = pipeline.Create(
 		shader_stages,
@@ -116,7 +143,9 @@ std::expected<GraphicsPipeline, GraphicsError> PipelineBuilder::CreatePipeline()
 		m_push_constants_ranges,
 		m_vs_uniform_sizes,
 		m_fs_uniform_sizes,
+		m_fs_storage_buffers,
 		m_texture,
+		m_texture_table,
 		m_depth_test_options,
 		m_blend_options,
 		m_cull_mode.value());
@@ -6,6 +6,7 @@ module;
 #include <expected>
 #include <filesystem>
 #include <optional>
+#include <utility>
 #include <vector>
 
 #include <vulkan/vulkan_raii.hpp>
@@ -15,18 +16,22 @@ export module PipelineBuilder;
 import GraphicsApi;
 import GraphicsError;
 import GraphicsPipeline;
+import ShaderVariant;
+import StorageBuffer;
 import Texture;
+import TextureTable;
 import VertexLayout;
 
 export class PipelineBuilder
 {
 public:
-	using PerFrameConstantsCallback = GraphicsPipeline::PerFrameConstantsCallback;
-	using PerObjectConstantsCallback = GraphicsPipeline::PerObjectConstantsCallback;
-
 	explicit PipelineBuilder(GraphicsApi const & graphics_api);
 
-	std::expected<void, GraphicsError> LoadShaders(std::filesystem::path const & vs_path, std::filesystem::path const & fs_path);
+	// Features missing from the variant are compiled out of the shaders, see ShaderVariant
+	std::expected<void, GraphicsError> LoadShaders(
+		std::filesystem::path const & vs_path,
+		std::filesystem::path const & fs_path,
+		ShaderVariant const & variant = {});
 
 	template <Vertex::VertexWithLayout VertexT>
 	void SetVertexType();
@@ -40,14 +45,15 @@ public:
 	template <typename... UniformTypes>
 	void SetFSUniformTypes();
 
+	// Bound after the fs uniforms, in order, the buffers have to outlive the pipeline
+	void SetFSStorageBuffers(std::vector<StorageBuffer const *> storage_buffers) { m_fs_storage_buffers = std::move(storage_buffers); }
 	void SetTexture(Texture const & texture) { m_texture = &texture; }
+	// Textures picked per object by an index into the table, see TextureTable
+	void SetTextureTable(TextureTable const & texture_table) { m_texture_table = &texture_table; }
 	void SetDepthTestOptions(DepthTestOptions const & options) { m_depth_test_options = options; }
 	void SetBlendOptions(BlendOptions const & options) { m_blend_options = options; }
 	void SetCullMode(CullMode cull_mode) { m_cull_mode = cull_mode; }
 
-	void SetPerFrameConstantsCallback(PerFrameConstantsCallback callback) { m_per_frame_constants_callback = callback; }
-	void SetPerObjectConstantsCallback(PerObjectConstantsCallback callback) { m_per_object_constants_callback = callback; }
-
 	std::expected<GraphicsPipeline, GraphicsError> CreatePipeline() const;
 
 private:
@@ -55,6 +61,7 @@ private:
 
 	vk::raii::ShaderModule m_vert_shader_module = nullptr;
 	vk::raii::ShaderModule m_frag_shader_module = nullptr;
+	ShaderVariant m_shader_variant;
 
 	vk::VertexInputBindingDescription m_vert_binding_desc;
 	std::vector<vk::VertexInputAttributeDescription> m_vert_attrib_descs;
@@ -62,7 +69,9 @@ private:
 	std::vector<vk::PushConstantRange> m_push_constants_ranges;
 	std::vector<vk::DeviceSize> m_vs_uniform_sizes;
 	std::vector<vk::DeviceSize> m_fs_uniform_sizes;
+	std::vector<StorageBuffer const *> m_fs_storage_buffers;
 	Texture const * m_texture = nullptr;
+	TextureTable const * m_texture_table = nullptr;
 
 	DepthTestOptions m_depth_test_options;
 	BlendOptions m_blend_options;
@@ -70,9 +79,6 @@ private:
 	// PipelineBuilder does not have a default state for the cull mode, a null optional here means "not set yet".
 	// PipelineBuilder requires the cull mode to be set explicitly because it is a common source of errors.
 	std::optional<CullMode> m_cull_mode;
-
-	PerFrameConstantsCallback m_per_frame_constants_callback;
-	PerObjectConstantsCallback m_per_object_constants_callback;
 };
 
 template <Vertex::VertexWithLayout VertexT>
@@ -2,12 +2,21 @@
 
 module;
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+#include <glm/vec2.hpp>
+
 #include <vulkan/vulkan_raii.hpp>
 
 module Renderer;
 
 Renderer::Renderer(GraphicsApi const & graphics_api)
 	: m_graphics_api(graphics_api)
+	, m_gpu_profiler(graphics_api)
 {
 }
 
@@ -50,26 +59,162 @@ void transition_image_layout(
 	commandBuffer.pipelineBarrier2(dependency_info);
 }
 
-void Renderer::BeginDraw() const
+void Renderer::OnViewportResized(int /*width*/, int /*height*/)
+{
+	// The target is recreated at the new swap chain size when it's needed again
+	if (*m_scene_color_image)
+	{
+		m_graphics_api.WaitForLastFrame();
+		destroy_scene_target();
+	}
+}
+
+void Renderer::SetRenderScale(float scale)
+{
+	m_render_scale = std::clamp(scale, 0.01f, 1.0f);
+}
+
+glm::ivec2 Renderer::GetSceneSize() const
+{
+	vk::Extent2D swap_chain_extent = m_graphics_api.GetSwapChainExtent();
+	return glm::ivec2{
+		std::max(static_cast<int>(std::lround(swap_chain_extent.width * m_render_scale)), 1),
+		std::max(static_cast<int>(std::lround(swap_chain_extent.height * m_render_scale)), 1)
+	};
+}
+
+bool Renderer::create_scene_target()
+{
+	constexpr std::uint32_t layers = 1;
+
+	vk::Extent2D extent = m_graphics_api.GetSwapChainExtent();
+	vk::Format color_format = m_graphics_api.GetSwapChainImageFormat();
+	vk::Format depth_format = m_graphics_api.GetDepthImageFormat();
+
+	try
+	{
+		m_scene_color_image = m_graphics_api.Create2dImage(
+			extent.width,
+			extent.height,
+			layers,
+			color_format,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+			vk::ImageCreateFlags{});
+		m_scene_color_memory = m_graphics_api.CreateImageMemory(m_scene_color_image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		m_scene_color_view = m_graphics_api.CreateImageView(
+			*m_scene_color_image, vk::ImageViewType::e2D, color_format, vk::ImageAspectFlagBits::eColor, layers);
+
+		m_scene_depth_image = m_graphics_api.Create2dImage(
+			extent.width,
+			extent.height,
+			layers,
+			depth_format,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			vk::ImageCreateFlags{});
+		m_scene_depth_memory = m_graphics_api.CreateImageMemory(m_scene_depth_image, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		m_scene_depth_view = m_graphics_api.CreateImageView(
+			*m_scene_depth_image, vk::ImageViewType::e2D, depth_format, vk::ImageAspectFlagBits::eDepth, layers);
+	}
+	catch (vk::SystemError const & err)
+	{
+		std::cout << "Renderer: failed to create the scene target, drawing at native resolution: " << err.what() << std::endl;
+		destroy_scene_target();
+		m_render_scale = 1.0f;
+		return false;
+	}
+
+	return true;
+}
+
+void Renderer::destroy_scene_target()
+{
+	m_scene_color_view.clear();
+	m_scene_color_memory.clear();
+	m_scene_color_image.clear();
+	m_scene_depth_view.clear();
+	m_scene_depth_memory.clear();
+	m_scene_depth_image.clear();
+}
+
+void Renderer::begin_rendering(
+	vk::ImageView color_view,
+	vk::AttachmentLoadOp color_load_op,
+	vk::ImageView depth_view,
+	vk::Extent2D extent) const
+{
+	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.GetCurCommandBuffer();
+
+	vk::RenderingAttachmentInfo attachment_info = {
+		.imageView = color_view,
+		.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+		.loadOp = color_load_op,
+		.storeOp = vk::AttachmentStoreOp::eStore,
+		.clearValue = vk::ClearColorValue(m_clear_color.r, m_clear_color.g, m_clear_color.b, 1.0f)
+	};
+
+	vk::RenderingAttachmentInfo depth_attachment_info = {
+		.imageView = depth_view,
+		.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+		.loadOp = vk::AttachmentLoadOp::eClear,
+		.storeOp = vk::AttachmentStoreOp::eDontCare,
+		.clearValue = vk::ClearDepthStencilValue(1.0f, 0)
+	};
+
+	vk::RenderingInfo rendering_info = {
+		.renderArea = { .offset = { 0, 0 }, .extent = extent },
+		.layerCount = 1,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &attachment_info,
+		.pDepthAttachment = &depth_attachment_info
+	};
+
+	command_buffer.beginRendering(rendering_info);
+
+	command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f,
+		static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+	command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
+}
+
+void Renderer::BeginDraw()
 {
 	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.GetCurCommandBuffer();
 
 	command_buffer.begin({});
+	m_graphics_api.GetStateCache().BeginFrame();
+
+	// Query resets and copies have to be recorded outside of the rendering scope
+	m_gpu_profiler.BeginFrame();
+	m_graphics_api.RecordImageUpdates(command_buffer);
+
+	glm::ivec2 scene_size = GetSceneSize();
+	vk::Extent2D swap_chain_extent = m_graphics_api.GetSwapChainExtent();
+	m_drawing_scene_target = (scene_size.x != static_cast<int>(swap_chain_extent.width) || scene_size.y != static_cast<int>(swap_chain_extent.height))
+		&& (*m_scene_color_image || create_scene_target());
+
+	vk::Image color_image = m_drawing_scene_target ? *m_scene_color_image : m_graphics_api.GetCurSwapChainImage();
+	vk::Image depth_image = m_drawing_scene_target ? *m_scene_depth_image : *m_graphics_api.GetDepthImage();
+
+	// The scene target is shared by the frames in flight, so the previous frame's blit has to be done reading it
+	vk::PipelineStageFlags2 color_src_stage = m_drawing_scene_target
+		? vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eBlit
+		: vk::PipelineStageFlagBits2::eColorAttachmentOutput;
 
 	transition_image_layout(
 		command_buffer,
-		m_graphics_api.GetCurSwapChainImage(),
+		color_image,
 		vk::ImageLayout::eUndefined,
 		vk::ImageLayout::eColorAttachmentOptimal,
 		{},                                                        // src_access_mask (no need to wait for previous operations)
 		vk::AccessFlagBits2::eColorAttachmentWrite,                // dst_access_mask
-		vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // src_stage_mask
+		color_src_stage,                                           // src_stage_mask
 		vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // dst_stage_mask
 		vk::ImageAspectFlagBits::eColor);
 
 	transition_image_layout(
 		command_buffer,
-		*m_graphics_api.GetDepthImage(),
+		depth_image,
 		vk::ImageLayout::eUndefined,
 		vk::ImageLayout::eDepthAttachmentOptimal,
 		vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
@@ -78,40 +223,104 @@ void Renderer::BeginDraw() const
 		vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
 		vk::ImageAspectFlagBits::eDepth);
 
-	vk::RenderingAttachmentInfo attachment_info = {
-		.imageView = m_graphics_api.GetCurSwapChainImageView(),
-		.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-		.loadOp = vk::AttachmentLoadOp::eClear,
-		.storeOp = vk::AttachmentStoreOp::eStore,
-		.clearValue = vk::ClearColorValue(m_clear_color.r, m_clear_color.g, m_clear_color.b, 1.0f)
-	};
+	if (m_drawing_scene_target)
+	{
+		// Only the top left scene_size corner of the target is drawn to
+		begin_rendering(*m_scene_color_view, vk::AttachmentLoadOp::eClear, *m_scene_depth_view,
+			vk::Extent2D{ static_cast<std::uint32_t>(scene_size.x), static_cast<std::uint32_t>(scene_size.y) });
+	}
+	else
+	{
+		begin_rendering(*m_graphics_api.GetCurSwapChainImageView(), vk::AttachmentLoadOp::eClear,
+			*m_graphics_api.GetDepthImageView(), swap_chain_extent);
+	}
+}
 
-	vk::RenderingAttachmentInfo depth_attachment_info = {
-		.imageView = m_graphics_api.GetDepthImageView(),
-		.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
-		.loadOp = vk::AttachmentLoadOp::eClear,
-		.storeOp = vk::AttachmentStoreOp::eDontCare,
-		.clearValue = vk::ClearDepthStencilValue(1.0f, 0)
-	};
+void Renderer::BeginOverlay()
+{
+	if (!m_drawing_scene_target)
+		return;
+	m_drawing_scene_target = false;
+
+	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.GetCurCommandBuffer();
+
+	command_buffer.endRendering();
+
+	transition_image_layout(
+		command_buffer,
+		*m_scene_color_image,
+		vk::ImageLayout::eColorAttachmentOptimal,
+		vk::ImageLayout::eTransferSrcOptimal,
+		vk::AccessFlagBits2::eColorAttachmentWrite,
+		vk::AccessFlagBits2::eTransferRead,
+		vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		vk::PipelineStageFlagBits2::eBlit,
+		vk::ImageAspectFlagBits::eColor);
+
+	// The swap chain image is acquired at the color attachment output stage, see GraphicsApi::DrawFrame
+	transition_image_layout(
+		command_buffer,
+		m_graphics_api.GetCurSwapChainImage(),
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eTransferDstOptimal,
+		{},
+		vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		vk::PipelineStageFlagBits2::eBlit,
+		vk::ImageAspectFlagBits::eColor);
 
+	glm::ivec2 scene_size = GetSceneSize();
 	vk::Extent2D swap_chain_extent = m_graphics_api.GetSwapChainExtent();
-	vk::RenderingInfo rendering_info = {
-		.renderArea = { .offset = { 0, 0 }, .extent = swap_chain_extent },
-		.layerCount = 1,
-		.colorAttachmentCount = 1,
-		.pColorAttachments = &attachment_info,
-		.pDepthAttachment = &depth_attachment_info
+	vk::ImageSubresourceLayers subresource{
+		.aspectMask = vk::ImageAspectFlagBits::eColor,
+		.mipLevel = 0,
+		.baseArrayLayer = 0,
+		.layerCount = 1
 	};
+	vk::ImageBlit blit{
+		.srcSubresource = subresource,
+		.srcOffsets = std::array{ vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ scene_size.x, scene_size.y, 1 } },
+		.dstSubresource = subresource,
+		.dstOffsets = std::array{ vk::Offset3D{ 0, 0, 0 },
+			vk::Offset3D{ static_cast<std::int32_t>(swap_chain_extent.width), static_cast<std::int32_t>(swap_chain_extent.height), 1 } }
+	};
+	command_buffer.blitImage(
+		*m_scene_color_image, vk::ImageLayout::eTransferSrcOptimal,
+		m_graphics_api.GetCurSwapChainImage(), vk::ImageLayout::eTransferDstOptimal,
+		blit,
+		vk::Filter::eLinear);
 
-	command_buffer.beginRendering(rendering_info);
+	transition_image_layout(
+		command_buffer,
+		m_graphics_api.GetCurSwapChainImage(),
+		vk::ImageLayout::eTransferDstOptimal,
+		vk::ImageLayout::eColorAttachmentOptimal,
+		vk::AccessFlagBits2::eTransferWrite,
+		vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+		vk::PipelineStageFlagBits2::eBlit,
+		vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		vk::ImageAspectFlagBits::eColor);
 
-	command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f,
-		static_cast<float>(swap_chain_extent.width), static_cast<float>(swap_chain_extent.height), 0.0f, 1.0f));
-	command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swap_chain_extent));
+	// The overlay pipelines are created with a depth format too, so they need a depth attachment
+	transition_image_layout(
+		command_buffer,
+		*m_graphics_api.GetDepthImage(),
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eDepthAttachmentOptimal,
+		vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+		vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+		vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+		vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+		vk::ImageAspectFlagBits::eDepth);
+
+	begin_rendering(*m_graphics_api.GetCurSwapChainImageView(), vk::AttachmentLoadOp::eLoad,
+		*m_graphics_api.GetDepthImageView(), swap_chain_extent);
 }
 
-void Renderer::EndDraw() const
+void Renderer::EndDraw()
 {
+	BeginOverlay(); // in case nothing was drawn in the overlay
+
 	vk::raii::CommandBuffer const & command_buffer = m_graphics_api.GetCurCommandBuffer();
 
 	command_buffer.endRendering();
@@ -127,5 +336,7 @@ void Renderer::EndDraw() const
 		vk::PipelineStageFlagBits2::eBottomOfPipe,              // dst_stage_mask
 		vk::ImageAspectFlagBits::eColor);
 
+	m_gpu_profiler.EndFrame();
+
 	command_buffer.end();
 }
@@ -2,25 +2,73 @@
 
 module;
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
+#include <vulkan/vulkan_raii.hpp>
+
 export module Renderer;
 
+import GpuProfiler;
 import GraphicsApi;
 import GraphicsError;
+import StateCache;
 
+// Records a frame in two parts: the scene passes between BeginDraw and BeginOverlay, and the overlay (2d text) between
+// BeginOverlay and EndDraw. With a render scale below 1 the scene is drawn to an offscreen target at the scaled
+// resolution, which BeginOverlay upscales to the swap chain image with a filtered blit, the overlay stays at native resolution.
 export class Renderer
 {
 public:
 	explicit Renderer(GraphicsApi const & graphics_api);
 
-	void BeginDraw() const;
-	void EndDraw() const;
+	// Call after the swap chain was recreated
+	void OnViewportResized(int width, int height);
+
+	// Clamped to (0, 1], see ResolutionScaler
+	void SetRenderScale(float scale);
+	float GetRenderScale() const { return m_render_scale; }
+	// Resolution the scene passes are drawn at
+	glm::ivec2 GetSceneSize() const;
+
+	void BeginDraw();
+	void BeginOverlay();
+	void EndDraw();
 
 	void SetClearColor(glm::vec3 const & color) { m_clear_color = color; }
 
+	GpuProfiler & GetGpuProfiler() { return m_gpu_profiler; }
+	GpuProfiler const & GetGpuProfiler() const { return m_gpu_profiler; }
+
+	// Counts of binds issued and skipped as redundant during the last frame
+	StateCounters const & GetStateCounters() const { return m_graphics_api.GetStateCache().GetLastFrameCounters(); }
+
+private:
+	bool create_scene_target();
+	void destroy_scene_target();
+
+	void begin_rendering(
+		vk::ImageView color_view,
+		vk::AttachmentLoadOp color_load_op,
+		vk::ImageView depth_view,
+		vk::Extent2D extent) const;
+
 private:
 	GraphicsApi const & m_graphics_api;
 
 	glm::vec3 m_clear_color;
+
+	GpuProfiler m_gpu_profiler;
+
+	float m_render_scale = 1.0f;
+
+	// Created at the swap chain size the first time the scale drops below 1, a scaled frame only draws to part of it.
+	// Same formats as the swap chain and its depth image, so the pipelines don't depend on where they draw.
+	vk::raii::Image m_scene_color_image = nullptr;
+	vk::raii::DeviceMemory m_scene_color_memory = nullptr;
+	vk::raii::ImageView m_scene_color_view = nullptr;
+	vk::raii::Image m_scene_depth_image = nullptr;
+	vk::raii::DeviceMemory m_scene_depth_memory = nullptr;
+	vk::raii::ImageView m_scene_depth_view = nullptr;
+	bool m_drawing_scene_target = false;
 };
@@ -0,0 +1,129 @@
+// StateCache.cpp
+
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan/vulkan_raii.hpp>
+
+module StateCache;
+
+void StateCache::BeginFrame()
+{
+	m_last_frame_counters = m_counters;
+	m_counters = StateCounters{};
+
+	m_pipeline = nullptr;
+	m_descriptor_layout = nullptr;
+	m_descriptor_sets.fill(nullptr);
+	m_vertex_buffer = nullptr;
+	m_index_buffer = nullptr;
+
+	m_push_constants_layout = nullptr;
+	m_push_constants_valid.fill(false);
+}
+
+void StateCache::BindPipeline(vk::raii::CommandBuffer const & command_buffer, vk::Pipeline pipeline)
+{
+	if (pipeline == m_pipeline)
+	{
+		++m_counters.skipped;
+		return;
+	}
+
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+	++m_counters.issued;
+
+	m_pipeline = pipeline;
+}
+
+void StateCache::BindDescriptorSet(
+	vk::raii::CommandBuffer const & command_buffer,
+	vk::PipelineLayout layout,
+	std::uint32_t set_index,
+	vk::DescriptorSet descriptor_set)
+{
+	// Each pipeline has its own set 0 layout, so its layout isn't compatible with any other and every set has to be rebound
+	if (layout != m_descriptor_layout)
+	{
+		m_descriptor_layout = layout;
+		m_descriptor_sets.fill(nullptr);
+	}
+
+	if (set_index < m_max_descriptor_sets && descriptor_set == m_descriptor_sets[set_index])
+	{
+		++m_counters.skipped;
+		return;
+	}
+
+	command_buffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eGraphics,
+		layout,
+		set_index /*firstSet*/,
+		descriptor_set,
+		{} /*dynamicOffsets*/);
+	++m_counters.issued;
+
+	if (set_index < m_max_descriptor_sets)
+		m_descriptor_sets[set_index] = descriptor_set;
+}
+
+void StateCache::BindVertexBuffer(vk::raii::CommandBuffer const & command_buffer, vk::Buffer buffer)
+{
+	if (buffer == m_vertex_buffer)
+	{
+		++m_counters.skipped;
+		return;
+	}
+
+	command_buffer.bindVertexBuffers(0 /*firstBinding*/, buffer, vk::DeviceSize{ 0 } /*offsets*/);
+	++m_counters.issued;
+
+	m_vertex_buffer = buffer;
+}
+
+void StateCache::BindIndexBuffer(vk::raii::CommandBuffer const & command_buffer, vk::Buffer buffer, vk::IndexType index_type)
+{
+	if (buffer == m_index_buffer && index_type == m_index_type)
+	{
+		++m_counters.skipped;
+		return;
+	}
+
+	command_buffer.bindIndexBuffer(buffer, vk::DeviceSize{ 0 } /*offset*/, index_type);
+	++m_counters.issued;
+
+	m_index_buffer = buffer;
+	m_index_type = index_type;
+}
+
+bool StateCache::push_constants_changed(vk::PipelineLayout layout, std::uint32_t offset, std::uint32_t size, void const * data)
+{
+	// Push constants are only guaranteed to be kept across pipelines with compatible layouts, be conservative
+	if (layout != m_push_constants_layout)
+	{
+		m_push_constants_layout = layout;
+		m_push_constants_valid.fill(false);
+	}
+
+	if (offset + size > m_max_push_constants_size)
+	{
+		++m_counters.issued;
+		return true;
+	}
+
+	bool known = std::all_of(m_push_constants_valid.begin() + offset, m_push_constants_valid.begin() + offset + size,
+		[](bool valid) { return valid; });
+	if (known && std::memcmp(m_push_constants.data() + offset, data, size) == 0)
+	{
+		++m_counters.skipped;
+		return false;
+	}
+
+	std::memcpy(m_push_constants.data() + offset, data, size);
+	std::fill(m_push_constants_valid.begin() + offset, m_push_constants_valid.begin() + offset + size, true);
+	++m_counters.issued;
+	return true;
+}
@@ -0,0 +1,85 @@
+// StateCache.ixx
+
+module;
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan/vulkan_raii.hpp>
+
+export module StateCache;
+
+export struct StateCounters
+{
+	std::uint32_t issued = 0;
+	std::uint32_t skipped = 0;
+};
+
+// Tracks what has been bound in the command buffer being recorded, binds and push constants that
+// wouldn't change anything are skipped. A new command buffer starts with nothing bound, so BeginFrame()
+// has to be called whenever recording begins.
+export class StateCache
+{
+public:
+	// The minimum maxPushConstantsSize guaranteed by the spec, and all the demo pipelines need
+	constexpr static std::uint32_t m_max_push_constants_size = 128;
+	constexpr static std::uint32_t m_max_descriptor_sets = 4;
+
+public:
+	// Publishes the counters of the previous frame and forgets all state
+	void BeginFrame();
+
+	void BindPipeline(vk::raii::CommandBuffer const & command_buffer, vk::Pipeline pipeline);
+	void BindDescriptorSet(
+		vk::raii::CommandBuffer const & command_buffer,
+		vk::PipelineLayout layout,
+		std::uint32_t set_index,
+		vk::DescriptorSet descriptor_set);
+	void BindVertexBuffer(vk::raii::CommandBuffer const & command_buffer, vk::Buffer buffer);
+	void BindIndexBuffer(vk::raii::CommandBuffer const & command_buffer, vk::Buffer buffer, vk::IndexType index_type);
+
+	template <typename T>
+	void PushConstants(
+		vk::raii::CommandBuffer const & command_buffer,
+		vk::PipelineLayout layout,
+		vk::ShaderStageFlags stages,
+		std::uint32_t offset,
+		T const & data);
+
+	StateCounters const & GetLastFrameCounters() const { return m_last_frame_counters; }
+
+private:
+	bool push_constants_changed(vk::PipelineLayout layout, std::uint32_t offset, std::uint32_t size, void const * data);
+
+private:
+	vk::Pipeline m_pipeline;
+	// Sets bound with a different layout are treated as disturbed, the pipelines don't share set layouts
+	vk::PipelineLayout m_descriptor_layout;
+	std::array<vk::DescriptorSet, m_max_descriptor_sets> m_descriptor_sets{};
+	vk::Buffer m_vertex_buffer;
+	vk::Buffer m_index_buffer;
+	vk::IndexType m_index_type = vk::IndexType::eUint16;
+
+	// Shadow of the push constant block of the current layout, only the bytes in m_push_constants_valid are known
+	vk::PipelineLayout m_push_constants_layout;
+	std::array<std::byte, m_max_push_constants_size> m_push_constants{};
+	std::array<bool, m_max_push_constants_size> m_push_constants_valid{};
+
+	StateCounters m_counters;
+	StateCounters m_last_frame_counters;
+};
+
+template <typename T>
+void StateCache::PushConstants(
+	vk::raii::CommandBuffer const & command_buffer,
+	vk::PipelineLayout layout,
+	vk::ShaderStageFlags stages,
+	std::uint32_t offset,
+	T const & data)
+{
+	if (!push_constants_changed(layout, offset, static_cast<std::uint32_t>(sizeof(T)), &data))
+		return;
+
+	command_buffer.pushConstants<T>(layout, stages, offset, data);
+}
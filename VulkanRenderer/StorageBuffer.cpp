@@ -0,0 +1,50 @@
+// StorageBuffer.cpp
+
+module;
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <expected>
+#include <string>
+
+#include <vulkan/vulkan_raii.hpp>
+
+module StorageBuffer;
+
+std::expected<void, GraphicsError> StorageBuffer::Create(std::size_t size)
+{
+	if (size == 0)
+		return std::unexpected{ GraphicsError{ "StorageBuffer::Create: size must not be 0" } };
+
+	try
+	{
+		for (FrameBuffer & frame_buffer : m_frame_buffers)
+		{
+			frame_buffer.buffer.Create(
+				m_graphics_api.get(),
+				size,
+				vk::BufferUsageFlagBits::eStorageBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+			frame_buffer.mapping = frame_buffer.buffer.GetMemory().mapMemory(0 /*offset*/, size);
+		}
+	}
+	catch (vk::SystemError const & err)
+	{
+		return std::unexpected{ GraphicsError{ "Vulkan error: " + std::string(err.what()) } };
+	}
+
+	m_size = size;
+	return {};
+}
+
+void StorageBuffer::Update(void const * data, std::size_t size, std::size_t offset /*= 0*/)
+{
+	if (!IsValid() || offset >= m_size)
+		return;
+
+	size = std::min(size, m_size - offset);
+	FrameBuffer const & frame_buffer = m_frame_buffers[m_graphics_api.get().GetCurFrameIndex()];
+	std::memcpy(static_cast<std::byte *>(frame_buffer.mapping) + offset, data, size);
+}
@@ -0,0 +1,50 @@
+// StorageBuffer.ixx
+
+module;
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+
+#include <vulkan/vulkan_raii.hpp>
+
+export module StorageBuffer;
+
+import Buffer;
+import GraphicsApi;
+import GraphicsError;
+
+// Shader storage buffer that is rewritten every frame, pipelines bind it with PipelineBuilder::SetFSStorageBuffers.
+// There is one host visible copy per frame in flight, an update only touches the copy of the current frame,
+// so it has to happen while the frame is recorded, after its fence was waited on.
+export class StorageBuffer
+{
+public:
+	explicit StorageBuffer(GraphicsApi const & graphics_api) : m_graphics_api(graphics_api) {}
+
+	StorageBuffer(StorageBuffer const &) = delete;
+	StorageBuffer & operator=(StorageBuffer const &) = delete;
+
+	std::expected<void, GraphicsError> Create(std::size_t size);
+
+	// Data past the end of the buffer is dropped
+	void Update(void const * data, std::size_t size, std::size_t offset = 0);
+
+	bool IsValid() const { return m_size != 0; }
+	std::size_t GetSize() const { return m_size; }
+	vk::Buffer GetBuffer(std::uint32_t frame_index) const { return *m_frame_buffers[frame_index].buffer.Get(); }
+
+private:
+	struct FrameBuffer
+	{
+		Buffer buffer;
+		void * mapping{ nullptr };
+	};
+
+	std::reference_wrapper<GraphicsApi const> m_graphics_api;
+
+	std::array<FrameBuffer, GraphicsApi::m_max_frames_in_flight> m_frame_buffers;
+	std::size_t m_size = 0;
+};
@@ -4,9 +4,11 @@ module;
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <expected>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -191,6 +193,7 @@ std::expected<void, GraphicsError> Texture::Create(GraphicsApi const & graphics_
 		return std::unexpected{ GraphicsError{ "Texture::Create: Failed to create texture. " + std::string(err.what()) } };
 	}
 
+	m_format = format;
 	m_width = image_data.width;
 	m_height = image_data.height;
 
@@ -241,12 +244,49 @@ std::expected<void, GraphicsError> Texture::Create(GraphicsApi const & graphics_
 		return std::unexpected{ GraphicsError{ "Texture::Create: Failed to create cube texture. " + std::string(err.what()) } };
 	}
 
+	m_format = format;
 	m_width = image_data.width;
 	m_height = image_data.height;
 
 	return {};
 }
 
+std::expected<void, GraphicsError> Texture::Update(GraphicsApi const & graphics_api, ImageData const & image_data, std::uint32_t x, std::uint32_t y)
+{
+	if (!image_data.IsValid())
+		return std::unexpected{ GraphicsError{ "Texture::Update: image_data not valid" } };
+	if (!IsValid() || x + image_data.width > m_width || y + image_data.height > m_height)
+		return std::unexpected{ GraphicsError{ "Texture::Update: region outside of the texture" } };
+	if (to_vk_format(image_data.format) != m_format)
+		return std::unexpected{ GraphicsError{ "Texture::Update: the image's format differs from the texture's" } };
+
+	// Recorded into the next frame's command buffer, ordered after the frames already submitted sampling the region
+	std::size_t const pixel_count = static_cast<std::size_t>(image_data.width) * image_data.height;
+	std::span<std::byte> texels = graphics_api.QueueImageUpdate(
+		*m_image,
+		vk::Offset2D{ static_cast<std::int32_t>(x), static_cast<std::int32_t>(y) },
+		vk::Extent2D{ image_data.width, image_data.height },
+		image_data.format == PixelFormat::RGB_UNORM ? pixel_count * 4 : image_data.GetSize());
+
+	if (image_data.format == PixelFormat::RGB_UNORM)
+	{
+		// The texture is RGBA, see to_vk_format
+		for (std::size_t i = 0; i < pixel_count; ++i)
+		{
+			texels[i * 4 + 0] = static_cast<std::byte>(image_data.data[i * 3 + 0]);
+			texels[i * 4 + 1] = static_cast<std::byte>(image_data.data[i * 3 + 1]);
+			texels[i * 4 + 2] = static_cast<std::byte>(image_data.data[i * 3 + 2]);
+			texels[i * 4 + 3] = std::byte{ 255 }; // Opaque alpha
+		}
+	}
+	else
+	{
+		std::memcpy(texels.data(), image_data.data, texels.size());
+	}
+
+	return {};
+}
+
 bool Texture::IsValid() const
 {
 	return m_image != nullptr
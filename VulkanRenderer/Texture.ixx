@@ -60,6 +60,11 @@ public:
 	std::expected<void, GraphicsError> Create(GraphicsApi const & graphics_api, ImageData const & image_data, bool use_mip_map = true);
 	std::expected<void, GraphicsError> Create(GraphicsApi const & graphics_api, CubeImageData const & image_data);
 
+	// Overwrites the region of a 2d texture at x, y with the image, which has the format the texture was created with.
+	// Only the first mip level is written, so it's meant for textures created without mip maps.
+	// The copy is recorded at the start of the next frame, the texture has to live until that frame is done.
+	std::expected<void, GraphicsError> Update(GraphicsApi const & graphics_api, ImageData const & image_data, std::uint32_t x, std::uint32_t y);
+
 	bool IsValid() const;
 
 	vk::raii::ImageView const & GetImageView() const { return m_image_view; }
@@ -73,6 +78,7 @@ private:
 	vk::raii::DeviceMemory m_image_memory = nullptr;
 	vk::raii::ImageView m_image_view = nullptr;
 	vk::raii::Sampler m_sampler = nullptr;
+	vk::Format m_format = vk::Format::eUndefined;
 	std::uint32_t m_width = 0;
 	std::uint32_t m_height = 0;
 };
@@ -0,0 +1,96 @@
+// TextureTable.cpp
+
+module;
+
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+module TextureTable;
+
+TextureTable::TextureTable(GraphicsApi const & graphics_api)
+	: m_graphics_api(graphics_api)
+{
+	vk::raii::Device const & device = m_graphics_api.GetDevice();
+
+	vk::DescriptorSetLayoutBinding layout_binding{
+		.binding = 0,
+		.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+		.descriptorCount = m_max_textures,
+		.stageFlags = vk::ShaderStageFlagBits::eFragment,
+		.pImmutableSamplers = nullptr
+	};
+
+	// Slots that were never written are fine as long as the shaders don't sample them
+	vk::DescriptorBindingFlags binding_flags = vk::DescriptorBindingFlagBits::ePartiallyBound
+		| vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+
+	vk::StructureChain<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayoutBindingFlagsCreateInfo> layout_info{
+		{
+			.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+			.bindingCount = 1,
+			.pBindings = &layout_binding
+		},
+		{
+			.bindingCount = 1,
+			.pBindingFlags = &binding_flags
+		}
+	};
+	m_descriptor_set_layout = vk::raii::DescriptorSetLayout{ device, layout_info.get<vk::DescriptorSetLayoutCreateInfo>() };
+
+	vk::DescriptorPoolSize pool_size{
+		.type = vk::DescriptorType::eCombinedImageSampler,
+		.descriptorCount = m_max_textures
+	};
+
+	vk::DescriptorPoolCreateInfo pool_info{
+		.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet | vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size
+	};
+	m_descriptor_pool = vk::raii::DescriptorPool{ device, pool_info };
+
+	vk::DescriptorSetLayout layout = *m_descriptor_set_layout;
+	vk::DescriptorSetAllocateInfo alloc_info{
+		.descriptorPool = *m_descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &layout
+	};
+
+	std::vector<vk::raii::DescriptorSet> descriptor_sets = device.allocateDescriptorSets(alloc_info);
+	m_descriptor_set = std::move(descriptor_sets.front());
+}
+
+std::expected<std::uint32_t, GraphicsError> TextureTable::Add(Texture const & texture)
+{
+	if (!texture.IsValid())
+		return std::unexpected{ GraphicsError{ "TextureTable::Add: invalid texture" } };
+	if (m_size == m_max_textures)
+		return std::unexpected{ GraphicsError{ "TextureTable::Add: table is full (" + std::to_string(m_max_textures) + " textures)" } };
+
+	vk::DescriptorImageInfo image_info{
+		.sampler = *texture.GetSampler(),
+		.imageView = *texture.GetImageView(),
+		.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+	};
+
+	vk::WriteDescriptorSet descriptor_write{
+		.dstSet = *m_descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = m_size,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+		.pImageInfo = &image_info,
+		.pBufferInfo = nullptr,
+		.pTexelBufferView = nullptr
+	};
+
+	m_graphics_api.GetDevice().updateDescriptorSets(descriptor_write, {});
+
+	return m_size++;
+}
@@ -0,0 +1,49 @@
+// TextureTable.ixx
+
+module;
+
+#include <cstdint>
+#include <expected>
+
+#include <vulkan/vulkan_raii.hpp>
+
+export module TextureTable;
+
+import GraphicsApi;
+import GraphicsError;
+import Texture;
+
+// A single descriptor set holding an array of all the 2d textures a scene uses. Pipelines created with the table
+// get it as set 1 and pick their texture with an index from the object data, so one pipeline can draw any number of
+// differently textured objects. The binding is partially bound and update-after-bind, so textures can be added while
+// earlier frames that use the set are still in flight.
+export class TextureTable
+{
+public:
+	// Has to match the array size of the texture table in the shaders
+	constexpr static std::uint32_t m_max_textures = 1024;
+	constexpr static std::uint32_t m_descriptor_set_index = 1;
+
+public:
+	explicit TextureTable(GraphicsApi const & graphics_api);
+
+	TextureTable(TextureTable const &) = delete;
+	TextureTable & operator=(TextureTable const &) = delete;
+
+	// Returns the index the shaders use to sample the texture, the texture has to outlive the table
+	std::expected<std::uint32_t, GraphicsError> Add(Texture const & texture);
+
+	std::uint32_t GetSize() const { return m_size; }
+
+	vk::DescriptorSetLayout GetLayout() const { return *m_descriptor_set_layout; }
+	vk::DescriptorSet GetDescriptorSet() const { return *m_descriptor_set; }
+
+private:
+	GraphicsApi const & m_graphics_api;
+
+	vk::raii::DescriptorSetLayout m_descriptor_set_layout = nullptr;
+	vk::raii::DescriptorPool m_descriptor_pool = nullptr;
+	vk::raii::DescriptorSet m_descriptor_set = nullptr;
+
+	std::uint32_t m_size = 0;
+};
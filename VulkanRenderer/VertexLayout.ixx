@@ -19,6 +19,13 @@ namespace Vertex
 		Float4,
 	};
 
+	// Instance attributes advance once per instance, e.g. a quad expanded in the vertex shader for every glyph
+	export enum class InputRate
+	{
+		Vertex,
+		Instance,
+	};
+
 	export struct AttributeDesc
 	{
 		AttributeType type;
@@ -30,6 +37,7 @@ namespace Vertex
 	{
 		std::size_t stride;
 		std::vector<AttributeDesc> attributes;
+		InputRate input_rate = InputRate::Vertex;
 	};
 
 	export template<typename VertexT>
@@ -60,7 +68,7 @@ namespace Vertex
 		return vk::VertexInputBindingDescription{
 			.binding = 0,
 			.stride = static_cast<std::uint32_t>(layout.stride),
-			.inputRate = vk::VertexInputRate::eVertex
+			.inputRate = layout.input_rate == InputRate::Instance ? vk::VertexInputRate::eInstance : vk::VertexInputRate::eVertex
 		};
 	}
 